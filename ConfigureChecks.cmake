@@ -5,6 +5,7 @@ include(DefineInstallationPaths)
 include(CheckIncludeFileCXX)
 include(CheckFunctionExists)
 include(CheckSymbolExists)
+include(CheckCXXSymbolExists)
 include(CheckLibraryExists)
 include(CheckCXXCompilerFlag)
 include(CheckMkdirArgs)
@@ -114,6 +115,7 @@ check_include_file_cxx(sys/file.h HAVE_SYS_FILE_H)
 
 message(STATUS "Checking Linux headers")
 check_include_file_cxx(sys/epoll.h HAVE_SYS_EPOLL_H)
+check_include_file_cxx(linux/io_uring.h HAVE_LINUX_IO_URING_H)
 
 message(STATUS "Checking Win32 headers")
 check_include_file_cxx(windows.h HAVE_WINDOWS_H)
@@ -131,7 +133,9 @@ check_include_file_cxx(sys/poll.h HAVE_SYS_POLL_H)
 
 check_function_exists(chdir HAVE_CHDIR)
 check_function_exists(epoll_create HAVE_EPOLL_CREATE)
+check_cxx_symbol_exists(IORING_ENTER_EXT_ARG linux/io_uring.h HAVE_IORING_ENTER_EXT_ARG)
 check_function_exists(fork HAVE_FORK)
+check_function_exists(fsync HAVE_FSYNC)
 check_function_exists(ftime HAVE_FTIME)
 check_function_exists(getgid HAVE_GETGID)
 check_function_exists(getgrnam HAVE_GETGRNAM)
@@ -149,6 +153,8 @@ check_function_exists(mkdir HAVE_MKDIR)
 check_function_exists(mmap HAVE_MMAP)
 check_function_exists(pipe HAVE_PIPE)
 check_function_exists(poll HAVE_POLL)
+check_function_exists(recvmmsg HAVE_RECVMMSG)
+check_function_exists(sendmmsg HAVE_SENDMMSG)
 check_function_exists(setitimer HAVE_SETITIMER)
 check_function_exists(setpgid HAVE_SETPGID)
 check_function_exists(setpgrp HAVE_SETPGRP)
@@ -163,6 +169,7 @@ check_function_exists(stricmp HAVE_STRICMP)
 check_function_exists(strncasecmp HAVE_STRNCASECMP)
 check_function_exists(strnicmp HAVE_STRNICMP)
 check_function_exists(strsep HAVE_STRSEP)
+check_function_exists(syncfs HAVE_SYNCFS)
 check_function_exists(uname HAVE_UNAME)
 check_function_exists(wait HAVE_WAIT)
 check_function_exists(waitpid HAVE_WAITPID)
@@ -30,6 +30,7 @@
 #cmakedefine HAVE_SYS_MMAN_H
 #cmakedefine HAVE_SYS_EVENT_H
 #cmakedefine HAVE_SYS_EPOLL_H
+#cmakedefine HAVE_LINUX_IO_URING_H
 #cmakedefine HAVE_SYS_RESOURCE_H
 #cmakedefine HAVE_WINDOWS_H
 #cmakedefine HAVE_WINSOCK2_H
@@ -38,7 +39,9 @@
 
 #cmakedefine HAVE_CHDIR
 #cmakedefine HAVE_EPOLL_CREATE
+#cmakedefine HAVE_IORING_ENTER_EXT_ARG
 #cmakedefine HAVE_FORK
+#cmakedefine HAVE_FSYNC
 #cmakedefine HAVE_FTIME
 #cmakedefine HAVE_GETGID
 #cmakedefine HAVE_GETGRNAM
@@ -59,11 +62,13 @@
 #cmakedefine HAVE_MMAP
 #cmakedefine HAVE_PIPE
 #cmakedefine HAVE_POLL
+#cmakedefine HAVE_RECVMMSG
 #cmakedefine HAVE_RECV
 #cmakedefine HAVE_RECVFROM
 #cmakedefine HAVE_SELECT
 #cmakedefine HAVE_SEND
 #cmakedefine HAVE_SENDTO
+#cmakedefine HAVE_SENDMMSG
 #cmakedefine HAVE_SETITIMER
 #cmakedefine HAVE_SETPGID
 #cmakedefine HAVE_SETPGRP
@@ -79,6 +84,7 @@
 #cmakedefine HAVE_STRNCASECMP
 #cmakedefine HAVE_STRNICMP
 #cmakedefine HAVE_STRSEP
+#cmakedefine HAVE_SYNCFS
 #cmakedefine HAVE_UNAME
 #cmakedefine HAVE_WAIT
 #cmakedefine HAVE_WAITPID
@@ -24,8 +24,8 @@ end
 
 -- send memory check request to all players in games
 function ah_timer_tick(options)
-	-- iterate all games
-	for i,game in pairs(api.server_get_games()) do
+	-- iterate all games, a slice of them per main loop iteration
+	async_games(function(game)
 		-- check only Starcraft: BroodWar
 		if game.clienttag and (game.clienttag == CLIENTTAG_BROODWARS) then
 			-- check only games where count of players > 1
@@ -39,7 +39,7 @@ function ah_timer_tick(options)
 				end
 			end
 		end
-    end
+	end)
 end
 
 -- handle response from the client
@@ -54,7 +54,8 @@ function handle_command(account, text)
 				-- FIXME: we can use _G[func] if func is a text but not a function, 
 				--        like ["/dotastats"] = "command_dotastats"
 				--        and function command_dotastats can be defined below, not only before
-				return func(account, text) 
+				-- a command that sleeps goes on later and counts as handled
+				return async_call(0, func, account, text)
 			end
 		end
 	end
@@ -83,6 +84,19 @@ function handle_command_before(account, text)
 end
 
 
+-- Tell the server which commands handle_command wants to see,
+--  all others are not passed to Lua at all
+function command_subscribe()
+	local commands = {}
+	for cg,cmdlist in pairs(lua_command_table) do
+		for cmd,func in pairs(cmdlist) do
+			table.insert(commands, cmd)
+		end
+	end
+	api.subscribe("handle_command", commands)
+end
+
+
 -- Split command to arguments, 
 --  index 0 is always a command name without a slash 
 --  return table with arguments
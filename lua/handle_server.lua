@@ -7,14 +7,10 @@
 
 
 -- Loop each second
-function handle_server_mainloop()
-	-- Tick all timers
-	for t in pairs(__timers) do
-		__timers[t]:tick()
-	end
-	
-	-- DEBUG(os.time())
-end
+-- (the timers of timer_add() tick on their own, see async.lua)
+--function handle_server_mainloop()
+--	DEBUG(os.time())
+--end
 
 
 -- When restart Lua VM
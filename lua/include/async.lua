@@ -0,0 +1,172 @@
+--[[
+	This file is a part of the PvPGN Project http://pvpgn.pro
+	Licensed under the same terms as Lua itself.
+]]--
+
+
+--
+-- Coroutines on the server timers
+--
+-- Code started with async() can wait with sleep() without blocking the
+-- server; after() and every() run a function later or periodically and
+-- async_users(), async_games() and async_channels() walk the big lists
+-- a slice per main loop iteration.
+--
+--   every(60, function()
+--       async_users(function(account)
+--           ...
+--       end)
+--   end)
+--
+
+local unpack = table.unpack or unpack
+
+-- Coroutines and functions waiting for a timer, by the id of api.timer_start()
+__async_waiting = {}
+
+-- Objects walked by the async iterators before they let the server go on
+async_slice = 100
+
+
+-- Is the code running in a coroutine that can sleep
+function async_running()
+	local co, main = coroutine.running()
+	return co ~= nil and not main
+end
+
+local function async_resume(co, ...)
+	local ok, err = coroutine.resume(co, ...)
+	if not ok then
+		ERROR("async: " .. tostring(err))
+	end
+	return ok, err
+end
+
+-- Run func(...) in a new coroutine until its first sleep
+function async(func, ...)
+	local co = coroutine.create(func)
+	async_resume(co, ...)
+	return co
+end
+
+-- Run func(...) in a new coroutine, return what it returned when it did
+-- not sleep or "default" when it goes on later. Handlers can use it to
+-- answer the server at once and keep working:
+--   return async_call(0, command_quiz, account, text)
+function async_call(default, func, ...)
+	local co = coroutine.create(func)
+	local result = { coroutine.resume(co, ...) }
+	if not result[1] then
+		ERROR("async: " .. tostring(result[2]))
+		return default
+	end
+	if coroutine.status(co) ~= "dead" then
+		return default
+	end
+	return unpack(result, 2)
+end
+
+-- Let the server run for the given seconds, 0 goes on in the next main
+-- loop iteration. Only in code started by async() and the functions below.
+function sleep(seconds)
+	if not async_running() then
+		error("sleep() outside of async()", 2)
+	end
+	local id = api.timer_start(seconds or 0)
+	__async_waiting[id] = coroutine.running()
+	coroutine.yield()
+end
+
+-- Call func() outside of any coroutine after the given seconds
+local function async_timer(seconds, func)
+	__async_waiting[api.timer_start(seconds)] = func
+end
+
+-- Run func(...) once after the given seconds, cancel() stops it before
+function after(seconds, func, ...)
+	local args = { ... }
+	local handle = { cancelled = false }
+	async(function()
+		sleep(seconds)
+		if not handle.cancelled then
+			func(unpack(args))
+		end
+	end)
+	return handle
+end
+
+-- Run func(handle) every given seconds until it returns false or cancel()
+-- stops it. The first run is after "first" seconds, by default the period.
+-- Each run is a coroutine of its own and the next one is armed before it
+-- starts, so a run that sleeps or fails does not hold up the others.
+function every(seconds, func, first)
+	local handle = { cancelled = false }
+	local tick
+	tick = function()
+		if handle.cancelled then return end
+		async_timer(seconds, tick)
+		async(function()
+			if func(handle) == false then
+				handle.cancelled = true
+			end
+		end)
+	end
+	async_timer(first or seconds, tick)
+	return handle
+end
+
+function cancel(handle)
+	handle.cancelled = true
+end
+
+-- Called by the server when a timer of api.timer_start() expired
+function handle_server_timer(id)
+	local waiting = __async_waiting[id]
+	-- a timer from before a rehash
+	if not waiting then return end
+
+	__async_waiting[id] = nil
+	if type(waiting) == "function" then
+		waiting()
+	else
+		async_resume(waiting)
+	end
+end
+
+
+-- Call func(object) for the objects of ids (a table indexed from 0) until
+-- it returns false, sleeping for an iteration every async_slice objects.
+-- The objects are looked up when their turn comes, the ones gone by then
+-- are skipped. Outside of async() the walk does not stop.
+-- (Lua 5.1 can not yield in the iterator of a for loop, so no iterator.)
+local function async_each(ids, get, func, slice)
+	local i = 0
+	slice = slice or async_slice
+	while ids[i] ~= nil do
+		if i > 0 and i % slice == 0 and async_running() then
+			sleep(0)
+		end
+
+		local object = get(ids[i])
+		if object and next(object) then
+			if func(object) == false then
+				return false
+			end
+		end
+		i = i + 1
+	end
+	return true
+end
+
+-- async_users(function(account) ... end)
+function async_users(func, slice)
+	return async_each(api.server_get_user_ids(), api.account_get_by_id, func, slice)
+end
+
+function async_games(func, slice)
+	return async_each(api.server_get_game_ids(), api.game_get_by_id, func, slice)
+end
+
+function async_channels(func, slice)
+	return async_each(api.server_get_channel_ids(), api.channel_get_by_id, func, slice)
+end
@@ -9,8 +9,11 @@
 -- Global table with timers
 __timers = {}
 
+-- The first tick is right away, then one every interval seconds
+-- (the timers run on every() of async.lua)
 function timer_add(id, interval, callback)
-	timer_object = timer:new(id, interval, callback)
+	local timer_object = timer:new(id, interval, callback)
+	timer_object.handle = every(interval, function() timer_object:tick() end, 0)
 	table.insert(__timers, timer_object)
 end
 
@@ -20,6 +23,7 @@ function timer_del(id)
 	for k,v in pairs(__timers) do
 		i = i + 1
 		if (v.id == id) then
+			cancel(v.handle)
 			table.remove(__timers, i)
 			return true
 		end
@@ -52,7 +56,6 @@ end
 
 -- Event when timer executes
 function timer:tick()
-	if os.time() < self.prev_time + self.interval then return 0 end
 	self.prev_time = os.time()
 	
 	-- Debug: display time when the timer ticks
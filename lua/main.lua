@@ -9,6 +9,11 @@
 -- Executes after preload all the lua files
 function main()
 	
+	-- the server calls handle_command only for the commands of lua_command_table
+	command_subscribe()
+	-- and handle_channel_message only for the quiz channel while a quiz runs
+	api.subscribe("handle_channel_message", {})
+
 	if (config.ah) then
 		-- start antihack
 		ah_init()
@@ -39,6 +39,8 @@ function quiz:start(channelname, quizname)
 	end
 	
 	config.quiz_channel = channelname
+	-- let messages of the quiz channel through to handle_channel_message
+	api.subscribe("handle_channel_message", { channelname })
 	
 	-- reset
 	_q_question_counter = 0
@@ -135,6 +137,7 @@ function quiz:stop(username)
 	q_save_records()
 
 	config.quiz_channel = nil
+	api.subscribe("handle_channel_message", {})
 end
 
 
@@ -0,0 +1,398 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Local test of a bnetd cluster: starts a few bnetd nodes on this host
+# which share one users directory and checks over telnet that
+#  - friends on other nodes are told about a login,
+#  - whispers, replies and the away notice reach across nodes,
+#  - /where finds users on other nodes,
+#  - chat in a channel reaches the members on all nodes,
+#  - a login on one node ends the session of the account on another one,
+#    and the next login there sees the changes made meanwhile,
+#  - accounts created on two nodes get different userids,
+#  - the others forget the users of a node that went away and keep
+#    relaying chat among themselves,
+#  - a link not proving it knows cluster_secret gets closed.
+#
+# The accounts are created by the script. Run from anywhere:
+#
+#   cluster_test.py --bnetd /path/to/bnetd --conf /path/to/build/conf
+#
+# bnetd.conf in the conf directory is only used as a template, the nodes
+# run with copies in a temporary directory. The support files and the
+# i18n files are taken from the source tree.
+# ==========================================================================
+
+import argparse
+import os
+import re
+import shutil
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+NODES = 3
+CHANNEL = "Cluster Test"
+
+# accounts: name, userid, friends (by userid)
+USERS = [("alice", 1, [2]), ("bob", 2, [1]), ("carol", 3, []), ("dave", 4, [])]
+ADMINS = ("alice", "bob")
+PASS = "secret"
+CLUSTER_SECRET = "cluster test"
+
+# cluster frame types, see cluster.cpp
+FRAME_HELLO = 1
+FRAME_ONLINE = 2
+FRAME_CHALLENGE = 9
+
+# seconds given to the nodes to start and link up and to an answer
+SETTLE = 30
+TIMEOUT = 5
+
+
+def rotl(x, n):
+	n &= 31
+	return ((x << n) | (x >> (32 - n))) & 0xffffffff
+
+
+def bnet_hash(data):
+	""" the Battle.net variant of SHA-1, see common/bnethash.cpp """
+	h = [0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0]
+	data = bytes(data)
+	for pos in range(0, max(len(data), 1), 64):
+		chunk = data[pos:pos + 64].ljust(64, b"\0")
+		w = list(struct.unpack("<16I", chunk)) + [0] * 64
+		for i in range(16, 80):
+			w[i] = rotl(1, w[i - 16] ^ w[i - 8] ^ w[i - 14] ^ w[i - 3])
+		a, b, c, d, e = h
+		for i in range(80):
+			if i < 20:
+				f, k = (b & c) | (~b & d), 0x5a827999
+			elif i < 40:
+				f, k = b ^ c ^ d, 0x6ed9eba1
+			elif i < 60:
+				f, k = (b & c) | (b & d) | (c & d), 0x8f1bbcdc
+			else:
+				f, k = b ^ c ^ d, 0xca62c1d6
+			t = (rotl(a, 5) + (f & 0xffffffff) + e + w[i] + k) & 0xffffffff
+			a, b, c, d, e = t, a, rotl(b, 30), c, d
+		h = [(x + y) & 0xffffffff for x, y in zip(h, [a, b, c, d, e])]
+	return h
+
+
+def free_port():
+	with socket.socket() as s:
+		s.bind(("127.0.0.1", 0))
+		return s.getsockname()[1]
+
+
+class Client:
+	""" a telnet chat user """
+
+	def __init__(self, name, port):
+		self.name = name
+		self.sock = socket.create_connection(("127.0.0.1", port), TIMEOUT)
+		self.text = ""
+		self.sock.sendall(b"\r\n%s\r\n%s\r\n" % (name.encode(), PASS.encode()))
+		self.expect("Your unique name: " + name)
+
+	def say(self, line):
+		self.sock.sendall(line.encode() + b"\r\n")
+
+	def expect(self, pattern, timeout=TIMEOUT):
+		""" the first line matching pattern or None, skipping what came before """
+		regex = re.compile(pattern)
+		until = time.time() + timeout
+		while True:
+			for n, line in enumerate(self.text.split("\n")[:-1]):
+				if regex.search(line):
+					self.text = "\n".join(self.text.split("\n")[n + 1:])
+					return line.strip()
+			left = until - time.time()
+			if left <= 0 or not self.read(left):
+				return None
+
+	def closed(self, timeout=TIMEOUT):
+		until = time.time() + timeout
+		while time.time() < until:
+			if not self.read(until - time.time()):
+				return self.sock.fileno() < 0 or self.eof
+		return False
+
+	def read(self, timeout):
+		self.eof = False
+		self.sock.settimeout(timeout)
+		try:
+			more = self.sock.recv(4096)
+		except socket.timeout:
+			return False
+		except OSError:
+			more = b""
+		if not more:
+			self.eof = True
+			return False
+		self.text += more.decode("latin-1").replace("\r", "")
+		return True
+
+	def drain(self):
+		while self.read(0.2):
+			pass
+		self.text = ""
+
+	def close(self):
+		self.sock.close()
+
+
+def set_keys(text, keys):
+	""" replaces the setting of each key or the commented out example of it """
+	for key, value in keys.items():
+		text, n = re.subn(r"(?m)^%s\s*=.*$" % key, "%s = %s" % (key, value), text)
+		if not n:
+			text, n = re.subn(r"(?m)^#%s\s*=.*$" % key, "%s = %s" % (key, value), text, count=1)
+		if not n:
+			text += "\n%s = %s\n" % (key, value)
+	return text
+
+
+def node_conf(template, confdir, tmp, i, ports):
+	""" the installed paths in the template point to the build and the node's own directory """
+	var = os.path.join(tmp, "n%d" % i)
+	os.makedirs(var)
+
+	def relocate(match):
+		key, path = match.group(1), match.group(2)
+		base = os.path.basename(path)
+		if key == "i18ndir":
+			return '%s = "%s"' % (key, os.path.join(HERE, "..", "conf", "i18n"))
+		if key == "filedir":
+			return '%s = "%s"' % (key, os.path.join(HERE, "..", "files"))
+		if os.path.isfile(os.path.join(confdir, base)):
+			return '%s = "%s"' % (key, os.path.join(confdir, base))
+		if key.endswith("dir"):
+			os.makedirs(os.path.join(var, base), exist_ok=True)
+		return '%s = "%s"' % (key, os.path.join(var, base))
+
+	with open(template) as f:
+		text = f.read()
+	text = re.sub(r'(?m)^(\w+)\s*=\s*"(/[^";]*)"', relocate, text)
+	peers = ",".join("127.0.0.1:%d" % ports[j]["cluster"] for j in range(NODES) if j != i)
+	return set_keys(text, {
+		"storage_path": '"file:mode=plain;dir=%s/users;clan=%s/clans;team=%s/teams;default=%s"' % (
+			tmp, tmp, tmp, os.path.join(confdir, "bnetd_default_user.plain")),
+		"servaddrs": '"127.0.0.1:%d"' % ports[i]["bnet"],
+		"w3routeaddr": '"127.0.0.1:%d"' % ports[i]["w3route"],
+		"telnetaddrs": '"127.0.0.1:%d"' % ports[i]["telnet"],
+		"pidfile": '"%s/bnetd.pid"' % var,
+		"loglevels": '"fatal,error,warn,info"',
+		"track": "0",
+		"cluster_node": '"n%d"' % i,
+		"cluster_addr": '"127.0.0.1:%d"' % ports[i]["cluster"],
+		"cluster_peers": '"%s"' % peers,
+		"cluster_secret": '"%s"' % CLUSTER_SECRET,
+		"cluster_uid_offset": "%d" % i,
+		"command_groups_file": '"%s"' % os.path.join(tmp, "command_groups.conf")})
+
+
+def write_accounts(tmp, confdir):
+	for sub in ("users", "clans", "teams"):
+		os.makedirs(os.path.join(tmp, sub))
+	with open(os.path.join(confdir, "command_groups.conf")) as f:
+		groups = f.read()
+	with open(os.path.join(tmp, "command_groups.conf"), "w") as f:
+		f.write(groups + "\n8\t/addacct\n")
+	passhash = "".join("%08x" % x for x in bnet_hash(PASS.encode()))
+	for name, uid, friends in USERS:
+		with open(os.path.join(tmp, "users", name), "w") as f:
+			f.write('"BNET\\\\acct\\\\username"="%s"\n' % name)
+			f.write('"BNET\\\\acct\\\\passhash1"="%s"\n' % passhash)
+			f.write('"BNET\\\\acct\\\\userid"="%d"\n' % uid)
+			f.write('"friend\\\\count"="%d"\n' % len(friends))
+			for n, friend in enumerate(friends):
+				f.write('"friend\\\\%d\\\\uid"="%d"\n' % (n, friend))
+			if name in ADMINS:
+				f.write('"BNET\\\\auth\\\\command_groups"="255"\n')
+
+
+def linked(tmp, nodes, peers):
+	""" every node in nodes is up with peers others """
+	for i in nodes:
+		try:
+			with open(os.path.join(tmp, "n%d" % i, "bnetd.log")) as f:
+				up = set(re.findall(r'cluster link \S+ to node "(\w+)" is up', f.read()))
+		except IOError:
+			return False
+		if len(up) < peers:
+			return False
+	return True
+
+
+def frame(kind, *strings):
+	data = b"".join(s.encode() + b"\0" for s in strings)
+	return struct.pack("<HH", len(data) + 4, kind) + data
+
+
+def refused(port, first):
+	""" a link sending first after the challenge is closed """
+	with socket.create_connection(("127.0.0.1", port), TIMEOUT) as sock:
+		sock.settimeout(TIMEOUT)
+		head = sock.recv(4)
+		if len(head) < 4 or struct.unpack("<HH", head)[1] != FRAME_CHALLENGE:
+			return False
+		sock.recv(4096)
+		sock.sendall(first)
+		try:
+			while sock.recv(4096):
+				pass
+		except socket.timeout:
+			return False
+		except OSError:
+			pass
+		return True
+
+
+def check(what, ok):
+	print("%-50s %s" % (what, ok and "ok" or "FAILED"))
+	return bool(ok)
+
+
+def main():
+	parser = argparse.ArgumentParser(description="local test of a bnetd cluster")
+	parser.add_argument("--bnetd", default="/usr/local/sbin/bnetd", help="the bnetd binary")
+	parser.add_argument("--conf", required=True, help="directory with bnetd.conf and the files it names")
+	args = parser.parse_args()
+
+	tmp = tempfile.mkdtemp(prefix="cluster_test.")
+	procs = []
+	clients = []
+	ok = True
+	try:
+		write_accounts(tmp, os.path.abspath(args.conf))
+		ports = [dict((kind, free_port()) for kind in ("bnet", "w3route", "telnet", "cluster")) for i in range(NODES)]
+		for i in range(NODES):
+			conf = os.path.join(tmp, "n%d.conf" % i)
+			with open(conf, "w") as f:
+				f.write(node_conf(os.path.join(args.conf, "bnetd.conf"), os.path.abspath(args.conf), tmp, i, ports))
+			procs.append(subprocess.Popen([args.bnetd, "-f", "-c", conf],
+				stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+
+		until = time.time() + SETTLE
+		while not linked(tmp, range(NODES), NODES - 1) and time.time() < until:
+			time.sleep(0.2)
+		ok = check("the nodes linked up", linked(tmp, range(NODES), NODES - 1))
+		if not ok:
+			return 1
+
+		port = ports[0]["cluster"]
+		ok &= check("a hello with a wrong proof is refused", refused(port, frame(FRAME_HELLO, "n9", "00", "0" * 40)))
+		ok &= check("a frame before the hello is refused", refused(port, frame(FRAME_ONLINE, "alice")))
+
+		alice = Client("alice", ports[0]["telnet"])
+		clients.append(alice)
+		bob = Client("bob", ports[1]["telnet"])
+		clients.append(bob)
+		carol = Client("carol", ports[2]["telnet"])
+		clients.append(carol)
+
+		ok &= check("a friend hears of a login on another node", alice.expect(r"<from bob> Your friend bob has entered"))
+
+		alice.say("/w bob hello from n0")
+		ok &= check("a whisper reaches another node", bob.expect(r"<from alice> hello from n0"))
+		ok &= check("the sender gets the whisper ack", alice.expect(r"<to bob> hello from n0"))
+
+		bob.say("/r hello back")
+		ok &= check("a reply goes back to the sender's node", alice.expect(r"<from bob> hello back"))
+
+		carol.say("/where alice")
+		ok &= check("/where finds a user on another node", carol.expect(r"alice is logged on to node n0"))
+
+		bob.say("/away gone fishing")
+		bob.expect(r"marked as being away")
+		alice.say("/w bob are you there")
+		ok &= check("the away notice comes back", alice.expect(r"bob is away \(gone fishing\)"))
+		bob.say("/away")
+
+		alice.say("/w dave anybody")
+		ok &= check("nobody by that name in the cluster", alice.expect(r"That user is not logged on"))
+
+		for client in (alice, bob, carol):
+			client.say("/join %s" % CHANNEL)
+			client.expect(r"Joining channel")
+		time.sleep(1)
+		for client in (alice, bob, carol):
+			client.drain()
+
+		alice.say("hello channel")
+		ok &= check("channel chat reaches the second node", bob.expect(r"<alice> hello channel"))
+		ok &= check("channel chat reaches the third node", carol.expect(r"<alice> hello channel"))
+		carol.say("hello from n2")
+		ok &= check("chat from the third node reaches the first", alice.expect(r"<carol> hello from n2"))
+		ok &= check("chat from the third node reaches the second", bob.expect(r"<carol> hello from n2"))
+
+		dave = Client("dave", ports[0]["telnet"])
+		clients.append(dave)
+		again = Client("dave", ports[2]["telnet"])
+		clients.append(again)
+		ok &= check("a login on another node ends the session", dave.closed())
+
+		# the first node reads the account again at the next login there
+		again.say("/f a carol")
+		again.expect(r"Added carol to your friends list")
+		again.close()
+		time.sleep(1)
+		dave = Client("dave", ports[0]["telnet"])
+		clients.append(dave)
+		dave.say("/f l")
+		ok &= check("a login sees changes made on another node", dave.expect(r"^1: .?carol"))
+
+		alice.drain()
+		alice.say("/addacct erin %s" % PASS)
+		first = alice.expect(r"Account \d+ created")
+		bob.drain()
+		bob.say("/addacct frank %s" % PASS)
+		second = bob.expect(r"Account \d+ created")
+		ok &= check("two nodes create accounts with different userids", first and second and first != second)
+
+		# take a node away, the others forget its users and keep chatting
+		procs[1].send_signal(signal.SIGKILL)
+		procs[1].wait()
+		time.sleep(2)
+		carol.drain()
+		carol.say("/where bob")
+		ok &= check("the users of a stopped node are offline", carol.expect(r"User is offline|User was last seen"))
+		alice.drain()
+		alice.say("still here")
+		ok &= check("chat is still relayed without the node", carol.expect(r"<alice> still here"))
+	except (IOError, OSError) as e:
+		ok = check("test ran (%s)" % e, False)
+	finally:
+		for client in clients:
+			client.close()
+		for proc in procs:
+			if proc.poll() is None:
+				proc.kill()
+				proc.wait()
+		if ok:
+			shutil.rmtree(tmp)
+		else:
+			print("logs left in %s" % tmp)
+
+	return not ok
+
+
+if __name__ == "__main__":
+	sys.exit(main())
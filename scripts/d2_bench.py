@@ -0,0 +1,539 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Local load test of a realm: starts a d2cs and a d2dbs on this host and
+# drives them the way a busy realm would, then prints throughput and
+# latency percentiles for every operation.
+#
+# Everything else the two need is played by this script:
+#  - a bnetd which accepts every account and character login,
+#  - a few d2gs, each connecting from its own 127.0.0.x address, which
+#    create and join games, load the characters from d2dbs, save them
+#    back and send ladder updates when they leave,
+#  - the D2 clients, each of them logging in, creating a character and
+#    then in a loop: character login, character list, create game, join
+#    game, game list and leave the game.
+#
+# No accounts or installed configuration are needed. Run from anywhere:
+#
+#   d2_bench.py --d2cs /path/to/d2cs --d2dbs /path/to/d2dbs
+#
+# See --help for the size and length of the run. Returns non zero if an
+# operation failed or never completed, which is what the ctest of the same
+# name checks.
+# ==========================================================================
+
+import argparse
+import asyncio
+import os
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+REALM = "D2CS"
+
+# seconds given to the servers to start and to answer a request
+SETTLE = 10
+TIMEOUT = 10
+
+# the d2gs connect from 127.0.0.GS_ADDR + i
+GS_ADDR = 10
+
+# clients connecting at the same time, more overflow the listen queue of
+# d2cs (LISTEN_QUEUE) and some of them lose their first bytes
+LOGIN_BURST = 8
+
+# class bytes of the connections
+CLASS_D2CS = 0x01
+CLASS_D2GS = 0x64
+CLASS_D2DBS = 0x65
+
+# d2cs <-> client, see common/d2cs_protocol.h
+LOGINREQ = 0x01
+CREATECHARREQ = 0x02
+CREATEGAMEREQ = 0x03
+JOINGAMEREQ = 0x04
+GAMELISTREQ = 0x05
+CHARLOGINREQ = 0x07
+CHARLISTREQ_110 = 0x19
+
+# bnetd <-> d2cs, see common/d2cs_bnetd_protocol.h
+BNETD_AUTHREQ = 0x01
+BNETD_AUTHREPLY = 0x02
+BNETD_ACCOUNTLOGIN = 0x10
+BNETD_CHARLOGIN = 0x11
+
+# d2gs <-> d2cs, see common/d2cs_d2gs_protocol.h
+D2GS_AUTHREQ = 0x10
+D2GS_AUTHREPLY = 0x11
+D2GS_SETGSINFO = 0x12
+D2GS_ECHO = 0x13
+D2GS_CREATEGAME = 0x20
+D2GS_JOINGAME = 0x21
+D2GS_UPDATEGAMEINFO = 0x22
+D2GS_CLOSEGAME = 0x23
+
+# d2gs <-> d2dbs, see d2dbs/dbspacket.h
+DBS_SAVE = 0x30
+DBS_GET = 0x31
+DBS_LADDER = 0x32
+DBS_CHARLOCK = 0x33
+DBS_ECHO = 0x34
+DATA_CHARSAVE = 0x01
+DATA_PORTRAIT = 0x02
+
+# the order of the report
+OPERATIONS = ("login", "createchar", "charlogin", "charlist", "creategame",
+	"joingame", "gamelist", "dbs_load", "dbs_save", "dbs_ladder")
+
+
+def cstr(text):
+	return text.encode() + b"\0"
+
+
+def free_port():
+	with socket.socket() as s:
+		s.bind(("127.0.0.1", 0))
+		return s.getsockname()[1]
+
+
+def charsave_checksum(data):
+	""" what d2dbs checks a charsave against, see common/d2char_checksum.cpp """
+	checksum = 0
+	for i, ch in enumerate(data):
+		if 0x0c <= i < 0x10:
+			ch = 0
+		checksum = ((checksum << 1) + ch + (checksum >> 31)) & 0xffffffff
+	return data[:0x0c] + struct.pack("<I", checksum) + data[0x10:]
+
+
+def letters(n):
+	""" character names may only hold letters """
+	text = ""
+	for i in range(4):
+		text = chr(ord("a") + n % 26) + text
+		n //= 26
+	return text
+
+
+class Stats:
+	""" latencies and failures of every operation """
+
+	def __init__(self):
+		self.times = dict((op, []) for op in OPERATIONS)
+		self.errors = dict((op, 0) for op in OPERATIONS)
+		self.start = self.stop = 0
+
+	def add(self, op, since):
+		self.times[op].append(time.monotonic() - since)
+
+	def fail(self, op):
+		self.errors[op] += 1
+
+	def report(self):
+		elapsed = self.stop - self.start
+		print("%-12s %8s %7s %9s %8s %8s %8s %8s" % ("operation", "count", "errors",
+			"ops/s", "p50 ms", "p90 ms", "p99 ms", "max ms"))
+		for op in OPERATIONS:
+			times = sorted(self.times[op])
+			if times:
+				pct = [times[min(len(times) - 1, int(p * len(times)))] * 1000 for p in (0.5, 0.9, 0.99)]
+				print("%-12s %8d %7d %9.1f %8.2f %8.2f %8.2f %8.2f" % (op, len(times), self.errors[op],
+					len(times) / elapsed, pct[0], pct[1], pct[2], times[-1] * 1000))
+			else:
+				print("%-12s %8d %7d %9s" % (op, 0, self.errors[op], "-"))
+		print("%.1f seconds" % elapsed)
+
+	def ok(self):
+		return all(self.times[op] and not self.errors[op] for op in OPERATIONS)
+
+
+class Session:
+	""" one character in one game, shared by its client and its d2gs """
+
+	def __init__(self):
+		self.left = asyncio.Event()
+		self.done = asyncio.Event()
+		self.round = 0
+
+
+class Link:
+	""" a s2s connection, the header is size, type and seqno """
+
+	def __init__(self, reader, writer):
+		self.reader = reader
+		self.writer = writer
+
+	def send(self, type, body, seqno=0):
+		if not self.writer.is_closing():
+			self.writer.write(struct.pack("<HHI", len(body) + 8, type, seqno) + body)
+
+	async def recv(self):
+		head = await self.reader.readexactly(8)
+		size, type, seqno = struct.unpack("<HHI", head)
+		return type, seqno, await self.reader.readexactly(size - 8)
+
+
+class Bnetd:
+	""" answers the account and character logins of d2cs """
+
+	def __init__(self):
+		self.ready = asyncio.Event()
+
+	async def serve(self, reader, writer):
+		link = Link(reader, writer)
+		try:
+			await reader.readexactly(1)
+			link.send(BNETD_AUTHREQ, struct.pack("<I", 1))
+			while True:
+				type, seqno, body = await link.recv()
+				if type in (BNETD_AUTHREPLY, BNETD_ACCOUNTLOGIN, BNETD_CHARLOGIN):
+					link.send(type, struct.pack("<I", 0), seqno)
+				if type == BNETD_AUTHREPLY:
+					self.ready.set()
+		except (asyncio.IncompleteReadError, ConnectionError):
+			writer.close()
+
+
+class GameServer:
+	""" a d2gs without the game: creates and joins games, loads and saves characters """
+
+	def __init__(self, index, args, stats, sessions):
+		self.addr = "127.0.0.%d" % (GS_ADDR + index)
+		self.args = args
+		self.stats = stats
+		self.sessions = sessions
+		self.ready = asyncio.Event()
+		self.gameid = 0
+		self.seqno = 0
+		self.pending = {}
+
+	async def connect(self, port, cclass):
+		deadline = time.monotonic() + SETTLE
+		while True:
+			try:
+				reader, writer = await asyncio.open_connection("127.0.0.1", port, local_addr=(self.addr, 0))
+				break
+			except OSError:
+				if time.monotonic() > deadline:
+					raise
+				await asyncio.sleep(0.1)
+		writer.write(bytes([cclass]))
+		return Link(reader, writer)
+
+	async def run(self, d2cs_port, d2dbs_port):
+		self.dbs = await self.connect(d2dbs_port, CLASS_D2DBS)
+		self.cs = await self.connect(d2cs_port, CLASS_D2GS)
+		asyncio.ensure_future(self.dbs_loop())
+		try:
+			while True:
+				type, seqno, body = await self.cs.recv()
+				if type == D2GS_AUTHREQ:
+					self.cs.send(D2GS_AUTHREPLY, struct.pack("<4I", 0, 0, 0, 0) + bytes(128))
+				elif type == D2GS_AUTHREPLY:
+					if struct.unpack("<I", body[:4])[0] == 0:
+						self.cs.send(D2GS_SETGSINFO, struct.pack("<II", self.args.maxgame, 0))
+						self.ready.set()
+				elif type == D2GS_ECHO:
+					self.cs.send(D2GS_ECHO, b"")
+				elif type == D2GS_CREATEGAME:
+					self.gameid += 1
+					self.cs.send(D2GS_CREATEGAME, struct.pack("<II", 0, self.gameid), seqno)
+				elif type == D2GS_JOINGAME:
+					gameid = struct.unpack("<I", body[:4])[0]
+					charname, account = body[8:].split(b"\0")[:2]
+					# enter first, so the game is in the list before the client hears of it
+					self.cs.send(D2GS_UPDATEGAMEINFO, struct.pack("<4I", 1, gameid, 1, 0) + charname + b"\0")
+					self.cs.send(D2GS_JOINGAME, struct.pack("<II", 0, gameid), seqno)
+					asyncio.ensure_future(self.play(gameid, account.decode(), charname.decode()))
+		except (asyncio.IncompleteReadError, ConnectionError):
+			pass
+
+	async def dbs_loop(self):
+		try:
+			while True:
+				type, seqno, body = await self.dbs.recv()
+				if type == DBS_ECHO:
+					self.dbs.send(DBS_ECHO, b"")
+				elif seqno in self.pending:
+					self.pending.pop(seqno).set_result(body)
+		except (asyncio.IncompleteReadError, ConnectionError):
+			for future in self.pending.values():
+				future.cancel()
+
+	async def dbs_request(self, type, body):
+		self.seqno += 1
+		future = asyncio.get_event_loop().create_future()
+		self.pending[self.seqno] = future
+		self.dbs.send(type, body, self.seqno)
+		return await asyncio.wait_for(future, TIMEOUT)
+
+	async def play(self, gameid, account, charname):
+		session = self.sessions[charname]
+		names = cstr(account) + cstr(charname) + cstr(REALM)
+		try:
+			since = time.monotonic()
+			reply = await self.dbs_request(DBS_GET, struct.pack("<H", DATA_CHARSAVE) + names)
+			result, created, ladder, datatype, datalen = struct.unpack("<IIIHH", reply[:16])
+			if result != 0:
+				self.stats.fail("dbs_load")
+				return
+			self.stats.add("dbs_load", since)
+			# a d2gs signs what it saves
+			charsave = charsave_checksum(reply[16 + len(charname) + 1:][:datalen])
+
+			await session.left.wait()
+
+			since = time.monotonic()
+			reply = await self.dbs_request(DBS_SAVE, struct.pack("<HH", DATA_CHARSAVE, len(charsave)) + names + charsave)
+			if struct.unpack("<I", reply[:4])[0] != 0:
+				self.stats.fail("dbs_save")
+			else:
+				self.stats.add("dbs_save", since)
+
+			# ladder updates and unlocks are not answered, the portrait
+			# read behind them is
+			since = time.monotonic()
+			session.round += 1
+			self.dbs.send(DBS_LADDER, struct.pack("<IIIHH", 1, session.round * 1000, 0, 0, 0x20) + cstr(charname) + cstr(REALM))
+			self.dbs.send(DBS_CHARLOCK, struct.pack("<I", 0) + names)
+			reply = await self.dbs_request(DBS_GET, struct.pack("<H", DATA_PORTRAIT) + names)
+			if struct.unpack("<I", reply[:4])[0] != 0:
+				self.stats.fail("dbs_ladder")
+			else:
+				self.stats.add("dbs_ladder", since)
+		except (asyncio.TimeoutError, asyncio.CancelledError):
+			self.stats.fail("dbs_load")
+		finally:
+			self.cs.send(D2GS_UPDATEGAMEINFO, struct.pack("<4I", 2, gameid, 1, 0) + cstr(charname))
+			self.cs.send(D2GS_CLOSEGAME, struct.pack("<I", gameid))
+			session.done.set()
+
+
+class Client:
+	""" a D2 client talking to d2cs, the header is size and type """
+
+	def __init__(self, index, args, stats, sessions):
+		self.index = index
+		self.args = args
+		self.stats = stats
+		self.sessions = sessions
+		self.account = "bench%05d" % index
+		self.charname = "bench" + letters(index)
+		self.seqno = 0
+		self.op = "login"
+
+	def send(self, type, body):
+		self.writer.write(struct.pack("<HB", len(body) + 3, type) + body)
+
+	async def recv(self, type):
+		while True:
+			head = await self.reader.readexactly(3)
+			size, rtype = struct.unpack("<HB", head)
+			body = await self.reader.readexactly(size - 3)
+			if rtype == type:
+				return body
+
+	async def request(self, op, type, body, check):
+		""" sends a request and times the reply, check() tells if it succeeded """
+		self.op = op
+		since = time.monotonic()
+		self.send(type, body)
+		reply = await asyncio.wait_for(self.recv(type), TIMEOUT)
+		if check(reply):
+			self.stats.add(op, since)
+			return reply
+		self.stats.fail(op)
+		return None
+
+	async def run(self, port, stop, burst):
+		ok = lambda reply: struct.unpack("<I", reply[:4])[0] == 0
+		async with burst:
+			try:
+				self.reader, self.writer = await asyncio.open_connection("127.0.0.1", port)
+			except OSError:
+				self.stats.fail("login")
+				return
+			self.writer.write(bytes([CLASS_D2CS]))
+			try:
+				if not await self.request("login", LOGINREQ,
+					struct.pack("<11I", 0, 0, 0, self.index, 0, 0, 0, 0, 0, 0, 0) + bytes(20) + cstr(self.account), ok):
+					self.writer.close()
+					return
+			except (asyncio.TimeoutError, asyncio.IncompleteReadError, ConnectionError):
+				self.stats.fail(self.op)
+				self.writer.close()
+				return
+		try:
+			if not await self.request("createchar", CREATECHARREQ,
+				struct.pack("<HHH", self.index % 7, 0, 0x20) + cstr(self.charname), ok):
+				return
+			session = self.sessions[self.charname] = Session()
+			round = 0
+			while not stop.is_set():
+				round += 1
+				gamename = "b%dr%d" % (self.index, round)
+				await self.request("charlogin", CHARLOGINREQ, cstr(self.charname), ok)
+				await self.request("charlist", CHARLISTREQ_110, struct.pack("<HH", 8, 0), lambda reply: True)
+				self.seqno += 1
+				if not await self.request("creategame", CREATEGAMEREQ,
+					struct.pack("<HIBBB", self.seqno, 0, 1, 0, 8) + cstr(gamename) + b"\0\0",
+					lambda reply: struct.unpack("<I", reply[6:10])[0] == 0):
+					continue
+				session.left.clear()
+				session.done.clear()
+				self.seqno += 1
+				if not await self.request("joingame", JOINGAMEREQ,
+					struct.pack("<H", self.seqno) + cstr(gamename) + b"\0",
+					lambda reply: struct.unpack("<I", reply[14:18])[0] == 0):
+					continue
+				self.seqno += 1
+				self.op = "gamelist"
+				since = time.monotonic()
+				self.send(GAMELISTREQ, struct.pack("<HI", self.seqno, 0))
+				# the list ends with an entry without a name
+				while True:
+					reply = await asyncio.wait_for(self.recv(GAMELISTREQ), TIMEOUT)
+					if reply[11:12] == b"\0":
+						break
+				self.stats.add("gamelist", since)
+				if self.args.think:
+					await asyncio.sleep(self.args.think / 1000)
+				# d2gs saves the character when it leaves
+				self.op = "dbs_save"
+				session.left.set()
+				await asyncio.wait_for(session.done.wait(), TIMEOUT)
+		except (asyncio.TimeoutError, asyncio.IncompleteReadError, ConnectionError):
+			self.stats.fail(self.op)
+		finally:
+			self.writer.close()
+
+
+def write_conf(path, keys):
+	with open(path, "w") as f:
+		for key, value in keys.items():
+			f.write("%s = %s\n" % (key, value))
+
+
+async def bench(args, tmp, stats):
+	bnetd = Bnetd()
+	bnetd_port = free_port()
+	server = await asyncio.start_server(bnetd.serve, "127.0.0.1", bnetd_port)
+	d2cs_port = free_port()
+	d2dbs_port = free_port()
+	gameservlist = ",".join("127.0.0.%d" % (GS_ADDR + i) for i in range(args.gameservers))
+
+	for sub in ("charsave", "charinfo", "bak/charsave", "bak/charinfo", "ladders"):
+		os.makedirs(os.path.join(tmp, sub))
+	dirs = {
+		"charsavedir": '"%s/charsave"' % tmp,
+		"charinfodir": '"%s/charinfo"' % tmp,
+		"bak_charsavedir": '"%s/bak/charsave"' % tmp,
+		"bak_charinfodir": '"%s/bak/charinfo"' % tmp,
+		"ladderdir": '"%s/ladders"' % tmp}
+	d2cs_keys = {
+		"realmname": REALM,
+		"servaddrs": "127.0.0.1:%d" % d2cs_port,
+		"gameservlist": gameservlist,
+		"bnetdaddr": "127.0.0.1:%d" % bnetd_port,
+		"max_connections": args.clients + args.gameservers + 100,
+		"loglevels": args.loglevels,
+		"check_multilogin": 0,
+		"maxchar": 8,
+		"s2s_retryinterval": 1}
+	for cls in ("amazon", "sorceress", "necromancer", "paladin", "barbarian", "druid", "assasin"):
+		d2cs_keys["newbiefile_" + cls] = '"%s"' % args.newbie
+	d2cs_keys.update(dirs)
+	d2dbs_keys = {
+		"servaddrs": "127.0.0.1:%d" % d2dbs_port,
+		"gameservlist": gameservlist,
+		"loglevels": args.loglevels,
+		"logfile-gs": '"%s/d2dbs-gs.log"' % tmp}
+	d2dbs_keys.update(dirs)
+	write_conf(os.path.join(tmp, "d2cs.conf"), d2cs_keys)
+	write_conf(os.path.join(tmp, "d2dbs.conf"), d2dbs_keys)
+
+	procs = []
+	tasks = []
+	try:
+		# in the foreground they log to stderr
+		for binary, name in ((args.d2dbs, "d2dbs"), (args.d2cs, "d2cs")):
+			with open(os.path.join(tmp, name + ".log"), "w") as log:
+				procs.append(subprocess.Popen([binary, "-f", "-c", os.path.join(tmp, name + ".conf")],
+					stdout=log, stderr=log))
+		await asyncio.wait_for(bnetd.ready.wait(), SETTLE)
+
+		sessions = {}
+		servers = [GameServer(i, args, stats, sessions) for i in range(args.gameservers)]
+		tasks += [asyncio.ensure_future(gs.run(d2cs_port, d2dbs_port)) for gs in servers]
+		for gs in servers:
+			await asyncio.wait_for(gs.ready.wait(), SETTLE)
+
+		stop = asyncio.Event()
+		burst = asyncio.Semaphore(LOGIN_BURST)
+		clients = [Client(i + 1, args, stats, sessions) for i in range(args.clients)]
+		stats.start = time.monotonic()
+		running = [asyncio.ensure_future(client.run(d2cs_port, stop, burst)) for client in clients]
+		await asyncio.sleep(args.duration)
+		stop.set()
+		await asyncio.wait(running, timeout=TIMEOUT)
+		stats.stop = time.monotonic()
+	finally:
+		for task in tasks:
+			task.cancel()
+		server.close()
+		for proc in procs:
+			proc.kill()
+			proc.wait()
+
+
+def main():
+	parser = argparse.ArgumentParser(description="load test of a local d2cs and d2dbs")
+	parser.add_argument("--d2cs", default=os.environ.get("D2CS", "/usr/local/sbin/d2cs"))
+	parser.add_argument("--d2dbs", default=os.environ.get("D2DBS", "/usr/local/sbin/d2dbs"))
+	parser.add_argument("--newbie", default=os.path.join(HERE, "..", "files", "newbie.save"),
+		help="character template (default: files/newbie.save of the source tree)")
+	parser.add_argument("--clients", type=int, default=50, help="simulated D2 clients")
+	parser.add_argument("--gameservers", type=int, default=2, help="simulated d2gs")
+	parser.add_argument("--maxgame", type=int, default=1000, help="games per d2gs")
+	parser.add_argument("--duration", type=float, default=10, help="seconds of load")
+	parser.add_argument("--think", type=float, default=0, help="milliseconds a client stays in a game")
+	parser.add_argument("--loglevels", default="fatal,error,warn", help="loglevels of d2cs and d2dbs")
+	args = parser.parse_args()
+	args.newbie = os.path.abspath(args.newbie)
+
+	tmp = tempfile.mkdtemp(prefix="d2_bench.")
+	stats = Stats()
+	ok = False
+	try:
+		asyncio.get_event_loop().run_until_complete(bench(args, tmp, stats))
+		stats.report()
+		ok = stats.ok()
+	except asyncio.TimeoutError:
+		print("d2cs or d2dbs did not come up")
+	finally:
+		if ok:
+			shutil.rmtree(tmp)
+		else:
+			print("logs left in %s" % tmp)
+
+	return not ok
+
+
+if __name__ == "__main__":
+	sys.exit(main())
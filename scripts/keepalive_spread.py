@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Measures how bnetd spreads its keepalive probes: a burst of bots logs in
+# and stays idle, the NULL messages (nullmsg) they receive are counted per
+# second. With probes at a fixed now+period after login every period
+# repeats the login pattern second by second, bursts and gaps included;
+# spread out, the seconds of one period have nothing to do with the ones
+# of the period before.
+#
+#   keepalive_spread.py --bnetd /path/to/bnetd --conf /path/to/build/conf
+#
+# Prints the NULLs per second and fails when the periods repeat each
+# other, one second gets much more than its share or probes went missing.
+# ==========================================================================
+
+import argparse
+import os
+import re
+import select
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import shutil
+
+from cluster_test import bnet_hash, free_port, set_keys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PASS = "secret"
+
+
+def server_conf(template, confdir, tmp, ports, nullmsg):
+	""" the installed paths in the template point to the build and tmp """
+	var = os.path.join(tmp, "var")
+	os.makedirs(var)
+
+	def relocate(match):
+		key, path = match.group(1), match.group(2)
+		base = os.path.basename(path)
+		if key == "i18ndir":
+			return '%s = "%s"' % (key, os.path.join(HERE, "..", "conf", "i18n"))
+		if key == "filedir":
+			return '%s = "%s"' % (key, os.path.join(HERE, "..", "files"))
+		if os.path.isfile(os.path.join(confdir, base)):
+			return '%s = "%s"' % (key, os.path.join(confdir, base))
+		if key.endswith("dir"):
+			os.makedirs(os.path.join(var, base), exist_ok=True)
+		return '%s = "%s"' % (key, os.path.join(var, base))
+
+	with open(template) as f:
+		text = f.read()
+	text = re.sub(r'(?m)^(\w+)\s*=\s*"(/[^";]*)"', relocate, text)
+	return set_keys(text, {
+		"storage_path": '"file:mode=plain;dir=%s/users;clan=%s/clans;team=%s/teams;default=%s"' % (
+			tmp, tmp, tmp, os.path.join(confdir, "bnetd_default_user.plain")),
+		"servaddrs": '"127.0.0.1:%d"' % ports["bnet"],
+		"w3routeaddr": '"127.0.0.1:%d"' % ports["w3route"],
+		"telnetaddrs": '""',
+		"pidfile": '"%s/bnetd.pid"' % var,
+		"loglevels": '"fatal,error,warn"',
+		"track": "0",
+		"cluster_node": '""',
+		"quota": "false",
+		"max_conns_per_IP": "0",
+		"nullmsg": str(nullmsg)})
+
+
+def write_accounts(tmp, bots):
+	for sub in ("users", "clans", "teams"):
+		os.makedirs(os.path.join(tmp, sub))
+	passhash = "".join("%08x" % x for x in bnet_hash(PASS.encode()))
+	for i in range(bots):
+		name = "bot%04d" % i
+		with open(os.path.join(tmp, "users", name), "w") as f:
+			f.write('"BNET\\\\acct\\\\username"="%s"\n' % name)
+			f.write('"BNET\\\\acct\\\\passhash1"="%s"\n' % passhash)
+			f.write('"BNET\\\\acct\\\\userid"="%d"\n' % (i + 1))
+
+
+def main():
+	parser = argparse.ArgumentParser(description="measure the spread of bnetd keepalive probes")
+	parser.add_argument("--bnetd", default="/usr/local/sbin/bnetd", help="the bnetd binary")
+	parser.add_argument("--conf", required=True, help="directory with bnetd.conf and the files it names")
+	parser.add_argument("--bots", type=int, default=200, help="bots logging in together")
+	parser.add_argument("--nullmsg", type=int, default=10, help="null message period in seconds")
+	parser.add_argument("--periods", type=int, default=3, help="periods to count")
+	args = parser.parse_args()
+
+	tmp = tempfile.mkdtemp(prefix="keepalive_spread.")
+	proc = None
+	socks = []
+	try:
+		write_accounts(tmp, args.bots)
+		ports = dict((kind, free_port()) for kind in ("bnet", "w3route"))
+		conf = os.path.join(tmp, "bnetd.conf")
+		with open(conf, "w") as f:
+			f.write(server_conf(os.path.join(args.conf, "bnetd.conf"), os.path.abspath(args.conf), tmp, ports, args.nullmsg))
+		proc = subprocess.Popen([args.bnetd, "-f", "-c", conf], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+		until = time.time() + 30
+		while True:
+			try:
+				socket.create_connection(("127.0.0.1", ports["bnet"]), 1).close()
+				break
+			except OSError:
+				if time.time() > until:
+					print("bnetd did not start")
+					return 1
+				time.sleep(0.2)
+
+		# the burst: every bot logs in as fast as the server takes them
+		for i in range(args.bots):
+			socks.append(socket.create_connection(("127.0.0.1", ports["bnet"]), 5))
+		for i, s in enumerate(socks):
+			s.sendall(b"\x03\r\nbot%04d\r\n%s\r\n" % (i, PASS.encode()))
+		login = time.time()
+
+		# count the NULLs by the second they arrive in
+		counts = {}
+		buffers = dict((s, b"") for s in socks)
+		end = login + args.nullmsg * args.periods + 2
+		while time.time() < end:
+			ready, _, _ = select.select(socks, [], [], max(0, min(1, end - time.time())))
+			for s in ready:
+				data = s.recv(4096)
+				if not data:
+					print("a bot was disconnected")
+					return 1
+				buffers[s] += data
+				lines = buffers[s].split(b"\n")
+				buffers[s] = lines.pop()
+				second = int(time.time() - login)
+				for line in lines:
+					if line.startswith(b"2000 NULL"):
+						counts[second] = counts.get(second, 0) + 1
+
+		seconds = range(1, args.nullmsg * args.periods + 1)
+		series = [counts.get(i, 0) for i in seconds]
+		total = sum(series)
+		share = args.bots / float(args.nullmsg)
+		print("%d bots, nullmsg = %d, NULLs per second: %s" % (args.bots, args.nullmsg, " ".join(str(n) for n in series)))
+		# how much each period differs from the one before, second by second
+		repeat = [sum(abs(series[p * args.nullmsg + i] - series[(p - 1) * args.nullmsg + i]) for i in range(args.nullmsg))
+			for p in range(1, args.periods)]
+		print("total %d, expected about %d, busiest second %d, fair share %.1f, change between periods %s" % (
+			total, args.bots * args.periods, max(series), share, " ".join(str(n) for n in repeat)))
+
+		ok = True
+		if total < args.bots * (args.periods - 1):
+			print("FAILED: probes went missing")
+			ok = False
+		if min(repeat) < args.bots / 10:
+			print("FAILED: the periods repeat each other, the probes run in lockstep")
+			ok = False
+		if max(series) > 3 * share:
+			print("FAILED: the probes bunch up")
+			ok = False
+		return 0 if ok else 1
+	finally:
+		for s in socks:
+			s.close()
+		if proc:
+			proc.kill()
+			proc.wait()
+		shutil.rmtree(tmp, ignore_errors=True)
+
+
+if __name__ == "__main__":
+	sys.exit(main())
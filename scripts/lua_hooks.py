@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Checks which events bnetd passes to the Lua scripts. A copy of the
+# bundled scripts gets handle_command and handle_channel_message wrapped
+# to log what they see, a bot sends commands and chat, and the log must
+# show only the events the scripts subscribed to with api.subscribe():
+# the commands of lua_command_table, and the quiz channel while a quiz
+# runs. Needs a bnetd built WITH_LUA.
+#
+#   lua_hooks.py --bnetd /path/to/bnetd --conf /path/to/build/conf
+# ==========================================================================
+
+import argparse
+import os
+import re
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+from cluster_test import free_port, set_keys
+from keepalive_spread import server_conf, write_accounts, PASS
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+WRAP = '''
+local seen_handle_command = handle_command
+function handle_command(account, text)
+	DEBUG("handle_command saw " .. text)
+	return seen_handle_command(account, text)
+end
+local seen_channel_message = handle_channel_message
+function handle_channel_message(channel, account, text, message_type)
+	DEBUG("handle_channel_message saw " .. text)
+	return seen_channel_message(channel, account, text, message_type)
+end
+'''
+
+# what the bot sends, and which hook should see it
+STEPS = [
+	("/whoami", None),
+	("/time", None),
+	("/quiz", "handle_command"),
+	("hello in chat", None),
+	("/join quiz", None),
+	("/quiz start misc", "handle_command"),
+	("hello in quiz", "handle_channel_message"),
+	("/quiz stop", "handle_command"),
+	("after the quiz", None)]
+
+
+def main():
+	parser = argparse.ArgumentParser(description="check the events bnetd passes to the Lua scripts")
+	parser.add_argument("--bnetd", default="/usr/local/sbin/bnetd", help="the bnetd binary, built WITH_LUA")
+	parser.add_argument("--conf", required=True, help="directory with bnetd.conf and the files it names")
+	parser.add_argument("--scripts", default=os.path.join(HERE, "..", "lua"), help="the Lua scripts")
+	args = parser.parse_args()
+
+	tmp = tempfile.mkdtemp(prefix="lua_hooks.")
+	proc = None
+	sock = None
+	try:
+		scripts = os.path.join(tmp, "lua")
+		shutil.copytree(args.scripts, scripts)
+		with open(os.path.join(scripts, "main.lua"), "a") as f:
+			f.write(WRAP)
+
+		write_accounts(tmp, 1)
+		ports = dict((kind, free_port()) for kind in ("bnet", "w3route"))
+		text = server_conf(os.path.join(args.conf, "bnetd.conf"), os.path.abspath(args.conf), tmp, ports, 0)
+		conf = os.path.join(tmp, "bnetd.conf")
+		with open(conf, "w") as f:
+			f.write(set_keys(text, {
+				"scriptdir": '"%s"' % scripts,
+				"loglevels": '"fatal,error,warn,info,debug"'}))
+		proc = subprocess.Popen([args.bnetd, "-f", "-c", conf], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+		until = time.time() + 30
+		while True:
+			try:
+				sock = socket.create_connection(("127.0.0.1", ports["bnet"]), 5)
+				break
+			except OSError:
+				if time.time() > until:
+					print("bnetd did not start")
+					return 1
+				time.sleep(0.2)
+
+		sock.sendall(b"\x03\r\nbot0000\r\n%s\r\n" % PASS.encode())
+		time.sleep(1)
+		for line, hook in STEPS:
+			sock.sendall(line.encode() + b"\r\n")
+			time.sleep(0.5)
+		time.sleep(1)
+
+		with open(os.path.join(tmp, "var", "bnetd.log")) as f:
+			log = f.read()
+		seen = re.findall(r"(\w+) saw (.*)$", log, re.M)
+		expected = [(hook, line) for line, hook in STEPS if hook]
+		print("seen by Lua: %s" % seen)
+		if "Lua sripts were successfully loaded" not in log:
+			print("FAILED: the scripts did not load, is bnetd built WITH_LUA?")
+			return 1
+		if seen != expected:
+			print("FAILED: expected %s" % expected)
+			return 1
+		return 0
+	finally:
+		if sock:
+			sock.close()
+		if proc:
+			proc.kill()
+			proc.wait()
+		shutil.rmtree(tmp, ignore_errors=True)
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Drives bnetd into memory pressure (see mem_budget in bnetd.conf) with
+# local clients and checks what the memory governor does about it. "Sink"
+# bots join a channel and never read what the server sends them while
+# "talker" bots in it read everything:
+#  - the talkers chat, the lines to the sinks pile up until the server
+#    drops them (shedding) instead of queueing more,
+#  - the talkers whisper to the sinks, which is never dropped, until the
+#    server refuses new connections and disconnects the sinks,
+#  - with the sinks gone the server is back to normal and takes logins.
+# The figures come from the status file, written every second. Who is
+# still logged on comes from there as well, a sink does not see the server
+# close the connection behind the data it did not read.
+#
+# The kernel takes a few hundred KB for each sink before anything queues
+# up in the server, the chat is fast until the queues grow and slow after
+# so a second of it moves less than a stage, the governor only looks once
+# a second. The budget has to be reached before a sink has the 1000
+# packets the server allows a connection to queue, the last sinks run
+# into that limit rather than being kicked.
+#
+#   mem_pressure.py --bnetd /path/to/bnetd --conf /path/to/build/conf
+# ==========================================================================
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+from cluster_test import check, free_port, set_keys
+from keepalive_spread import server_conf, write_accounts, PASS
+
+CHANNEL = "Pressure"
+SINKS = 10
+TALKERS = 4
+
+# seconds a stage gets to show up, the sockets of the sinks take the
+# first one up to a megabyte each
+TIMEOUT = 120
+
+
+class Bot:
+	""" a bot connection, reading everything when asked to """
+
+	def __init__(self, port, n, rcvbuf=None):
+		self.sock = socket.socket()
+		if rcvbuf:
+			self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, rcvbuf)
+		self.sock.connect(("127.0.0.1", port))
+		self.sock.sendall(b"\x03\r\nbot%04d\r\n%s\r\n/join %s\r\n" % (n, PASS.encode(), CHANNEL.encode()))
+		self.sock.setblocking(False)
+		self.closed = False
+
+	def say(self, line):
+		try:
+			self.sock.sendall(line.encode() + b"\r\n")
+		except OSError:
+			self.closed = True
+
+	def drain(self):
+		""" reads what is there, notes when the server closed the connection """
+		try:
+			while True:
+				if not self.sock.recv(65536):
+					self.closed = True
+					return
+		except BlockingIOError:
+			pass
+		except OSError:
+			self.closed = True
+
+	def close(self):
+		self.sock.close()
+
+
+def status(tmp):
+	""" the Users and Mem* figures of the status file """
+	for name in glob.glob(os.path.join(tmp, "var", "status", "*")):
+		try:
+			with open(name) as f:
+				figures = dict((k, int(v)) for k, v in re.findall(r"(?m)^(Users|Mem\w+)=(\d+)", f.read()))
+		except (IOError, ValueError):
+			continue
+		if "MemStage" in figures:
+			return figures
+	return {}
+
+
+def accepted(port):
+	""" a refused connection is closed before the server says anything """
+	try:
+		with socket.create_connection(("127.0.0.1", port), 5) as sock:
+			sock.settimeout(5)
+			sock.sendall(b"\x03\r\n")
+			return bool(sock.recv(100))
+	except OSError:
+		return False
+
+
+def main():
+	parser = argparse.ArgumentParser(description="drive bnetd into memory pressure")
+	parser.add_argument("--bnetd", default="/usr/local/sbin/bnetd", help="the bnetd binary")
+	parser.add_argument("--conf", required=True, help="directory with bnetd.conf and the files it names")
+	parser.add_argument("--budget", type=int, default=25000, help="mem_budget in KB")
+	args = parser.parse_args()
+
+	tmp = tempfile.mkdtemp(prefix="mem_pressure.")
+	proc = None
+	bots = []
+	ok = True
+	try:
+		write_accounts(tmp, SINKS + TALKERS)
+		ports = dict((kind, free_port()) for kind in ("bnet", "w3route"))
+		conf = os.path.join(tmp, "bnetd.conf")
+		with open(conf, "w") as f:
+			f.write(set_keys(server_conf(os.path.join(args.conf, "bnetd.conf"), os.path.abspath(args.conf), tmp, ports, 0), {
+				"mem_budget": str(args.budget),
+				"output_update_secs": "1"}))
+		proc = subprocess.Popen([args.bnetd, "-f", "-c", conf], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+		until = time.time() + TIMEOUT
+		while not status(tmp):
+			if time.time() > until:
+				print("bnetd did not start")
+				return 1
+			time.sleep(0.2)
+
+		sinks = [Bot(ports["bnet"], n, 1024) for n in range(SINKS)]
+		talkers = [Bot(ports["bnet"], SINKS + n) for n in range(TALKERS)]
+		bots = sinks + talkers
+		time.sleep(2)
+
+		# chat is dropped for the sinks, so it can not use up the budget
+		line = 0
+		until = time.time() + TIMEOUT
+		while status(tmp).get("MemShed", 0) == 0 and time.time() < until:
+			fast = status(tmp).get("MemUsed", 0) < 200
+			for talker in talkers:
+				for n in range(fast and 6 or 1):
+					line += 1
+					talker.say("line %d %0180d" % (line, 0))
+				talker.drain()
+			time.sleep(0.1)
+		figures = status(tmp)
+		print("shedding: %s" % figures)
+		ok &= check("chat to the sinks is dropped", figures.get("MemShed", 0) > 0)
+		ok &= check("shedding keeps the sinks connected", figures.get("MemStage", 0) < 2 and figures.get("Users") == SINKS + TALKERS)
+
+		# whispers are not dropped, they fill the budget
+		refused = False
+		until = time.time() + TIMEOUT
+		while status(tmp).get("Users") != TALKERS and time.time() < until:
+			for n, talker in enumerate(talkers):
+				for i in range(4):
+					line += 1
+					for sink in range(n, SINKS, TALKERS):
+						talker.say("/w bot%04d line %d %0180d" % (sink, line, 0))
+				talker.drain()
+			if status(tmp).get("MemStage", 0) >= 2 and not refused:
+				refused = not accepted(ports["bnet"])
+			time.sleep(0.1)
+		figures = status(tmp)
+		print("disconnecting: %s" % figures)
+		ok &= check("new connections are refused", refused and figures.get("MemRefused", 0) > 0)
+		ok &= check("the sinks are disconnected", figures.get("Users") == TALKERS and figures.get("MemKicked", 0) > 0)
+		for talker in talkers:
+			talker.drain()
+		ok &= check("the talkers keeping up stay connected", not any(talker.closed for talker in talkers))
+
+		until = time.time() + TIMEOUT
+		while status(tmp).get("MemStage", 0) != 0 and time.time() < until:
+			for talker in talkers:
+				talker.drain()
+			time.sleep(0.2)
+		figures = status(tmp)
+		print("after: %s" % figures)
+		ok &= check("the pressure is gone", figures.get("MemStage", 0) == 0 and figures.get("MemUsed", 0) * 100 < args.budget * 70)
+		ok &= check("new connections are taken again", accepted(ports["bnet"]))
+	except (IOError, OSError) as e:
+		ok = check("test ran (%s)" % e, False)
+	finally:
+		for bot in bots:
+			bot.close()
+		if proc:
+			proc.kill()
+			proc.wait()
+		if ok:
+			shutil.rmtree(tmp, ignore_errors=True)
+		else:
+			print("logs left in %s" % tmp)
+
+	return not ok
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Join/leave storm against one big channel (see presence_coalesce_size in
+# bnetd.conf). Bots idle in the channel while others hop out and back in
+# again and again, some of them quitting and logging in anew on the way,
+# and a few leave for good at the end.
+# The storm runs once with the notices sent at once and once coalesced:
+#  - every idling bot has to end up with the right member list, built from
+#    the USER, JOIN and LEAVE lines it got,
+#  - coalesced, the idling bots have to get far fewer of those lines.
+#
+#   presence_storm.py --bnetd /path/to/bnetd --conf /path/to/build/conf
+# ==========================================================================
+
+import argparse
+import os
+import select
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+from cluster_test import check, free_port, set_keys
+from keepalive_spread import server_conf, write_accounts, PASS
+
+CHANNEL = "Storm"
+
+# bots idling in the channel, bots hopping and how often each hops
+IDLERS = 60
+HOPPERS = 40
+ROUNDS = 10
+
+# the first of the hoppers quit halfway and log in again, the last ones
+# leave for good at the end
+QUITTERS = 10
+LEAVERS = 5
+
+COALESCE_SIZE = 20
+COALESCE_WINDOW = 1
+
+
+class Bot:
+	""" a bot connection keeping track of who it sees in its channel """
+
+	def __init__(self, port, n):
+		self.name = "bot%04d" % n
+		self.sock = socket.create_connection(("127.0.0.1", port), 10)
+		self.sock.sendall(b"\x03\r\n%s\r\n%s\r\n/join %s\r\n" % (self.name.encode(), PASS.encode(), CHANNEL.encode()))
+		self.sock.setblocking(False)
+		self.buf = b""
+		self.channel = None
+		self.members = set()
+		self.notices = 0
+		self.errors = []
+
+	def say(self, line):
+		self.sock.sendall(line.encode() + b"\r\n")
+
+	def read(self):
+		""" returns False once the server closed the connection """
+		try:
+			data = self.sock.recv(65536)
+		except BlockingIOError:
+			return True
+		if not data:
+			return False
+		lines = (self.buf + data).split(b"\r\n")
+		self.buf = lines.pop()
+		for line in lines:
+			self.event(line.decode("latin-1").split(" "))
+		return True
+
+	def event(self, words):
+		if words[0] == "1007":
+			self.channel = " ".join(words[2:]).strip('"')
+			self.members = set()
+		elif words[0] == "1001":
+			self.members.add(words[2])
+		elif words[0] == "1002":
+			self.notices += 1
+			if words[2] in self.members:
+				self.errors.append("%s joined twice" % words[2])
+			self.members.add(words[2])
+		elif words[0] == "1003":
+			self.notices += 1
+			if words[2] not in self.members:
+				self.errors.append("%s left without being there" % words[2])
+			self.members.discard(words[2])
+		elif words[0] == "1009":
+			self.notices += 1
+
+	def close(self):
+		self.sock.close()
+
+
+def pump(bots, seconds):
+	""" reads what the bots get for a while """
+	until = time.time() + seconds
+	while True:
+		left = until - time.time()
+		if left <= 0:
+			return
+		socks = dict((bot.sock, bot) for bot in bots)
+		ready, _, _ = select.select(list(socks), [], [], left)
+		for sock in ready:
+			if not socks[sock].read():
+				bots.remove(socks[sock])
+
+
+def storm(args, coalesce):
+	""" runs the storm, returns whether the lists were right and the notices the idlers got """
+	tmp = tempfile.mkdtemp(prefix="presence_storm.")
+	proc = None
+	bots = []
+	ok = True
+	try:
+		write_accounts(tmp, IDLERS + HOPPERS)
+		ports = dict((kind, free_port()) for kind in ("bnet", "w3route"))
+		conf = os.path.join(tmp, "bnetd.conf")
+		with open(conf, "w") as f:
+			f.write(set_keys(server_conf(os.path.join(args.conf, "bnetd.conf"), os.path.abspath(args.conf), tmp, ports, 0), {
+				"presence_coalesce_size": str(coalesce),
+				"presence_coalesce_window": str(COALESCE_WINDOW)}))
+		proc = subprocess.Popen([args.bnetd, "-f", "-c", conf], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+		until = time.time() + 30
+		while True:
+			try:
+				socket.create_connection(("127.0.0.1", ports["bnet"]), 1).close()
+				break
+			except OSError:
+				if time.time() > until:
+					print("bnetd did not start")
+					return False, 0
+				time.sleep(0.2)
+
+		idlers = [Bot(ports["bnet"], n) for n in range(IDLERS)]
+		hoppers = [Bot(ports["bnet"], IDLERS + n) for n in range(HOPPERS)]
+		bots = idlers + hoppers
+		pump(bots, COALESCE_WINDOW + 1)
+		before = sum(bot.notices for bot in idlers)
+
+		for r in range(ROUNDS):
+			if r == ROUNDS // 2:
+				for n in range(QUITTERS):
+					bots.remove(hoppers[n])
+					hoppers[n].close()
+				# the account is taken until the server saw the close
+				pump(bots, 0.3)
+				for n in range(QUITTERS):
+					hoppers[n] = Bot(ports["bnet"], IDLERS + n)
+					bots.append(hoppers[n])
+			for bot in hoppers:
+				bot.say("/join %s-%s" % (CHANNEL, bot.name))
+				bot.say("/join %s" % CHANNEL)
+			pump(bots, 0.1)
+		for bot in hoppers[-LEAVERS:]:
+			bot.say("/join %s-%s" % (CHANNEL, bot.name))
+		pump(bots, COALESCE_WINDOW + 2)
+
+		everyone = set(bot.name for bot in idlers + hoppers[:-LEAVERS])
+		for bot in idlers:
+			if bot.channel != CHANNEL or bot.members != everyone or bot.errors:
+				print("%s sees %d of %d members, %s" % (bot.name, len(bot.members & everyone), len(everyone),
+					"; ".join(bot.errors[:3] + ["missing " + name for name in sorted(everyone - bot.members)[:3]])))
+				ok = False
+		return ok, sum(bot.notices for bot in idlers) - before
+	except (IOError, OSError) as e:
+		print("storm failed: %s" % e)
+		ok = False
+		return False, 0
+	finally:
+		for bot in bots:
+			bot.close()
+		if proc:
+			proc.kill()
+			proc.wait()
+		if ok:
+			shutil.rmtree(tmp, ignore_errors=True)
+		else:
+			print("logs left in %s" % tmp)
+
+
+def main():
+	parser = argparse.ArgumentParser(description="run a join/leave storm against bnetd")
+	parser.add_argument("--bnetd", default="/usr/local/sbin/bnetd", help="the bnetd binary")
+	parser.add_argument("--conf", required=True, help="directory with bnetd.conf and the files it names")
+	args = parser.parse_args()
+
+	plain_ok, plain = storm(args, 0)
+	coalesced_ok, coalesced = storm(args, COALESCE_SIZE)
+	print("presence notices to the idling bots: %d sent at once, %d coalesced" % (plain, coalesced))
+
+	ok = check("the member lists are right without coalescing", plain_ok)
+	ok &= check("the member lists are right with coalescing", coalesced_ok)
+	ok &= check("coalescing saves most notices", plain > 0 and coalesced * 4 < plain)
+	return not ok
+
+
+if __name__ == "__main__":
+	sys.exit(main())
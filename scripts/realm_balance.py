@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# Local test of a realm served by several d2cs: starts a bnetd and a few
+# d2cs processes on this host, lets D2DV clients join the realm and checks
+# that bnetd spreads the joins, keeps a client on its d2cs when it joins
+# again or logs in anew and stops sending clients to a d2cs that went away.
+#
+# The accounts are created in a temporary directory. The d2cs need no d2gs
+# to register with bnetd. Run from anywhere:
+#
+#   realm_balance.py --bnetd /path/to/bnetd --d2cs /path/to/d2cs --conf /path/to/build/conf
+#
+# The bnetd.conf in --conf is only used as a template, the processes run
+# with copies in a temporary directory.
+# ==========================================================================
+
+import argparse
+import os
+import shutil
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+from cluster_test import bnet_hash, free_port, set_keys
+from keepalive_spread import server_conf, write_accounts, PASS
+
+NUM_D2CS = 3
+
+# clients joining the realm, the first RELOGIN of them log in again
+NUM_CLIENTS = 30
+RELOGIN = 6
+
+REALM = "D2CS"
+
+# seconds given to the d2cs to register with bnetd
+SETTLE = 3
+
+
+class Client:
+	""" just enough of a D2DV client to log in and join a realm """
+
+	def __init__(self, name, port):
+		self.name = name
+		self.sock = socket.create_connection(("127.0.0.1", port), 10)
+		self.sock.sendall(b"\x01")
+		self.seqno = 0
+
+	def send(self, type, body):
+		self.sock.sendall(struct.pack("<BBH", 0xff, type, len(body) + 4) + body)
+
+	def recv(self, type):
+		while True:
+			head = self.recvall(4)
+			body = self.recvall(struct.unpack("<H", head[2:])[0] - 4)
+			if head[1] == type:
+				return body
+
+	def recvall(self, size):
+		data = b""
+		while len(data) < size:
+			more = self.sock.recv(size - len(data))
+			if not more:
+				raise IOError("connection closed")
+			data += more
+		return data
+
+	def login(self):
+		self.send(0x50, struct.pack("<I4s4sIIIIII", 0, b"68XI", b"VD2D", 0x0d, 0, 0, 0, 1033, 1033) + b"USA\0United States\0")
+		sessionkey = struct.unpack("<II", self.recv(0x50)[:8])[1]
+		ticks = 12345
+		passhash = bnet_hash(PASS.lower().encode())
+		hash2 = bnet_hash(struct.pack("<7I", ticks, sessionkey, *passhash))
+		self.send(0x3a, struct.pack("<7I", ticks, sessionkey, *hash2) + self.name.encode() + b"\0")
+		result = struct.unpack("<I", self.recv(0x3a)[:4])[0]
+		if result != 0:
+			raise IOError("login of %s failed (%d)" % (self.name, result))
+
+	def join(self):
+		""" returns the d2cs port bnetd sent us to, or None if refused """
+		self.seqno += 1
+		self.send(0x3e, struct.pack("<6I", self.seqno, 0, 0, 0, 0, 0) + REALM.encode() + b"\0")
+		reply = self.recv(0x3e)
+		if len(reply) < 22:
+			return None
+		return struct.unpack(">H", reply[20:22])[0]
+
+	def close(self):
+		self.sock.close()
+
+
+def write_conf(path, keys):
+	with open(path, "w") as f:
+		for key, value in keys.items():
+			f.write("%s = %s\n" % (key, value))
+
+
+def count(ports):
+	spread = {}
+	for port in ports:
+		spread[port] = spread.get(port, 0) + 1
+	return spread
+
+
+def check(what, ok):
+	print("%-40s %s" % (what, ok and "ok" or "FAILED"))
+	return ok
+
+
+def main():
+	parser = argparse.ArgumentParser(description="test a realm served by several d2cs")
+	parser.add_argument("--bnetd", default=os.environ.get("BNETD", "/usr/local/sbin/bnetd"), help="the bnetd binary")
+	parser.add_argument("--d2cs", default=os.environ.get("D2CS", "/usr/local/sbin/d2cs"), help="the d2cs binary")
+	parser.add_argument("--conf", required=True, help="directory with bnetd.conf and the files it names")
+	args = parser.parse_args()
+
+	tmp = tempfile.mkdtemp(prefix="realm_balance.")
+	procs = []
+	clients = []
+	ok = True
+	try:
+		write_accounts(tmp, NUM_CLIENTS)
+		ports = dict((kind, free_port()) for kind in ("bnet", "w3route"))
+		d2cs_ports = [free_port() for i in range(NUM_D2CS)]
+
+		# one realm.conf line per d2cs, all with the same realm name
+		with open(os.path.join(tmp, "realm.conf"), "w") as f:
+			for port in d2cs_ports:
+				f.write('"%s" "balance test" 127.0.0.1:%d\n' % (REALM, port))
+		text = server_conf(os.path.join(args.conf, "bnetd.conf"), os.path.abspath(args.conf), tmp, ports, 0)
+		with open(os.path.join(tmp, "bnetd.conf"), "w") as f:
+			f.write(set_keys(text, {
+				"realmfile": '"%s/realm.conf"' % tmp,
+				"d2cs_version": "0"}))
+		procs.append(subprocess.Popen([args.bnetd, "-f", "-c", os.path.join(tmp, "bnetd.conf")],
+			stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+		time.sleep(1)
+
+		# the character store is shared, everything else is per d2cs
+		for sub in ("charsave", "charinfo", "bak/charsave", "bak/charinfo", "ladders"):
+			os.makedirs(os.path.join(tmp, sub))
+		for i, port in enumerate(d2cs_ports):
+			conf = os.path.join(tmp, "d2cs%d.conf" % i)
+			write_conf(conf, {
+				"realmname": REALM,
+				"servaddrs": "127.0.0.1:%d" % port,
+				"gameservlist": "127.0.0.1",
+				"bnetdaddr": "127.0.0.1:%d" % ports["bnet"],
+				"loglevels": "fatal,error,warn",
+				"logfile": '"%s/d2cs%d.log"' % (tmp, i),
+				"pidfile": '"%s/d2cs%d.pid"' % (tmp, i),
+				"charsavedir": '"%s/charsave"' % tmp,
+				"charinfodir": '"%s/charinfo"' % tmp,
+				"bak_charsavedir": '"%s/bak/charsave"' % tmp,
+				"bak_charinfodir": '"%s/bak/charinfo"' % tmp,
+				"ladderdir": '"%s/ladders"' % tmp})
+			procs.append(subprocess.Popen([args.d2cs, "-f", "-c", conf],
+				stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+		time.sleep(SETTLE)
+
+		for i in range(NUM_CLIENTS):
+			client = Client("bot%04d" % i, ports["bnet"])
+			client.login()
+			clients.append(client)
+
+		joined = [client.join() for client in clients]
+		spread = count(joined)
+		print("joins per d2cs: %s" % spread)
+		ok &= check("every d2cs got clients", len(spread) == NUM_D2CS and None not in spread)
+		ok &= check("joins are balanced", max(spread.values()) - min(spread.values()) <= 1)
+
+		again = [client.join() for client in clients]
+		ok &= check("a second join keeps the d2cs", again == joined)
+
+		# a new session of the account goes back to the d2cs it was on; the
+		# ones from the last d2cs join first, the least loaded would be the first
+		relogin = []
+		for port in reversed(d2cs_ports):
+			relogin += [i for i in range(NUM_CLIENTS) if joined[i] == port][:RELOGIN // NUM_D2CS]
+		for i in relogin:
+			clients[i].close()
+		for i in relogin:
+			clients[i] = Client("bot%04d" % i, ports["bnet"])
+			clients[i].login()
+		again = [clients[i].join() for i in relogin]
+		ok &= check("a new login keeps the d2cs", again == [joined[i] for i in relogin])
+
+		# take one d2cs away, its clients move to the others
+		gone = d2cs_ports[-1]
+		procs[-1].send_signal(signal.SIGKILL)
+		procs[-1].wait()
+		time.sleep(1)
+		moved = [client.join() for client in clients]
+		spread = count(moved)
+		print("joins per d2cs: %s" % spread)
+		ok &= check("nobody is sent to the stopped d2cs", gone not in spread and None not in spread)
+		ok &= check("the others keep their clients", all(a == b for a, b in zip(joined, moved) if a != gone))
+		ok &= check("joins stay balanced", max(spread.values()) - min(spread.values()) <= 1)
+	finally:
+		for client in clients:
+			client.close()
+		for proc in procs:
+			if proc.poll() is None:
+				proc.kill()
+				proc.wait()
+		if ok:
+			shutil.rmtree(tmp)
+		else:
+			print("logs left in %s" % tmp)
+
+	return not ok
+
+
+if __name__ == "__main__":
+	sys.exit(main())
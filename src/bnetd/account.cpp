@@ -52,6 +52,7 @@
 #include "attrgroup.h"
 #include "attrlayer.h"
 #include "storage.h"
+#include "cluster.h"
 #include "common/flags.h"
 #include "common/xalloc.h"
 #include "common/xstring.h"
@@ -154,7 +155,7 @@ namespace pvpgn
 					goto err;
 				}
 
-				if (account_set_numattr(account, "BNET\\acct\\userid", maxuserid + 1) < 0) {
+				if (account_set_numattr(account, "BNET\\acct\\userid", accountlist_next_uid()) < 0) {
 					eventlog(eventlog_level_error, __FUNCTION__, "could not set userid");
 					goto err;
 				}
@@ -484,6 +485,19 @@ namespace pvpgn
 		}
 
 
+		/* in a cluster each node keeps to its own residue, the others don't see its new accounts */
+		extern unsigned int accountlist_next_uid(void)
+		{
+			unsigned int uid, stride;
+
+			uid = maxuserid + 1;
+			if (cluster_is_enabled() && (stride = prefs_get_cluster_uid_stride()) > 1)
+				uid += (prefs_get_cluster_uid_offset() % stride + stride - uid % stride) % stride;
+
+			return uid;
+		}
+
+
 		extern int accountlist_save(unsigned flags)
 		{
 			return attrlayer_save(flags);
@@ -92,6 +92,7 @@ namespace pvpgn
 		extern unsigned int account_get_uid_real(t_account const * account, char const * fn, unsigned int ln);
 		extern int account_match(t_account * account, char const * username);
 		extern int account_save(t_account *account, unsigned flags);
+		extern int account_flush(t_account *account, unsigned flags);
 		extern char const * account_get_strattr_real(t_account * account, char const * key, char const * fn, unsigned int ln);
 #define account_get_strattr(A,K) account_get_strattr_real(A,K,__FILE__,__LINE__)
 		extern int account_set_strattr(t_account * account, char const * key, char const * val);
@@ -102,6 +103,7 @@ namespace pvpgn
 		extern t_hashtable * accountlist_uid(void);
 		extern int accountlist_load_all(int flag);
 		extern unsigned int accountlist_get_length(void);
+		extern unsigned int accountlist_next_uid(void);
 		extern int accountlist_save(unsigned flags);
 		extern int accountlist_flush(unsigned flags);
 		extern t_account * accountlist_find_account(char const * username);
@@ -25,6 +25,7 @@
 
 #include "compat/strcasecmp.h"
 
+#include "common/addr.h"
 #include "common/bnet_protocol.h"
 #include "common/bnettime.h"
 #include "common/eventlog.h"
@@ -501,6 +502,17 @@ namespace pvpgn
 		}
 
 
+		/* dump the packets of the account's connection when it logs out */
+		extern int account_get_flightrec(t_account * account)
+		{
+			return account_get_boolattr(account, "BNET\\acct\\flightrec") == 1;
+		}
+		extern int account_set_flightrec(t_account * account, int val)
+		{
+			return account_set_boolattr(account, "BNET\\acct\\flightrec", val);
+		}
+
+
 		/* Return text with account lock */
 		extern std::string account_get_locktext(t_connection * c, t_account * account, bool with_author, bool for_mute)
 		{
@@ -1838,6 +1850,44 @@ namespace pvpgn
 			return 0;
 		}
 
+		/* the d2cs of the realm the account last played on, kept by address so
+		 * it still points at the same d2cs when realm.conf lines move */
+		extern int account_get_realm_d2cs(t_account * account, char const * realmname, unsigned int * ip, unsigned short * port)
+		{
+			char const * str;
+			t_addr * addr;
+
+			if (!realmname)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realmname");
+				return -1;
+			}
+
+			std::string key("BNET\\d2cs\\" + std::string(realmname));
+
+			if (!(str = account_get_strattr(account, key.c_str())) || !(addr = addr_create_str(str, 0, 0)))
+				return -1;
+
+			*ip = addr_get_ip(addr);
+			*port = addr_get_port(addr);
+			addr_destroy(addr);
+
+			return 0;
+		}
+
+		extern int account_set_realm_d2cs(t_account * account, char const * realmname, unsigned int ip, unsigned short port)
+		{
+			if (!realmname)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realmname");
+				return -1;
+			}
+
+			std::string key("BNET\\d2cs\\" + std::string(realmname));
+
+			return account_set_strattr(account, key.c_str(), addr_num_to_addr_str(ip, port));
+		}
+
 		extern int account_set_friend(t_account * account, int friendnum, unsigned int frienduid)
 		{
 			if (frienduid == 0 || friendnum < 0 || friendnum >= prefs_get_max_friends())
@@ -103,6 +103,8 @@ namespace pvpgn
 		extern int account_set_auth_muteby(t_account * account, char const * val);
 		extern std::string account_get_locktext(t_connection * c, t_account * account, bool with_author = true, bool for_mute = false);
 		extern std::string account_get_mutetext(t_connection * c, t_account * account, bool with_author = true);
+		extern int account_get_flightrec(t_account * account);
+		extern int account_set_flightrec(t_account * account, int val);
 
 		/* profile */
 		extern std::string account_get_sex(t_account * account); /* the profile attributes are updated directly in bnetd.c */
@@ -207,6 +209,8 @@ namespace pvpgn
 		extern int account_set_closed_characterlist(t_account * account, t_clienttag clienttag, std::string charlist);
 		extern int account_add_closed_character(t_account * account, t_clienttag clienttag, t_character * ch);
 		extern int account_check_closed_character(t_account * account, t_clienttag clienttag, char const * realmname, char const * charname);
+		extern int account_get_realm_d2cs(t_account * account, char const * realmname, unsigned int * ip, unsigned short * port);
+		extern int account_set_realm_d2cs(t_account * account, char const * realmname, unsigned int ip, unsigned short port);
 
 
 		extern int account_set_friend(t_account * account, int friendnum, unsigned int frienduid);
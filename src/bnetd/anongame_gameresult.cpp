@@ -23,6 +23,7 @@
 #include "common/xalloc.h"
 #include "common/packet.h"
 #include "common/bn_type.h"
+#include "common/tlv.h"
 
 
 #include "common/setup_after.h"
@@ -41,8 +42,7 @@ namespace pvpgn
 				return -1;
 			}
 
-			if ((gameresult->players)) xfree((void *)gameresult->players);
-			if ((gameresult->heroes)) xfree((void *)gameresult->heroes);
+			/* the players and heroes are in the same block */
 			xfree((void *)gameresult);
 
 			return 0;
@@ -51,48 +51,54 @@ namespace pvpgn
 		extern t_anongame_gameresult * anongame_gameresult_parse(t_packet const * const packet)
 		{
 			t_anongame_gameresult 			* gameresult;
-			t_client_w3route_gameresult_player 		* player;
-			t_client_w3route_gameresult_part2 		* part2;
-			t_client_w3route_gameresult_hero		* hero;
-			t_client_w3route_gameresult_part3		* part3;
-
-			int counter, heroes_count;
-			unsigned expectedsize;  //still without hero infos
-			unsigned int offset = 0;
-
-			int result_count = bn_byte_get(packet->u.client_w3route_gameresult.number_of_results);
-			expectedsize = sizeof(t_client_w3route_gameresult)+
-				sizeof(t_client_w3route_gameresult_player)* result_count +
-				sizeof(t_client_w3route_gameresult_part2)+
-				sizeof(t_client_w3route_gameresult_part3);
-
-			if (packet_get_size(packet) < expectedsize)
+			t_client_w3route_gameresult_player const	* players;
+			t_client_w3route_gameresult_part2 const	* part2;
+			t_client_w3route_gameresult_hero const	* heroes;
+			t_client_w3route_gameresult_part3 const	* part3;
+			t_tlv_reader reader;
+
+			int counter, result_count;
+			unsigned int heroes_count;
+
+			/* check the whole report before anything is allocated */
+			tlv_reader_init(&reader, packet_get_raw_data_const(packet, 0), packet_get_size(packet));
+			if (!tlv_reader_take(&reader, sizeof(t_client_w3route_gameresult)))
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "gameresult packet is smaller than expected");
 				return NULL;
 			}
 
-			gameresult = (t_anongame_gameresult*)xmalloc(sizeof(t_anongame_gameresult));
+			result_count = bn_byte_get(packet->u.client_w3route_gameresult.number_of_results);
+			if (!(players = (t_client_w3route_gameresult_player const *)tlv_reader_take(&reader, sizeof(t_client_w3route_gameresult_player)* result_count)) ||
+				!(part2 = (t_client_w3route_gameresult_part2 const *)tlv_reader_take(&reader, sizeof(t_client_w3route_gameresult_part2))))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "gameresult packet is smaller than expected");
+				return NULL;
+			}
 
-			gameresult->players = (t_anongame_player*)xmalloc(sizeof(t_anongame_player)*result_count);
+			heroes_count = bn_int_get(part2->heroes_used_count);
+			if (heroes_count > tlv_reader_get_left(&reader) / sizeof(t_client_w3route_gameresult_hero) ||
+				!(heroes = (t_client_w3route_gameresult_hero const *)tlv_reader_take(&reader, sizeof(t_client_w3route_gameresult_hero)* heroes_count)) ||
+				!(part3 = (t_client_w3route_gameresult_part3 const *)tlv_reader_take(&reader, sizeof(t_client_w3route_gameresult_part3))))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "gameresult packet is smaller than expected");
+				return NULL;
+			}
 
-			gameresult->number_of_results = result_count;
+			gameresult = (t_anongame_gameresult*)xmalloc(sizeof(t_anongame_gameresult)+
+				sizeof(t_anongame_player)* result_count +
+				sizeof(t_anongame_hero)* heroes_count);
+			gameresult->players = (t_anongame_player*)(gameresult + 1);
 
-			offset += sizeof(t_client_w3route_gameresult);
+			gameresult->number_of_results = result_count;
 
 			for (counter = 0; counter < result_count; counter++)
 			{
-				player = (t_client_w3route_gameresult_player *)packet_get_raw_data_const(packet, offset);
-
-				gameresult->players[counter].number = bn_byte_get(player->number);
-				gameresult->players[counter].result = bn_int_get(player->result);
-				gameresult->players[counter].race = bn_int_get(player->race);
-
-				offset += sizeof(t_client_w3route_gameresult_player);
+				gameresult->players[counter].number = bn_byte_get(players[counter].number);
+				gameresult->players[counter].result = bn_int_get(players[counter].result);
+				gameresult->players[counter].race = bn_int_get(players[counter].race);
 			}
 
-			part2 = (t_client_w3route_gameresult_part2 *)packet_get_raw_data_const(packet, offset);
-
 			gameresult->unit_score = bn_int_get(part2->unit_score);
 			gameresult->heroes_score = bn_int_get(part2->heroes_score);
 			gameresult->resource_score = bn_int_get(part2->resource_score);
@@ -101,37 +107,22 @@ namespace pvpgn
 			gameresult->buildings_produced = bn_int_get(part2->buildings_produced);
 			gameresult->buildings_razed = bn_int_get(part2->buildings_razed);
 			gameresult->largest_army = bn_int_get(part2->largest_army);
-			heroes_count = bn_int_get(part2->heroes_used_count);
 			gameresult->heroes_used_count = heroes_count;
 
-			offset += sizeof(t_client_w3route_gameresult_part2);
-
 			if ((heroes_count))
 			{
-				gameresult->heroes = (t_anongame_hero*)xmalloc(sizeof(t_anongame_hero)*heroes_count);
+				gameresult->heroes = (t_anongame_hero*)(gameresult->players + result_count);
 
-				if (packet_get_size(packet) < expectedsize + sizeof(t_client_w3route_gameresult_hero)*heroes_count)
+				for (counter = 0; counter < (int)heroes_count; counter++)
 				{
-					eventlog(eventlog_level_error, __FUNCTION__, "gameresult packet is smaller than expected");
-					return NULL;
-				}
-
-				for (counter = 0; counter < heroes_count; counter++)
-				{
-					hero = (t_client_w3route_gameresult_hero *)packet_get_raw_data_const(packet, offset);
-
-					gameresult->heroes[counter].level = bn_short_get(hero->level);
-					gameresult->heroes[counter].race_and_name = bn_int_get(hero->race_and_name);
-					gameresult->heroes[counter].hero_xp = bn_int_get(hero->hero_xp);
-
-					offset += sizeof(t_client_w3route_gameresult_hero);
+					gameresult->heroes[counter].level = bn_short_get(heroes[counter].level);
+					gameresult->heroes[counter].race_and_name = bn_int_get(heroes[counter].race_and_name);
+					gameresult->heroes[counter].hero_xp = bn_int_get(heroes[counter].hero_xp);
 				}
 			}
 			else
 				gameresult->heroes = NULL;
 
-			part3 = (t_client_w3route_gameresult_part3 *)packet_get_raw_data_const(packet, offset);
-
 			gameresult->heroes_killed = bn_int_get(part3->heroes_killed);
 			gameresult->items_obtained = bn_int_get(part3->items_obtained);
 			gameresult->mercenaries_hired = bn_int_get(part3->mercenaries_hired);
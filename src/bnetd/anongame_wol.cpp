@@ -20,9 +20,11 @@
 #include "common/setup_before.h"
 #include "anongame_wol.h"
 
+#include <cstddef>
 #include <cstring>
 #include <cctype>
 #include <cstdlib>
+#include <string>
 
 #include "compat/strcasecmp.h"
 
@@ -30,7 +32,7 @@
 #include "common/packet.h"
 #include "common/eventlog.h"
 #include "common/tag.h"
-#include "common/list.h"
+#include "common/xalloc.h"
 #include "common/anongame_protocol.h"
 
 #include "irc.h"
@@ -38,6 +40,9 @@
 #include "connection.h"
 #include "channel.h"
 #include "anongame.h"
+#include "anongame_wol_queue.h"
+#include "prefs.h"
+#include "server.h"
 #include "common/setup_after.h"
 
 namespace pvpgn
@@ -53,12 +58,11 @@ namespace pvpgn
 			t_anong_tag      wol_anong_tag_handler;
 		} t_wol_anongame_tag_table_row;
 
-		static t_list * anongame_wol_matchlist_head = NULL;
-
 		static int _handle_address_tag(t_anongame_wol_player * player, char * param);
 		static int _handle_port_tag(t_anongame_wol_player * player, char * param);
 		static int _handle_country_tag(t_anongame_wol_player * player, char * param);
 		static int _handle_colour_tag(t_anongame_wol_player * player, char * param);
+		static int _handle_location_tag(t_anongame_wol_player * player, char * param);
 
 		static const t_wol_anongame_tag_table_row t_wol_anongame_tag_table[] =
 		{
@@ -66,6 +70,7 @@ namespace pvpgn
 			{ MATCHTAG_PORT, _handle_port_tag },
 			{ MATCHTAG_COUNTRY, _handle_country_tag },
 			{ MATCHTAG_COLOUR, _handle_colour_tag },
+			{ MATCHTAG_LOCATION, _handle_location_tag },
 
 			{ NULL, NULL }
 		};
@@ -89,31 +94,31 @@ namespace pvpgn
 		{
 			t_anongame_wol_player * player;
 
-			player = (t_anongame_wol_player*)xmalloc(sizeof(t_anongame_wol_player));
+			/* a new request replaces the one still waiting */
+			if ((player = conn_wol_get_anongame_player(conn)))
+				anongame_wol_queue_del(&player->waiter);
+			else {
+				player = (t_anongame_wol_player*)xmalloc(sizeof(t_anongame_wol_player));
+				player->conn = conn;
+				anongame_wol_waiter_init(&player->waiter);
+				conn_wol_set_anongame_player(conn, player);
 
-			player->conn = conn;
+				DEBUG1("[** WOL **] annongame player created: {}", conn_get_chatname(conn));
+			}
 
 			/* Used only in Red Alert 2 and Yuri's Revenge */
 			player->address = 0;
 			player->port = 0;
 			player->country = -2; /* Default values are form packet dumps - not prefered country */
 			player->colour = -2; /* Default values are form packet dumps - not prefered colour */
-
-			conn_wol_set_anongame_player(conn, player);
-
-			list_append_data(anongame_wol_matchlist_head, player);
-
-			DEBUG1("[** WOL **] annongame player created: {}", conn_get_chatname(conn));
+			player->location = 0;
 
 			return player;
 		}
 
-		static int anongame_wol_player_destroy(t_anongame_wol_player * player, t_elem ** curr)
+		static int anongame_wol_player_destroy(t_anongame_wol_player * player)
 		{
-			if (list_remove_data(anongame_wol_matchlist_head, player, curr) < 0){
-				ERROR0("could not remove item from list");
-				return -1;
-			}
+			anongame_wol_queue_del(&player->waiter);
 
 			DEBUG0("[** WOL **] destroying annongame player");
 
@@ -122,6 +127,11 @@ namespace pvpgn
 			return 0;
 		}
 
+		static t_anongame_wol_player * anongame_wol_player_from_waiter(t_anongame_wol_waiter const * waiter)
+		{
+			return (t_anongame_wol_player *)((char *)waiter - offsetof(t_anongame_wol_player, waiter));
+		}
+
 		static t_connection * anongame_wol_player_get_conn(t_anongame_wol_player const * player)
 		{
 			if (!player) {
@@ -225,64 +235,39 @@ namespace pvpgn
 			return 0;
 		}
 
+		static int _handle_location_tag(t_anongame_wol_player * player, char * param)
+		{
+			if (!player) {
+				ERROR0("got NULL player");
+				return -1;
+			}
+
+			if (param)
+				player->location = std::atoi(param);
+
+			return 0;
+		}
+
 		/* Matchlist functions:*/
 
 		extern int anongame_wol_matchlist_create(void)
 		{
-			anongame_wol_matchlist_head = list_create();
-
 			return 0;
 		}
 
 		extern int anongame_wol_matchlist_destroy(void)
 		{
-			t_anongame_wol_player * player;
-			t_elem * curr;
-
-			if (anongame_wol_matchlist_head) {
-				LIST_TRAVERSE(anongame_wol_matchlist_head, curr) {
-					if (!(player = (t_anongame_wol_player*)elem_get_data(curr))) { /* should not happen */
-						ERROR0("wol_matchlist contains NULL item");
-						continue;
-					}
-					anongame_wol_player_destroy(player, &curr);
-				}
-
-				if (list_destroy(anongame_wol_matchlist_head) < 0)
-					return -1;
-				anongame_wol_matchlist_head = NULL;
-			}
+			anongame_wol_queue_destroy_all();
 
 			return 0;
 		}
 
-		extern t_list * anongame_wol_matchlist(void)
-		{
-			return anongame_wol_matchlist_head;
-		}
-
-		static t_anongame_wol_player * anongame_wol_matchlist_find_player_by_conn(t_connection * conn)
+		/* still in the lobby it asked for a match in */
+		static int anongame_wol_waiter_check(t_anongame_wol_waiter const * waiter)
 		{
-			t_elem * curr;
+			t_channel * channel = conn_get_channel(anongame_wol_player_from_waiter(waiter)->conn);
 
-			if (!conn) {
-				ERROR0("got NULL conn");
-				return NULL;
-			}
-
-			LIST_TRAVERSE(anongame_wol_matchlist(), curr) {
-				t_anongame_wol_player * player = (t_anongame_wol_player *)elem_get_data(curr);
-				if (conn == anongame_wol_player_get_conn(player)) {
-					return player;
-				}
-			}
-
-			return NULL;
-		}
-
-		static int anongame_wol_matchlist_get_length(void)
-		{
-			return list_get_length(anongame_wol_matchlist_head);
+			return channel && strcasecmp(channel_get_name(channel), waiter->queue->name) == 0;
 		}
 
 		/* support functions */
@@ -347,22 +332,50 @@ namespace pvpgn
 		}
 
 
-		static int anongame_wol_trystart(t_anongame_wol_player const * player1)
+		typedef enum {
+			anongame_wol_mode_none,
+			anongame_wol_mode_ral2_solo,
+			anongame_wol_mode_yuri_solo,
+			anongame_wol_mode_yuri_coop
+		} t_anongame_wol_mode;
+
+		static t_anongame_wol_mode anongame_wol_get_mode(t_clienttag ctag, char const * channelname)
 		{
-			t_elem * curr;
-			char temp[MAX_IRC_MESSAGE_LEN];
-			char _temp[MAX_IRC_MESSAGE_LEN];
-			int random;
-
-			t_anongame_wol_player * player2;
-			t_connection * conn_pl1;
-			t_connection * conn_pl2;
-			char const * channelname;
-			const char * mapname;
-			t_clienttag ctag;
+			switch (ctag) {
+			case CLIENTTAG_REDALERT2_UINT:
+				if (std::strcmp(channelname, RAL2_CHANNEL_FFA) == 0)
+					return anongame_wol_mode_ral2_solo;
+				break;
+			case CLIENTTAG_YURISREV_UINT:
+				if (std::strcmp(channelname, YURI_CHANNEL_FFA) == 0)
+					return anongame_wol_mode_yuri_solo;
+				if (std::strcmp(channelname, YURI_CHANNEL_COOP) == 0)
+					return anongame_wol_mode_yuri_coop;
+				break;
+			default:
+				DEBUG0("unsupported client for WOL Matchgame");
+				return anongame_wol_mode_none;
+			}
 
-			std::memset(temp, 0, sizeof(temp));
-			std::memset(_temp, 0, sizeof(_temp));
+			ERROR1("undefined channel type for {} channel", channelname);
+			return anongame_wol_mode_none;
+		}
+
+		static std::string anongame_wol_start_msg(t_anongame_wol_mode mode, t_anongame_wol_player const * player1, t_anongame_wol_player const * player2)
+		{
+			t_clienttag ctag = conn_get_clienttag(player1->conn);
+			char const * name1 = conn_get_chatname(player1->conn);
+			char const * name2 = conn_get_chatname(player2->conn);
+			unsigned int address1 = (unsigned int)anongame_wol_player_get_address(player1);
+			unsigned int address2 = (unsigned int)anongame_wol_player_get_address(player2);
+			unsigned int port1 = (unsigned int)anongame_wol_player_get_port(player1);
+			unsigned int port2 = (unsigned int)anongame_wol_player_get_port(player2);
+			int pl1_colour = anongame_wol_player_get_colour(player1);
+			int pl1_country = anongame_wol_player_get_country(player1);
+			int pl2_colour = anongame_wol_player_get_colour(player2);
+			int pl2_country = anongame_wol_player_get_country(player2);
+			int random = rand();
+			char const * mapname;
 
 			/**
 			 * Expected start message is
@@ -376,129 +389,105 @@ namespace pvpgn
 			 *
 			 * Yuris Revenge Quick Coop:
 			 *
+			 * The first player is the GameHost, the second the GameJoinie.
 			 */
 
-			if (!player1) {
-				ERROR0("got NULL player");
-				return -1;
+			if (!name1)
+				name1 = "";
+			if (!name2)
+				name2 = "";
+
+			switch (mode) {
+			case anongame_wol_mode_ral2_solo:
+				DEBUG0("Generating SOLO game for Red Alert 2");
+
+				_get_pair(&pl1_colour, &pl2_colour, 7, true);
+				_get_pair(&pl1_country, &pl2_country, 8, false);
+				if (!(mapname = anongame_get_map_from_prefs(ANONGAME_TYPE_1V1, ctag)))
+					mapname = "";
+
+				return fmt::format(":Start {},0,0,10000,0,1,0,1,1,0,1,x,2,1,165368,{},1:"
+					"{},{},{},{:x},1,{:x},"
+					"{},{},{},{:x},1,{:x}",
+					random, mapname,
+					name1, pl1_country, pl1_colour, address1, port1,
+					name2, pl2_country, pl2_colour, address2, port2);
+
+			case anongame_wol_mode_yuri_solo:
+				DEBUG0("Generating SOLO game for Yuri's Revenge");
+
+				_get_pair(&pl1_colour, &pl2_colour, 7, true);
+				_get_pair(&pl1_country, &pl2_country, 9, false);
+				if (!(mapname = anongame_get_map_from_prefs(ANONGAME_TYPE_1V1, ctag)))
+					mapname = "";
+
+				return fmt::format(":Start {},0,0,10000,0,0,1,1,1,0,3,0,x,2,1,163770,{},1:"
+					"{},{},{},-2,-2,{:x},1,{:x},"
+					"{},{},{},-2,-2,{:x},1,{:x}",
+					random, mapname,
+					name1, pl1_country, pl1_colour, address1, port1,
+					name2, pl2_country, pl2_colour, address2, port2);
+
+			case anongame_wol_mode_yuri_coop:
+				DEBUG0("Generating COOP game for Yuri's Revenge");
+
+				/* the computers of coop games follow the players */
+				return fmt::format(":Start {},0,0,10000,10,0,1,1,0,1,3,0,x,2,1,163770,C1A01MD.MAP,1:"
+					"{},0,4,0,-2,{:x},1,{:x},"
+					"{},0,5,1,-2,{:x},1,{:x}"
+					":@:0,-1,-1,-2,-2,0,-1,-1,-2,-2,1,8,1,-2,-2,1,8,2,-2,-2,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,",
+					random,
+					name1, address1, port1,
+					name2, address2, port2);
+
+			default:
+				return std::string();
 			}
+		}
 
-			conn_pl1 = anongame_wol_player_get_conn(player1);
-			ctag = conn_get_clienttag(conn_pl1);
-			channelname = channel_get_name(conn_get_channel(conn_pl1));
-
-			LIST_TRAVERSE(anongame_wol_matchlist(), curr) {
-				player2 = (t_anongame_wol_player *)elem_get_data(curr);
-				conn_pl2 = anongame_wol_player_get_conn(player2);
+		static int anongame_wol_start(t_anongame_wol_mode mode, t_anongame_wol_player * player1, t_anongame_wol_player * player2)
+		{
+			anongame_wol_queue_del(&player1->waiter);
+			anongame_wol_queue_del(&player2->waiter);
 
-				if ((player1 != player2) && ((conn_get_channel(conn_pl1)) == (conn_get_channel(conn_pl2)))) {
-					switch (ctag) {
-					case CLIENTTAG_REDALERT2_UINT: {
-						random = rand();
+			/* the same start for both */
+			std::string msg = anongame_wol_start_msg(mode, player1, player2);
+			if (msg.empty())
+				return -1;
 
-						if (std::strcmp(channelname, RAL2_CHANNEL_FFA) == 0) {
-							int pl1_colour = anongame_wol_player_get_colour(player1);
-							int pl1_country = anongame_wol_player_get_country(player1);
-							int pl2_colour = anongame_wol_player_get_colour(player2);
-							int pl2_country = anongame_wol_player_get_country(player2);
+			_send_msg(player1->conn, "PRIVMSG", msg.c_str());
+			_send_msg(player2->conn, "PRIVMSG", msg.c_str());
 
-							DEBUG0("Generating SOLO game for Red Alert 2");
+			return 0;
+		}
 
-							_get_pair(&pl1_colour, &pl2_colour, 7, true);
-							_get_pair(&pl1_country, &pl2_country, 8, false);
-							mapname = anongame_get_map_from_prefs(ANONGAME_TYPE_1V1, ctag);
+		static int anongame_wol_trystart(t_anongame_wol_player * player1)
+		{
+			t_anongame_wol_waiter * waiter;
+			t_anongame_wol_mode mode;
+			t_channel * channel;
+			char const * channelname;
 
-							/* We have madatory of game */
-							std::snprintf(_temp, sizeof(_temp), ":Start %d,0,0,10000,0,1,0,1,1,0,1,x,2,1,165368,%s,1:", random, mapname);
-							std::strcat(temp, _temp);
+			if (!player1) {
+				ERROR0("got NULL player");
+				return -1;
+			}
 
-							/* GameHost informations */
-							std::snprintf(_temp, sizeof(_temp), "%s,%d,%d,%x,1,%x,", conn_get_chatname(conn_pl1), pl1_country, pl1_colour, anongame_wol_player_get_address(player1), anongame_wol_player_get_port(player1));
-							std::strcat(temp, _temp);
+			if (!(channel = conn_get_channel(anongame_wol_player_get_conn(player1)))) {
+				ERROR0("player is not in a channel");
+				return -1;
+			}
+			channelname = channel_get_name(channel);
 
-							/* GameJoinie informations */
-							std::snprintf(_temp, sizeof(_temp), "%s,%d,%d,%x,1,%x", conn_get_chatname(conn_pl2), pl2_country, pl2_colour, anongame_wol_player_get_address(player2), anongame_wol_player_get_port(player2));
-							std::strcat(temp, _temp);
+			if ((mode = anongame_wol_get_mode(conn_get_clienttag(player1->conn), channelname)) == anongame_wol_mode_none)
+				return 0;
 
-							_send_msg(conn_pl1, "PRIVMSG", temp);
-							_send_msg(conn_pl2, "PRIVMSG", temp);
-						}
-						else
-							ERROR1("undefined channel type for {} channel", channelname);
-					}
-						return 0;
-					case CLIENTTAG_YURISREV_UINT: {
-													  random = rand();
-
-													  if (std::strcmp(channelname, YURI_CHANNEL_FFA) == 0) {
-														  int pl1_colour = anongame_wol_player_get_colour(player1);
-														  int pl1_country = anongame_wol_player_get_country(player1);
-														  int pl2_colour = anongame_wol_player_get_colour(player2);
-														  int pl2_country = anongame_wol_player_get_country(player2);
-
-														  DEBUG0("Generating SOLO game for Yuri's Revenge");
-
-														  _get_pair(&pl1_colour, &pl2_colour, 7, true);
-														  _get_pair(&pl1_country, &pl2_country, 9, false);
-														  mapname = anongame_get_map_from_prefs(ANONGAME_TYPE_1V1, ctag);
-
-														  /* We have madatory of game */
-														  std::snprintf(_temp, sizeof(_temp), ":Start %d,0,0,10000,0,0,1,1,1,0,3,0,x,2,1,163770,%s,1:", random, mapname);
-														  std::strcat(temp, _temp);
-
-														  /* GameHost informations */
-														  std::snprintf(_temp, sizeof(_temp), "%s,%d,%d,-2,-2,", conn_get_chatname(conn_pl1), pl1_country, pl1_colour);
-														  std::strcat(temp, _temp);
-														  std::snprintf(_temp, sizeof(_temp), "%x,1,%x,", anongame_wol_player_get_address(player1), anongame_wol_player_get_port(player1));
-														  std::strcat(temp, _temp);
-
-														  /* GameJoinie informations */
-														  std::snprintf(_temp, sizeof(_temp), "%s,%d,%d,-2,-2,", conn_get_chatname(conn_pl2), pl2_country, pl2_colour);
-														  std::strcat(temp, _temp);
-														  std::snprintf(_temp, sizeof(_temp), "%x,1,%x", anongame_wol_player_get_address(player2), anongame_wol_player_get_port(player2));
-														  std::strcat(temp, _temp);
-
-														  _send_msg(conn_pl1, "PRIVMSG", temp);
-														  _send_msg(conn_pl2, "PRIVMSG", temp);
-													  }
-													  else if (std::strcmp(channelname, YURI_CHANNEL_COOP) == 0) {
-														  DEBUG0("Generating COOP game for Yuri's Revenge");
-
-														  /* We have madatory of game */
-														  std::snprintf(_temp, sizeof(_temp), ":Start %d,0,0,10000,10,0,1,1,0,1,3,0,x,2,1,163770,C1A01MD.MAP,1:", random);
-														  std::strcat(temp, _temp);
-
-														  /* GameHost informations */
-														  std::snprintf(_temp, sizeof(_temp), "%s,0,4,0,-2,", conn_get_chatname(conn_pl1));
-														  std::strcat(temp, _temp);
-														  std::snprintf(_temp, sizeof(_temp), "%x,1,%x,", anongame_wol_player_get_address(player1), anongame_wol_player_get_port(player1));
-														  std::strcat(temp, _temp);
-
-														  /* GameJoinie informations */
-														  std::snprintf(_temp, sizeof(_temp), "%s,0,5,1,-2,", conn_get_chatname(anongame_wol_player_get_conn(player2)));
-														  std::strcat(temp, _temp);
-														  std::snprintf(_temp, sizeof(_temp), "%x,1,%x", anongame_wol_player_get_address(player2), anongame_wol_player_get_port(player2));
-														  std::strcat(temp, _temp);
-
-														  /* Some computers for coop games */
-														  std::snprintf(_temp, sizeof(_temp), ":@:0,-1,-1,-2,-2,0,-1,-1,-2,-2,1,8,1,-2,-2,1,8,2,-2,-2,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,");
-														  std::strcat(temp, _temp);
-
-														  _send_msg(conn_pl1, "PRIVMSG", temp);
-														  _send_msg(conn_pl2, "PRIVMSG", temp);
-													  }
-													  else
-														  ERROR1("undefined channel type for {} channel", channelname);
-					}
-						return 0;
-					default:
-						DEBUG0("unsupported client for WOL Matchgame");
-						return 0;
-					}
-				}
-			}
+			/* wait in the queue of the lobby, unless somebody there is waiting already */
+			anongame_wol_queue_add(anongame_wol_queue_get(channelname), &player1->waiter, player1->location, now);
+			if (!(waiter = anongame_wol_queue_find_partner(&player1->waiter, now, prefs_get_wol_match_region_wait(), anongame_wol_waiter_check)))
+				return 0;
 
-			return 0;
+			return anongame_wol_start(mode, player1, anongame_wol_player_from_waiter(waiter));
 		}
 
 		static int anongame_wol_tokenize_line(t_connection * conn, char const * text)
@@ -521,11 +510,6 @@ namespace pvpgn
 				return -1;
 			}
 
-			if (!(player = anongame_wol_player_create(conn))) {
-				ERROR0("player was not created");
-				return -1;
-			}
-
 			/**
 			 * Here are expected privmsgs:
 			 * :user!EMPR@host PRIVMSG matchbot :Match COU=-1,COL=-1,SHA=-1,SHB=-1,LOC=2,RAT=0
@@ -550,6 +534,12 @@ namespace pvpgn
 			*temp++ = '\0';
 
 			if ((std::strcmp(command, "Match") == 0)) {
+				if (!(player = anongame_wol_player_create(conn))) {
+					ERROR0("player was not created");
+					xfree(line);
+					return -1;
+				}
+
 				strcat(temp, ","); /* FIXME: This is DUMB - without that we lost the last tag/param */
 
 				for (p = temp; *p && (*p != '\0'); p++) {
@@ -583,20 +573,32 @@ namespace pvpgn
 
 		extern int anongame_wol_destroy(t_connection * conn)
 		{
-			t_elem *curr;
+			t_anongame_wol_player * player;
 
 			/* Player destroying */
 
-			LIST_TRAVERSE(anongame_wol_matchlist_head, curr) {
-				t_anongame_wol_player * player = (t_anongame_wol_player*)elem_get_data(curr);
-
-				if (conn == anongame_wol_player_get_conn(player))
-					anongame_wol_player_destroy(player, &curr);
-			}
+			if ((player = conn_wol_get_anongame_player(conn)))
+				anongame_wol_player_destroy(player);
 
 			return 0;
 		}
 
+		/* pairs the players who waited long enough for one of their region with anybody */
+		extern void anongame_wol_check(std::time_t now)
+		{
+			t_anongame_wol_waiter * waiter1;
+			t_anongame_wol_waiter * waiter2;
+
+			while (anongame_wol_queue_pop_expired(now, prefs_get_wol_match_region_wait(), anongame_wol_waiter_check, &waiter1, &waiter2)) {
+				t_anongame_wol_player * player1 = anongame_wol_player_from_waiter(waiter1);
+				t_anongame_wol_player * player2 = anongame_wol_player_from_waiter(waiter2);
+				t_anongame_wol_mode mode = anongame_wol_get_mode(conn_get_clienttag(player1->conn), channel_get_name(conn_get_channel(player1->conn)));
+
+				if (mode != anongame_wol_mode_none)
+					anongame_wol_start(mode, player1, player2);
+			}
+		}
+
 		extern int anongame_wol_privmsg(t_connection * conn, int numparams, char ** params, char * text)
 		{
 
@@ -24,7 +24,11 @@
 #ifndef JUST_NEED_TYPES
 # define JUST_NEED_TYPES
 # include "connection.h"
+# include "anongame_wol_queue.h"
 # undef JUST_NEED_TYPES
+#else
+# include "connection.h"
+# include "anongame_wol_queue.h"
 #endif
 
 #define MATCHTAG_ADDRESS           "ADR"
@@ -51,12 +55,14 @@ namespace pvpgn
 #ifdef ANONGAME_WOL_INTERNAL_ACCESS
 		{
 			t_connection       * conn;
+			t_anongame_wol_waiter waiter;	/* in the queue of its channel */
 
 			/* Red Alert 2 and Yuri's Revnenge */
 			int                  address;
 			int                  port;
 			int                  country;
 			int                  colour;
+			int                  location;
 		}
 #endif
 		t_anongame_wol_player;
@@ -72,6 +78,8 @@ namespace pvpgn
 #ifndef INCLUDED_ANONGAME_WOL_PROTOS
 #define INCLUDED_ANONGAME_WOL_PROTOS
 
+#include <ctime>
+
 #define JUST_NEED_TYPES
 # include "connection.h"
 #undef JUST_NEED_TYPES
@@ -86,6 +94,7 @@ namespace pvpgn
 		extern int anongame_wol_matchlist_destroy(void);
 
 		extern int anongame_wol_destroy(t_connection * conn);
+		extern void anongame_wol_check(std::time_t now);
 		extern int anongame_wol_privmsg(t_connection * conn, int numparams, char ** params, char * text);
 
 	}
@@ -0,0 +1,217 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "anongame_wol_queue.h"
+
+#include "compat/strcasecmp.h"
+#include "common/xalloc.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/*
+		 * Players waiting for a quick match, queued by the lobby they asked
+		 * in. Joining, leaving and pairing with the longest waiting player
+		 * are constant time. Pairing within a region only looks at the
+		 * players whose region falls into the same bucket.
+		 */
+		static DECLARE_ELIST_INIT(anongame_wol_queues);
+
+
+		extern void anongame_wol_waiter_init(t_anongame_wol_waiter * waiter)
+		{
+			waiter->queue = NULL;
+			waiter->region = 0;
+			waiter->since = 0;
+			elist_init(&waiter->link);
+			elist_init(&waiter->region_link);
+		}
+
+
+		extern t_anongame_wol_queue * anongame_wol_queue_get(char const * name)
+		{
+			t_anongame_wol_queue * queue;
+			t_elist * curr;
+			unsigned int i;
+
+			elist_for_each(curr, &anongame_wol_queues)
+			{
+				queue = elist_entry(curr, t_anongame_wol_queue, link);
+				if (strcasecmp(queue->name, name) == 0)
+					return queue;
+			}
+
+			queue = (t_anongame_wol_queue *)xmalloc(sizeof(t_anongame_wol_queue));
+			queue->name = xstrdup(name);
+			queue->count = 0;
+			elist_init(&queue->waiters);
+			for (i = 0; i < ANONGAME_WOL_QUEUE_REGIONS; i++)
+				elist_init(&queue->regions[i]);
+			elist_add_tail(&anongame_wol_queues, &queue->link);
+
+			return queue;
+		}
+
+
+		extern void anongame_wol_queue_add(t_anongame_wol_queue * queue, t_anongame_wol_waiter * waiter, int region, std::time_t now)
+		{
+			anongame_wol_queue_del(waiter);
+
+			waiter->queue = queue;
+			waiter->region = region;
+			waiter->since = now;
+			elist_add_tail(&queue->waiters, &waiter->link);
+			elist_add_tail(&queue->regions[(unsigned int)region % ANONGAME_WOL_QUEUE_REGIONS], &waiter->region_link);
+			queue->count++;
+		}
+
+
+		extern void anongame_wol_queue_del(t_anongame_wol_waiter * waiter)
+		{
+			if (!waiter->queue)
+				return;
+
+			elist_del(&waiter->link);
+			elist_del(&waiter->region_link);
+			waiter->queue->count--;
+			waiter->queue = NULL;
+		}
+
+
+		/*
+		 * The longest waiting player of the queue. With region_wait only
+		 * one of the same region, unless one of the two has waited that
+		 * long already.
+		 */
+		extern t_anongame_wol_waiter * anongame_wol_queue_find_partner(t_anongame_wol_waiter const * waiter, std::time_t now, unsigned int region_wait, t_anongame_wol_waiter_check check)
+		{
+			t_anongame_wol_queue * queue = waiter->queue;
+			t_anongame_wol_waiter * first;
+			t_elist * curr;
+			t_elist * save;
+
+			if (!queue)
+				return NULL;
+
+			for (;;)
+			{
+				curr = elist_next(&queue->waiters);
+				if (curr == &waiter->link)
+					curr = elist_next(curr);
+				if (curr == &queue->waiters)
+					return NULL;
+				first = elist_entry(curr, t_anongame_wol_waiter, link);
+				if (!check || check(first))
+					break;
+				anongame_wol_queue_del(first);
+			}
+
+			if (!region_wait || now - first->since >= (std::time_t)region_wait || now - waiter->since >= (std::time_t)region_wait)
+				return first;
+
+			elist_for_each_safe(curr, &queue->regions[(unsigned int)waiter->region % ANONGAME_WOL_QUEUE_REGIONS], save)
+			{
+				t_anongame_wol_waiter * other = elist_entry(curr, t_anongame_wol_waiter, region_link);
+
+				if (other == waiter || other->region != waiter->region)
+					continue;
+				if (!check || check(other))
+					return other;
+				anongame_wol_queue_del(other);
+			}
+
+			return NULL;
+		}
+
+
+		/* takes the two longest waiting players of a queue out once the first waited region_wait */
+		extern int anongame_wol_queue_pop_expired(std::time_t now, unsigned int region_wait, t_anongame_wol_waiter_check check, t_anongame_wol_waiter ** waiter1, t_anongame_wol_waiter ** waiter2)
+		{
+			t_elist * curr;
+
+			if (!region_wait)
+				return 0;
+
+			elist_for_each(curr, &anongame_wol_queues)
+			{
+				t_anongame_wol_queue * queue = elist_entry(curr, t_anongame_wol_queue, link);
+
+				while (queue->count >= 2)
+				{
+					*waiter1 = elist_entry(elist_next(&queue->waiters), t_anongame_wol_waiter, link);
+					*waiter2 = elist_entry(elist_next(&(*waiter1)->link), t_anongame_wol_waiter, link);
+					if (check && !check(*waiter1))
+					{
+						anongame_wol_queue_del(*waiter1);
+						continue;
+					}
+					if (now - (*waiter1)->since < (std::time_t)region_wait)
+						break;
+					if (check && !check(*waiter2))
+					{
+						anongame_wol_queue_del(*waiter2);
+						continue;
+					}
+
+					anongame_wol_queue_del(*waiter1);
+					anongame_wol_queue_del(*waiter2);
+					return 1;
+				}
+			}
+
+			return 0;
+		}
+
+
+		extern unsigned int anongame_wol_queue_get_waiting(void)
+		{
+			unsigned int count = 0;
+			t_elist * curr;
+
+			elist_for_each(curr, &anongame_wol_queues)
+				count += elist_entry(curr, t_anongame_wol_queue, link)->count;
+
+			return count;
+		}
+
+
+		extern void anongame_wol_queue_destroy_all(void)
+		{
+			t_elist * curr;
+			t_elist * save;
+			t_elist * wcurr;
+
+			elist_for_each_safe(curr, &anongame_wol_queues, save)
+			{
+				t_anongame_wol_queue * queue = elist_entry(curr, t_anongame_wol_queue, link);
+
+				/* the players stay with their connections */
+				elist_for_each(wcurr, &queue->waiters)
+					elist_entry(wcurr, t_anongame_wol_waiter, link)->queue = NULL;
+
+				elist_del(&queue->link);
+				xfree((void *)queue->name);
+				xfree(queue);
+			}
+		}
+
+	}
+
+}
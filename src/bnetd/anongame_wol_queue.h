@@ -0,0 +1,85 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef INCLUDED_ANONGAME_WOL_QUEUE_TYPES
+#define INCLUDED_ANONGAME_WOL_QUEUE_TYPES
+
+#include <ctime>
+
+#include "common/elist.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+#define ANONGAME_WOL_QUEUE_REGIONS 32
+
+		/* one for each lobby (game mode) that has players waiting for a quick match */
+		typedef struct anongame_wol_queue
+		{
+			char const *   name;		/* of the channel */
+			unsigned int   count;
+			t_elist        waiters;		/* oldest first */
+			t_elist        regions[ANONGAME_WOL_QUEUE_REGIONS];	/* by region modulo, oldest first */
+			t_elist        link;
+		} t_anongame_wol_queue;
+
+		/* part of the player waiting */
+		typedef struct anongame_wol_waiter
+		{
+			t_anongame_wol_queue * queue;	/* NULL when not waiting */
+			int                    region;	/* LOC of the match request */
+			std::time_t            since;
+			t_elist                link;
+			t_elist                region_link;
+		} t_anongame_wol_waiter;
+
+		/* whether a waiting player can still be paired, the others are taken out */
+		typedef int(*t_anongame_wol_waiter_check)(t_anongame_wol_waiter const * waiter);
+
+	}
+
+}
+
+#endif
+
+/*******/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_ANONGAME_WOL_QUEUE_PROTOS
+#define INCLUDED_ANONGAME_WOL_QUEUE_PROTOS
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		extern void anongame_wol_waiter_init(t_anongame_wol_waiter * waiter);
+		extern t_anongame_wol_queue * anongame_wol_queue_get(char const * name);
+		extern void anongame_wol_queue_add(t_anongame_wol_queue * queue, t_anongame_wol_waiter * waiter, int region, std::time_t now);
+		extern void anongame_wol_queue_del(t_anongame_wol_waiter * waiter);
+		extern t_anongame_wol_waiter * anongame_wol_queue_find_partner(t_anongame_wol_waiter const * waiter, std::time_t now, unsigned int region_wait, t_anongame_wol_waiter_check check);
+		extern int anongame_wol_queue_pop_expired(std::time_t now, unsigned int region_wait, t_anongame_wol_waiter_check check, t_anongame_wol_waiter ** waiter1, t_anongame_wol_waiter ** waiter2);
+		extern unsigned int anongame_wol_queue_get_waiting(void);
+		extern void anongame_wol_queue_destroy_all(void);
+
+	}
+
+}
+
+#endif
+#endif
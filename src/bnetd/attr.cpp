@@ -0,0 +1,154 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "attr.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "common/xalloc.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/*
+		 * Every loaded account has mostly the same few hundred keys, so
+		 * each key is kept once and counted. An attribute's key points
+		 * into its entry, the entry is found again from it by offset.
+		 */
+		typedef struct attr_key {
+			unsigned int refs;
+			unsigned int hash;
+			char         str[1];
+		} t_attr_key;
+
+		static t_attr_key ** attr_keys = NULL;	/* open addressed, linear probing */
+		static unsigned int attr_keys_size = 0;	/* power of two */
+		static unsigned int attr_keys_count = 0;
+		static unsigned long attr_keys_refs = 0;
+		static unsigned long attr_keys_bytes = 0;
+
+
+		static unsigned int attr_key_hash(char const * key)
+		{
+			unsigned int hash = 2166136261U;
+
+			for (; *key; key++)
+				hash = (hash ^ (unsigned char)*key) * 16777619U;
+			return hash;
+		}
+
+
+		static void attr_key_grow(void)
+		{
+			t_attr_key ** old = attr_keys;
+			unsigned int oldsize = attr_keys_size;
+			unsigned int i, pos;
+
+			attr_keys_size = oldsize ? oldsize * 2 : 1024;
+			attr_keys = (t_attr_key **)xmalloc(attr_keys_size * sizeof(*attr_keys));
+			std::memset(attr_keys, 0, attr_keys_size * sizeof(*attr_keys));
+			memlimit_add((attr_keys_size - oldsize) * sizeof(*attr_keys));
+			attr_keys_bytes += (attr_keys_size - oldsize) * sizeof(*attr_keys);
+
+			for (i = 0; i < oldsize; i++) {
+				if (!old[i])
+					continue;
+				for (pos = old[i]->hash & (attr_keys_size - 1); attr_keys[pos]; pos = (pos + 1) & (attr_keys_size - 1));
+				attr_keys[pos] = old[i];
+			}
+			if (old)
+				xfree(old);
+		}
+
+
+		extern const char * attr_key_intern(const char *key)
+		{
+			unsigned int hash = attr_key_hash(key);
+			unsigned int pos;
+			std::size_t len;
+			t_attr_key * entry;
+
+			/* keep it at most half full */
+			if ((attr_keys_count + 1) * 2 > attr_keys_size)
+				attr_key_grow();
+
+			for (pos = hash & (attr_keys_size - 1); (entry = attr_keys[pos]); pos = (pos + 1) & (attr_keys_size - 1))
+				if (entry->hash == hash && !std::strcmp(entry->str, key)) {
+					entry->refs++;
+					attr_keys_refs++;
+					return entry->str;
+				}
+
+			len = std::strlen(key);
+			entry = (t_attr_key *)xmalloc(offsetof(t_attr_key, str) + len + 1);
+			entry->refs = 1;
+			entry->hash = hash;
+			std::memcpy(entry->str, key, len + 1);
+			attr_keys[pos] = entry;
+			attr_keys_count++;
+			attr_keys_refs++;
+			attr_keys_bytes += offsetof(t_attr_key, str) + len + 1;
+			memlimit_add(offsetof(t_attr_key, str) + len + 1);
+
+			return entry->str;
+		}
+
+
+		extern void attr_key_release(const char *key)
+		{
+			t_attr_key * entry = (t_attr_key *)(key - offsetof(t_attr_key, str));
+			unsigned int mask = attr_keys_size - 1;
+			unsigned int pos, next, home;
+
+			attr_keys_refs--;
+			if (--entry->refs)
+				return;
+
+			for (pos = entry->hash & mask; attr_keys[pos] != entry; pos = (pos + 1) & mask);
+			attr_keys[pos] = NULL;
+
+			/* move the entries after it back so probing still finds them */
+			for (next = (pos + 1) & mask; attr_keys[next]; next = (next + 1) & mask) {
+				home = attr_keys[next]->hash & mask;
+				if (((next - home) & mask) >= ((next - pos) & mask)) {
+					attr_keys[pos] = attr_keys[next];
+					attr_keys[next] = NULL;
+					pos = next;
+				}
+			}
+
+			attr_keys_count--;
+			attr_keys_bytes -= offsetof(t_attr_key, str) + std::strlen(entry->str) + 1;
+			memlimit_sub(offsetof(t_attr_key, str) + std::strlen(entry->str) + 1);
+			xfree(entry);
+		}
+
+
+		extern void attr_key_get_stats(t_attr_key_stats *stats)
+		{
+			stats->keys = attr_keys_count;
+			stats->refs = attr_keys_refs;
+			stats->bytes = attr_keys_bytes;
+		}
+
+	}
+
+}
@@ -19,22 +19,71 @@
 #ifndef __ATTR_INCLUDED__
 #define __ATTR_INCLUDED__
 
+#include <cstring>
+
 #include "common/elist.h"
 #include "common/xalloc.h"
 
+/* the inline functions below account their memory, even for JUST_NEED_TYPES */
+#ifdef JUST_NEED_TYPES
+#undef JUST_NEED_TYPES
+#include "memlimit.h"
+#define JUST_NEED_TYPES
+#else
+#include "memlimit.h"
+#endif
+
 namespace pvpgn
 {
 
 	namespace bnetd
 	{
 
+		/* values this short live in the attribute itself, most of them do;
+		 * it keeps a t_attr at 40 bytes on 64 bit systems */
+#define ATTR_VAL_INLINE 15
+
 		typedef struct attr_struct {
-			const char 		*key;
-			const char 		*val;
-			int			dirty;
+			const char 		*key;	/* shared by all attributes with this key */
+			const char 		*val;	/* inl or a heap copy */
 			t_hlist		link;
+			char		dirty;
+			char		inl[ATTR_VAL_INLINE];
 		} t_attr;
 
+		typedef struct {
+			unsigned int keys;	/* distinct keys */
+			unsigned long refs;	/* attributes using them */
+			unsigned long bytes;	/* held by the key table */
+		} t_attr_key_stats;
+
+		extern const char * attr_key_intern(const char *key);
+		extern void attr_key_release(const char *key);
+		extern void attr_key_get_stats(t_attr_key_stats *stats);
+
+		static inline void attr_set_val(t_attr *attr, const char *val)
+		{
+			const char *heap = (attr->val && attr->val != attr->inl) ? attr->val : NULL;
+			std::size_t len;
+
+			/* val may point into the old value, copy it before that goes */
+			if (!val)
+				attr->val = NULL;
+			else if ((len = std::strlen(val)) < sizeof(attr->inl)) {
+				std::memmove(attr->inl, val, len + 1);
+				attr->val = attr->inl;
+			}
+			else {
+				attr->val = xstrdup(val);
+				memlimit_add(len + 1);
+			}
+
+			if (heap) {
+				memlimit_sub(std::strlen(heap) + 1);
+				xfree((void*)heap);
+			}
+		}
+
 		static inline t_attr *attr_create(const char *key, const char *val)
 		{
 			t_attr *attr;
@@ -42,16 +91,19 @@ namespace pvpgn
 			attr = (t_attr*)xmalloc(sizeof(t_attr));
 			attr->dirty = 0;
 			hlist_init(&attr->link);
-			attr->key = key ? xstrdup(key) : NULL;
-			attr->val = val ? xstrdup(val) : NULL;
+			attr->key = key ? attr_key_intern(key) : NULL;
+			attr->val = NULL;
+			attr_set_val(attr, val);
+			memlimit_add(sizeof(t_attr));
 
 			return attr;
 		}
 
 		static inline int attr_destroy(t_attr *attr)
 		{
-			if (attr->key) xfree((void*)attr->key);
-			if (attr->val) xfree((void*)attr->val);
+			attr_set_val(attr, NULL);
+			if (attr->key) attr_key_release(attr->key);
+			memlimit_sub(sizeof(t_attr));
 
 			xfree((void*)attr);
 
@@ -78,14 +130,6 @@ namespace pvpgn
 			return attr->val;
 		}
 
-		static inline void attr_set_val(t_attr *attr, const char *val)
-		{
-			if (attr->val) xfree((void*)attr->val);
-
-			if (val) attr->val = xstrdup(val);
-			else attr->val = NULL;
-		}
-
 		static inline void attr_set_dirty(t_attr *attr)
 		{
 			attr->dirty = 1;
@@ -36,6 +36,7 @@
 #include "prefs.h"
 #include "server.h"
 #include "connection.h"
+#include "slowlog.h"
 #include "common/setup_after.h"
 
 
@@ -46,6 +47,9 @@ namespace pvpgn
 	{
 		static const char * key_get_tab(const char *key);
 
+		static t_attrgroup_stats attrgroup_stats = { 0, 0 };
+		static unsigned long attrgroup_read_count;	/* attributes delivered by the current read */
+
 		static inline void attrgroup_set_accessed(t_attrgroup *attrgroup)
 		{
 			FLAG_SET(&attrgroup->flags, ATTRGROUP_FLAG_ACCESSED);
@@ -181,6 +185,17 @@ namespace pvpgn
 			}
 
 			attrgroup_unload(attrgroup);
+
+			/* the default account stays loaded through a flush, but not past here */
+			if (FLAG_ISSET(attrgroup->flags, ATTRGROUP_FLAG_LOADED)) {
+				t_hlist *curr, *save;
+
+				hlist_for_each_safe(curr, &attrgroup->list, save)
+					attr_destroy(hlist_entry(curr, t_attr, link));
+				hlist_init(&attrgroup->list);
+				attrgroup_clear_loaded(attrgroup);
+			}
+
 			if (attrgroup->storage) storage->free_info(attrgroup->storage);
 			xfree(attrgroup);
 
@@ -189,6 +204,9 @@ namespace pvpgn
 
 		extern int attrgroup_save(t_attrgroup *attrgroup, int flags)
 		{
+			t_slowlog_mark mark;
+			unsigned long usec;
+
 			if (!attrgroup) {
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL attrgroup");
 				return -1;
@@ -205,7 +223,10 @@ namespace pvpgn
 
 			assert(attrgroup->storage);
 
+			mark = slowlog_begin();
 			storage->write_attrs(attrgroup->storage, &attrgroup->list);
+			if ((usec = slowlog_elapsed(mark)))
+				slowlog_add(slowlog_storage, NULL, attrgroup_get_attr(attrgroup, "BNET\\acct\\username"), "write_attrs", usec);
 			attrgroup_clear_dirty(attrgroup);
 
 			return 1;
@@ -230,12 +251,10 @@ namespace pvpgn
 				return 0;
 
 			assert(attrgroup->storage);
-			unsigned int uid = *((unsigned int *)attrgroup->storage);
 			t_storage_info *defacct = storage->get_defacct();
-			unsigned int defuid = *((unsigned int *)defacct);
 
-			// do not flush default account
-			if (uid == defuid)
+			// do not flush default account (the file storage info is a path, not an uid)
+			if (!storage->cmp_info(attrgroup->storage, defacct))
 			{
 				storage->free_info(defacct);
 				return 2;
@@ -272,30 +291,37 @@ namespace pvpgn
 		{
 			t_attrgroup *attrgroup = (t_attrgroup *)data;
 
+			attrgroup_read_count++;
+			// set loaded attribute without a dirty flag
+			return attrgroup_set_attr(attrgroup, key, val, false);
+		}
+
 #ifdef WITH_SQL
-			if (strcmp(prefs_get_storage_path(), "sql") == 0)
-			{
-				const char *tab = key_get_tab(key);
+		static bool attrgroup_tab_loaded(t_attrgroup *attrgroup, const char *tab)
+		{
+			for (std::vector<const char *>::iterator it = attrgroup->loadedtabs->begin(); it != attrgroup->loadedtabs->end(); ++it)
+			if (strcmp(tab, *it) == 0)
+				return true;
 
-				bool is_found = false;
-				for (std::vector<const char *>::iterator it = attrgroup->loadedtabs->begin(); it != attrgroup->loadedtabs->end(); ++it)
-				{
-					if (strcmp(tab, *it) == 0)
-						is_found = true;
-				}
-				// add a tab if it's not found
-				if (!is_found)
-					attrgroup->loadedtabs->push_back(tab);
-				else
-					xfree((void*)tab);
+			return false;
+		}
+
+		static void attrgroup_tab_unload(t_attrgroup *attrgroup, const char *tab)
+		{
+			for (std::vector<const char *>::iterator it = attrgroup->loadedtabs->begin(); it != attrgroup->loadedtabs->end(); ++it)
+			if (strcmp(tab, *it) == 0)
+			{
+				xfree((void*)*it);
+				attrgroup->loadedtabs->erase(it);
+				return;
 			}
-#endif
-			// set loaded attribute without a dirty flag
-			return attrgroup_set_attr(attrgroup, key, val, false);
 		}
+#endif
 
 		extern int attrgroup_load(t_attrgroup *attrgroup, const char *tab)
 		{
+			t_slowlog_mark mark;
+
 			assert(attrgroup);
 			assert(attrgroup->storage);
 
@@ -304,9 +330,7 @@ namespace pvpgn
 #ifdef WITH_SQL
 				if (strcmp(prefs_get_storage_path(), "sql") == 0)
 				{
-					// find a tab
-					for (std::vector<const char *>::iterator it = attrgroup->loadedtabs->begin(); it != attrgroup->loadedtabs->end(); ++it)
-					if (strcmp(tab, *it) == 0)
+					if (attrgroup_tab_loaded(attrgroup, tab))
 						return 0;
 				}
 				else
@@ -322,10 +346,30 @@ namespace pvpgn
 			}
 
 			attrgroup_set_loaded(attrgroup);
+#ifdef WITH_SQL
+			/* remember the table before reading it, setting the loaded attributes
+			 * looks them up again; it is kept even when the account has no row
+			 * in it, or every lookup of one of its attributes would read it again */
+			if (strcmp(prefs_get_storage_path(), "sql") == 0)
+				attrgroup->loadedtabs->push_back(xstrdup(tab));
+#endif
+			attrgroup_read_count = 0;
+			attrgroup_stats.reads++;
+			mark = slowlog_begin();
 			if (storage->read_attrs(attrgroup->storage, _cb_load_attr, attrgroup, tab)) {
 				eventlog(eventlog_level_error, __FUNCTION__, "got error loading attributes");
+#ifdef WITH_SQL
+				/* read it again next time instead of taking it as empty */
+				if (strcmp(prefs_get_storage_path(), "sql") == 0)
+					attrgroup_tab_unload(attrgroup, tab);
+#endif
 				return -1;
 			}
+			/* the name is not looked up, it could be in a table not read yet */
+			slowlog_end(mark, slowlog_storage, NULL, "read_attrs");
+			/* the whole table came in one read instead of one per attribute */
+			if (attrgroup_read_count > 1)
+				attrgroup_stats.saved += attrgroup_read_count - 1;
 
 			return 0;
 		}
@@ -413,8 +457,10 @@ namespace pvpgn
 
 			const char * tab = key_get_tab(*pkey);
 			/* trigger loading of attributes if not loaded already */
-			if (attrgroup_load(attrgroup, tab))
+			if (attrgroup_load(attrgroup, tab)) {
+				xfree((void*)tab);
 				return NULL;	/* eventlog happens earlier */
+			}
 			xfree((void*)tab);
 
 			/* we are doing attribute lookup so we are accessing it */
@@ -437,7 +483,17 @@ namespace pvpgn
 			}
 
 			if (curr == &attrgroup->list) {	/* no key found in cached list */
+#ifdef WITH_SQL
+				/* the table is loaded, so the attribute is not set in it */
+				if (strcmp(prefs_get_storage_path(), "sql") == 0) {
+					attrgroup_stats.saved++;
+					return NULL;
+				}
+#endif
+				t_slowlog_mark mark = slowlog_begin();
+
 				attr = (t_attr*)storage->read_attr(attrgroup->storage, *pkey);
+				slowlog_end(mark, slowlog_storage, NULL, "read_attr");
 				if (attr) hlist_add(&attrgroup->list, &attr->link);
 			}
 
@@ -528,6 +584,11 @@ namespace pvpgn
 			return 0;
 		}
 
+		extern void attrgroup_get_stats(t_attrgroup_stats * stats)
+		{
+			*stats = attrgroup_stats;
+		}
+
 		// extract tab name from key
 		static const char * key_get_tab(const char *key)
 		{
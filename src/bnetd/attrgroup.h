@@ -63,6 +63,12 @@ namespace pvpgn
 
 		typedef int(*t_attr_cb)(t_attrgroup *, void *);
 
+		typedef struct
+		{
+			unsigned long reads;  /* tables read from storage */
+			unsigned long saved;  /* attribute lookups that needed no read of their own */
+		} t_attrgroup_stats;
+
 		extern t_attrgroup *attrgroup_create_storage(t_storage_info *storage);
 		extern t_attrgroup *attrgroup_create_newuser(const char *name);
 		extern t_attrgroup *attrgroup_create_nameuid(const char *name, unsigned uid);
@@ -74,6 +80,7 @@ namespace pvpgn
 		extern int attrgroup_set_attr(t_attrgroup *attrgroup, const char *key, const char *val, bool set_dirty = true);
 		extern int attrgroup_save(t_attrgroup *attrgroup, int flags);
 		extern int attrgroup_flush(t_attrgroup *attrgroup, int flags);
+		extern void attrgroup_get_stats(t_attrgroup_stats * stats);
 
 	}
 
@@ -25,6 +25,8 @@
 #include "attrgroup.h"
 #include "storage.h"
 #include "prefs.h"
+#include "server.h"
+#include "slowlog.h"
 #include "common/setup_after.h"
 
 namespace pvpgn
@@ -40,6 +42,7 @@ namespace pvpgn
 		std::vector<const char*> loadedtabs;
 
 		static int attrlayer_unload_default(void);
+		static int attrlayer_sync(int flags, int done);
 
 		extern int attrlayer_init(void)
 		{
@@ -120,11 +123,45 @@ namespace pvpgn
 			if (fcount > 0)
 				eventlog(eventlog_level_debug, __FUNCTION__, "flushed {} user accounts", fcount);
 
+			if (attrlayer_sync(flags, curr == &loadedlist) < 0)
+				return -1;
+
 			if (!FLAG_ISSET(flags, FS_ALL) && curr != &loadedlist) return 1;
 
 			return 0;
 		}
 
+		/*
+		 * The saves are renamed over the accounts when a walk over the
+		 * list is done, on FS_ALL, and at the latest usersync seconds after
+		 * the last time, as a busy dirty list may never be walked to its
+		 * end. Not after every user_step batch: a commit waits for the
+		 * whole filesystem. Saves that could not be made durable stay with
+		 * the storage and are tried again on the next call.
+		 */
+		static int attrlayer_sync(int flags, int done)
+		{
+			static std::time_t lastsync = 0;
+			static int failed = 0;
+			t_slowlog_mark mark;
+			int ret;
+
+			if (!FLAG_ISSET(flags, FS_ALL) && !done && !failed && now - lastsync < (std::time_t)prefs_get_user_sync_timer())
+				return 0;
+			lastsync = now;
+
+			mark = slowlog_begin();
+			ret = storage->sync();
+			slowlog_end(mark, slowlog_storage, NULL, "sync");
+
+			if (ret < 0 && !failed)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not make the saved accounts durable, trying again");
+			else if (ret >= 0 && failed)
+				eventlog(eventlog_level_info, __FUNCTION__, "saved accounts durable again");
+			failed = ret < 0;
+			return ret;
+		}
+
 		extern int attrlayer_save(int flags)
 		{
 			static t_elist *curr = &dirtylist;
@@ -164,6 +201,9 @@ namespace pvpgn
 			if (scount > 0)
 				eventlog(eventlog_level_debug, __FUNCTION__, "saved {} user accounts", scount);
 
+			if (attrlayer_sync(flags, curr == &dirtylist) < 0)
+				return -1;
+
 			if (!FLAG_ISSET(flags, FS_ALL) && curr != &dirtylist) return 1;
 
 			return 0;
@@ -24,6 +24,8 @@
 #include <cstring>
 #include <cerrno>
 #include <cstdlib>
+#include <climits>
+#include <vector>
 
 #include "compat/strdup.h"
 #include "compat/strcasecmp.h"
@@ -39,8 +41,12 @@
 #include "account.h"
 #include "account_wrap.h"
 #include "prefs.h"
+#include "quota.h"
+#include "memlimit.h"
+#include "server.h"
 #include "irc.h"
 #include "i18n.h"
+#include "cluster.h"
 #include "common/setup_after.h"
 
 #ifdef WITH_LUA
@@ -53,19 +59,34 @@ namespace pvpgn
 	namespace bnetd
 	{
 
-		static t_list * channellist_head = NULL;
+		/* the channels, linked through their list member */
+		static DECLARE_ELIST_INIT(channellist_head);
+		static unsigned int channellist_count = 0;
 
 		static t_channelmember * memberlist_curr = NULL;
 		static int totalcount = 0;
 
+		/* channels with queued presence events, see channellist_presence_flush() */
+		static DECLARE_ELIST_INIT(presence_channellist);
+		static unsigned long presence_sent = 0;  /* presence packets sent */
+		static unsigned long presence_saved = 0; /* presence packets the uncoalesced code would have sent on top */
+
 
 		static int channellist_load_permanent(char const * filename);
 		static t_channel * channellist_find_channel_by_fullname(char const * name);
 		static char * channel_format_name(char const * sname, char const * country, char const * realmname, unsigned int id);
+		static int channel_presence_coalesce(t_channel const * channel);
+		static int channel_is_clustered(t_channel const * channel);
+		static void channel_presence_queue(t_channel * channel, t_channelmember * member, unsigned int event, unsigned int recipients);
+		static void channel_presence_send(t_channel const * channel, t_channelmember * member, t_message_type type, char const * text, unsigned int after, unsigned int upto, int bnetonly);
+		static unsigned int channel_presence_queue_part(t_channel * channel, t_channelmember * member, t_message_type type, char const * text, unsigned int partseq);
+		static t_channelpart * channel_presence_take_part(t_channel * channel, t_connection * c);
+		static void channel_presence_send_part(t_channel const * channel, t_channelpart const * part);
+		static void channel_part_destroy(t_channelpart * part);
 
 		extern int channel_set_userflags(t_connection * c);
 
-		extern t_channel * channel_create(char const * fullname, char const * shortname, t_clienttag clienttag, int permflag, int botflag, int operflag, int logflag, char const * country, char const * realmname, int maxmembers, int moderated, int clanflag, int autoname, t_list * channellist)
+		extern t_channel * channel_create(char const * fullname, char const * shortname, t_clienttag clienttag, int permflag, int botflag, int operflag, int logflag, char const * country, char const * realmname, int maxmembers, int moderated, int clanflag, int autoname, t_elist * channellist)
 		{
 			t_channel * channel;
 
@@ -232,8 +253,20 @@ namespace pvpgn
 			channel->gameType = 0;
 			channel->gameExtension = NULL;
 
+			quota_init(&channel->quota);
+
+			channel->presence.seq = 0;
+			channel->presence.pending = 0;
+			channel->presence.parts = NULL;
+			channel->presence.since = 0;
+
+			elist_init(&channel->list);
+			elist_init(&channel->presence.list);
 			if (channellist)
-				list_append_data(channellist, channel);
+			{
+				elist_add_tail(channellist, &channel->list);
+				channellist_count++;
+			}
 			else
 				DEBUG0("channel was not added into any channellist");
 
@@ -243,10 +276,10 @@ namespace pvpgn
 
 		extern t_channel * channel_create(char const * fullname, char const * shortname, t_clienttag clienttag, int permflag, int botflag, int operflag, int logflag, char const * country, char const * realmname, int maxmembers, int moderated, int clanflag, int autoname)
 		{
-			return channel_create(fullname, shortname, clienttag, permflag, botflag, operflag, logflag, country, realmname, maxmembers, moderated, clanflag, autoname, channellist_head);
+			return channel_create(fullname, shortname, clienttag, permflag, botflag, operflag, logflag, country, realmname, maxmembers, moderated, clanflag, autoname, &channellist_head);
 		}
 
-		extern int channel_destroy(t_channel * channel, t_elem ** curr)
+		extern int channel_destroy(t_channel * channel)
 		{
 			t_elem * ban;
 
@@ -263,15 +296,26 @@ namespace pvpgn
 				return -1;
 			}
 
-			if (list_remove_data(channellist_head, channel, curr) < 0)
-			{
-				//        eventlog(eventlog_level_error,__FUNCTION__,"could not remove item from list");
+			if (elist_empty(&channel->list))
 				eventlog(eventlog_level_info, __FUNCTION__, "channel was not removed from any list");
-				//        return -1;
+			else
+			{
+				elist_del(&channel->list);
+				channellist_count--;
 			}
 
 			eventlog(eventlog_level_info, __FUNCTION__, "destroying channel \"{}\"", channel->name);
 
+			if (channel->presence.since)
+				elist_del(&channel->presence.list);
+			while (channel->presence.parts)
+			{
+				t_channelpart * part = channel->presence.parts;
+
+				channel->presence.parts = part->next;
+				channel_part_destroy(part);
+			}
+
 			if (channel->gameExtension)
 				xfree(channel->gameExtension);
 
@@ -430,7 +474,9 @@ namespace pvpgn
 		extern int channel_add_connection(t_channel * channel, t_connection * connection)
 		{
 			t_channelmember * member;
+			t_channelpart *   part;
 			t_connection *    user;
+			int               coalesce;
 
 			if (!channel)
 			{
@@ -452,8 +498,28 @@ namespace pvpgn
 			member = (t_channelmember*)xmalloc(sizeof(t_channelmember));
 			member->connection = connection;
 			member->next = channel->memberlist;
+			member->joinseq = ++channel->presence.seq;
+			member->flagseq = 0;
+			member->pending = 0;
+			member->rejoinseq = 0;
 			channel->memberlist = member;
 			channel->currmembers++;
+			if (channel->currmembers == 1 && channel_is_clustered(channel))
+				cluster_channel_join(channel->name);
+
+			/* in big channels the join notice for the others is sent on the next presence flush */
+			coalesce = channel_presence_coalesce(channel) && !conn_get_game(connection);
+			if ((part = channel_presence_take_part(channel, connection)))
+			{
+				/* the members told of neither still list this one, they only get the current flags */
+				if (coalesce)
+					member->rejoinseq = part->partseq;
+				else
+					channel_presence_send_part(channel, part);
+				channel_part_destroy(part);
+			}
+			if (coalesce)
+				channel_presence_queue(channel, member, channel_presence_join, channel->currmembers - 1);
 
 			channel_message_log(channel, connection, 0, "JOINED");
 
@@ -474,8 +540,11 @@ namespace pvpgn
 			{
 				message_send_text(connection, message_type_adduser, user, NULL);
 				/* In WOL gamechannels we send JOINGAME ack explicitely to self */
-				if (!conn_get_game(connection))
+				if (!conn_get_game(connection) && (!coalesce || user == connection))
+				{
 					message_send_text(user, message_type_join, connection, NULL);
+					presence_sent++;
+				}
 			}
 			else {
 				if (!conn_get_game(connection))
@@ -503,8 +572,8 @@ namespace pvpgn
 		extern int channel_del_connection(t_channel * channel, t_connection * connection, t_message_type type, char const * text)
 		{
 			t_channelmember * curr;
-			t_channelmember * temp;
-			t_elem * curr2;
+			t_channelmember * prev;
+			unsigned int      listed;
 
 			if (!channel)
 			{
@@ -517,33 +586,52 @@ namespace pvpgn
 				return -1;
 			}
 
-			channel_message_send(channel, type, connection, text);
-			channel_message_log(channel, connection, 0, "PARTED");
+			prev = NULL;
+			for (curr = channel->memberlist; curr && curr->connection != connection; curr = curr->next)
+				prev = curr;
 
-			curr = channel->memberlist;
-			if (curr->connection == connection)
+			if (!curr)
 			{
-				channel->memberlist = channel->memberlist->next;
-				xfree(curr);
+				channel_message_send(channel, type, connection, text);
+				channel_message_log(channel, connection, 0, "PARTED");
+				eventlog(eventlog_level_error, __FUNCTION__, "[{}] connection not in channel member list", conn_get_socket(connection));
+				return -1;
 			}
-			else
-			{
-				while (curr->next && curr->next->connection != connection)
-					curr = curr->next;
 
-				if (curr->next)
-				{
-					temp = curr->next;
-					curr->next = curr->next->next;
-					xfree(temp);
-				}
-				else
-				{
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] connection not in channel member list", conn_get_socket(connection));
-					return -1;
-				}
+			if (curr->pending & channel_presence_join)
+			{
+				/* the older members were never told about this one, so the join and the part
+				 * cancel out; only those who saw it in their own member list get the part, and
+				 * those still listing it from before a part the join cancelled get that back */
+				listed = 0;
+				if (curr->rejoinseq)
+					listed = channel_presence_queue_part(channel, curr, type, text, curr->rejoinseq);
+				presence_saved += channel->currmembers - 1 - listed;
+				channel_presence_send(channel, curr, type, text, curr->joinseq, UINT_MAX, 0);
+				if (conn_is_irc_variant(connection))
+					message_send_text(connection, type, connection, text);
+			}
+			else if (channel_presence_coalesce(channel) && !conn_get_game(connection))
+			{
+				/* sent on the next presence flush unless the member is back by then */
+				channel_presence_queue_part(channel, curr, type, text, channel->presence.seq);
+				if (conn_is_irc_variant(connection))
+					message_send_text(connection, type, connection, text);
 			}
+			else
+				channel_message_send(channel, type, connection, text);
+			channel_message_log(channel, connection, 0, "PARTED");
+
+			if (curr->pending)
+				channel->presence.pending--;
+			if (prev)
+				prev->next = curr->next;
+			else
+				channel->memberlist = curr->next;
+			xfree(curr);
 			channel->currmembers--;
+			if (channel->currmembers == 0 && channel_is_clustered(channel))
+				cluster_channel_part(channel->name);
 
 			if (conn_get_tmpOP_channel(connection) &&
 				std::strcmp(conn_get_tmpOP_channel(connection), channel_get_name(channel)) == 0)
@@ -557,13 +645,25 @@ namespace pvpgn
 
 			if (!channel->memberlist && !(channel->flags & channel_flags_permanent)) /* if channel is empty, delete it unless it's a permanent channel */
 			{
-				channel_destroy(channel, &curr2);
+				channel_destroy(channel);
 			}
 
 			return 0;
 		}
 
 
+		static t_channelmember * channel_find_member(t_channel const * channel, t_connection const * c)
+		{
+			t_channelmember * member;
+
+			for (member = channel->memberlist; member; member = member->next)
+				if (member->connection == c)
+					return member;
+
+			return NULL;
+		}
+
+
 		extern void channel_update_latency(t_connection * me)
 		{
 			t_channel *    channel;
@@ -581,12 +681,37 @@ namespace pvpgn
 				return;
 			}
 
+			if (channel_presence_coalesce(channel))
+			{
+				t_channelmember * member;
+
+				t_channelmember * dst;
+				unsigned int      recipients = 0;
+
+				member = NULL;
+				for (dst = channel->memberlist; dst; dst = dst->next)
+				{
+					if (dst->connection == me)
+						member = dst;
+					if (conn_get_class(dst->connection) == conn_class_bnet)
+						recipients++;
+				}
+				if (member)
+				{
+					channel_presence_queue(channel, member, channel_presence_latency, recipients);
+					return;
+				}
+			}
+
 			if (!(message = message_create(message_type_userflags, me, NULL))) /* handles NULL text */
 				return;
 
 			for (c = channel_get_first(channel); c; c = channel_get_next())
 			if (conn_get_class(c) == conn_class_bnet)
+			{
 				message_send(message, c);
+				presence_sent++;
+			}
 			message_destroy(message);
 		}
 
@@ -608,16 +733,287 @@ namespace pvpgn
 				return;
 			}
 
+			if (channel_presence_coalesce(channel))
+			{
+				t_channelmember * member;
+
+				if ((member = channel_find_member(channel, me)))
+				{
+					channel_presence_queue(channel, member, channel_presence_flags, channel->currmembers);
+					return;
+				}
+			}
+
 			if (!(message = message_create(message_type_userflags, me, NULL))) /* handles NULL text */
 				return;
 
 			for (c = channel_get_first(channel); c; c = channel_get_next())
+			{
 				message_send(message, c);
+				presence_sent++;
+			}
 
 			message_destroy(message);
 		}
 
 
+		static int channel_presence_coalesce(t_channel const * channel)
+		{
+			unsigned int size;
+
+			if (!(size = prefs_get_presence_coalesce_size()))
+				return 0;
+			if (channel->flags & channel_flags_thevoid)
+				return 0;
+
+			return (unsigned int)channel->currmembers >= size;
+		}
+
+
+		static void channel_presence_queue(t_channel * channel, t_channelmember * member, unsigned int event, unsigned int recipients)
+		{
+			presence_saved += recipients;
+
+			/* a newer flag change replaces the queued one, the flush sends the current flags */
+			if (event != channel_presence_join)
+				member->flagseq = ++channel->presence.seq;
+
+			if (!member->pending)
+				channel->presence.pending++;
+			member->pending |= event;
+
+			if (!channel->presence.since)
+			{
+				elist_add_tail(&presence_channellist, &channel->presence.list);
+				channel->presence.since = now;
+			}
+		}
+
+
+		/*
+		 * Queue the part, kick or quit of "member" for the members that joined up
+		 * to presence sequence "partseq". The message is formatted for them now
+		 * as the connection may be gone by the flush. Returns the number of
+		 * recipients.
+		 */
+		static unsigned int channel_presence_queue_part(t_channel * channel, t_channelmember * member, t_message_type type, char const * text, unsigned int partseq)
+		{
+			t_channelpart *   part;
+			t_channelmember * dst;
+			char const *      name;
+			unsigned int      recipients;
+
+			if (!(name = conn_get_chatname(member->connection)))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "[{}] member has no chat name", conn_get_socket(member->connection));
+				return 0;
+			}
+
+			part = (t_channelpart*)xmalloc(sizeof(t_channelpart));
+			part->name = xstrdup(name);
+			conn_unget_chatname(member->connection, name);
+			part->charname = conn_get_charname(member->connection) ? xstrdup(conn_get_charname(member->connection)) : NULL;
+			part->text = text ? xstrdup(text) : NULL;
+			part->partseq = partseq;
+			if (!(part->message = message_create(type, member->connection, part->text)))
+			{
+				part->next = NULL;
+				channel_part_destroy(part);
+				return 0;
+			}
+
+			recipients = 0;
+			for (dst = channel->memberlist; dst; dst = dst->next)
+			{
+				if (dst == member || dst->joinseq > partseq)
+					continue;
+				message_prepare(part->message, dst->connection);
+				recipients++;
+			}
+			message_detach(part->message, part->name);
+
+			part->next = channel->presence.parts;
+			channel->presence.parts = part;
+			presence_saved += recipients;
+
+			if (!channel->presence.since)
+			{
+				elist_add_tail(&presence_channellist, &channel->presence.list);
+				channel->presence.since = now;
+			}
+
+			return recipients;
+		}
+
+
+		/* unlink and return the queued part of whoever "c" is in the channel, NULL if none */
+		static t_channelpart * channel_presence_take_part(t_channel * channel, t_connection * c)
+		{
+			t_channelpart * * link;
+			t_channelpart *   part;
+			char const *      name;
+			char const *      charname;
+
+			if (!channel->presence.parts || !(name = conn_get_chatname(c)))
+				return NULL;
+			charname = conn_get_charname(c);
+
+			for (link = &channel->presence.parts; (part = *link); link = &part->next)
+			{
+				if (std::strcmp(part->name, name) != 0)
+					continue;
+				if (part->charname ? !charname || std::strcmp(part->charname, charname) != 0 : charname != NULL)
+					continue;
+				*link = part->next;
+				break;
+			}
+			conn_unget_chatname(c, name);
+
+			return part;
+		}
+
+
+		static void channel_presence_send_part(t_channel const * channel, t_channelpart const * part)
+		{
+			t_channelmember * dst;
+
+			for (dst = channel->memberlist; dst; dst = dst->next)
+			{
+				if (dst->joinseq > part->partseq)
+					continue;
+				message_send(part->message, dst->connection);
+				presence_sent++;
+				if (presence_saved)
+					presence_saved--;
+			}
+		}
+
+
+		static void channel_part_destroy(t_channelpart * part)
+		{
+			if (part->message)
+				message_destroy(part->message);
+			xfree(part->name);
+			if (part->charname)
+				xfree(part->charname);
+			if (part->text)
+				xfree(part->text);
+			xfree(part);
+		}
+
+
+		/*
+		 * Send a presence message about "member" to the members that joined after
+		 * presence sequence "after" and up to "upto", i.e. those whose own member
+		 * list does not reflect it yet.
+		 */
+		static void channel_presence_send(t_channel const * channel, t_channelmember * member, t_message_type type, char const * text, unsigned int after, unsigned int upto, int bnetonly)
+		{
+			t_message *       message;
+			t_channelmember * dst;
+
+			if (!(message = message_create(type, member->connection, text)))
+				return;
+
+			for (dst = channel->memberlist; dst; dst = dst->next)
+			{
+				if (dst->joinseq <= after || dst->joinseq > upto)
+					continue;
+				if (dst == member && type != message_type_userflags)
+					continue;
+				if (bnetonly && conn_get_class(dst->connection) != conn_class_bnet)
+					continue;
+				message_send(message, dst->connection);
+				presence_sent++;
+				if (presence_saved)
+					presence_saved--;
+			}
+
+			message_destroy(message);
+		}
+
+
+		static void channel_presence_flush(t_channel * channel)
+		{
+			std::vector<t_channelmember *> queued;
+			std::vector<t_channelpart *> parts;
+			t_channelmember * member;
+			t_channelpart *   part;
+			unsigned int      after;
+
+			/* the parts first, oldest first, then the joins are not undone by them */
+			for (part = channel->presence.parts; part; part = part->next)
+				parts.push_back(part);
+			for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+			{
+				channel_presence_send_part(channel, *it);
+				channel_part_destroy(*it);
+			}
+			channel->presence.parts = NULL;
+
+			queued.reserve(channel->presence.pending);
+			for (member = channel->memberlist; member; member = member->next)
+			if (member->pending)
+				queued.push_back(member);
+
+			/* the member list is newest first, announce in join order */
+			for (auto it = queued.rbegin(); it != queued.rend(); ++it)
+			{
+				member = *it;
+				after = 0;
+				if (member->pending & channel_presence_join)
+				{
+					/* those from before a part the join cancelled still list this one */
+					if (member->rejoinseq)
+						channel_presence_send(channel, member, message_type_userflags, NULL, 0, member->rejoinseq, 0);
+					/* the join carries the current flags for everyone who was there before */
+					channel_presence_send(channel, member, message_type_join, NULL, member->rejoinseq, member->joinseq, 0);
+					after = member->joinseq;
+					member->rejoinseq = 0;
+				}
+				if (member->pending & channel_presence_flags)
+					channel_presence_send(channel, member, message_type_userflags, NULL, after, member->flagseq, 0);
+				else if (member->pending & channel_presence_latency)
+					channel_presence_send(channel, member, message_type_userflags, NULL, after, member->flagseq, 1);
+				member->pending = 0;
+			}
+
+			channel->presence.pending = 0;
+			channel->presence.since = 0;
+		}
+
+
+		/*
+		 * Called once per tick from the main loop. Sends the join, part and
+		 * flag notices queued by big channels once they are
+		 * presence_coalesce_window seconds old.
+		 */
+		extern void channellist_presence_flush(std::time_t now)
+		{
+			t_elist *   curr;
+			t_elist *   save;
+			t_channel * channel;
+
+			elist_for_each_safe(curr, &presence_channellist, save)
+			{
+				channel = elist_entry(curr, t_channel, presence.list);
+				if (now < channel->presence.since + (std::time_t)prefs_get_presence_coalesce_window())
+					continue;
+				channel_presence_flush(channel);
+				elist_del(&channel->presence.list);
+			}
+		}
+
+
+		extern void channellist_presence_get_stats(unsigned long * sent, unsigned long * saved)
+		{
+			if (sent)
+				*sent = presence_sent;
+			if (saved)
+				*saved = presence_saved;
+		}
+
+
 		extern void channel_message_log(t_channel const * channel, t_connection * me, int fromuser, char const * text)
 		{
 			if (!channel)
@@ -740,6 +1136,12 @@ namespace pvpgn
 				if ((type == message_type_talk || type == message_type_whisper || type == message_type_emote || type == message_type_broadcast) &&
 					conn_check_ignoring(c, tname) == 1)
 					continue; /* ignore squelched players */
+				if (c != me && (type == message_type_talk || type == message_type_emote) &&
+					memlimit_get_stage() >= memlimit_stage_shed && memlimit_is_backlogged(conn_get_membytes(c)))
+				{
+					memlimit_count_shed();
+					continue; /* chat is optional under memory pressure for who is behind anyway */
+				}
 
 				if (!channel->clienttag || channel->clienttag == conn_get_clienttag(c)) {
 					message_to_send = message1;
@@ -750,8 +1152,13 @@ namespace pvpgn
 
 				if (message_send(message_to_send, c) == 0 && c != me)
 					heard = 1;
+				if (type == message_type_part || type == message_type_quit || type == message_type_kick)
+					presence_sent++;
 			}
 
+			if (type == message_type_talk && channel_is_clustered(channel) && cluster_channel_talk(channel->name, tname, text) > 0)
+				heard = 1; /* can't tell, don't claim otherwise */
+
 			conn_unget_chatname(me, tname);
 
 			message_destroy(message1);
@@ -770,6 +1177,41 @@ namespace pvpgn
 #endif
 		}
 
+		/* chat of a member logged on to another cluster node */
+		extern void channel_message_relay(char const * name, char const * srcname, char const * text)
+		{
+			t_channel *    channel;
+			t_connection * c;
+			t_message *    message;
+
+			if (!(channel = channellist_find_channel_by_fullname(name)) || !channel_is_clustered(channel))
+				return;
+			if (!(message = message_create_remote(message_type_talk, srcname, text)))
+				return;
+
+			for (c = channel_get_first(channel); c; c = channel_get_next())
+			{
+				if (conn_check_ignoring(c, srcname) == 1)
+					continue;
+				if (memlimit_get_stage() >= memlimit_stage_shed && memlimit_is_backlogged(conn_get_membytes(c)))
+				{
+					memlimit_count_shed();
+					continue;
+				}
+				message_send(message, c);
+			}
+
+			message_destroy(message);
+		}
+
+
+		/* the channels on the channel list are shared by the cluster nodes, game channels and the void are not */
+		static int channel_is_clustered(t_channel const * channel)
+		{
+			return cluster_is_enabled() && !elist_empty(&channel->list) && !(channel->flags & channel_flags_thevoid);
+		}
+
+
 		extern int channel_ban_user(t_channel * channel, char const * user)
 		{
 			t_elem const * curr;
@@ -936,6 +1378,18 @@ namespace pvpgn
 		}
 
 
+		extern t_quota * channel_get_quota(t_channel * channel)
+		{
+			if (!channel)
+			{
+				eventlog(eventlog_level_warn, __FUNCTION__, "got NULL channel");
+				return NULL;
+			}
+
+			return &channel->quota;
+		}
+
+
 		static int channellist_load_permanent(char const * filename)
 		{
 			std::FILE *       fp;
@@ -1155,133 +1609,124 @@ namespace pvpgn
 		extern int channellist_reload(void)
 		{
 			t_elem * curr;
+			t_elist * pos;
+			t_elist * save;
 			t_channel * channel, *old_channel;
 			t_channelmember * memberlist, *member, *old_member;
 			t_list * channellist_old;
 
-			if (channellist_head)
-			{
-
-				channellist_old = list_create();
+			channellist_old = list_create();
 
-				/* First pass - get members */
-				LIST_TRAVERSE(channellist_head, curr)
+			/* First pass - get members */
+			elist_for_each_safe(pos, &channellist_head, save)
+			{
+				channel = elist_entry(pos, t_channel, list);
+				/* Trick to avoid automatic channel destruction */
+				channel->flags |= channel_flags_permanent;
+				if (channel->memberlist)
 				{
-					if (!(channel = (t_channel*)elem_get_data(curr)))
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "channel list contains NULL item");
-						continue;
-					}
-					/* Trick to avoid automatic channel destruction */
-					channel->flags |= channel_flags_permanent;
-					if (channel->memberlist)
-					{
-						/* we need only channel name and memberlist */
+					/* we need only channel name and memberlist */
 
-						old_channel = (t_channel *)xmalloc(sizeof(t_channel));
-						old_channel->shortname = xstrdup(channel->shortname);
-						old_channel->memberlist = NULL;
-						member = channel->memberlist;
-
-						/* First pass */
-						while (member)
-						{
-							old_member = (t_channelmember*)xmalloc(sizeof(t_channelmember));
-							old_member->connection = member->connection;
+					old_channel = (t_channel *)xmalloc(sizeof(t_channel));
+					old_channel->shortname = xstrdup(channel->shortname);
+					old_channel->memberlist = NULL;
+					member = channel->memberlist;
 
-							if (old_channel->memberlist)
-								old_member->next = old_channel->memberlist;
-							else
-								old_member->next = NULL;
-
-							old_channel->memberlist = old_member;
-							member = member->next;
-						}
+					/* First pass */
+					while (member)
+					{
+						old_member = (t_channelmember*)xmalloc(sizeof(t_channelmember));
+						old_member->connection = member->connection;
 
-						/* Second pass - remove connections from channel */
-						member = old_channel->memberlist;
-						while (member)
-						{
-							channel_del_connection(channel, member->connection, message_type_quit, NULL);
-							conn_set_channel_var(member->connection, NULL);
-							member = member->next;
-						}
+						if (old_channel->memberlist)
+							old_member->next = old_channel->memberlist;
+						else
+							old_member->next = NULL;
 
-						list_prepend_data(channellist_old, old_channel);
+						old_channel->memberlist = old_member;
+						member = member->next;
 					}
 
-					/* Channel is empty - Destroying it */
-					channel->flags &= ~channel_flags_permanent;
-					if (channel_destroy(channel, &curr) < 0)
-						eventlog(eventlog_level_error, __FUNCTION__, "could not destroy channel");
+					/* Second pass - remove connections from channel */
+					member = old_channel->memberlist;
+					while (member)
+					{
+						channel_del_connection(channel, member->connection, message_type_quit, NULL);
+						conn_set_channel_var(member->connection, NULL);
+						member = member->next;
+					}
 
+					list_prepend_data(channellist_old, old_channel);
 				}
 
-				/* Cleanup and reload */
+				/* Channel is empty - Destroying it */
+				channel->flags &= ~channel_flags_permanent;
+				if (channel_destroy(channel) < 0)
+					eventlog(eventlog_level_error, __FUNCTION__, "could not destroy channel");
+
+			}
 
-				if (list_destroy(channellist_head) < 0)
-					return -1;
+			/* Reload, the list is empty now */
 
-				channellist_head = NULL;
-				channellist_create();
+			channellist_load_permanent(prefs_get_channelfile());
 
-				/* Now put all users on their previous channel */
+			/* Now put all users on their previous channel */
 
-				LIST_TRAVERSE(channellist_old, curr)
+			LIST_TRAVERSE(channellist_old, curr)
+			{
+				if (!(channel = (t_channel*)elem_get_data(curr)))
 				{
-					if (!(channel = (t_channel*)elem_get_data(curr)))
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "old channel list contains NULL item");
-						continue;
-					}
+					eventlog(eventlog_level_error, __FUNCTION__, "old channel list contains NULL item");
+					continue;
+				}
 
-					memberlist = channel->memberlist;
-					while (memberlist)
-					{
-						member = memberlist;
-						memberlist = memberlist->next;
-						conn_set_channel(member->connection, channel->shortname);
-					}
+				memberlist = channel->memberlist;
+				while (memberlist)
+				{
+					member = memberlist;
+					memberlist = memberlist->next;
+					conn_set_channel(member->connection, channel->shortname);
 				}
+			}
 
 
-				/* Ross don't blame me for this but this way the code is cleaner */
+			/* Ross don't blame me for this but this way the code is cleaner */
 
-				LIST_TRAVERSE(channellist_old, curr)
+			LIST_TRAVERSE(channellist_old, curr)
+			{
+				if (!(channel = (t_channel*)elem_get_data(curr)))
 				{
-					if (!(channel = (t_channel*)elem_get_data(curr)))
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "old channel list contains NULL item");
-						continue;
-					}
-
-					memberlist = channel->memberlist;
-					while (memberlist)
-					{
-						member = memberlist;
-						memberlist = memberlist->next;
-						xfree((void*)member);
-					}
+					eventlog(eventlog_level_error, __FUNCTION__, "old channel list contains NULL item");
+					continue;
+				}
 
-					if (channel->shortname)
-						xfree((void*)channel->shortname);
+				memberlist = channel->memberlist;
+				while (memberlist)
+				{
+					member = memberlist;
+					memberlist = memberlist->next;
+					xfree((void*)member);
+				}
 
-					if (list_remove_data(channellist_old, channel, &curr) < 0)
-						eventlog(eventlog_level_error, __FUNCTION__, "could not remove item from list");
-					xfree((void*)channel);
+				if (channel->shortname)
+					xfree((void*)channel->shortname);
 
-				}
+				if (list_remove_data(channellist_old, channel, &curr) < 0)
+					eventlog(eventlog_level_error, __FUNCTION__, "could not remove item from list");
+				xfree((void*)channel);
 
-				if (list_destroy(channellist_old) < 0)
-					return -1;
 			}
+
+			if (list_destroy(channellist_old) < 0)
+				return -1;
 			return 0;
 
 		}
 
 		extern int channellist_create(void)
 		{
-			channellist_head = list_create();
+			elist_init(&channellist_head);
+			channellist_count = 0;
 
 			return channellist_load_permanent(prefs_get_channelfile());
 		}
@@ -1289,40 +1734,33 @@ namespace pvpgn
 
 		extern int channellist_destroy(void)
 		{
-			t_channel *    channel;
-			t_elem * curr;
+			t_elist * curr;
+			t_elist * save;
 
-			if (channellist_head)
-			{
-				LIST_TRAVERSE(channellist_head, curr)
-				{
-					if (!(channel = (t_channel*)elem_get_data(curr))) /* should not happen */
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "channel list contains NULL item");
-						continue;
-					}
+			elist_for_each_safe(curr, &channellist_head, save)
+				channel_destroy(elist_entry(curr, t_channel, list));
+			elist_init(&presence_channellist);
 
-					channel_destroy(channel, &curr);
-				}
+			return 0;
+		}
 
-				if (list_destroy(channellist_head) < 0)
-					return -1;
-				channellist_head = NULL;
-			}
 
-			return 0;
+		extern t_elist * channellist(void)
+		{
+			return &channellist_head;
 		}
 
 
-		extern t_list * channellist(void)
+		/* the channel of a channellist() position, for elist_for_each() */
+		extern t_channel * channellist_get_channel(t_elist const * pos)
 		{
-			return channellist_head;
+			return elist_entry(pos, t_channel, list);
 		}
 
 
 		extern int channellist_get_length(void)
 		{
-			return list_get_length(channellist_head);
+			return channellist_count;
 		}
 
 		extern int channel_get_max(t_channel const * channel)
@@ -1406,22 +1844,19 @@ namespace pvpgn
 		static t_channel * channellist_find_channel_by_fullname(char const * name)
 		{
 			t_channel *    channel;
-			t_elem const * curr;
+			t_elist *      curr;
 
-			if (channellist_head)
+			elist_for_each(curr, &channellist_head)
 			{
-				LIST_TRAVERSE(channellist_head, curr)
+				channel = elist_entry(curr, t_channel, list);
+				if (!channel->name)
 				{
-					channel = (t_channel*)elem_get_data(curr);
-					if (!channel->name)
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "found channel with NULL name");
-						continue;
-					}
-
-					if (strcasecmp(channel->name, name) == 0)
-						return channel;
+					eventlog(eventlog_level_error, __FUNCTION__, "found channel with NULL name");
+					continue;
 				}
+
+				if (strcasecmp(channel->name, name) == 0)
+					return channel;
 			}
 
 			return NULL;
@@ -1435,7 +1870,7 @@ namespace pvpgn
 		extern t_channel * channellist_find_channel_by_name(char const * name, char const * country, char const * realmname)
 		{
 			t_channel *    channel;
-			t_elem const * curr;
+			t_elist *      curr;
 			int            foundperm;
 			int            foundlang;
 			int            maxchannel; /* the number of "rollover" channels that exist */
@@ -1458,75 +1893,72 @@ namespace pvpgn
 			maxchannel = 0;
 			foundperm = 0;
 			foundlang = 0;
-			if (channellist_head)
+			elist_for_each(curr, &channellist_head)
 			{
-				LIST_TRAVERSE(channellist_head, curr)
+				channel = elist_entry(curr, t_channel, list);
+				if (!channel->name)
 				{
-					channel = (t_channel*)elem_get_data(curr);
-					if (!channel->name)
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "found channel with NULL name");
-						continue;
-					}
+					eventlog(eventlog_level_error, __FUNCTION__, "found channel with NULL name");
+					continue;
+				}
 
-					if (strcasecmp(channel->name, name) == 0)
-					{
-						// eventlog(eventlog_level_debug,__FUNCTION__,"found exact match for \"%s\"",name);
-						return channel;
-					}
+				if (strcasecmp(channel->name, name) == 0)
+				{
+					// eventlog(eventlog_level_debug,__FUNCTION__,"found exact match for \"%s\"",name);
+					return channel;
+				}
 
-					if (channel->shortname && strcasecmp(channel->shortname, name) == 0)
+				if (channel->shortname && strcasecmp(channel->shortname, name) == 0)
+				{
+					special_channel = channellist_find_channel_by_name(channel->name, country, realmname);
+					if (special_channel) channel = special_channel;
+
+					/* FIXME: what should we do if the client doesn't have a country?  For now, just take the first
+					 * channel that would otherwise match. */
+					if (((!channel->country && !foundlang) || !country ||
+						(channel->country && country && (std::strcmp(channel->country, country) == 0))) &&
+						(!channel->realmname || !realmname || !std::strcmp(channel->realmname, realmname)))
 					{
-						special_channel = channellist_find_channel_by_name(channel->name, country, realmname);
-						if (special_channel) channel = special_channel;
-
-						/* FIXME: what should we do if the client doesn't have a country?  For now, just take the first
-						 * channel that would otherwise match. */
-						if (((!channel->country && !foundlang) || !country ||
-							(channel->country && country && (std::strcmp(channel->country, country) == 0))) &&
-							(!channel->realmname || !realmname || !std::strcmp(channel->realmname, realmname)))
+						if (channel->maxmembers == -1 || channel->currmembers < channel->maxmembers)
 						{
-							if (channel->maxmembers == -1 || channel->currmembers < channel->maxmembers)
-							{
-								eventlog(eventlog_level_debug, __FUNCTION__, "found permanent channel \"{}\" for \"{}\"", channel->name, name);
-								return channel;
-							}
-
-							if (!foundlang && (channel->country)) //remember we had found a language specific channel but it was full
-							{
-								foundlang = 1;
-								if (!(channel->flags & channel_flags_autoname))
-									savespecialname = channel->name;
-								maxchannel = 0;
-							}
-
-							maxchannel++;
+							eventlog(eventlog_level_debug, __FUNCTION__, "found permanent channel \"{}\" for \"{}\"", channel->name, name);
+							return channel;
 						}
 
-						// eventlog(eventlog_level_debug,__FUNCTION__,"countries didn't match");
-
-						foundperm = 1;
+						if (!foundlang && (channel->country)) //remember we had found a language specific channel but it was full
+						{
+							foundlang = 1;
+							if (!(channel->flags & channel_flags_autoname))
+								savespecialname = channel->name;
+							maxchannel = 0;
+						}
 
-						/* save off some info in case we need to create a new copy */
-						saveshortname = channel->shortname;
-						savetag = channel->clienttag;
-						savebotflag = channel->flags & channel_flags_allowbots;
-						saveoperflag = channel->flags & channel_flags_allowopers;
-						if (channel->logname)
-							savelogflag = 1;
-						else
-							savelogflag = 0;
-						if (country)
-							savecountry = country;
-						else
-							savecountry = channel->country;
-						if (realmname)
-							saverealmname = realmname;
-						else
-							saverealmname = channel->realmname;
-						savemaxmembers = channel->maxmembers;
-						savemoderated = channel->flags & channel_flags_moderated;
+						maxchannel++;
 					}
+
+					// eventlog(eventlog_level_debug,__FUNCTION__,"countries didn't match");
+
+					foundperm = 1;
+
+					/* save off some info in case we need to create a new copy */
+					saveshortname = channel->shortname;
+					savetag = channel->clienttag;
+					savebotflag = channel->flags & channel_flags_allowbots;
+					saveoperflag = channel->flags & channel_flags_allowopers;
+					if (channel->logname)
+						savelogflag = 1;
+					else
+						savelogflag = 0;
+					if (country)
+						savecountry = country;
+					else
+						savecountry = channel->country;
+					if (realmname)
+						saverealmname = realmname;
+					else
+						saverealmname = channel->realmname;
+					savemaxmembers = channel->maxmembers;
+					savemoderated = channel->flags & channel_flags_moderated;
 				}
 			}
 
@@ -1565,21 +1997,18 @@ namespace pvpgn
 		extern t_channel * channellist_find_channel_bychannelid(unsigned int channelid)
 		{
 			t_channel *    channel;
-			t_elem const * curr;
+			t_elist *      curr;
 
-			if (channellist_head)
+			elist_for_each(curr, &channellist_head)
 			{
-				LIST_TRAVERSE(channellist_head, curr)
+				channel = elist_entry(curr, t_channel, list);
+				if (!channel->name)
 				{
-					channel = (t_channel*)elem_get_data(curr);
-					if (!channel->name)
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "found channel with NULL name");
-						continue;
-					}
-					if (channel->id == channelid)
-						return channel;
+					eventlog(eventlog_level_error, __FUNCTION__, "found channel with NULL name");
+					continue;
 				}
+				if (channel->id == channelid)
+					return channel;
 			}
 
 			return NULL;
@@ -36,16 +36,27 @@
 
 #ifdef JUST_NEED_TYPES
 # include "connection.h"
+# include "message.h"
 # include "common/list.h"
 #else
 # define JUST_NEED_TYPES
 # include "connection.h"
+# include "message.h"
 # include "common/list.h"
 # undef JUST_NEED_TYPES
 #endif
+# include "common/elist.h"
 
 #endif
 
+#ifdef JUST_NEED_TYPES
+# include "quota.h"
+#else
+# define JUST_NEED_TYPES
+# include "quota.h"
+# undef JUST_NEED_TYPES
+#endif
+
 namespace pvpgn
 {
 
@@ -58,7 +69,29 @@ namespace pvpgn
 			/* standalone mode */
 			t_connection *         connection;
 			struct channelmember * next;
+			unsigned int           joinseq;  /* channel presence sequence when this member joined */
+			unsigned int           flagseq;  /* channel presence sequence of the last queued flag change */
+			unsigned int           pending;  /* channel_presence_* events not yet broadcast */
+			unsigned int           rejoinseq; /* sequence of the queued part this join cancelled, 0 if none */
 		} t_channelmember;
+
+		/* a part, kick or quit not yet broadcast, its sender may be gone already */
+		typedef struct channelpart
+		{
+			t_message *            message;  /* detached from the sender, see message_detach() */
+			char *                 name;     /* chat name of the sender, the message's srcname */
+			char *                 charname; /* its D2 character, NULL if none */
+			char *                 text;
+			unsigned int           partseq;  /* members up to this sequence still list the sender */
+			struct channelpart *   next;
+		} t_channelpart;
+
+		typedef enum
+		{
+			channel_presence_join = 0x01,
+			channel_presence_flags = 0x02,
+			channel_presence_latency = 0x04
+		} t_channel_presence;
 #endif
 
 		typedef enum
@@ -93,6 +126,17 @@ namespace pvpgn
 			t_list *          banlist;    /* of char * */
 			char *            logname;    /* NULL if not logged */
 			std::FILE *       log;        /* NULL if not logging */
+			t_quota           quota;      /* aggregate flood meter for all members */
+			t_elist           list;       /* on channellist(), unlinked for WOL game channels */
+
+			struct
+			{
+				unsigned int  seq;        /* bumped on every join and queued flag change */
+				unsigned int  pending;    /* number of members with queued events */
+				t_channelpart * parts;    /* queued parts, newest first */
+				std::time_t   since;      /* when the oldest queued event was queued, 0 if none */
+				t_elist       list;       /* on the flush queue while since is set */
+			} presence;
 
 			/**
 			*  Westwood Online Extensions
@@ -115,10 +159,13 @@ namespace pvpgn
 #ifndef INCLUDED_CHANNEL_PROTOS
 #define INCLUDED_CHANNEL_PROTOS
 
+#include <ctime>
+
 #define JUST_NEED_TYPES
 #include "connection.h"
 #include "message.h"
 #include "common/list.h"
+#include "common/elist.h"
 #include "common/tag.h"
 #undef JUST_NEED_TYPES
 
@@ -133,11 +180,12 @@ namespace pvpgn
 	{
 
 		extern int channel_set_userflags(t_connection * c);
-		extern t_channel * channel_create(char const * fullname, char const * shortname, t_clienttag clienttag, int permflag, int botflag, int operflag, int logflag, char const * country, char const * realmname, int maxmembers, int moderated, int clanflag, int autoname, t_list * channellist);
+		extern t_channel * channel_create(char const * fullname, char const * shortname, t_clienttag clienttag, int permflag, int botflag, int operflag, int logflag, char const * country, char const * realmname, int maxmembers, int moderated, int clanflag, int autoname, t_elist * channellist);
 		extern t_channel * channel_create(char const * fullname, char const * shortname, t_clienttag clienttag, int permflag, int botflag, int operflag, int logflag, char const * country, char const * realmname, int maxmembers, int moderated, int clanflag, int autoname);
-		extern int channel_destroy(t_channel * channel, t_elem ** elem);
+		extern int channel_destroy(t_channel * channel);
 		extern char const * channel_get_name(t_channel const * channel);
 		extern char const * channel_get_shortname(t_channel const * channel);
+		extern t_quota * channel_get_quota(t_channel * channel);
 		extern t_clienttag channel_get_clienttag(t_channel const * channel);
 		extern unsigned channel_get_flags(t_channel const * channel);
 		extern int channel_set_flags(t_channel * channel, unsigned flags);
@@ -150,6 +198,7 @@ namespace pvpgn
 		extern void channel_update_userflags(t_connection * conn);
 		extern void channel_message_log(t_channel const * channel, t_connection * me, int fromuser, char const * text);
 		extern void channel_message_send(t_channel const * channel, t_message_type type, t_connection * conn, char const * text);
+		extern void channel_message_relay(char const * name, char const * srcname, char const * text);
 		extern int channel_ban_user(t_channel * channel, char const * user);
 		extern int channel_unban_user(t_channel * channel, char const * user);
 		extern int channel_check_banning(t_channel const * channel, t_connection const * user);
@@ -167,10 +216,13 @@ namespace pvpgn
 		extern int channellist_create(void);
 		extern int channellist_destroy(void);
 		extern int channellist_reload(void);
-		extern t_list * channellist(void);
+		extern t_elist * channellist(void);
+		extern t_channel * channellist_get_channel(t_elist const * pos);
 		extern t_channel * channellist_find_channel_by_name(char const * name, char const * locale, char const * realmname);
 		extern t_channel * channellist_find_channel_bychannelid(unsigned int channelid);
 		extern int channellist_get_length(void);
+		extern void channellist_presence_flush(std::time_t now);
+		extern void channellist_presence_get_stats(unsigned long * sent, unsigned long * saved);
 
 		/**
 		*  Westwood Online Extensions
@@ -48,6 +48,8 @@
 #include "anongame.h"
 #include "storage.h"
 #include "server.h"
+#include "cluster.h"
+#include "slowlog.h"
 
 #include "common/setup_after.h"
 
@@ -711,6 +713,8 @@ namespace pvpgn
 
 		extern int clan_save(t_clan * clan)
 		{
+			t_slowlog_mark mark;
+
 			if (clan->created <= 0)
 			{
 				if (now - clan->creation_time > 120)
@@ -721,7 +725,9 @@ namespace pvpgn
 				return 0;
 			}
 
+			mark = slowlog_begin();
 			storage->write_clan(clan);
+			slowlog_end(mark, slowlog_storage, NULL, "write_clan");
 
 			clan->modified = 0;
 
@@ -1100,7 +1106,15 @@ namespace pvpgn
 
 		extern const char *clanmember_get_online_status(t_clanmember * member, char *status)
 		{
-			return clanmember_get_online_status_by_connection(clanmember_get_conn(member), status);
+			t_connection * conn;
+
+			/* where a member on another cluster node is isn't known, only that it is online */
+			if (!(conn = clanmember_get_conn(member)) && cluster_find_node(account_get_name((t_account*)member->memberacc)))
+			{
+				(*status) = SERVER_CLAN_MEMBER_ONLINE;
+				return NULL;
+			}
+			return clanmember_get_online_status_by_connection(conn, status);
 		}
 
 		extern const char *clanmember_get_online_status_by_connection(t_connection * conn, char *status)
@@ -0,0 +1,1386 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "cluster.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "compat/psock.h"
+#include "compat/strerror.h"
+#include "common/eventlog.h"
+#include "common/list.h"
+#include "common/elist.h"
+#include "common/addr.h"
+#include "common/network.h"
+#include "common/fdwatch.h"
+#include "common/bn_type.h"
+#include "common/bnethash.h"
+#include "common/field_sizes.h"
+
+#include "prefs.h"
+#include "connection.h"
+#include "account.h"
+#include "account_wrap.h"
+#include "attrlayer.h"
+#include "message.h"
+#include "channel.h"
+#include "clan.h"
+#include "watch.h"
+#include "i18n.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/*
+		 * The nodes talk over TCP. Every node connects to each of its
+		 * cluster_peers and only sends on those outbound links, what it
+		 * receives comes in on the links the peers opened to it. A frame is
+		 * a bn_short size (including the header), a bn_short type and then
+		 * bn_int numbers and NUL terminated strings in the order given below.
+		 *
+		 * Only nodes knowing cluster_secret get a link up: the accepting node
+		 * sends a challenge, the connecting one answers with its hello and a
+		 * challenge of its own, and the accepting one answers that with its
+		 * hello. A proof is the hash of the secret, the nonce and the name
+		 * of the node proving, nothing else is taken before it checked out.
+		 */
+		typedef enum
+		{
+			cluster_frame_hello = 1,    /* node, nonce (empty in the answer), proof, uid stride, uid offset */
+			cluster_frame_online,       /* username; who is logged on when a link comes up */
+			cluster_frame_watch,        /* event, clienttag, username, gamename */
+			cluster_frame_whisper,      /* from, to, text */
+			cluster_frame_whisperreply, /* status, from, to, reason, text */
+			cluster_frame_sub,          /* channel; to the owner of a channel with local members */
+			cluster_frame_unsub,        /* channel */
+			cluster_frame_talk,         /* channel, origin node, from, text */
+			cluster_frame_challenge     /* nonce; first on an inbound link */
+		} t_cluster_frame_type;
+
+		typedef enum
+		{
+			cluster_whisper_delivered,
+			cluster_whisper_away,
+			cluster_whisper_dnd,
+			cluster_whisper_offline
+		} t_cluster_whisper_status;
+
+		typedef enum
+		{
+			cluster_link_idle,       /* outbound, waiting for the next attempt */
+			cluster_link_connecting,
+			cluster_link_hello,      /* waiting for the peer to prove who it is */
+			cluster_link_up,
+			cluster_link_closed,     /* inbound, reaped by cluster_check() */
+			cluster_link_disabled    /* outbound to ourself */
+		} t_cluster_link_state;
+
+		typedef struct
+		{
+			int                  sock;
+			int                  fidx;
+			int                  outbound;
+			int                  writing; /* fdwatch also watches for writability */
+			t_cluster_link_state state;
+			std::time_t          since;   /* of the last state change */
+			t_addr const *       peer;    /* outbound only */
+			char                 addr[32];
+			std::string          node;
+			std::string          nonce;   /* of our challenge */
+			std::string          inbuf;
+			std::string          outbuf;
+			unsigned long        sent;
+			unsigned long        received;
+		} t_cluster_link;
+
+		typedef struct
+		{
+			std::string name;
+			std::string owner; /* the node we are subscribed to */
+		} t_cluster_channel;
+
+		static const std::size_t cluster_frame_max = 4096;
+		/* a peer that lets this much pile up is considered dead */
+		static const std::size_t cluster_outbuf_max = 4 * 1024 * 1024;
+
+		static std::string cluster_node;
+		static int cluster_lsock = -1;
+		static int cluster_lidx = -1;
+		static t_addrlist * cluster_peer_addrs = NULL;
+		static std::vector<t_cluster_link *> cluster_links;
+		/* users logged on to other nodes by lowercase account name */
+		static std::map<std::string, std::string> cluster_presence;
+		/* lowercase names of accounts another node took over, our copy is reloaded */
+		static std::set<std::string> cluster_stale;
+		/* channels with local members by lowercase name */
+		static std::map<std::string, t_cluster_channel> cluster_channels;
+		/* for the channels this node owns, the other nodes with members */
+		static std::map<std::string, std::set<std::string> > cluster_subscribers;
+
+		static int cluster_handle_accept(void * data, t_fdwatch_type rw);
+		static int cluster_handle_link(void * data, t_fdwatch_type rw);
+		static void cluster_resubscribe(void);
+
+
+		static std::string cluster_lower(char const * str)
+		{
+			std::string lower(str);
+
+			for (std::string::iterator it = lower.begin(); it != lower.end(); ++it)
+				*it = std::tolower(static_cast<unsigned char>(*it));
+			return lower;
+		}
+
+
+		static char const * cluster_link_state_get_str(t_cluster_link_state state)
+		{
+			switch (state)
+			{
+			case cluster_link_idle:
+				return "down";
+			case cluster_link_connecting:
+				return "connecting";
+			case cluster_link_hello:
+				return "handshake";
+			case cluster_link_up:
+				return "up";
+			case cluster_link_closed:
+				return "closed";
+			case cluster_link_disabled:
+				return "disabled";
+			default:
+				return "unknown";
+			}
+		}
+
+
+		static void cluster_frame_begin(std::string & frame, t_cluster_frame_type type)
+		{
+			bn_short temp;
+
+			frame.assign(2 * sizeof(bn_short), '\0');
+			bn_short_set(&temp, static_cast<std::uint16_t>(type));
+			std::memcpy(&frame[sizeof(bn_short)], &temp, sizeof(temp));
+		}
+
+
+		static void cluster_frame_add_int(std::string & frame, unsigned int value)
+		{
+			bn_int temp;
+
+			bn_int_set(&temp, value);
+			frame.append(reinterpret_cast<char const *>(&temp), sizeof(temp));
+		}
+
+
+		static void cluster_frame_add_str(std::string & frame, char const * str)
+		{
+			if (str)
+				frame.append(str);
+			frame.push_back('\0');
+		}
+
+
+		typedef struct
+		{
+			std::string const * frame;
+			std::size_t         pos;
+		} t_cluster_reader;
+
+
+		static int cluster_read_int(t_cluster_reader * reader, unsigned int * value)
+		{
+			bn_int temp;
+
+			if (reader->pos + sizeof(temp) > reader->frame->size())
+				return -1;
+			std::memcpy(&temp, reader->frame->data() + reader->pos, sizeof(temp));
+			reader->pos += sizeof(temp);
+			*value = bn_int_get(temp);
+			return 0;
+		}
+
+
+		static char const * cluster_read_str(t_cluster_reader * reader)
+		{
+			char const * str;
+			std::size_t  end;
+
+			if ((end = reader->frame->find('\0', reader->pos)) == std::string::npos)
+				return NULL;
+			str = reader->frame->data() + reader->pos;
+			reader->pos = end + 1;
+			return str;
+		}
+
+
+		static std::string cluster_nonce(void)
+		{
+			static std::random_device random;
+			char nonce[33];
+
+			std::snprintf(nonce, sizeof(nonce), "%08x%08x%08x%08x", random(), random(), random(), random());
+			return nonce;
+		}
+
+
+		static std::string cluster_proof(std::string const & nonce, std::string const & node)
+		{
+			std::string data(prefs_get_cluster_secret());
+			t_hash      hash;
+
+			data.append(":").append(nonce).append(":").append(node);
+			sha1_hash(&hash, data.size(), data.data());
+			return hash_get_str(hash);
+		}
+
+
+		/* compares all of it, how long it takes tells nothing about the secret */
+		static int cluster_proof_ok(char const * proof, std::string const & nonce, std::string const & node)
+		{
+			std::string  expected(cluster_proof(nonce, node));
+			unsigned int diff;
+
+			if (std::strlen(proof) != expected.size())
+				return 0;
+			diff = 0;
+			for (std::string::size_type i = 0; i < expected.size(); i++)
+				diff |= static_cast<unsigned char>(proof[i]) ^ static_cast<unsigned char>(expected[i]);
+			return diff == 0;
+		}
+
+
+		static void cluster_link_drop_node(t_cluster_link const * link)
+		{
+			std::map<std::string, std::string>::iterator pit;
+			std::map<std::string, std::set<std::string> >::iterator sit;
+
+			/* a reconnect may have been accepted before the old link noticed */
+			for (std::vector<t_cluster_link *>::const_iterator it = cluster_links.begin(); it != cluster_links.end(); ++it)
+				if (*it != link && !(*it)->outbound && (*it)->state == cluster_link_up && (*it)->node == link->node)
+					return;
+
+			for (pit = cluster_presence.begin(); pit != cluster_presence.end();)
+			{
+				if (pit->second == link->node)
+					pit = cluster_presence.erase(pit);
+				else
+					++pit;
+			}
+			for (sit = cluster_subscribers.begin(); sit != cluster_subscribers.end();)
+			{
+				sit->second.erase(link->node);
+				if (sit->second.empty())
+					sit = cluster_subscribers.erase(sit);
+				else
+					++sit;
+			}
+		}
+
+
+		static void cluster_link_close(t_cluster_link * link, char const * reason)
+		{
+			int was_up;
+
+			if (link->sock < 0)
+				return;
+
+			if (link->node.empty())
+				eventlog(eventlog_level_info, __FUNCTION__, "closing cluster link {} ({})", link->addr, reason);
+			else
+				eventlog(eventlog_level_info, __FUNCTION__, "closing cluster link {} to node \"{}\" ({})", link->addr, link->node, reason);
+
+			if (link->fidx >= 0)
+				fdwatch_del_fd(link->fidx);
+			psock_close(link->sock);
+			link->sock = -1;
+			link->fidx = -1;
+			link->writing = 0;
+			link->inbuf.clear();
+			link->outbuf.clear();
+			link->since = std::time(NULL);
+
+			was_up = (link->state == cluster_link_up);
+			if (link->outbound)
+			{
+				if (link->state != cluster_link_disabled)
+					link->state = cluster_link_idle;
+				if (was_up)
+					cluster_resubscribe();
+			}
+			else
+			{
+				link->state = cluster_link_closed;
+				if (was_up)
+					cluster_link_drop_node(link);
+			}
+		}
+
+
+		static void cluster_link_flush(t_cluster_link * link)
+		{
+			int n;
+
+			while (!link->outbuf.empty())
+			{
+				if ((n = net_send(link->sock, link->outbuf.data(), link->outbuf.size())) < 0)
+				{
+					cluster_link_close(link, "write error");
+					return;
+				}
+				if (n == 0)
+					break;
+				link->outbuf.erase(0, n);
+			}
+
+			if (link->outbuf.empty() == !link->writing)
+				return;
+			link->writing = !link->outbuf.empty();
+			fdwatch_update_fd(link->fidx, link->writing ? fdwatch_type_read | fdwatch_type_write : fdwatch_type_read);
+		}
+
+
+		static int cluster_link_send(t_cluster_link * link, std::string & frame)
+		{
+			bn_short temp;
+
+			if (link->sock < 0)
+				return -1;
+			if (frame.size() > cluster_frame_max)
+			{
+				eventlog(eventlog_level_warn, __FUNCTION__, "frame for cluster node \"{}\" too long ({} bytes), dropped", link->node, frame.size());
+				return -1;
+			}
+			if (link->outbuf.size() + frame.size() > cluster_outbuf_max)
+			{
+				cluster_link_close(link, "send queue full");
+				return -1;
+			}
+
+			bn_short_set(&temp, static_cast<std::uint16_t>(frame.size()));
+			std::memcpy(&frame[0], &temp, sizeof(temp));
+			link->outbuf.append(frame);
+			link->sent++;
+
+			/* only the handshake may go out before the link is up */
+			if (link->state == cluster_link_up || link->state == cluster_link_hello)
+				cluster_link_flush(link);
+			return link->sock < 0 ? -1 : 0;
+		}
+
+
+		static t_cluster_link * cluster_find_link(std::string const & node)
+		{
+			for (std::vector<t_cluster_link *>::const_iterator it = cluster_links.begin(); it != cluster_links.end(); ++it)
+				if ((*it)->outbound && (*it)->state == cluster_link_up && (*it)->node == node)
+					return *it;
+			return NULL;
+		}
+
+
+		static int cluster_send_node(std::string const & node, std::string & frame)
+		{
+			t_cluster_link * link;
+
+			if (!(link = cluster_find_link(node)))
+				return -1;
+			return cluster_link_send(link, frame);
+		}
+
+
+		static unsigned int cluster_broadcast(std::string & frame)
+		{
+			unsigned int count = 0;
+
+			for (std::vector<t_cluster_link *>::const_iterator it = cluster_links.begin(); it != cluster_links.end(); ++it)
+				if ((*it)->outbound && (*it)->state == cluster_link_up && cluster_link_send(*it, frame) == 0)
+					count++;
+			return count;
+		}
+
+
+		/*
+		 * Rendezvous hashing: the owner of a channel is the node scoring
+		 * highest for its name among this one and the peers that are up, so
+		 * a node going away only moves the channels it owned.
+		 */
+		static unsigned int cluster_score(std::string const & node, std::string const & lname)
+		{
+			unsigned int hash = 2166136261U;
+			std::string::size_type i;
+
+			for (i = 0; i <= node.size(); i++)
+				hash = (hash ^ static_cast<unsigned char>(node.c_str()[i])) * 16777619U;
+			for (i = 0; i < lname.size(); i++)
+				hash = (hash ^ static_cast<unsigned char>(lname[i])) * 16777619U;
+			return hash;
+		}
+
+
+		static std::string const & cluster_channel_owner(std::string const & lname)
+		{
+			std::string const * owner = &cluster_node;
+			unsigned int        best = cluster_score(cluster_node, lname);
+			unsigned int        score;
+
+			for (std::vector<t_cluster_link *>::const_iterator it = cluster_links.begin(); it != cluster_links.end(); ++it)
+			{
+				if (!(*it)->outbound || (*it)->state != cluster_link_up)
+					continue;
+				score = cluster_score((*it)->node, lname);
+				if (score > best || (score == best && (*it)->node < *owner))
+				{
+					best = score;
+					owner = &(*it)->node;
+				}
+			}
+			return *owner;
+		}
+
+
+		static void cluster_channel_subscribe(t_cluster_channel & channel, std::string const & owner)
+		{
+			std::string frame;
+
+			if (channel.owner == owner)
+				return;
+
+			if (!channel.owner.empty() && channel.owner != cluster_node)
+			{
+				cluster_frame_begin(frame, cluster_frame_unsub);
+				cluster_frame_add_str(frame, channel.name.c_str());
+				cluster_send_node(channel.owner, frame);
+			}
+			if (owner != cluster_node)
+			{
+				cluster_frame_begin(frame, cluster_frame_sub);
+				cluster_frame_add_str(frame, channel.name.c_str());
+				cluster_send_node(owner, frame);
+			}
+			channel.owner = owner;
+		}
+
+
+		/* the set of nodes that are up changed, follow the channels that moved */
+		static void cluster_resubscribe(void)
+		{
+			for (std::map<std::string, t_cluster_channel>::iterator it = cluster_channels.begin(); it != cluster_channels.end(); ++it)
+				cluster_channel_subscribe(it->second, cluster_channel_owner(it->first));
+		}
+
+
+		static void cluster_link_snapshot(t_cluster_link * link)
+		{
+			t_elist *      curr;
+			t_connection * c;
+			std::string    frame;
+
+			elist_for_each(curr, connlist())
+			{
+				c = connlist_get_conn(curr);
+				if (!c || conn_get_state(c) != conn_state_loggedin || !conn_get_account(c))
+					continue;
+				cluster_frame_begin(frame, cluster_frame_online);
+				cluster_frame_add_str(frame, conn_get_username(c));
+				if (cluster_link_send(link, frame) < 0)
+					return;
+			}
+		}
+
+
+		static void cluster_remote_watch(std::string const & node, unsigned int event, t_clienttag clienttag, char const * username, char const * gamename)
+		{
+			t_account *     account;
+			t_connection *  c;
+			t_clanmember *  member;
+			std::string     lname;
+			std::map<std::string, std::string>::iterator it;
+
+			if (!(account = accountlist_find_account(username)))
+			{
+				eventlog(eventlog_level_warn, __FUNCTION__, "node \"{}\" reported unknown account \"{}\"", node, username);
+				return;
+			}
+			lname = cluster_lower(username);
+
+			switch (event)
+			{
+			case Watch::ET_login:
+				cluster_presence[lname] = node;
+				/* the other node changes the account from now on */
+				cluster_stale.insert(lname);
+				/* one login per account across the cluster, the newest wins */
+				if ((c = connlist_find_connection_by_account(account)) && conn_get_state(c) != conn_state_destroy)
+				{
+					eventlog(eventlog_level_info, __FUNCTION__, "[{}] forcing logout, \"{}\" logged on to node \"{}\"", conn_get_socket(c), username, node);
+					conn_set_state(c, conn_state_destroy);
+				}
+				break;
+			case Watch::ET_logout:
+				/* stale if the account has moved on to another node meanwhile */
+				if ((it = cluster_presence.find(lname)) == cluster_presence.end() || it->second != node)
+					return;
+				cluster_presence.erase(it);
+				break;
+			case Watch::ET_joingame:
+			case Watch::ET_leavegame:
+				break;
+			default:
+				eventlog(eventlog_level_error, __FUNCTION__, "got unknown event {} from node \"{}\"", event, node);
+				return;
+			}
+
+			if ((member = account_get_clanmember(account)) && clanmember_get_clan(member))
+				clanmember_on_change_status(member);
+			watchlist->dispatch_remote(account, gamename, clienttag, static_cast<Watch::EventType>(event));
+		}
+
+
+		static void cluster_remote_whisper(std::string const & node, char const * from, char const * to, char const * text)
+		{
+			t_connection *           dest_c;
+			t_message *              message;
+			t_cluster_whisper_status status;
+			char const *             reason = NULL;
+			char const *             username = to;
+			std::string              frame;
+
+			if (!(dest_c = connlist_find_connection_by_accountname(to)))
+				status = cluster_whisper_offline;
+			else if ((reason = conn_get_dndstr(dest_c)))
+				status = cluster_whisper_dnd;
+			else
+			{
+				status = (reason = conn_get_awaystr(dest_c)) ? cluster_whisper_away : cluster_whisper_delivered;
+
+				if ((message = message_create_remote(message_type_whisper, from, text)))
+				{
+					message_send(message, dest_c);
+					message_destroy(message);
+				}
+				if (std::strlen(from) < MAX_USERNAME_LEN)
+					conn_set_lastsender(dest_c, (std::string("*") + from).c_str());
+			}
+			if (dest_c)
+				username = conn_get_username(dest_c);
+
+			cluster_frame_begin(frame, cluster_frame_whisperreply);
+			cluster_frame_add_int(frame, status);
+			cluster_frame_add_str(frame, from);
+			cluster_frame_add_str(frame, username);
+			cluster_frame_add_str(frame, reason);
+			cluster_frame_add_str(frame, status <= cluster_whisper_away ? text : "");
+			cluster_send_node(node, frame);
+		}
+
+
+		/* tell the sender what do_whisper() would have told it */
+		static void cluster_whisper_reply(unsigned int status, char const * from, char const * to, char const * reason, char const * text)
+		{
+			t_connection * c;
+			t_message *    message;
+
+			if (!(c = connlist_find_connection_by_accountname(from)))
+				return;
+
+			switch (status)
+			{
+			case cluster_whisper_offline:
+				message_send_text(c, message_type_error, c, localize(c, "That user is not logged on."));
+				break;
+			case cluster_whisper_dnd:
+				message_send_text(c, message_type_info, c, localize(c, "{} is unavailable ({})", to, reason));
+				break;
+			case cluster_whisper_delivered:
+			case cluster_whisper_away:
+				if ((message = message_create_remote(message_type_whisperack, to, text)))
+				{
+					message_send(message, c);
+					message_destroy(message);
+				}
+				if (status == cluster_whisper_away)
+					message_send_text(c, message_type_info, c, localize(c, "{} is away ({})", to, reason));
+				break;
+			}
+		}
+
+
+		static void cluster_remote_talk(std::string & frame, char const * channelname, char const * origin, char const * from, char const * text)
+		{
+			std::string lname(cluster_lower(channelname));
+			std::map<std::string, std::set<std::string> >::iterator it;
+
+			channel_message_relay(channelname, from, text);
+
+			/* the owner passes it on, everybody else only delivers it */
+			if (cluster_channel_owner(lname) != cluster_node || (it = cluster_subscribers.find(lname)) == cluster_subscribers.end())
+				return;
+			for (std::set<std::string>::const_iterator sit = it->second.begin(); sit != it->second.end(); ++sit)
+				if (*sit != origin && *sit != cluster_node)
+					cluster_send_node(*sit, frame);
+		}
+
+
+		static int cluster_link_dispatch(t_cluster_link * link, std::string & frame)
+		{
+			t_cluster_reader reader;
+			unsigned int     type;
+			char const *     strs[4];
+			unsigned int     nums[2];
+			bn_short         temp;
+
+			std::memcpy(&temp, frame.data() + sizeof(bn_short), sizeof(temp));
+			type = bn_short_get(temp);
+			reader.frame = &frame;
+			reader.pos = 2 * sizeof(bn_short);
+
+			if (type == cluster_frame_challenge)
+			{
+				if (!link->outbound || link->state != cluster_link_hello || !link->nonce.empty() ||
+					!(strs[0] = cluster_read_str(&reader)) || strs[0][0] == '\0')
+					return -1;
+
+				std::string reply;
+				link->nonce = cluster_nonce();
+				cluster_frame_begin(reply, cluster_frame_hello);
+				cluster_frame_add_str(reply, cluster_node.c_str());
+				cluster_frame_add_str(reply, link->nonce.c_str());
+				cluster_frame_add_str(reply, cluster_proof(strs[0], cluster_node).c_str());
+				cluster_frame_add_int(reply, prefs_get_cluster_uid_stride());
+				cluster_frame_add_int(reply, prefs_get_cluster_uid_offset());
+				cluster_link_send(link, reply);
+				return 0;
+			}
+
+			if (type == cluster_frame_hello)
+			{
+				if (!(strs[0] = cluster_read_str(&reader)) || strs[0][0] == '\0' || !(strs[1] = cluster_read_str(&reader)) ||
+					!(strs[2] = cluster_read_str(&reader)) || cluster_read_int(&reader, &nums[0]) < 0 || cluster_read_int(&reader, &nums[1]) < 0 ||
+					link->state != cluster_link_hello || link->nonce.empty())
+					return -1;
+				if (!cluster_proof_ok(strs[2], link->nonce, strs[0]))
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "cluster link {} from \"{}\" does not know cluster_secret", link->addr, strs[0]);
+					return -1;
+				}
+				/* or both would hand out the same userids */
+				if (cluster_node != strs[0] && (nums[0] != prefs_get_cluster_uid_stride() || nums[1] == prefs_get_cluster_uid_offset()))
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "node \"{}\" at {} uses cluster_uid_stride {} and cluster_uid_offset {}, we use {} and {}",
+						strs[0], link->addr, nums[0], nums[1], prefs_get_cluster_uid_stride(), prefs_get_cluster_uid_offset());
+					return -1;
+				}
+
+				if (link->outbound)
+				{
+					if (cluster_node == strs[0])
+					{
+						eventlog(eventlog_level_error, __FUNCTION__, "cluster peer {} is this node, remove it from cluster_peers", link->addr);
+						link->state = cluster_link_disabled;
+						cluster_link_close(link, "loop");
+						return 0;
+					}
+					link->node = strs[0];
+					link->state = cluster_link_up;
+					link->since = std::time(NULL);
+					eventlog(eventlog_level_info, __FUNCTION__, "cluster link {} to node \"{}\" is up", link->addr, link->node);
+					cluster_link_snapshot(link);
+					cluster_resubscribe();
+				}
+				else
+				{
+					if (strs[1][0] == '\0')
+						return -1;
+
+					std::string reply;
+					cluster_frame_begin(reply, cluster_frame_hello);
+					cluster_frame_add_str(reply, cluster_node.c_str());
+					cluster_frame_add_str(reply, "");
+					cluster_frame_add_str(reply, cluster_proof(strs[1], cluster_node).c_str());
+					cluster_frame_add_int(reply, prefs_get_cluster_uid_stride());
+					cluster_frame_add_int(reply, prefs_get_cluster_uid_offset());
+
+					/* answered all the same, so a link to ourself disables itself */
+					if (cluster_node == strs[0])
+					{
+						eventlog(eventlog_level_error, __FUNCTION__, "node at {} uses our node name \"{}\"", link->addr, cluster_node);
+						cluster_link_send(link, reply);
+						return 0;
+					}
+					link->node = strs[0];
+					link->state = cluster_link_up;
+					link->since = std::time(NULL);
+					eventlog(eventlog_level_info, __FUNCTION__, "cluster node \"{}\" connected from {}", link->node, link->addr);
+					cluster_link_send(link, reply);
+				}
+				return 0;
+			}
+
+			/* the rest only flows from the node that opened the link */
+			if (link->outbound || link->state != cluster_link_up)
+				return -1;
+
+			switch (type)
+			{
+			case cluster_frame_online:
+				if (!(strs[0] = cluster_read_str(&reader)))
+					return -1;
+				cluster_presence[cluster_lower(strs[0])] = link->node;
+				break;
+			case cluster_frame_watch:
+				if (cluster_read_int(&reader, &nums[0]) < 0 || cluster_read_int(&reader, &nums[1]) < 0 ||
+					!(strs[0] = cluster_read_str(&reader)) || !(strs[1] = cluster_read_str(&reader)))
+					return -1;
+				cluster_remote_watch(link->node, nums[0], nums[1], strs[0], strs[1][0] ? strs[1] : NULL);
+				break;
+			case cluster_frame_whisper:
+				if (!(strs[0] = cluster_read_str(&reader)) || !(strs[1] = cluster_read_str(&reader)) || !(strs[2] = cluster_read_str(&reader)))
+					return -1;
+				cluster_remote_whisper(link->node, strs[0], strs[1], strs[2]);
+				break;
+			case cluster_frame_whisperreply:
+				if (cluster_read_int(&reader, &nums[0]) < 0 || !(strs[0] = cluster_read_str(&reader)) || !(strs[1] = cluster_read_str(&reader)) ||
+					!(strs[2] = cluster_read_str(&reader)) || !(strs[3] = cluster_read_str(&reader)))
+					return -1;
+				cluster_whisper_reply(nums[0], strs[0], strs[1], strs[2], strs[3]);
+				break;
+			case cluster_frame_sub:
+				if (!(strs[0] = cluster_read_str(&reader)))
+					return -1;
+				cluster_subscribers[cluster_lower(strs[0])].insert(link->node);
+				break;
+			case cluster_frame_unsub:
+				if (!(strs[0] = cluster_read_str(&reader)))
+					return -1;
+				{
+					std::map<std::string, std::set<std::string> >::iterator it;
+
+					if ((it = cluster_subscribers.find(cluster_lower(strs[0]))) != cluster_subscribers.end())
+					{
+						it->second.erase(link->node);
+						if (it->second.empty())
+							cluster_subscribers.erase(it);
+					}
+				}
+				break;
+			case cluster_frame_talk:
+				if (!(strs[0] = cluster_read_str(&reader)) || !(strs[1] = cluster_read_str(&reader)) ||
+					!(strs[2] = cluster_read_str(&reader)) || !(strs[3] = cluster_read_str(&reader)))
+					return -1;
+				cluster_remote_talk(frame, strs[0], strs[1], strs[2], strs[3]);
+				break;
+			default:
+				eventlog(eventlog_level_warn, __FUNCTION__, "got unknown frame type {} from node \"{}\"", type, link->node);
+				break;
+			}
+			return 0;
+		}
+
+
+		/* handles the whole frames in inbuf, what is left is less than one */
+		static int cluster_link_parse(t_cluster_link * link)
+		{
+			std::size_t pos, size;
+			bn_short    temp;
+
+			for (pos = 0; link->inbuf.size() - pos >= 2 * sizeof(bn_short); pos += size)
+			{
+				std::memcpy(&temp, link->inbuf.data() + pos, sizeof(temp));
+				size = bn_short_get(temp);
+				if (size < 2 * sizeof(bn_short) || size > cluster_frame_max)
+				{
+					cluster_link_close(link, "bad frame size");
+					return -1;
+				}
+				if (link->inbuf.size() - pos < size)
+					break;
+
+				std::string frame(link->inbuf, pos, size);
+				link->received++;
+				if (cluster_link_dispatch(link, frame) < 0)
+				{
+					cluster_link_close(link, "protocol error");
+					return -1;
+				}
+				if (link->sock < 0)
+					return -1;
+			}
+			link->inbuf.erase(0, pos);
+
+			return 0;
+		}
+
+
+		static int cluster_link_read(t_cluster_link * link)
+		{
+			char buf[4096];
+			int  n;
+
+			/* parsed after every read, inbuf never holds more than a frame and a read */
+			for (;;)
+			{
+				if ((n = net_recv(link->sock, buf, sizeof(buf))) < 0)
+				{
+					cluster_link_close(link, "connection closed");
+					return -2;
+				}
+				if (n == 0)
+					break;
+				link->inbuf.append(buf, n);
+				if (cluster_link_parse(link) < 0)
+					return -2;
+			}
+
+			return 0;
+		}
+
+
+		static int cluster_link_connected(t_cluster_link * link)
+		{
+			int               err;
+			psock_t_socklen   errlen;
+
+			err = 0;
+			errlen = sizeof(err);
+			if (psock_getsockopt(link->sock, PSOCK_SOL_SOCKET, PSOCK_SO_ERROR, &err, &errlen) < 0 || (errlen && err))
+			{
+				cluster_link_close(link, err ? pstrerror(err) : "connect failed");
+				return -1;
+			}
+
+			/* the peer starts with its challenge */
+			link->state = cluster_link_hello;
+			link->since = std::time(NULL);
+			link->nonce.clear();
+			link->writing = 0;
+			fdwatch_update_fd(link->fidx, fdwatch_type_read);
+			return 0;
+		}
+
+
+		static int cluster_handle_link(void * data, t_fdwatch_type rw)
+		{
+			t_cluster_link * link = static_cast<t_cluster_link *>(data);
+
+			switch (rw)
+			{
+			case fdwatch_type_read:
+				if (link->state == cluster_link_connecting)
+					return 0; /* the write side tells how the connect went */
+				return cluster_link_read(link);
+			case fdwatch_type_write:
+				if (link->state == cluster_link_connecting)
+					return cluster_link_connected(link);
+				cluster_link_flush(link);
+				return 0;
+			default:
+				return -1;
+			}
+		}
+
+
+		static void cluster_link_connect(t_cluster_link * link)
+		{
+			struct sockaddr_in saddr;
+
+			link->since = std::time(NULL);
+			if ((link->sock = psock_socket(PSOCK_PF_INET, PSOCK_SOCK_STREAM, PSOCK_IPPROTO_TCP)) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not create socket (psock_socket: {})", pstrerror(psock_errno()));
+				return;
+			}
+			if (psock_ctl(link->sock, PSOCK_NONBLOCK) < 0)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not set cluster socket to non-blocking mode (psock_ctl: {})", pstrerror(psock_errno()));
+
+			std::memset(&saddr, 0, sizeof(saddr));
+			saddr.sin_family = PSOCK_AF_INET;
+			saddr.sin_port = htons(addr_get_port(link->peer));
+			saddr.sin_addr.s_addr = htonl(addr_get_ip(link->peer));
+			if (psock_connect(link->sock, (struct sockaddr *)&saddr, (psock_t_socklen)sizeof(saddr)) < 0 &&
+				psock_errno() != PSOCK_EINPROGRESS && psock_errno() != PSOCK_EWOULDBLOCK)
+			{
+				eventlog(eventlog_level_debug, __FUNCTION__, "could not connect to cluster peer {} (psock_connect: {})", link->addr, pstrerror(psock_errno()));
+				psock_close(link->sock);
+				link->sock = -1;
+				return;
+			}
+
+			if ((link->fidx = fdwatch_add_fd(link->sock, fdwatch_type_read | fdwatch_type_write, cluster_handle_link, link)) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not add cluster socket {} to fdwatch pool (max sockets?)", link->sock);
+				psock_close(link->sock);
+				link->sock = -1;
+				return;
+			}
+			link->writing = 1;
+			link->state = cluster_link_connecting;
+		}
+
+
+		/* links are only taken from the hosts of cluster_peers */
+		static int cluster_peer_allowed(unsigned int ip)
+		{
+			t_elem const * curr;
+
+			if (!cluster_peer_addrs)
+				return 0;
+			LIST_TRAVERSE_CONST(cluster_peer_addrs, curr)
+			{
+				if (addr_get_ip((t_addr const *)elem_get_data(curr)) == ip)
+					return 1;
+			}
+			return 0;
+		}
+
+
+		static int cluster_handle_accept(void * data, t_fdwatch_type rw)
+		{
+			t_cluster_link *   link;
+			struct sockaddr_in caddr;
+			psock_t_socklen    caddr_len;
+			int                sock;
+			std::string        frame;
+
+			caddr_len = sizeof(caddr);
+			std::memset(&caddr, 0, sizeof(caddr));
+			if ((sock = psock_accept(cluster_lsock, (struct sockaddr *)&caddr, &caddr_len)) < 0)
+			{
+				eventlog(eventlog_level_debug, __FUNCTION__, "could not accept cluster connection (psock_accept: {})", pstrerror(psock_errno()));
+				return 0;
+			}
+			if (!cluster_peer_allowed(ntohl(caddr.sin_addr.s_addr)))
+			{
+				eventlog(eventlog_level_warn, __FUNCTION__, "refused cluster connection from {}, not in cluster_peers", addr_num_to_addr_str(ntohl(caddr.sin_addr.s_addr), ntohs(caddr.sin_port)));
+				psock_close(sock);
+				return 0;
+			}
+			if (psock_ctl(sock, PSOCK_NONBLOCK) < 0)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not set cluster socket to non-blocking mode (psock_ctl: {})", pstrerror(psock_errno()));
+
+			link = new t_cluster_link();
+			link->sock = sock;
+			link->outbound = 0;
+			link->writing = 0;
+			link->state = cluster_link_hello;
+			link->since = std::time(NULL);
+			link->peer = NULL;
+			link->sent = link->received = 0;
+			std::snprintf(link->addr, sizeof(link->addr), "%s", addr_num_to_addr_str(ntohl(caddr.sin_addr.s_addr), ntohs(caddr.sin_port)));
+			if ((link->fidx = fdwatch_add_fd(sock, fdwatch_type_read, cluster_handle_link, link)) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not add cluster socket {} to fdwatch pool (max sockets?)", sock);
+				psock_close(sock);
+				delete link;
+				return 0;
+			}
+			cluster_links.push_back(link);
+
+			link->nonce = cluster_nonce();
+			cluster_frame_begin(frame, cluster_frame_challenge);
+			cluster_frame_add_str(frame, link->nonce.c_str());
+			cluster_link_send(link, frame);
+
+			return 0;
+		}
+
+
+		static int cluster_listen(char const * laddr)
+		{
+			t_addrlist *   laddrs;
+			t_addr const * addr;
+			int            val = 1;
+			char           temp[32];
+
+			if (!(laddrs = addrlist_create(laddr, INADDR_ANY, BNETD_CLUSTER_PORT)) || addrlist_get_length(laddrs) < 1)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "bad cluster_addr \"{}\"", laddr);
+				if (laddrs)
+					addrlist_destroy(laddrs);
+				return -1;
+			}
+			addr = (t_addr const *)elem_get_data(list_get_first_const(laddrs));
+			if (!addr_get_addr_str(addr, temp, sizeof(temp)))
+				std::strcpy(temp, "x.x.x.x:x");
+
+			if ((cluster_lsock = psock_socket(PSOCK_PF_INET, PSOCK_SOCK_STREAM, PSOCK_IPPROTO_TCP)) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not create cluster listening socket (psock_socket: {})", pstrerror(psock_errno()));
+				addrlist_destroy(laddrs);
+				return -1;
+			}
+			if (psock_setsockopt(cluster_lsock, PSOCK_SOL_SOCKET, PSOCK_SO_REUSEADDR, &val, (psock_t_socklen)sizeof(int)) < 0)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not set option SO_REUSEADDR on cluster socket (psock_setsockopt: {})", pstrerror(psock_errno()));
+
+			{
+				struct sockaddr_in saddr;
+
+				std::memset(&saddr, 0, sizeof(saddr));
+				saddr.sin_family = PSOCK_AF_INET;
+				saddr.sin_port = htons(addr_get_port(addr));
+				saddr.sin_addr.s_addr = htonl(addr_get_ip(addr));
+				if (psock_bind(cluster_lsock, (struct sockaddr *)&saddr, (psock_t_socklen)sizeof(saddr)) < 0)
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "could not bind cluster socket to address {} TCP (psock_bind: {})", temp, pstrerror(psock_errno()));
+					goto err;
+				}
+			}
+			if (psock_listen(cluster_lsock, LISTEN_QUEUE) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not listen on cluster socket (psock_listen: {})", pstrerror(psock_errno()));
+				goto err;
+			}
+			if (psock_ctl(cluster_lsock, PSOCK_NONBLOCK) < 0)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not set cluster listen socket to non-blocking mode (psock_ctl: {})", pstrerror(psock_errno()));
+			if ((cluster_lidx = fdwatch_add_fd(cluster_lsock, fdwatch_type_read, cluster_handle_accept, NULL)) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not add cluster listening socket to fdwatch pool (max sockets?)");
+				goto err;
+			}
+
+			eventlog(eventlog_level_info, __FUNCTION__, "listening for cluster nodes on {} TCP", temp);
+			addrlist_destroy(laddrs);
+			return 0;
+
+		err:
+			psock_close(cluster_lsock);
+			cluster_lsock = -1;
+			addrlist_destroy(laddrs);
+			return -1;
+		}
+
+
+		extern int cluster_init(void)
+		{
+			t_elem const *   curr;
+			t_cluster_link * link;
+
+			if (!prefs_get_cluster_node() || prefs_get_cluster_node()[0] == '\0')
+				return 0;
+			if (prefs_get_cluster_secret()[0] == '\0')
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "cluster_node is set but cluster_secret is not");
+				return -1;
+			}
+			if (prefs_get_cluster_uid_offset() >= prefs_get_cluster_uid_stride())
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "cluster_uid_offset must be less than cluster_uid_stride");
+				return -1;
+			}
+
+			cluster_node = prefs_get_cluster_node();
+			if (cluster_listen(prefs_get_cluster_addr()) < 0)
+			{
+				cluster_node.clear();
+				return -1;
+			}
+
+			if (prefs_get_cluster_peers()[0] != '\0')
+			{
+				if (!(cluster_peer_addrs = addrlist_create(prefs_get_cluster_peers(), INADDR_LOOPBACK, BNETD_CLUSTER_PORT)))
+					eventlog(eventlog_level_error, __FUNCTION__, "could not create cluster peer list");
+				else
+				{
+					LIST_TRAVERSE_CONST(cluster_peer_addrs, curr)
+					{
+						link = new t_cluster_link();
+						link->sock = -1;
+						link->fidx = -1;
+						link->outbound = 1;
+						link->writing = 0;
+						link->state = cluster_link_idle;
+						link->since = 0;
+						link->peer = (t_addr const *)elem_get_data(curr);
+						link->sent = link->received = 0;
+						if (!addr_get_addr_str(link->peer, link->addr, sizeof(link->addr)))
+							std::strcpy(link->addr, "x.x.x.x:x");
+						cluster_links.push_back(link);
+					}
+				}
+			}
+
+			eventlog(eventlog_level_info, __FUNCTION__, "cluster node \"{}\" with {} peers", cluster_node, cluster_links.size());
+			cluster_check(std::time(NULL));
+			return 0;
+		}
+
+
+		extern void cluster_destroy(void)
+		{
+			for (std::vector<t_cluster_link *>::iterator it = cluster_links.begin(); it != cluster_links.end(); ++it)
+			{
+				(*it)->state = cluster_link_disabled; /* nothing to follow up on */
+				cluster_link_close(*it, "shutdown");
+				delete *it;
+			}
+			cluster_links.clear();
+			cluster_presence.clear();
+			cluster_stale.clear();
+			cluster_channels.clear();
+			cluster_subscribers.clear();
+			if (cluster_peer_addrs)
+			{
+				addrlist_destroy(cluster_peer_addrs);
+				cluster_peer_addrs = NULL;
+			}
+
+			if (cluster_lsock >= 0)
+			{
+				fdwatch_del_fd(cluster_lidx);
+				psock_close(cluster_lsock);
+				cluster_lsock = -1;
+				cluster_lidx = -1;
+			}
+			cluster_node.clear();
+		}
+
+
+		/*
+		 * The copy of an account another node took over is dropped once its
+		 * session here is gone, the next login here reads it from storage
+		 * again. One that came back meanwhile is left alone.
+		 */
+		static void cluster_flush_stale(void)
+		{
+			t_account *    account;
+			t_connection * c;
+
+			for (std::set<std::string>::iterator it = cluster_stale.begin(); it != cluster_stale.end();)
+			{
+				if ((account = accountlist_find_account(it->c_str())))
+				{
+					if ((c = connlist_find_connection_by_account(account)))
+					{
+						if (conn_get_state(c) == conn_state_destroy)
+						{
+							++it;
+							continue;
+						}
+					}
+					else if (account_flush(account, FS_FORCE) < 0)
+						eventlog(eventlog_level_error, __FUNCTION__, "could not flush account \"{}\"", *it);
+				}
+				it = cluster_stale.erase(it);
+			}
+		}
+
+
+		/* called once a second: (re)connect to the peers, reap dead links and drop stale accounts */
+		extern void cluster_check(std::time_t now)
+		{
+			t_cluster_link * link;
+
+			if (cluster_node.empty())
+				return;
+
+			for (std::vector<t_cluster_link *>::iterator it = cluster_links.begin(); it != cluster_links.end();)
+			{
+				link = *it;
+				if ((link->state == cluster_link_connecting || link->state == cluster_link_hello) && now >= link->since + (std::time_t)BNETD_CLUSTER_RETRY)
+					cluster_link_close(link, "timeout");
+				if (link->state == cluster_link_closed)
+				{
+					delete link;
+					it = cluster_links.erase(it);
+				}
+				else
+					++it;
+			}
+
+			for (std::vector<t_cluster_link *>::const_iterator it = cluster_links.begin(); it != cluster_links.end(); ++it)
+			{
+				link = *it;
+				if (link->outbound && link->state == cluster_link_idle && (!link->since || now >= link->since + (std::time_t)BNETD_CLUSTER_RETRY))
+					cluster_link_connect(link);
+			}
+
+			cluster_flush_stale();
+		}
+
+
+		extern int cluster_is_enabled(void)
+		{
+			return !cluster_node.empty();
+		}
+
+
+		extern char const * cluster_find_node(char const * username)
+		{
+			std::map<std::string, std::string>::const_iterator it;
+
+			if (cluster_node.empty() || !username)
+				return NULL;
+			if ((it = cluster_presence.find(cluster_lower(username))) == cluster_presence.end())
+				return NULL;
+			return it->second.c_str();
+		}
+
+
+		extern unsigned int cluster_get_remote_users(void)
+		{
+			return cluster_presence.size();
+		}
+
+
+		extern unsigned int cluster_get_peers(t_cluster_peer_info * info, unsigned int max)
+		{
+			unsigned int n = 0;
+
+			for (std::vector<t_cluster_link *>::const_iterator it = cluster_links.begin(); it != cluster_links.end() && n < max; ++it)
+			{
+				std::snprintf(info[n].addr, sizeof(info[n].addr), "%s", (*it)->addr);
+				info[n].node = (*it)->node.empty() ? NULL : (*it)->node.c_str();
+				info[n].state = (*it)->outbound ? cluster_link_state_get_str((*it)->state) : "inbound";
+				info[n].sent = (*it)->sent;
+				info[n].received = (*it)->received;
+				n++;
+			}
+			return n;
+		}
+
+
+		extern void cluster_watch(t_account * account, char const * gamename, t_clienttag clienttag, unsigned int event)
+		{
+			std::string frame;
+
+			if (cluster_node.empty() || !account)
+				return;
+
+			cluster_frame_begin(frame, cluster_frame_watch);
+			cluster_frame_add_int(frame, event);
+			cluster_frame_add_int(frame, clienttag);
+			cluster_frame_add_str(frame, account_get_name(account));
+			cluster_frame_add_str(frame, gamename);
+			cluster_broadcast(frame);
+		}
+
+
+		/*
+		 * Whisper to a user logged on to another node. The answer comes back
+		 * asynchronously and produces the same acks and notices as a local
+		 * whisper. Returns -1 if nobody by that name is in the cluster.
+		 */
+		extern int cluster_whisper(t_connection * src, char const * dest, char const * text)
+		{
+			char const * username;
+			char const * node;
+			std::string  frame;
+
+			if (cluster_node.empty() || !src || !dest || !text)
+				return -1;
+
+			/* a Diablo II "character*account" or "*account" */
+			if ((username = std::strchr(dest, '*')))
+				username++;
+			else
+				username = dest;
+			if (!(node = cluster_find_node(username)))
+				return -1;
+
+			cluster_frame_begin(frame, cluster_frame_whisper);
+			cluster_frame_add_str(frame, conn_get_username(src));
+			cluster_frame_add_str(frame, username);
+			cluster_frame_add_str(frame, text);
+			return cluster_send_node(node, frame);
+		}
+
+
+		extern void cluster_channel_join(char const * channelname)
+		{
+			std::string lname;
+
+			if (cluster_node.empty() || !channelname)
+				return;
+
+			lname = cluster_lower(channelname);
+			if (cluster_channels.find(lname) != cluster_channels.end())
+				return;
+
+			t_cluster_channel & channel = cluster_channels[lname];
+			channel.name = channelname;
+			cluster_channel_subscribe(channel, cluster_channel_owner(lname));
+		}
+
+
+		extern void cluster_channel_part(char const * channelname)
+		{
+			std::map<std::string, t_cluster_channel>::iterator it;
+			std::string frame;
+
+			if (cluster_node.empty() || !channelname)
+				return;
+			if ((it = cluster_channels.find(cluster_lower(channelname))) == cluster_channels.end())
+				return;
+
+			if (it->second.owner != cluster_node)
+			{
+				cluster_frame_begin(frame, cluster_frame_unsub);
+				cluster_frame_add_str(frame, it->second.name.c_str());
+				cluster_send_node(it->second.owner, frame);
+			}
+			cluster_channels.erase(it);
+		}
+
+
+		/*
+		 * Chat of a local member goes to the owner of the channel which hands
+		 * it to the other nodes with members. Returns the number of nodes it
+		 * was sent to.
+		 */
+		extern int cluster_channel_talk(char const * channelname, char const * srcname, char const * text)
+		{
+			std::map<std::string, std::set<std::string> >::const_iterator it;
+			std::string lname;
+			std::string frame;
+			int         count = 0;
+
+			if (cluster_node.empty() || !channelname || !srcname || !text)
+				return 0;
+
+			lname = cluster_lower(channelname);
+			std::string const & owner = cluster_channel_owner(lname);
+
+			cluster_frame_begin(frame, cluster_frame_talk);
+			cluster_frame_add_str(frame, channelname);
+			cluster_frame_add_str(frame, cluster_node.c_str());
+			cluster_frame_add_str(frame, srcname);
+			cluster_frame_add_str(frame, text);
+
+			if (owner != cluster_node)
+				return cluster_send_node(owner, frame) < 0 ? 0 : 1;
+
+			if ((it = cluster_subscribers.find(lname)) == cluster_subscribers.end())
+				return 0;
+			for (std::set<std::string>::const_iterator sit = it->second.begin(); sit != it->second.end(); ++sit)
+				if (cluster_send_node(*sit, frame) == 0)
+					count++;
+			return count;
+		}
+
+	}
+
+}
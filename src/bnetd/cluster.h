@@ -0,0 +1,87 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef INCLUDED_CLUSTER_TYPES
+#define INCLUDED_CLUSTER_TYPES
+
+#include <ctime>
+
+#ifdef JUST_NEED_TYPES
+# include "common/tag.h"
+# include "account.h"
+# include "connection.h"
+#else
+# define JUST_NEED_TYPES
+# include "common/tag.h"
+# include "account.h"
+# include "connection.h"
+# undef JUST_NEED_TYPES
+#endif
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* one configured peer as shown by /cluster */
+		typedef struct
+		{
+			char          addr[32];
+			char const *  node;     /* NULL until the peer said hello */
+			char const *  state;
+			unsigned long sent;     /* frames */
+			unsigned long received;
+		} t_cluster_peer_info;
+
+	}
+
+}
+
+#endif
+
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_CLUSTER_PROTOS
+#define INCLUDED_CLUSTER_PROTOS
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		extern int cluster_init(void);
+		extern void cluster_destroy(void);
+		extern void cluster_check(std::time_t now);
+		extern int cluster_is_enabled(void);
+
+		extern char const * cluster_find_node(char const * username);
+		extern unsigned int cluster_get_remote_users(void);
+		extern unsigned int cluster_get_peers(t_cluster_peer_info * info, unsigned int max);
+
+		extern void cluster_watch(t_account * account, char const * gamename, t_clienttag clienttag, unsigned int event);
+		extern int cluster_whisper(t_connection * src, char const * dest, char const * text);
+		extern void cluster_channel_join(char const * channelname);
+		extern void cluster_channel_part(char const * channelname);
+		extern int cluster_channel_talk(char const * channelname, char const * srcname, char const * text);
+
+	}
+
+}
+
+#endif
+#endif
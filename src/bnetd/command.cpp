@@ -82,6 +82,10 @@
 #include "icons.h"
 #include "userlog.h"
 #include "i18n.h"
+#include "flightrec.h"
+#include "memprof.h"
+#include "cluster.h"
+#include "slowlog.h"
 
 #include "attrlayer.h"
 
@@ -179,6 +183,9 @@ namespace pvpgn
 
 			if (!(dest_c = connlist_find_connection_by_name(dest, conn_get_realm(user_c))))
 			{
+				/* the node the user is logged on to answers with the acks */
+				if (cluster_whisper(user_c, dest, text) == 0)
+					return;
 				message_send_text(user_c, message_type_error, user_c, localize(user_c, "That user is not logged on."));
 				return;
 			}
@@ -230,6 +237,7 @@ namespace pvpgn
 				(!(dest_c = connlist_find_connection_by_name(dest, conn_get_realm(c)))))
 			{
 				t_account * dest_a;
+				char const * node;
 				t_bnettime btlogin;
 				std::time_t ulogin;
 				struct std::tm * tmlogin;
@@ -239,6 +247,13 @@ namespace pvpgn
 					return;
 				}
 
+				if ((node = cluster_find_node(account_get_name(dest_a))))
+				{
+					msgtemp = localize(c, "{} is logged on to node {}.", account_get_name(dest_a), node);
+					message_send_text(c, message_type_info, c, msgtemp);
+					return;
+				}
+
 				if (conn_get_class(c) == conn_class_bnet) {
 					btlogin = time_to_bnettime((std::time_t)account_get_ll_time(dest_a), 0);
 					btlogin = bnettime_add_tzbias(btlogin, conn_get_tzbias(c));
@@ -398,6 +413,12 @@ namespace pvpgn
 		static int _handle_rehash_command(t_connection * c, char const * text);
 		static int _handle_find_command(t_connection * c, char const *text);
 		static int _handle_save_command(t_connection * c, char const * text);
+		static int _handle_flightrec_command(t_connection * c, char const * text);
+		static int _handle_memprof_command(t_connection * c, char const * text);
+		static int _handle_loglevel_command(t_connection * c, char const * text);
+		static int _handle_cluster_command(t_connection * c, char const * text);
+		static int _handle_slowlog_command(t_connection * c, char const * text);
+		static int _handle_fairness_command(t_connection * c, char const * text);
 
 		static int _handle_shutdown_command(t_connection * c, char const * text);
 		static int _handle_ladderinfo_command(t_connection * c, char const * text);
@@ -505,6 +526,12 @@ namespace pvpgn
 			{ "/rehash", _handle_rehash_command },
 			{ "/find", _handle_find_command },
 			{ "/save", _handle_save_command },
+			{ "/flightrec", _handle_flightrec_command },
+			{ "/memprof", _handle_memprof_command },
+			{ "/loglevel", _handle_loglevel_command },
+			{ "/cluster", _handle_cluster_command },
+			{ "/slowlog", _handle_slowlog_command },
+			{ "/fairness", _handle_fairness_command },
 			{ "/shutdown", _handle_shutdown_command },
 			{ "/ladderinfo", _handle_ladderinfo_command },
 			{ "/timer", _handle_timer_command },
@@ -603,7 +630,10 @@ namespace pvpgn
 					}
 					if (p->command_handler != NULL)
 					{
+						t_slowlog_mark mark = slowlog_begin();
+
 						result = ((p->command_handler)(c, text));
+						slowlog_end(mark, slowlog_command, c, p->command_string);
 						// -1 = unsuccess, 0 = success
 						if (result == 0)
 						{
@@ -2701,7 +2731,7 @@ namespace pvpgn
 			t_realm * realm;
 			t_realm * trealm;
 			t_connection * tc;
-			t_elem const * curr;
+			t_elist      * curr;
 			t_message    * message;
 
 			if (!(realm = conn_get_realm(c))) {
@@ -2726,9 +2756,9 @@ namespace pvpgn
 			}
 			else
 			{
-				LIST_TRAVERSE_CONST(connlist(), curr)
+				elist_for_each(curr, connlist())
 				{
-					tc = (t_connection*)elem_get_data(curr);
+					tc = connlist_get_conn(curr);
 					if (!tc)
 						continue;
 					if ((trealm = conn_get_realm(tc)) && (trealm == realm))
@@ -3072,7 +3102,7 @@ namespace pvpgn
 
 		static int _handle_channels_command(t_connection * c, char const *text)
 		{
-			t_elem const *    curr;
+			t_elist *         curr;
 			t_channel const * channel;
 			t_clienttag       clienttag;
 			t_connection const * conn;
@@ -3112,9 +3142,9 @@ namespace pvpgn
 
 			msgtemp = localize(c, " -----------name----------- users ----admin/operator----");
 			message_send_text(c, message_type_info, c, msgtemp);
-			LIST_TRAVERSE_CONST(channellist(), curr)
+			elist_for_each(curr, channellist())
 			{
-				channel = (t_channel*)elem_get_data(curr);
+				channel = channellist_get_channel(curr);
 				if ((!(channel_get_flags(channel) & channel_flags_clan)) && (!clienttag || !prefs_get_hide_temp_channels() || channel_get_permanent(channel)) &&
 					(!clienttag || !channel_get_clienttag(channel) ||
 					channel_get_clienttag(channel) == clienttag) &&
@@ -3294,7 +3324,7 @@ namespace pvpgn
 
 		static int _handle_connections_command(t_connection *c, char const *text)
 		{
-			t_elem const * curr;
+			t_elist      * curr;
 			t_connection * conn;
 			char           name[19];
 			char const *   channel_name;
@@ -3331,9 +3361,9 @@ namespace pvpgn
 				return -1;
 			}
 
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				conn = (t_connection*)elem_get_data(curr);
+				conn = connlist_get_conn(curr);
 				std::snprintf(name, sizeof name, "%s", conn_get_account(conn) ? conn_get_username(conn) : "(none)");
 
 				if (conn_get_channel(conn) != NULL)
@@ -3552,15 +3582,15 @@ namespace pvpgn
 		static int _handle_admins_command(t_connection * c, char const *text)
 		{
 			unsigned int    i;
-			t_elem const *  curr;
+			t_elist      *  curr;
 			t_connection *  tc;
 			char const *    nick;
 
 			std::snprintf(msgtemp0, sizeof msgtemp0, "%s", localize(c, "Currently logged on Administrators:").c_str());
 			i = std::strlen(msgtemp0);
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				tc = (t_connection*)elem_get_data(curr);
+				tc = connlist_get_conn(curr);
 				if (!tc)
 					continue;
 				if (!conn_get_account(tc))
@@ -3943,6 +3973,301 @@ namespace pvpgn
 			return 0;
 		}
 
+		static int _handle_flightrec_command(t_connection * c, char const *text)
+		{
+			t_connection * user;
+			t_account *    account;
+
+			std::vector<std::string> args = split_command(text, 2);
+			std::string subcommand = args[1];
+			char const * username = args[2].c_str();
+
+			if (subcommand == "dump" || subcommand == "d")
+			{
+				if (username[0] == '\0')
+				{
+					if (flightrec_dump_all("requested by command") < 0)
+					{
+						message_send_text(c, message_type_error, c, localize(c, "The flight recorder is off or its file could not be written."));
+						return -1;
+					}
+					message_send_text(c, message_type_info, c, localize(c, "The recorded packets of all connections have been dumped."));
+					return 0;
+				}
+				if (!(user = connlist_find_connection_by_accountname(username)))
+				{
+					message_send_text(c, message_type_error, c, localize(c, "That user is not logged on."));
+					return -1;
+				}
+				if (flightrec_dump(user, "requested by command") < 0)
+				{
+					message_send_text(c, message_type_error, c, localize(c, "The flight recorder is off or its file could not be written."));
+					return -1;
+				}
+				message_send_text(c, message_type_info, c, localize(c, "The recorded packets of {} have been dumped.", username));
+				return 0;
+			}
+
+			if ((subcommand == "flag" || subcommand == "f" || subcommand == "unflag" || subcommand == "u") && username[0] != '\0')
+			{
+				int flag = (subcommand == "flag" || subcommand == "f");
+
+				if (!(account = accountlist_find_account(username)))
+				{
+					message_send_text(c, message_type_error, c, localize(c, "Invalid user."));
+					return -1;
+				}
+				account_set_flightrec(account, flag);
+				if (flag)
+					message_send_text(c, message_type_info, c, localize(c, "The packets of {} will be dumped when they log out.", account_get_name(account)));
+				else
+					message_send_text(c, message_type_info, c, localize(c, "The packets of {} will no longer be dumped when they log out.", account_get_name(account)));
+				return 0;
+			}
+
+			describe_command(c, args[0].c_str());
+			return -1;
+		}
+
+		static int _handle_memprof_command(t_connection * c, char const *text)
+		{
+			t_xalloc_site sites[50];
+			unsigned int  count = 10;
+			unsigned int  n, i;
+
+			std::vector<std::string> args = split_command(text, 2);
+			std::string subcommand = args[1];
+
+			if (subcommand == "start")
+			{
+				if (!xalloc_profile_running())
+					xalloc_profile_start();
+				message_send_text(c, message_type_info, c, localize(c, "The allocation profiler is running."));
+				return 0;
+			}
+
+			if (subcommand == "stop")
+			{
+				xalloc_profile_stop();
+				message_send_text(c, message_type_info, c, localize(c, "The allocation profiler is stopped."));
+				return 0;
+			}
+
+			if (subcommand == "reset")
+			{
+				xalloc_profile_reset();
+				message_send_text(c, message_type_info, c, localize(c, "The allocation counters have been reset."));
+				return 0;
+			}
+
+			if (subcommand == "dump")
+			{
+				if (memprof_dump("requested by command") < 0)
+				{
+					message_send_text(c, message_type_error, c, localize(c, "The allocation profiler is stopped or its file could not be written."));
+					return -1;
+				}
+				message_send_text(c, message_type_info, c, localize(c, "The allocation profile has been dumped."));
+				return 0;
+			}
+
+			if (!subcommand.empty() && subcommand != "top")
+			{
+				describe_command(c, args[0].c_str());
+				return -1;
+			}
+
+			if (!args[2].empty() && (str_to_uint(args[2].c_str(), &count) < 0 || count == 0))
+			{
+				describe_command(c, args[0].c_str());
+				return -1;
+			}
+			if (count > sizeof(sites) / sizeof(*sites))
+				count = sizeof(sites) / sizeof(*sites);
+
+			if (!xalloc_profile_running())
+			{
+				message_send_text(c, message_type_error, c, localize(c, "The allocation profiler is stopped."));
+				return -1;
+			}
+
+			n = xalloc_profile_get_top(sites, count);
+			message_send_text(c, message_type_info, c, localize(c, "{} allocation sites, the top {} by live bytes (live/peak/blocks/allocs):", xalloc_profile_get_length(), n));
+			for (i = 0; i < n; i++)
+			{
+				msgtemp = fmt::format("{}/{}/{}/{} {}:{} {}()", sites[i].live, sites[i].peak, sites[i].blocks, sites[i].allocs, sites[i].file, sites[i].line, sites[i].func);
+				message_send_text(c, message_type_info, c, msgtemp);
+			}
+			return 0;
+		}
+
+		static int _handle_loglevel_command(t_connection * c, char const *text)
+		{
+			unsigned int mask;
+
+			std::vector<std::string> args = split_command(text, 2);
+			std::string name = args[1];
+			std::string levels = args[2];
+
+			if (name.empty())
+			{
+				message_send_text(c, message_type_info, c, localize(c, "Logged levels: {}", eventlog_get_levels_str(currlevel)));
+				if (eventlog_modules)
+					message_send_text(c, message_type_info, c, localize(c, "Modules with levels of their own: {}", eventlog_get_module_levels_str()));
+				return 0;
+			}
+
+			if (levels.empty())
+			{
+				describe_command(c, args[0].c_str());
+				return -1;
+			}
+
+			if (name == "*")
+			{
+				if (eventlog_parse_levels(levels.c_str(), &mask) < 0)
+				{
+					message_send_text(c, message_type_error, c, localize(c, "Invalid log levels."));
+					return -1;
+				}
+#ifdef WIN32_GUI
+				mask |= currlevel & eventlog_level_gui;
+#endif
+				currlevel = mask;
+				eventlog(eventlog_level_info, __FUNCTION__, "[{}] logged levels set to {}", conn_get_socket(c), eventlog_get_levels_str(currlevel));
+				message_send_text(c, message_type_info, c, localize(c, "Logged levels: {}", eventlog_get_levels_str(currlevel)));
+				return 0;
+			}
+
+			if (eventlog_set_module_level(name.c_str(), levels.c_str()) < 0)
+			{
+				message_send_text(c, message_type_error, c, localize(c, "Invalid log levels."));
+				return -1;
+			}
+			eventlog(eventlog_level_info, __FUNCTION__, "[{}] levels of {} set to {}", conn_get_socket(c), name, levels);
+			if (strcasecmp(levels.c_str(), "default") == 0)
+				message_send_text(c, message_type_info, c, localize(c, "{} logs the default levels again.", name));
+			else
+				message_send_text(c, message_type_info, c, localize(c, "{} logs: {}", name, levels));
+			return 0;
+		}
+
+		static int _handle_cluster_command(t_connection * c, char const *text)
+		{
+			t_cluster_peer_info peers[32];
+			unsigned int        count, i;
+
+			if (!cluster_is_enabled())
+			{
+				message_send_text(c, message_type_info, c, localize(c, "This server is not part of a cluster."));
+				return 0;
+			}
+
+			msgtemp = localize(c, "Node {}, {} users logged on to other nodes", prefs_get_cluster_node(), cluster_get_remote_users());
+			message_send_text(c, message_type_info, c, msgtemp);
+
+			count = cluster_get_peers(peers, sizeof(peers) / sizeof(*peers));
+			for (i = 0; i < count; i++)
+			{
+				msgtemp = fmt::format("{:<21} {:<12} {:<10} sent {} received {}", peers[i].addr, peers[i].node ? peers[i].node : "-", peers[i].state, peers[i].sent, peers[i].received);
+				message_send_text(c, message_type_info, c, msgtemp);
+			}
+			return 0;
+		}
+
+		static int _handle_slowlog_command(t_connection * c, char const *text)
+		{
+			t_slowlog_entry entries[50];
+			unsigned int    count = 10;
+			unsigned int    n, i;
+			char            timestr[16];
+			struct std::tm * tmwhen;
+
+			std::vector<std::string> args = split_command(text, 1);
+
+			if (args[1] == "clear")
+			{
+				slowlog_clear();
+				message_send_text(c, message_type_info, c, localize(c, "The slow operation log has been cleared."));
+				return 0;
+			}
+
+			if (!args[1].empty() && (str_to_uint(args[1].c_str(), &count) < 0 || count == 0))
+			{
+				describe_command(c, args[0].c_str());
+				return -1;
+			}
+			if (count > sizeof(entries) / sizeof(*entries))
+				count = sizeof(entries) / sizeof(*entries);
+
+			if (!prefs_get_slowlog_threshold())
+				message_send_text(c, message_type_info, c, localize(c, "The slow operation tracer is off."));
+
+			n = slowlog_get(entries, count);
+			message_send_text(c, message_type_info, c, localize(c, "{} slow operations over {} ms, the last {}:", slowlog_get_count(), prefs_get_slowlog_threshold(), n));
+			for (i = 0; i < n; i++)
+			{
+				if (!(tmwhen = std::localtime(&entries[i].when)) || !std::strftime(timestr, sizeof(timestr), "%H:%M:%S", tmwhen))
+					std::strcpy(timestr, "?");
+				msgtemp = fmt::format("{} {} \"{}\" {:.1f} ms, loop {}, socket {}, account {}", timestr,
+					slowlog_subsys_get_str((t_slowlog_subsys)entries[i].subsys), entries[i].what, entries[i].usec / 1000.0,
+					entries[i].loopusec ? fmt::format("{:.1f} ms", entries[i].loopusec / 1000.0) : "-",
+					entries[i].socket, entries[i].account[0] ? entries[i].account : "-");
+				message_send_text(c, message_type_info, c, msgtemp);
+			}
+			return 0;
+		}
+
+		static int _handle_fairness_command(t_connection * c, char const *text)
+		{
+			t_connection *  tc;
+			t_elist *       curr;
+			unsigned int    count = 10;
+			unsigned int    paused = 0;
+			unsigned int    i;
+			unsigned long   budget_hits, pauses, resumes;
+			std::vector<t_connection *> conns;
+
+			std::vector<std::string> args = split_command(text, 1);
+
+			if (!args[1].empty() && (str_to_uint(args[1].c_str(), &count) < 0 || count == 0))
+			{
+				describe_command(c, args[0].c_str());
+				return -1;
+			}
+
+			elist_for_each(curr, connlist())
+			{
+				tc = connlist_get_conn(curr);
+				if (conn_get_read_paused(tc))
+					paused++;
+				if (conn_get_read_paused(tc) || conn_get_read_budget_hits(tc) || conn_get_read_pauses(tc))
+					conns.push_back(tc);
+			}
+
+			/* paused ones first, then the busiest */
+			std::sort(conns.begin(), conns.end(), [](t_connection * a, t_connection * b) {
+				if (conn_get_read_paused(a) != conn_get_read_paused(b))
+					return conn_get_read_paused(a) > conn_get_read_paused(b);
+				return conn_get_read_budget_hits(a) + conn_get_read_pauses(a) > conn_get_read_budget_hits(b) + conn_get_read_pauses(b);
+			});
+
+			connlist_get_fairness(&budget_hits, &pauses, &resumes);
+			message_send_text(c, message_type_info, c, localize(c, "Read budget {} packets / {} bytes per iteration, used up {} times.", prefs_get_conn_read_packets(), prefs_get_conn_read_bytes(), budget_hits));
+			message_send_text(c, message_type_info, c, localize(c, "Reading paused at {} queued packets {} times, resumed {} times, {} connections paused now.", prefs_get_conn_read_pause(), pauses, resumes, paused));
+
+			for (i = 0; i < conns.size() && i < count; i++)
+			{
+				tc = conns[i];
+				msgtemp = fmt::format("socket {} {} {} budget used up {} paused {} queued {} KB{}", conn_get_socket(tc),
+					addr_num_to_ip_str(conn_get_addr(tc)), conn_get_loggeduser(tc) ? conn_get_loggeduser(tc) : "-",
+					conn_get_read_budget_hits(tc), conn_get_read_pauses(tc), conn_get_membytes(tc) / 1024,
+					conn_get_read_paused(tc) ? " (paused)" : "");
+				message_send_text(c, message_type_info, c, msgtemp);
+			}
+			return 0;
+		}
+
 		static int _handle_shutdown_command(t_connection * c, char const *text)
 		{
 			char const * dest;
@@ -4364,6 +4689,16 @@ namespace pvpgn
 			message_send_text(c, message_type_info, c, msgtemp);
 			msgtemp = localize(c, "You are not allowed to send lines with more than {} characters.", prefs_get_quota_maxline());
 			message_send_text(c, message_type_info, c, msgtemp);
+			if (prefs_get_quota_ip_lines())
+			{
+				msgtemp = localize(c, "All users from your address may write {} line(s) per {} second(s).", prefs_get_quota_ip_lines(), prefs_get_quota_time());
+				message_send_text(c, message_type_info, c, msgtemp);
+			}
+			if (prefs_get_quota_channel_lines())
+			{
+				msgtemp = localize(c, "Each channel accepts {} line(s) per {} second(s).", prefs_get_quota_channel_lines(), prefs_get_quota_time());
+				message_send_text(c, message_type_info, c, msgtemp);
+			}
 
 			return 0;
 		}
@@ -4624,10 +4959,10 @@ namespace pvpgn
 
 			message_send_text(c, message_type_info, c, localize(c, "Scanning online users for IP {}...", ip));
 
-			t_elem const * curr;
+			t_elist * curr;
 			int count = 0;
-			LIST_TRAVERSE_CONST(connlist(), curr) {
-				conn = (t_connection *)elem_get_data(curr);
+			elist_for_each(curr, connlist()) {
+				conn = connlist_get_conn(curr);
 				if (!conn) {
 					// got empty element
 					continue;
@@ -5217,11 +5552,11 @@ namespace pvpgn
 			msgtemp = localize(c, " for {}", prefs_get_servername());
 
 			t_connection * conn;
-			t_elem const * curr;
+			t_elist      * curr;
 			// send to online users
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				if (conn = (t_connection*)elem_get_data(curr))
+				if (conn = connlist_get_conn(curr))
 				{
 					clienttag_dest = conn_get_clienttag(conn);
 
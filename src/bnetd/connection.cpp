@@ -24,6 +24,8 @@
 #include <cerrno>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
+#include <vector>
 
 #ifdef WIN32_GUI
 #include <win32/winmain.h>
@@ -56,6 +58,9 @@
 #include "tick.h"
 #include "message.h"
 #include "prefs.h"
+#include "quota.h"
+#include "memlimit.h"
+#include "flightrec.h"
 #include "watch.h"
 #include "timer.h"
 #include "irc.h"
@@ -71,6 +76,8 @@
 #include "handle_d2cs.h"
 #include "command_groups.h"
 #include "attrlayer.h"
+#include "storage.h"
+#include "cluster.h"
 #include "anongame_wol.h"
 #include "icons.h"
 #include "i18n.h"
@@ -97,9 +104,20 @@ namespace pvpgn
 		t_elist arrayflist;
 
 		static int      totalcount = 0;
-		static t_list * conn_head = NULL;
-		static t_list * conn_dead = NULL;
-
+		/* all connections, linked through protocol.connlist */
+		static DECLARE_ELIST_INIT(conn_head);
+		static unsigned int conn_count = 0;
+		/* connections in destroy state: conn_dead have nothing left to send and
+		 * are freed on the next reap, conn_closing are still flushing their
+		 * queue and are kept ordered by deadline */
+		static DECLARE_ELIST_INIT(conn_dead);
+		static DECLARE_ELIST_INIT(conn_closing);
+		/* see conn_read_budget_hit() and conn_push_outqueue() */
+		static unsigned long fairness_budget_hits = 0;
+		static unsigned long fairness_pauses = 0;
+		static unsigned long fairness_resumes = 0;
+
+		static void conn_closing_unlink(t_connection * c);
 		static void conn_send_welcome(t_connection * c);
 		static void conn_send_issue(t_connection * c);
 
@@ -193,7 +211,8 @@ namespace pvpgn
 			conn_set_state(c, conn_state_destroy);
 		}
 
-		extern void conn_test_latency(t_connection * c, std::time_t now, t_timer_data delta)
+		/* send one latency probe (echo request or IRC PING) */
+		extern void conn_test_latency(t_connection * c)
 		{
 			t_packet * packet;
 
@@ -203,10 +222,6 @@ namespace pvpgn
 				return;
 			}
 
-
-			if (now == (std::time_t)0) /* zero means user logged out before expiration */
-				return;
-
 			if (conn_get_state(c) == conn_state_destroy)	// [zap-zero] 20020910
 				return;					// state_destroy: do nothing
 
@@ -256,14 +271,48 @@ namespace pvpgn
 					}
 				}
 			}
+		}
+
+
+		/* random part of a period, so probes of connections set up together drift apart */
+		static std::time_t conn_keepalive_jitter(unsigned int period)
+		{
+			if (period < 8)
+				return 0;
+			return (std::time_t)((unsigned int)std::rand() % (period / 8 + 1));
+		}
+
+
+		static void conn_keepalive(t_connection * c, std::time_t now, t_timer_data data);
+
+		static void conn_keepalive_schedule(t_connection * c)
+		{
+			std::time_t when;
+			t_timer_data data;
+
+			when = c->protocol.keepalive.next_latency;
+			if (c->protocol.keepalive.next_nullmsg && (!when || c->protocol.keepalive.next_nullmsg < when))
+				when = c->protocol.keepalive.next_nullmsg;
+			if (!when)
+				return;
 
-			if (timerlist_add_timer(c, now + (std::time_t)delta.n, conn_test_latency, delta) < 0)
+			data.n = 0;
+			if (timerlist_add_timer(c, when, conn_keepalive, data) < 0)
 				eventlog(eventlog_level_error, __FUNCTION__, "could not add timer");
 		}
 
 
-		static void conn_send_nullmsg(t_connection * c, std::time_t now, t_timer_data delta)
+		/*
+		 * One timer per connection drives both the latency probe and the null
+		 * message. A probe due within the next 1/8 of its period is sent along
+		 * with the other one, and neither is sent while the client is talking
+		 * to us anyway (the echo only once its latency is known).
+		 */
+		static void conn_keepalive(t_connection * c, std::time_t now, t_timer_data data)
 		{
+			unsigned int period;
+			int recent;
+
 			if (!c)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection");
@@ -273,10 +322,53 @@ namespace pvpgn
 			if (now == (std::time_t)0) /* zero means user logged out before expiration */
 				return;
 
-			message_send_text(c, message_type_null, c, NULL);
+			if (conn_get_state(c) == conn_state_destroy)
+				return;
 
-			if (timerlist_add_timer(c, now + (std::time_t)delta.n, conn_send_nullmsg, delta) < 0)
-				eventlog(eventlog_level_error, __FUNCTION__, "could not add timer");
+			if ((period = c->protocol.keepalive.latency) && c->protocol.keepalive.next_latency <= now + (std::time_t)(period / 8))
+			{
+				recent = now - c->protocol.keepalive.last_recv < (std::time_t)(period / 2);
+				if (!recent || !conn_get_latency(c))
+					conn_test_latency(c);
+				c->protocol.keepalive.next_latency = now + period - conn_keepalive_jitter(period);
+			}
+
+			if ((period = c->protocol.keepalive.nullmsg) && c->protocol.keepalive.next_nullmsg <= now + (std::time_t)(period / 8))
+			{
+				recent = now - c->protocol.keepalive.last_recv < (std::time_t)(period / 2);
+				if (!recent)
+					message_send_text(c, message_type_null, c, NULL);
+				c->protocol.keepalive.next_nullmsg = now + period - conn_keepalive_jitter(period);
+			}
+
+			conn_keepalive_schedule(c);
+		}
+
+
+		/*
+		 * Start latency probes and null messages every "latency" and "nullmsg"
+		 * seconds (0 = never). The first ones are spread over the whole period
+		 * so connections from a mass reconnect don't probe in lockstep.
+		 */
+		extern void conn_keepalive_start(t_connection * c, unsigned int latency, unsigned int nullmsg)
+		{
+			assert(c);
+
+			c->protocol.keepalive.latency = latency;
+			c->protocol.keepalive.nullmsg = nullmsg;
+			c->protocol.keepalive.next_latency = latency ? now + 1 + (std::time_t)((unsigned int)std::rand() % latency) : 0;
+			c->protocol.keepalive.next_nullmsg = nullmsg ? now + 1 + (std::time_t)((unsigned int)std::rand() % nullmsg) : 0;
+			/* IRC clients are pinged on their first line and get a full period to answer */
+			if (latency && conn_get_ircping(c))
+				c->protocol.keepalive.next_latency = now + (std::time_t)latency;
+			conn_keepalive_schedule(c);
+		}
+
+
+		extern void conn_keepalive_touch(t_connection * c)
+		{
+			assert(c);
+			c->protocol.keepalive.last_recv = now;
 		}
 
 
@@ -386,8 +478,7 @@ namespace pvpgn
 			temp->protocol.chat.away = NULL;
 			temp->protocol.chat.ignore_list = NULL;
 			temp->protocol.chat.ignore_count = 0;
-			temp->protocol.chat.quota.totcount = 0;
-			temp->protocol.chat.quota.list = list_create();
+			quota_init(&temp->protocol.chat.quota);
 			temp->protocol.client.versionid = 0;
 			temp->protocol.client.gameversion = 0;
 			temp->protocol.client.checksum = 0;
@@ -416,6 +507,7 @@ namespace pvpgn
 			temp->protocol.queues.outqueue = NULL;
 			temp->protocol.queues.outsize = 0;
 			temp->protocol.queues.outsizep = 0;
+			temp->protocol.queues.outbytes = 0;
 			temp->protocol.queues.inqueue = NULL;
 			temp->protocol.queues.insize = 0;
 			temp->protocol.loggeduser = NULL;
@@ -424,6 +516,8 @@ namespace pvpgn
 			temp->protocol.d2.character = NULL;
 			temp->protocol.d2.realminfo = NULL;
 			temp->protocol.d2.charname = NULL;
+			temp->protocol.d2.d2cs_ip = 0;
+			temp->protocol.d2.d2cs_port = 0;
 			temp->protocol.w3.w3_playerinfo = NULL;
 			temp->protocol.w3.routeconn = NULL;
 			temp->protocol.w3.anongame = NULL;
@@ -432,6 +526,18 @@ namespace pvpgn
 			temp->protocol.w3.server_proof = NULL;
 			temp->protocol.bound = NULL;
 			elist_init(&temp->protocol.timers);
+			elist_init(&temp->protocol.closing.list);
+			temp->protocol.closing.deadline = 0;
+			temp->protocol.flightrec = flightrec_create();
+			temp->protocol.closing.halfclosed = 0;
+			temp->protocol.fairness.paused = 0;
+			temp->protocol.fairness.pauses = 0;
+			temp->protocol.fairness.budget_hits = 0;
+			temp->protocol.keepalive.last_recv = now;
+			temp->protocol.keepalive.latency = 0;
+			temp->protocol.keepalive.nullmsg = 0;
+			temp->protocol.keepalive.next_latency = 0;
+			temp->protocol.keepalive.next_nullmsg = 0;
 
 			temp->protocol.wol.ingame = 0;
 
@@ -449,7 +555,8 @@ namespace pvpgn
 
 			temp->protocol.cflags = 0;
 
-			list_prepend_data(conn_head, temp);
+			elist_add(&conn_head, &temp->protocol.connlist);
+			conn_count++;
 
 			eventlog(eventlog_level_debug, __FUNCTION__, "[{}][{}] sessionkey=0x{:08} sessionnum=0x{:08}", temp->socket.tcp_sock, temp->socket.udp_sock, temp->protocol.sessionkey, temp->protocol.sessionnum);
 
@@ -537,10 +644,9 @@ namespace pvpgn
 			c->protocol.w3.anongame = NULL;
 		}
 
-		extern void conn_destroy(t_connection * c, t_elem ** elem, int conn_or_dead_list)
+		extern void conn_destroy(t_connection * c)
 		{
 			char const * classstr;
-			t_elem * curr;
 
 
 			if (c == NULL) {
@@ -550,11 +656,8 @@ namespace pvpgn
 
 			classstr = conn_class_get_str(c->protocol.cclass);
 
-			if (list_remove_data(conn_head, c, (conn_or_dead_list) ? &curr : elem) < 0)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "could not remove item from list");
-				return;
-			}
+			elist_del(&c->protocol.connlist);
+			conn_count--;
 
 			if (c->protocol.cclass == conn_class_d2cs_bnetd)
 			{
@@ -562,7 +665,7 @@ namespace pvpgn
 
 				realm = conn_get_realm(c);
 				if (realm)
-					realm_deactive(realm);
+					realm_deactive(realm, c);
 				else
 				{
 					eventlog(eventlog_level_error, __FUNCTION__, "could not find realm for d2cs connection");
@@ -576,23 +679,11 @@ namespace pvpgn
 
 			if (c->protocol.d2.realm) {
 				realm_add_player_number(c->protocol.d2.realm, -1);
+				realm_move_player(c->protocol.d2.realm, c, 0, 0);
 				realm_put(c->protocol.d2.realm, &c->protocol.d2.realm_regref);
 			}
 
 
-			/* free the memory with user quota */
-			{
-				t_qline * qline;
-
-				LIST_TRAVERSE(c->protocol.chat.quota.list, curr)
-				{
-					qline = (t_qline*)elem_get_data(curr);
-					xfree(qline);
-					list_remove_elem(c->protocol.chat.quota.list, &curr);
-				}
-				list_destroy(c->protocol.chat.quota.list);
-			}
-
 			/* if this user in a channel, notify everyone that the user has left */
 			if (c->protocol.chat.channel)
 				channel_del_connection(c->protocol.chat.channel, c, message_type_quit, NULL);
@@ -647,8 +738,10 @@ namespace pvpgn
 				xfree((void *)c->protocol.d2.realminfo); /* avoid warning */
 			if (c->protocol.d2.charname)
 				xfree((void *)c->protocol.d2.charname); /* avoid warning */
-			if (c->protocol.chat.irc.ircline)
+			if (c->protocol.chat.irc.ircline) {
+				memlimit_sub(std::strlen(c->protocol.chat.irc.ircline) + 1);
 				xfree((void *)c->protocol.chat.irc.ircline); /* avoid warning */
+			}
 			if (c->protocol.chat.irc.ircpass)
 				xfree((void *)c->protocol.chat.irc.ircpass); /* avoid warning */
 
@@ -685,14 +778,19 @@ namespace pvpgn
 
 			if (c->protocol.account)
 			{
+				if (account_get_flightrec(c->protocol.account))
+					flightrec_dump(c, "flagged account logged out");
 				eventlog(eventlog_level_info, __FUNCTION__, "[{}] \"{}\" logged out", c->socket.tcp_sock, conn_get_loggeduser(c));
 				//amadeo
 #ifdef WIN32_GUI
 				guiOnUpdateUserList();
 #endif
-				if (prefs_get_sync_on_logoff()) {
+				/* in a cluster the next login may be on another node, which reads the account from storage */
+				if (prefs_get_sync_on_logoff() || cluster_is_enabled()) {
 					if (account_save(conn_get_account(c), FS_FORCE) < 0)
 						eventlog(eventlog_level_error, __FUNCTION__, "cannot sync account (sync_on_logoff)");
+					else if (cluster_is_enabled())
+						storage->sync();
 				}
 
 #ifdef WITH_LUA
@@ -714,7 +812,10 @@ namespace pvpgn
 				psock_close(c->socket.tcp_sock);
 			}
 			/* clear out the packet queues */
-			if (c->protocol.queues.inqueue) packet_del_ref(c->protocol.queues.inqueue);
+			if (c->protocol.queues.inqueue) {
+				memlimit_sub(sizeof(t_packet));
+				packet_del_ref(c->protocol.queues.inqueue);
+			}
 			queue_clear(&c->protocol.queues.outqueue);
 
 			// [zap-zero] 20020601
@@ -727,11 +828,17 @@ namespace pvpgn
 			if (c->protocol.w3.anongame)
 				conn_destroy_anongame(c);
 
-			/* delete the conn from the dead list if its there, we dont check for error
-			 * because connections may be destroyed without first setting state to destroy */
-			if (conn_dead) list_remove_data(conn_dead, c, (conn_or_dead_list) ? elem : &curr);
+			/* delete the conn from the dead or closing list if its there, connections
+			 * may be destroyed without first setting state to destroy */
+			conn_closing_unlink(c);
 			connarray_del_conn(c->protocol.sessionnum);
 
+			/* also drop what got queued while tearing down (channel notices) */
+			queue_clear(&c->protocol.queues.outqueue);
+			memlimit_sub(c->protocol.queues.outbytes);
+
+			flightrec_destroy(c->protocol.flightrec);
+
 			eventlog(eventlog_level_info, __FUNCTION__, "[{}] closed {} connection", c->socket.tcp_sock, classstr);
 
 			xfree(c);
@@ -772,8 +879,6 @@ namespace pvpgn
 
 		extern void conn_set_class(t_connection * c, t_conn_class cclass)
 		{
-			t_timer_data  data;
-			unsigned long delta;
 			t_conn_class oldclass;
 
 			if (!c)
@@ -796,35 +901,23 @@ namespace pvpgn
 
 				/* remove any init timers */
 				if (oldclass == conn_class_init) timerlist_del_all_timers(c);
-				delta = prefs_get_latency();
-				data.n = delta;
-				if (timerlist_add_timer(c, now + (std::time_t)delta, conn_test_latency, data) < 0)
-					eventlog(eventlog_level_error, __FUNCTION__, "could not add timer");
+				conn_keepalive_start(c, prefs_get_latency(), 0);
 
 				eventlog(eventlog_level_debug, __FUNCTION__, "added latency check timer");
 				break;
 
 			case conn_class_w3route:
-				delta = prefs_get_latency();
-				data.n = delta;
-				if (timerlist_add_timer(c, now + (std::time_t)delta, conn_test_latency, data)<0)
-					eventlog(eventlog_level_error, __FUNCTION__, "could not add timer");
+				conn_keepalive_start(c, prefs_get_latency(), 0);
 				break;
 
 			case conn_class_bot:
 			case conn_class_telnet:
 			{
 									  t_packet * rpacket;
-									  if (cclass == conn_class_bot) {
-										  if ((delta = prefs_get_nullmsg())>0) {
-											  data.n = delta;
-											  if (timerlist_add_timer(c, now + (std::time_t)delta, conn_send_nullmsg, data) < 0)
-												  eventlog(eventlog_level_error, __FUNCTION__, "could not add timer");
-										  }
-									  }
-
 									  /* remove any init timers */
 									  if (oldclass == conn_class_init) timerlist_del_all_timers(c);
+									  if (cclass == conn_class_bot)
+										  conn_keepalive_start(c, 0, prefs_get_nullmsg());
 									  conn_send_issue(c);
 
 									  if (!(rpacket = packet_create(packet_class_raw)))
@@ -860,27 +953,61 @@ namespace pvpgn
 		}
 
 
-		extern void conn_set_state(t_connection * c, t_conn_state state)
+		static void conn_closing_unlink(t_connection * c)
 		{
-			t_elem * elem;
+			elist_del(&c->protocol.closing.list);
+			elist_init(&c->protocol.closing.list);
+		}
+
+
+		/* queue a closing connection on conn_closing, sorted by deadline (0 last) */
+		static void conn_closing_add(t_connection * c)
+		{
+			t_elist * curr;
+			t_connection * other;
+
+			conn_closing_unlink(c);
+			elist_for_each_rev(curr, &conn_closing)
+			{
+				other = elist_entry(curr, t_connection, protocol.closing.list);
+				if (!c->protocol.closing.deadline)
+					break;
+				if (other->protocol.closing.deadline && other->protocol.closing.deadline <= c->protocol.closing.deadline)
+					break;
+			}
+			/* curr is the last entry to stay before c, or the list head */
+			elist_add(curr, &c->protocol.closing.list);
+		}
+
+
+		static void conn_dead_add(t_connection * c)
+		{
+			conn_closing_unlink(c);
+			elist_add_tail(&conn_dead, &c->protocol.closing.list);
+		}
+
 
+		extern void conn_set_state(t_connection * c, t_conn_state state)
+		{
 			if (!c)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection");
 				return;
 			}
 
-			/* special case for destroying connections, add them to conn_dead list */
+			/* special case for destroying connections, they go to conn_dead or, if
+			 * there is still output queued, to conn_closing until it is sent or
+			 * close_timeout expires */
 			if (state == conn_state_destroy && c->protocol.state != conn_state_destroy) {
-				if (!conn_dead)
-					conn_dead = list_create();
-				list_append_data(conn_dead, c);
+				c->protocol.closing.deadline = prefs_get_close_timeout() ? now + prefs_get_close_timeout() : 0;
+				c->protocol.closing.halfclosed = 0;
+				if (conn_peek_outqueue(c))
+					conn_closing_add(c);
+				else
+					conn_dead_add(c);
 			}
 			else if (state != conn_state_destroy && c->protocol.state == conn_state_destroy)
-			if (list_remove_data(conn_dead, c, &elem)) {
-				eventlog(eventlog_level_error, __FUNCTION__, "could not remove dead connection");
-				return;
-			}
+				conn_closing_unlink(c);
 
 			c->protocol.state = state;
 		}
@@ -1879,7 +2006,6 @@ namespace pvpgn
 			t_channel * channel;
 			t_channel * oldchannel;
 			t_account * acc;
-			t_elem * curr;
 			int clantag = 0;
 			t_clan * clan = NULL;
 			t_clanmember * member = NULL;
@@ -2014,7 +2140,7 @@ namespace pvpgn
 			if (channel_add_connection(channel, c) < 0)
 			{
 				if (created)
-					channel_destroy(channel, &curr);
+					channel_destroy(channel);
 				c->protocol.chat.channel = NULL;
 				return -1;
 			}
@@ -2204,6 +2330,10 @@ namespace pvpgn
 		{
 			assert(c);
 
+			if (c->protocol.queues.inqueue)
+				memlimit_sub(sizeof(t_packet));
+			if (packet)
+				memlimit_add(sizeof(t_packet));
 			c->protocol.queues.inqueue = packet;
 		}
 
@@ -2268,19 +2398,51 @@ namespace pvpgn
 				return -1;
 			}
 
+			/* the sending side of a half closed connection is already shut down */
+			if (c->protocol.closing.halfclosed)
+				return 0;
+
 			// Protection from hack attempt
 			// Limit out queue packets due to it may cause memory leak with not enough memory program crash on a server machine
 			t_queue ** q = &c->protocol.queues.outqueue;
 			if (prefs_get_packet_limit() && queue_get_length((t_queue const * const *)q) > prefs_get_packet_limit())
 			{
-				queue_clear(q);
+				conn_clear_outqueue(c);
 				conn_set_state(c, conn_state_destroy);
 				eventlog(eventlog_level_error, __FUNCTION__, "outqueue reached limit of {} packets (hack attempt?)", prefs_get_packet_limit());
 				return 0;
 			}
 
+			if (prefs_get_mem_conn_limit() && conn_get_membytes(c) + sizeof(t_packet) > prefs_get_mem_conn_limit() * 1024UL)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "[{}] connection reached memory limit of {} KB ({} packets queued)", c->socket.tcp_sock, prefs_get_mem_conn_limit(), queue_get_length((t_queue const * const *)q));
+				conn_clear_outqueue(c);
+				conn_set_state(c, conn_state_destroy);
+				return 0;
+			}
+
 			queue_push_packet((t_queue * *)&c->protocol.queues.outqueue, packet);
-			if (!c->protocol.queues.outsizep++) fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_read | fdwatch_type_write);
+			c->protocol.queues.outbytes += sizeof(t_packet);
+			memlimit_add(sizeof(t_packet));
+			if (!c->protocol.queues.outsizep++) {
+				if (c->protocol.state == conn_state_destroy) {
+					fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_write);
+					conn_closing_add(c);
+				}
+				else
+					fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_read | fdwatch_type_write);
+			}
+
+			/* the client does not keep up reading, stop taking more work from it */
+			if (prefs_get_conn_read_pause() && c->protocol.queues.outsizep >= prefs_get_conn_read_pause() &&
+				!c->protocol.fairness.paused && c->protocol.state != conn_state_destroy)
+			{
+				c->protocol.fairness.paused = 1;
+				c->protocol.fairness.pauses++;
+				fairness_pauses++;
+				fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_write);
+				eventlog(eventlog_level_debug, __FUNCTION__, "[{}] {} packets queued, reading paused", c->socket.tcp_sock, c->protocol.queues.outsizep);
+			}
 
 			return 0;
 		}
@@ -2294,6 +2456,10 @@ namespace pvpgn
 			}
 
 			queue_clear(&c->protocol.queues.outqueue);
+			memlimit_sub(c->protocol.queues.outbytes);
+			c->protocol.queues.outbytes = 0;
+			if (c->protocol.state == conn_state_destroy)
+				conn_dead_add(c);
 			return 0;
 		}
 
@@ -2319,7 +2485,24 @@ namespace pvpgn
 			}
 
 			if (c->protocol.queues.outsizep) {
-				if (!(--c->protocol.queues.outsizep)) fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_read);
+				c->protocol.queues.outbytes -= sizeof(t_packet);
+				memlimit_sub(sizeof(t_packet));
+				if (!(--c->protocol.queues.outsizep)) {
+					if (c->protocol.fairness.paused) {
+						c->protocol.fairness.paused = 0;
+						fairness_resumes++;
+					}
+					fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_read);
+					/* flushed, a closing connection can go now */
+					if (c->protocol.state == conn_state_destroy)
+						conn_dead_add(c);
+				}
+				else if (c->protocol.fairness.paused && c->protocol.queues.outsizep <= prefs_get_conn_read_pause() / 2) {
+					c->protocol.fairness.paused = 0;
+					fairness_resumes++;
+					if (c->protocol.state != conn_state_destroy)
+						fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_read | fdwatch_type_write);
+				}
 				return queue_pull_packet((t_queue * *)&c->protocol.queues.outqueue);
 			}
 
@@ -2476,6 +2659,14 @@ namespace pvpgn
 		}
 
 
+		/* the socket's fdwatch slot, it is read and written with fdwatch_recv() and fdwatch_send() */
+		extern int conn_get_fdw_idx(t_connection const * c)
+		{
+			assert(c);
+			return c->socket.fdw_idx;
+		}
+
+
 		extern int conn_get_game_socket(t_connection const * c)
 		{
 			if (!c)
@@ -2817,6 +3008,41 @@ namespace pvpgn
 		}
 
 
+		extern unsigned int conn_get_d2cs_ip(t_connection const * c)
+		{
+			if (!c)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection");
+				return 0;
+			}
+			return c->protocol.d2.d2cs_ip;
+		}
+
+
+		extern unsigned short conn_get_d2cs_port(t_connection const * c)
+		{
+			if (!c)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection");
+				return 0;
+			}
+			return c->protocol.d2.d2cs_port;
+		}
+
+
+		extern int conn_set_d2cs_addr(t_connection * c, unsigned int ip, unsigned short port)
+		{
+			if (!c)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection");
+				return -1;
+			}
+			c->protocol.d2.d2cs_ip = ip;
+			c->protocol.d2.d2cs_port = port;
+			return 0;
+		}
+
+
 		extern int conn_set_idletime(t_connection * c)
 		{
 			if (!c)
@@ -2978,9 +3204,12 @@ namespace pvpgn
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL line");
 				return -1;
 			}
-			if (c->protocol.chat.irc.ircline)
+			if (c->protocol.chat.irc.ircline) {
+				memlimit_sub(std::strlen(c->protocol.chat.irc.ircline) + 1);
 				xfree((void *)c->protocol.chat.irc.ircline); /* avoid warning */
+			}
 			c->protocol.chat.irc.ircline = xstrdup(line);
+			memlimit_add(std::strlen(line) + 1);
 			return 0;
 		}
 
@@ -3100,8 +3329,9 @@ namespace pvpgn
 
 		extern int conn_quota_exceeded(t_connection * con, char const * text)
 		{
-			t_qline * qline;
-			t_elem *  curr;
+			unsigned int count;
+			unsigned int len;
+			t_quota * quota;
 
 			if (!prefs_get_quota() ||
 				!conn_get_account(con)
@@ -3110,43 +3340,22 @@ namespace pvpgn
 				/* || (account_get_command_groups(conn_get_account(con)) & command_get_group("/admin-con"))*/ 
 				) return 0;
 
-			if (std::strlen(text) > prefs_get_quota_maxline())
+			len = std::strlen(text);
+			if (len > prefs_get_quota_maxline())
 			{
 				message_send_text(con, message_type_error, con, localize(con, "Your line length quota has been exceeded!"));
 				return 1;
 			}
 
-			LIST_TRAVERSE(con->protocol.chat.quota.list, curr)
-			{
-				qline = (t_qline*)elem_get_data(curr);
-				if (now >= qline->inf + (std::time_t)prefs_get_quota_time())
-				{
-					/* these lines are at least quota_time old */
-					list_remove_elem(con->protocol.chat.quota.list, &curr);
-					if (qline->count > con->protocol.chat.quota.totcount)
-						eventlog(eventlog_level_error, __FUNCTION__, "qline->count={} but con->protocol.chat.quota.totcount={}", qline->count, con->protocol.chat.quota.totcount);
-					con->protocol.chat.quota.totcount -= qline->count;
-					xfree(qline);
-				}
-				else
-					break; /* old items are first, so we know nothing else will match */
-			}
-
-			qline = (t_qline*)xmalloc(sizeof(t_qline));
-			qline->inf = now; /* set the moment */
-			if (std::strlen(text) > prefs_get_quota_wrapline()) /* round up on the divide */
-				qline->count = (std::strlen(text) + prefs_get_quota_wrapline() - 1) / prefs_get_quota_wrapline();
+			if (len > prefs_get_quota_wrapline()) /* round up on the divide */
+				count = (len + prefs_get_quota_wrapline() - 1) / prefs_get_quota_wrapline();
 			else
-				qline->count = 1;
+				count = 1;
 
-			list_append_data(con->protocol.chat.quota.list, qline);
-
-			con->protocol.chat.quota.totcount += qline->count;
-
-			if (con->protocol.chat.quota.totcount >= prefs_get_quota_lines())
+			if (quota_add(&con->protocol.chat.quota, count, now, prefs_get_quota_lines(), prefs_get_quota_time()) >= prefs_get_quota_lines())
 			{
 				message_send_text(con, message_type_error, con, localize(con, "Your message quota has been exceeded!"));
-				if (con->protocol.chat.quota.totcount >= prefs_get_quota_dobae())
+				if (con->protocol.chat.quota.level / prefs_get_quota_time() >= prefs_get_quota_dobae())
 				{
 					/* kick out the dobae user for violation of the quota rule */
 					conn_set_state(con, conn_state_destroy);
@@ -3157,6 +3366,22 @@ namespace pvpgn
 				return 1;
 			}
 
+			/* aggregate limits, lines refused above don't count against them */
+			if (prefs_get_quota_ip_lines() &&
+				(quota = quota_get_by_addr(conn_get_addr(con), now, prefs_get_quota_ip_lines(), prefs_get_quota_time())) &&
+				quota_add(quota, count, now, prefs_get_quota_ip_lines(), prefs_get_quota_time()) >= prefs_get_quota_ip_lines())
+			{
+				message_send_text(con, message_type_error, con, localize(con, "Your address message quota has been exceeded!"));
+				return 1;
+			}
+
+			if (prefs_get_quota_channel_lines() && con->protocol.chat.channel &&
+				quota_add(channel_get_quota(con->protocol.chat.channel), count, now, prefs_get_quota_channel_lines(), prefs_get_quota_time()) >= prefs_get_quota_channel_lines())
+			{
+				message_send_text(con, message_type_error, con, localize(con, "The channel message quota has been exceeded!"));
+				return 1;
+			}
+
 			return 0;
 		}
 
@@ -3372,7 +3597,7 @@ namespace pvpgn
 		extern int conn_add_fdwatch(t_connection *c, fdwatch_handler handle)
 		{
 			assert(c);
-			c->socket.fdw_idx = fdwatch_add_fd(c->socket.tcp_sock, fdwatch_type_read, handle, c);
+			c->socket.fdw_idx = fdwatch_add_io_fd(c->socket.tcp_sock, fdwatch_type_read, handle, c);
 			return c->socket.fdw_idx;
 		}
 
@@ -3394,16 +3619,92 @@ namespace pvpgn
 		}
 
 
+		/* memory pinned by this connection as accounted in memlimit */
+		extern unsigned long conn_get_membytes(t_connection const * c)
+		{
+			unsigned long bytes;
+
+			assert(c);
+			bytes = c->protocol.queues.outbytes;
+			if (c->protocol.queues.inqueue)
+				bytes += sizeof(t_packet);
+			if (c->protocol.chat.irc.ircline)
+				bytes += std::strlen(c->protocol.chat.irc.ircline) + 1;
+			return bytes;
+		}
+
+
+		extern int conn_get_halfclosed(t_connection const * c)
+		{
+			assert(c);
+			return c->protocol.closing.halfclosed;
+		}
+
+
+		extern int conn_get_read_paused(t_connection const * c)
+		{
+			assert(c);
+			return c->protocol.fairness.paused;
+		}
+
+
+		extern unsigned long conn_get_read_pauses(t_connection const * c)
+		{
+			assert(c);
+			return c->protocol.fairness.pauses;
+		}
+
+
+		extern unsigned long conn_get_read_budget_hits(t_connection const * c)
+		{
+			assert(c);
+			return c->protocol.fairness.budget_hits;
+		}
+
+
+		/* the connection had more to read when its share of the iteration was used up */
+		extern void conn_read_budget_hit(t_connection * c)
+		{
+			assert(c);
+			c->protocol.fairness.budget_hits++;
+			fairness_budget_hits++;
+		}
+
+
+		/* totals since startup, for /fairness */
+		extern void connlist_get_fairness(unsigned long * budget_hits, unsigned long * pauses, unsigned long * resumes)
+		{
+			*budget_hits = fairness_budget_hits;
+			*pauses = fairness_pauses;
+			*resumes = fairness_resumes;
+		}
+
+
+		extern t_flightrec * conn_get_flightrec(t_connection const * c)
+		{
+			assert(c);
+			return c->protocol.flightrec;
+		}
+
+
+		/* the peer closed its end of a half closed connection */
+		extern void conn_close_done(t_connection * c)
+		{
+			assert(c);
+			conn_dead_add(c);
+		}
+
+
 		extern int conn_get_user_count_by_clienttag(t_clienttag ct)
 		{
 			t_connection * conn;
-			t_elem const * curr;
+			t_elist      * curr;
 			int clienttagusers = 0;
 
 			/* Get Number of Users for client tag specific */
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				conn = (t_connection*)elem_get_data(curr);
+				conn = connlist_get_conn(curr);
 				if ((ct == conn->protocol.client.clienttag)
 					&& (conn->protocol.state == conn_state_loggedin)) clienttagusers++;
 			}
@@ -3413,45 +3714,114 @@ namespace pvpgn
 
 		extern int connlist_create(void)
 		{
-			conn_head = list_create();
+			elist_init(&conn_head);
+			conn_count = 0;
 			connarray_create();
 			return 0;
 		}
 
 		extern int connlist_destroy(void)
 		{
-			if (conn_dead) list_destroy(conn_dead);
-			conn_dead = NULL;
+			elist_init(&conn_dead);
+			elist_init(&conn_closing);
 			connarray_destroy();
 			/* FIXME: if called with active connection, connection are not freed */
-			if (list_destroy(conn_head) < 0)
-				return -1;
-			conn_head = NULL;
+			if (!elist_empty(&conn_head))
+				eventlog(eventlog_level_error, __FUNCTION__, "got non-empty connection list");
+			elist_init(&conn_head);
 			return 0;
 		}
 
 		extern void connlist_reap(void)
 		{
-			t_elem		*curr;
 			t_connection	*c;
 
-			if (!conn_dead || !conn_head) return;
 
-			LIST_TRAVERSE(conn_dead, curr)
+			/* always take the first entry, destroying a connection may send
+			 * to others (channel leave messages) and move them between lists */
+			while (!elist_empty(&conn_dead))
 			{
-				c = (t_connection *)elem_get_data(curr);
+				c = elist_entry(elist_next(&conn_dead), t_connection, protocol.closing.list);
 
-				if (!c)
-					eventlog(eventlog_level_error, __FUNCTION__, "found NULL entry in conn_dead list");
-				else if (!conn_peek_outqueue(c)) {
-					conn_destroy(c, &curr, DESTROY_FROM_DEADLIST); /* also removes from conn_dead list and fdwatch */
+				/* send only the FIN and let the peer close first, the deadline
+				 * still applies while we wait for it (no deadline, no waiting) */
+				if (prefs_get_close_halfclose() && !c->protocol.closing.halfclosed &&
+					c->socket.tcp_sock != -1 && c->protocol.closing.deadline > now)
+				{
+					fdwatch_flush(c->socket.fdw_idx);
+					psock_shutdown(c->socket.tcp_sock, PSOCK_SHUT_WR);
+					c->protocol.closing.halfclosed = 1;
+					fdwatch_update_fd(c->socket.fdw_idx, fdwatch_type_read);
+					conn_closing_add(c);
+					continue;
 				}
+
+				conn_destroy(c); /* also removes from conn_dead list and fdwatch */
+			}
+
+			/* conn_closing is ordered by deadline so stop at the first one not expired */
+			while (!elist_empty(&conn_closing))
+			{
+				c = elist_entry(elist_next(&conn_closing), t_connection, protocol.closing.list);
+
+				if (!c->protocol.closing.deadline || c->protocol.closing.deadline > now)
+					break;
+
+				if (!c->protocol.closing.halfclosed)
+					eventlog(eventlog_level_info, __FUNCTION__, "[{}] close timeout, dropping {} queued packets", c->socket.tcp_sock, queue_get_length((t_queue const * const *)&c->protocol.queues.outqueue));
+				conn_destroy(c);
 			}
 		}
 
-		extern t_list * connlist(void)
+		/*
+		 * Disconnect the connections holding the most memory until about
+		 * "bytes" are released, returns how many were disconnected. Connections
+		 * that keep up with their output are not offenders and are left alone.
+		 */
+		extern unsigned int connlist_reclaim_memory(unsigned long bytes)
+		{
+			std::vector<t_connection *> big;
+			t_elist *      curr;
+			t_connection * c;
+			unsigned long released = 0;
+			unsigned int count = 0;
+
+			elist_for_each(curr, &conn_head)
+			{
+				c = elist_entry(curr, t_connection, protocol.connlist);
+				if (c->protocol.state != conn_state_destroy && memlimit_is_backlogged(c->protocol.queues.outbytes))
+					big.push_back(c);
+			}
+
+			std::sort(big.begin(), big.end(), [](t_connection const * a, t_connection const * b)
+			{
+				return a->protocol.queues.outbytes > b->protocol.queues.outbytes;
+			});
+
+			for (auto conn : big)
+			{
+				if (released >= bytes)
+					break;
+				eventlog(eventlog_level_warn, __FUNCTION__, "[{}] disconnecting \"{}\" under memory pressure ({} KB queued)", conn->socket.tcp_sock, conn_get_loggeduser(conn) ? conn_get_loggeduser(conn) : "", conn->protocol.queues.outbytes / 1024);
+				released += conn_get_membytes(conn);
+				conn_clear_outqueue(conn);
+				conn_set_state(conn, conn_state_destroy);
+				count++;
+			}
+
+			return count;
+		}
+
+		extern t_elist * connlist(void)
+		{
+			return &conn_head;
+		}
+
+
+		/* the connection of a connlist() position, for elist_for_each() */
+		extern t_connection * connlist_get_conn(t_elist const * pos)
 		{
-			return conn_head;
+			return elist_entry(pos, t_connection, protocol.connlist);
 		}
 
 
@@ -3484,11 +3854,11 @@ namespace pvpgn
 		extern t_connection * connlist_find_connection_by_sessionkey(unsigned int sessionkey)
 		{
 			t_connection * c;
-			t_elem const * curr;
+			t_elist *      curr;
 
-			LIST_TRAVERSE_CONST(conn_head, curr)
+			elist_for_each(curr, &conn_head)
 			{
-				c = (t_connection*)elem_get_data(curr);
+				c = elist_entry(curr, t_connection, protocol.connlist);
 				if (c->protocol.sessionkey == sessionkey)
 					return c;
 			}
@@ -3506,11 +3876,11 @@ namespace pvpgn
 		extern t_connection * connlist_find_connection_by_socket(int socket)
 		{
 			t_connection * c;
-			t_elem const * curr;
+			t_elist *      curr;
 
-			LIST_TRAVERSE_CONST(conn_head, curr)
+			elist_for_each(curr, &conn_head)
 			{
-				c = (t_connection*)elem_get_data(curr);
+				c = elist_entry(curr, t_connection, protocol.connlist);
 				if (c->socket.tcp_sock == socket)
 					return c;
 			}
@@ -3586,15 +3956,15 @@ namespace pvpgn
 		extern t_connection * connlist_find_connection_by_charname(char const * charname, char const * realmname)
 		{
 			t_connection    * c;
-			t_elem const    * curr;
+			t_elist         * curr;
 
 			if (!realmname) {
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realmname");
 				return NULL;
 			}
-			LIST_TRAVERSE_CONST(conn_head, curr)
+			elist_for_each(curr, &conn_head)
 			{
-				c = (t_connection*)elem_get_data(curr);
+				c = elist_entry(curr, t_connection, protocol.connlist);
 				if (!c)
 					continue;
 				if (!c->protocol.d2.charname)
@@ -3621,7 +3991,7 @@ namespace pvpgn
 
 		extern int connlist_get_length(void)
 		{
-			return list_get_length(conn_head);
+			return conn_count;
 		}
 
 
@@ -3629,12 +3999,12 @@ namespace pvpgn
 		{
 			t_connection const * c;
 			unsigned int         count;
-			t_elem const *       curr;
+			t_elist *            curr;
 
 			count = 0;
-			LIST_TRAVERSE_CONST(conn_head, curr)
+			elist_for_each(curr, &conn_head)
 			{
-				c = (const t_connection*)elem_get_data(curr);
+				c = elist_entry(curr, t_connection, protocol.connlist);
 				if ((c->protocol.state == conn_state_loggedin) &&
 					((c->protocol.cclass == conn_class_bnet) || (c->protocol.cclass == conn_class_bot) || (c->protocol.cclass == conn_class_telnet)
 					|| (c->protocol.cclass == conn_class_irc) || (c->protocol.cclass == conn_class_wol)))
@@ -3654,14 +4024,14 @@ namespace pvpgn
 		extern unsigned int connlist_count_connections(unsigned int addr)
 		{
 			t_connection * c;
-			t_elem const * curr;
+			t_elist *      curr;
 			unsigned int count;
 
 			count = 0;
 
-			LIST_TRAVERSE_CONST(conn_head, curr)
+			elist_for_each(curr, &conn_head)
 			{
-				c = (t_connection *)elem_get_data(curr);
+				c = elist_entry(curr, t_connection, protocol.connlist);
 				if (c->socket.tcp_addr == addr)
 					count++;
 			}
@@ -33,6 +33,7 @@
 # include "anongame.h"
 # include "anongame_wol.h"
 # include "realm.h"
+# include "flightrec.h"
 # include "common/queue.h"
 # include "common/tag.h"
 # include "common/elist.h"
@@ -49,6 +50,7 @@
 # include "anongame.h"
 # include "anongame_wol.h"
 # include "realm.h"
+# include "flightrec.h"
 # include "common/queue.h"
 # include "common/tag.h"
 # include "common/elist.h"
@@ -156,6 +158,7 @@ namespace pvpgn
 					t_queue *		outqueue;  /* packets waiting to be sent */
 					unsigned int	outsize;   /* amount sent from the current output packet */
 					unsigned int	outsizep;
+					unsigned long	outbytes;  /* memory accounted for the queued packets, see memlimit.h */
 					t_packet *		inqueue;   /* packet waiting to be processed */
 					unsigned int	insize;    /* amount received into the current input packet */
 				} queues; /* network queues and related data */
@@ -180,6 +183,25 @@ namespace pvpgn
 				const char *		loggeduser;   /* username as logged in or given (not taken from account) */
 				struct connection *	bound; /* matching Diablo II auth connection */
 				t_elist			timers; /* cached list of timers for cleaning */
+				t_elist			connlist; /* on the list of all connections */
+				struct {
+					t_elist			list; /* on the dead or the closing list */
+					std::time_t		deadline; /* drop the queued packets after this, 0 = never */
+					int			halfclosed; /* sending side shut down, waiting for the peer */
+				} closing;
+				struct {
+					int			paused;      /* reading stopped until the queue drains */
+					unsigned long	pauses;
+					unsigned long	budget_hits; /* iterations that ended with the read budget used up */
+				} fairness; /* see conn_read_packets and conn_read_pause */
+				struct {
+					std::time_t		last_recv;     /* when the last packet came in */
+					unsigned int	latency;       /* latency probe period, 0 = none */
+					unsigned int	nullmsg;       /* null message period, 0 = none */
+					std::time_t		next_latency;  /* when the next probe is due */
+					std::time_t		next_nullmsg;
+				} keepalive;
+				t_flightrec *		flightrec; /* last packets, NULL when off */
 				/* FIXME: this d2/w3 specific data could be unified into an union */
 				struct {
 					t_realm *			realm;
@@ -187,6 +209,8 @@ namespace pvpgn
 					t_character *		character;
 					char const *		realminfo;
 					char const *		charname;
+					unsigned int		d2cs_ip; /* d2cs of the realm the client was sent to */
+					unsigned short		d2cs_port;
 				} d2;
 				struct {
 					char const *		w3_playerinfo; /* ADDED BY UNDYING SOULZZ 4/7/02 */
@@ -239,19 +263,19 @@ namespace pvpgn
 #include "game.h"
 #include "account.h"
 #include "common/list.h"
+#include "common/elist.h"
 #include "character.h"
 #include "versioncheck.h"
 #include "timer.h"
 #include "anongame.h"
 #include "anongame_wol.h"
+#include "flightrec.h"
 #include "realm.h"
 #include "message.h"
 #include "common/tag.h"
 #include "common/fdwatch.h"
 #undef JUST_NEED_TYPES
 
-#define DESTROY_FROM_CONNLIST 0
-#define DESTROY_FROM_DEADLIST 1
 
 namespace pvpgn
 {
@@ -266,12 +290,14 @@ namespace pvpgn
 
 
 		extern void conn_shutdown(t_connection * c, std::time_t now, t_timer_data foo);
-		extern void conn_test_latency(t_connection * c, std::time_t now, t_timer_data delta);
+		extern void conn_test_latency(t_connection * c);
+		extern void conn_keepalive_start(t_connection * c, unsigned int latency, unsigned int nullmsg);
+		extern void conn_keepalive_touch(t_connection * c);
 		extern char const * conn_class_get_str(t_conn_class cclass);
 		extern char const * conn_state_get_str(t_conn_state state);
 
 		extern t_connection * conn_create(int tsock, int usock, unsigned int real_local_addr, unsigned short real_local_port, unsigned int local_addr, unsigned short local_port, unsigned int addr, unsigned short port);
-		extern void conn_destroy(t_connection * c, t_elem ** elem, int conn_or_dead_list);
+		extern void conn_destroy(t_connection * c);
 		extern int conn_match(t_connection const * c, char const * user);
 		extern t_conn_class conn_get_class(t_connection const * c);
 		extern void conn_set_class(t_connection * c, t_conn_class cclass);
@@ -351,10 +377,20 @@ namespace pvpgn
 		extern t_packet * conn_pull_outqueue(t_connection * c);
 		extern int conn_clear_outqueue(t_connection * c);
 		extern void conn_close_read(t_connection * c);
+		extern int conn_get_halfclosed(t_connection const * c);
+		extern int conn_get_read_paused(t_connection const * c);
+		extern unsigned long conn_get_read_pauses(t_connection const * c);
+		extern unsigned long conn_get_read_budget_hits(t_connection const * c);
+		extern void conn_read_budget_hit(t_connection * c);
+		extern void connlist_get_fairness(unsigned long * budget_hits, unsigned long * pauses, unsigned long * resumes);
+		extern t_flightrec * conn_get_flightrec(t_connection const * c);
+		extern unsigned long conn_get_membytes(t_connection const * c);
+		extern void conn_close_done(t_connection * c);
 		extern int conn_check_ignoring(t_connection const * c, char const * me);
 		extern t_account * conn_get_account(t_connection const * c);
 		extern void conn_login(t_connection * c, t_account * account, const char *loggeduser);
 		extern int conn_get_socket(t_connection const * c);
+		extern int conn_get_fdw_idx(t_connection const * c);
 		extern int conn_get_game_socket(t_connection const * c);
 		extern int conn_set_game_socket(t_connection * c, int usock);
 		extern char const * conn_get_username_real(t_connection const * c, char const * fn, unsigned int ln);
@@ -371,6 +407,9 @@ namespace pvpgn
 		extern int conn_set_realminfo(t_connection * c, char const * realminfo);
 		extern char const * conn_get_charname(t_connection const * c);
 		extern int conn_set_charname(t_connection * c, char const * charname);
+		extern unsigned int conn_get_d2cs_ip(t_connection const * c);
+		extern unsigned short conn_get_d2cs_port(t_connection const * c);
+		extern int conn_set_d2cs_addr(t_connection * c, unsigned int ip, unsigned short port);
 		extern int conn_set_idletime(t_connection * c);
 		extern unsigned int conn_get_idletime(t_connection const * c);
 		extern t_realm * conn_get_realm(t_connection const * c);
@@ -408,8 +447,10 @@ namespace pvpgn
 		extern t_connection * conn_get_routeconn(t_connection const * c);
 		extern int connlist_create(void);
 		extern void connlist_reap(void);
+		extern unsigned int connlist_reclaim_memory(unsigned long bytes);
 		extern int connlist_destroy(void);
-		extern t_list * connlist(void);
+		extern t_elist * connlist(void);
+		extern t_connection * connlist_get_conn(t_elist const * pos);
 		extern t_connection * connlist_find_connection_by_sessionkey(unsigned int sessionkey);
 		extern t_connection * connlist_find_connection_by_socket(int socket);
 		extern t_connection * connlist_find_connection_by_sessionnum(unsigned int sessionnum);
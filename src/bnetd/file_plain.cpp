@@ -20,6 +20,7 @@
 #include "common/setup_before.h"
 #include "file_plain.h"
 
+#include <cstdio>
 #include <cstring>
 #include <cerrno>
 
@@ -49,13 +50,32 @@ namespace pvpgn
 		};
 
 
+		/* escaped keys and values of all saves go through the same buffer */
+		static char *        escbuf = NULL;
+		static unsigned int  escbuflen = 0;
+
+		static char const * plain_escape(char const * in)
+		{
+			unsigned int len = std::strlen(in);
+
+			if (len * 4 + 1 > escbuflen) {
+				escbuflen = len * 4 + 1 < 256 ? 256 : len * 4 + 1;
+				if (escbuf)
+					xfree(escbuf);
+				escbuf = (char*)xmalloc(escbuflen);
+			}
+
+			return escape_chars_buf(in, len, escbuf);
+		}
+
+
 		static int plain_write_attrs(const char *filename, const t_hlist *attributes)
 		{
 			std::FILE       *  accountfile;
 			t_hlist    *  curr;
 			t_attr     *  attr;
 			char const *  key;
-			char const *  val;
+			int           err;
 
 			if (!(accountfile = std::fopen(filename, "w"))) {
 				eventlog(eventlog_level_error, __FUNCTION__, "unable to open file \"{}\" for writing (std::fopen: {})", filename, std::strerror(errno));
@@ -65,39 +85,35 @@ namespace pvpgn
 			hlist_for_each(curr, attributes) {
 				attr = hlist_entry(curr, t_attr, link);
 
-				if (attr_get_key(attr))
-					key = escape_chars(attr_get_key(attr), std::strlen(attr_get_key(attr)));
-				else {
+				if (!attr_get_key(attr)) {
 					eventlog(eventlog_level_error, __FUNCTION__, "attribute with NULL key in list");
-					key = NULL;
-				}
-
-				if (attr_get_val(attr))
-					val = escape_chars(attr_get_val(attr), std::strlen(attr_get_val(attr)));
-				else {
-					eventlog(eventlog_level_debug, __FUNCTION__, "attribute with NULL val in list key=\"{}\"", key ? key : "NULL");
-					val = NULL;
+					attr_clear_dirty(attr);
+					continue;
 				}
-
-				if (key && val) {
-					if (std::strncmp("BNET\\CharacterDefault\\", key, 20) == 0) {
-						eventlog(eventlog_level_debug, __FUNCTION__, "skipping attribute key=\"{}\"", key);
-					}
-					else {
-						eventlog(eventlog_level_debug, __FUNCTION__, "saving attribute key=\"{}\" val=\"{}\"", key, val);
-						std::fprintf(accountfile, "\"%s\"=\"%s\"\n", key, val);
-					}
+				if (!attr_get_val(attr) || std::strncmp("BNET\\CharacterDefault\\", attr_get_key(attr), 20) == 0) {
+					attr_clear_dirty(attr);
+					continue;
 				}
-				else eventlog(eventlog_level_debug, __FUNCTION__, "could not save attribute key=\"{}\"", key ? key : "NULL");
 
-				if (key) xfree((void *)key); /* avoid warning */
-				if (val) xfree((void *)val); /* avoid warning */
+				/* the value is escaped into the same buffer, so the key goes out first */
+				key = plain_escape(attr_get_key(attr));
+				std::fprintf(accountfile, "\"%s\"=\"", key);
+				std::fputs(plain_escape(attr_get_val(attr)), accountfile);
+				std::fputs("\"\n", accountfile);
 
 				attr_clear_dirty(attr);
 			}
 
+			/* a short write must not replace the old file */
+			err = std::fflush(accountfile) != 0 || std::ferror(accountfile);
+			if (err)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not write account file \"{}\" (std::fflush: {})", filename, std::strerror(errno));
 			if (std::fclose(accountfile) < 0) {
 				eventlog(eventlog_level_error, __FUNCTION__, "could not close account file \"{}\" after writing (std::fclose: {})", filename, std::strerror(errno));
+				err = 1;
+			}
+			if (err) {
+				std::remove(filename);
 				return -1;
 			}
 
@@ -0,0 +1,343 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "filesync.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef WIN32
+# include <io.h>
+#endif
+
+#include "compat/rename.h"
+#include "common/eventlog.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* target -> temporary file, a file saved twice in a cycle is renamed once */
+		static std::map<std::string, std::string> filesync_pending;
+
+		/* the pending files as "size<TAB>tempname<TAB>target" lines, see filesync_open() */
+		static std::string filesync_journalname;
+		static std::FILE * filesync_journal = NULL;
+
+		static int filesync_sync_file(char const * name, int isdir);
+
+
+		static std::string filesync_dirname(std::string const & path)
+		{
+			std::string::size_type pos = path.find_last_of("/\\");
+
+			return (pos == std::string::npos) ? std::string(".") : path.substr(0, pos ? pos : 1);
+		}
+
+
+		static void filesync_journal_add(char const * tempname, char const * path)
+		{
+			struct stat st;
+
+			if (!filesync_journal)
+				return;
+			if (stat(tempname, &st) < 0) {
+				eventlog(eventlog_level_error, __FUNCTION__, "could not stat \"{}\" ({})", tempname, std::strerror(errno));
+				return;
+			}
+			/* no sync, it only has to outlive a crash of the process */
+			std::fprintf(filesync_journal, "%lu\t%s\t%s\n", (unsigned long)st.st_size, tempname, path);
+			if (std::fflush(filesync_journal) != 0)
+				eventlog(eventlog_level_error, __FUNCTION__, "could not write \"{}\" ({})", filesync_journalname, std::strerror(errno));
+		}
+
+
+		/* starts the journal over with what is still pending */
+		static void filesync_journal_rewrite(void)
+		{
+			std::map<std::string, std::string>::const_iterator it;
+
+			if (!filesync_journal)
+				return;
+			std::fclose(filesync_journal);
+			if (!(filesync_journal = std::fopen(filesync_journalname.c_str(), "w"))) {
+				eventlog(eventlog_level_error, __FUNCTION__, "could not open \"{}\" for writing ({})", filesync_journalname, std::strerror(errno));
+				return;
+			}
+			for (it = filesync_pending.begin(); it != filesync_pending.end(); ++it)
+				filesync_journal_add(it->second.c_str(), it->first.c_str());
+		}
+
+
+		/* a file the system crashed on before it was on disk reads as NULs in its lost parts */
+		static int filesync_file_whole(char const * name)
+		{
+			std::FILE * fp;
+			char buf[4096];
+			std::size_t n;
+			int whole = 1;
+
+			if (!(fp = std::fopen(name, "rb")))
+				return 0;
+			while (whole && (n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+				if (std::memchr(buf, '\0', n))
+					whole = 0;
+			if (std::ferror(fp))
+				whole = 0;
+			std::fclose(fp);
+			return whole;
+		}
+
+
+		/*
+		 * Opens the journal of the files written completely but not yet
+		 * renamed, after finishing what the journal left by a crash lists: a
+		 * temporary file of the size it had when it was added is renamed over
+		 * its target, the save was complete. Temporary files it does not list
+		 * were written when the crash came and are the caller's to remove.
+		 */
+		extern int filesync_open(char const * journal)
+		{
+			std::map<std::string, std::pair<std::string, unsigned long> > found;
+			std::map<std::string, std::pair<std::string, unsigned long> >::iterator it;
+			std::set<std::string> dirs;
+			std::FILE * fp;
+			char line[4096];
+			struct stat st;
+			int ret = 0;
+
+			filesync_close();
+			filesync_journalname = journal;
+
+			if ((fp = std::fopen(journal, "r"))) {
+				/* a file added twice is renamed as it was last added */
+				while (std::fgets(line, sizeof(line), fp)) {
+					char * tempname;
+					char * path;
+					char * end;
+
+					if (!(tempname = std::strchr(line, '\t')) || !(path = std::strchr(tempname + 1, '\t')) || !(end = std::strchr(path + 1, '\n')))
+						continue; /* cut short by the crash */
+					*tempname++ = '\0';
+					*path++ = '\0';
+					*end = '\0';
+					found[path] = std::make_pair(std::string(tempname), std::strtoul(line, NULL, 10));
+				}
+				std::fclose(fp);
+			}
+
+			for (it = found.begin(); it != found.end(); ++it) {
+				char const * tempname = it->second.first.c_str();
+
+				if (stat(tempname, &st) < 0)
+					continue; /* renamed or dropped before the crash */
+				if ((unsigned long)st.st_size != it->second.second || !filesync_file_whole(tempname)) {
+					eventlog(eventlog_level_warn, __FUNCTION__, "removing incomplete save \"{}\" of \"{}\"", tempname, it->first);
+					std::remove(tempname);
+					continue;
+				}
+				if (filesync_sync_file(tempname, 0) < 0 || p_rename(tempname, it->first.c_str()) < 0) {
+					eventlog(eventlog_level_error, __FUNCTION__, "could not finish the save \"{}\" of \"{}\" ({}), kept for the next commit", tempname, it->first, std::strerror(errno));
+					filesync_pending[it->first] = it->second.first;
+					ret = -1;
+					continue;
+				}
+				eventlog(eventlog_level_info, __FUNCTION__, "finished the save of \"{}\" a crash interrupted", it->first);
+				dirs.insert(filesync_dirname(it->first));
+			}
+			for (std::set<std::string>::iterator dir = dirs.begin(); dir != dirs.end(); ++dir)
+				filesync_sync_file(dir->c_str(), 1);
+
+			if (!(filesync_journal = std::fopen(journal, "w"))) {
+				eventlog(eventlog_level_error, __FUNCTION__, "could not open \"{}\" for writing ({})", journal, std::strerror(errno));
+				return -1;
+			}
+			for (std::map<std::string, std::string>::iterator p = filesync_pending.begin(); p != filesync_pending.end(); ++p)
+				filesync_journal_add(p->second.c_str(), p->first.c_str());
+
+			return ret;
+		}
+
+
+		/* the pending files stay pending, commit first */
+		extern void filesync_close(void)
+		{
+			if (filesync_journal)
+				std::fclose(filesync_journal);
+			filesync_journal = NULL;
+		}
+
+
+		extern void filesync_add(char const * tempname, char const * path)
+		{
+			filesync_pending[path] = tempname;
+			filesync_journal_add(tempname, path);
+		}
+
+
+		/* forgets a pending file and removes it, the target stays as it is */
+		extern void filesync_drop(char const * path)
+		{
+			std::map<std::string, std::string>::iterator it = filesync_pending.find(path);
+
+			if (it == filesync_pending.end())
+				return;
+			std::remove(it->second.c_str());
+			filesync_pending.erase(it);
+		}
+
+
+		/* returns the temporary file waiting to be renamed over path, or NULL */
+		extern char const * filesync_get_tempname(char const * path)
+		{
+			std::map<std::string, std::string>::const_iterator it = filesync_pending.find(path);
+
+			return (it == filesync_pending.end()) ? NULL : it->second.c_str();
+		}
+
+
+		/* returns the file a pending temporary file will be renamed to, or NULL */
+		extern char const * filesync_get_target(char const * tempname)
+		{
+			std::map<std::string, std::string>::const_iterator it;
+
+			for (it = filesync_pending.begin(); it != filesync_pending.end(); ++it)
+				if (it->second == tempname)
+					return it->first.c_str();
+			return NULL;
+		}
+
+
+		extern unsigned int filesync_get_pending(void)
+		{
+			return filesync_pending.size();
+		}
+
+
+		/* returns -1 if the file could not be opened or synced */
+		static int filesync_sync_file(char const * name, int isdir)
+		{
+#ifdef WIN32
+			int fd;
+
+			/* directories can not be synced, the renames are durable with the files */
+			if (isdir)
+				return 0;
+			if ((fd = _open(name, _O_WRONLY)) < 0)
+				return -1;
+			if (_commit(fd) < 0) {
+				_close(fd);
+				return -1;
+			}
+			_close(fd);
+			return 0;
+#elif defined(HAVE_FSYNC)
+			int fd;
+
+			if ((fd = open(name, isdir ? O_RDONLY : O_WRONLY)) < 0)
+				return -1;
+			if (fsync(fd) < 0 && !isdir) {
+				close(fd);
+				return -1;
+			}
+			close(fd);
+			return 0;
+#else
+			return 0;
+#endif
+		}
+
+
+		extern int filesync_commit(void)
+		{
+			std::map<std::string, std::string>::iterator it;
+			std::set<std::string> dirs;
+			std::set<std::string> failed;
+			int ret = 0;
+
+			if (filesync_pending.empty())
+				return 0;
+
+			for (it = filesync_pending.begin(); it != filesync_pending.end(); ++it)
+				dirs.insert(filesync_dirname(it->first));
+
+#ifdef HAVE_SYNCFS
+			/* one call writes back the temporary files of all accounts of the cycle */
+			int fd;
+			for (std::set<std::string>::iterator dir = dirs.begin(); dir != dirs.end(); ++dir) {
+				if ((fd = open(dir->c_str(), O_RDONLY)) < 0 || syncfs(fd) < 0) {
+					eventlog(eventlog_level_error, __FUNCTION__, "could not sync the files in \"{}\" to disk ({})", *dir, std::strerror(errno));
+					for (it = filesync_pending.begin(); it != filesync_pending.end(); ++it)
+						if (filesync_dirname(it->first) == *dir)
+							failed.insert(it->first);
+				}
+				if (fd >= 0)
+					close(fd);
+			}
+#else
+			for (it = filesync_pending.begin(); it != filesync_pending.end(); ++it)
+				if (filesync_sync_file(it->second.c_str(), 0) < 0) {
+					eventlog(eventlog_level_error, __FUNCTION__, "could not sync \"{}\" to disk ({})", it->second, std::strerror(errno));
+					failed.insert(it->first);
+				}
+#endif
+
+			/* what could not be synced or renamed stays pending for the next commit */
+			for (it = filesync_pending.begin(); it != filesync_pending.end();) {
+				if (failed.count(it->first)) {
+					ret = -1;
+					++it;
+					continue;
+				}
+				if (p_rename(it->second.c_str(), it->first.c_str()) < 0) {
+					eventlog(eventlog_level_error, __FUNCTION__, "could not rename \"{}\" to \"{}\" (std::rename: {})", it->second, it->first, std::strerror(errno));
+					ret = -1;
+					++it;
+					continue;
+				}
+				filesync_pending.erase(it++);
+			}
+
+			/* and the renames themselves */
+			for (std::set<std::string>::iterator dir = dirs.begin(); dir != dirs.end(); ++dir)
+				filesync_sync_file(dir->c_str(), 1);
+
+			filesync_journal_rewrite();
+			return ret;
+		}
+
+	}
+
+}
@@ -0,0 +1,53 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_FILESYNC_PROTOS
+#define INCLUDED_FILESYNC_PROTOS
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/*
+		 * Files written under a temporary name next to their target are
+		 * renamed over it by filesync_commit(), after all of them are on
+		 * disk. A crash leaves the old or the new file, never a part of
+		 * one, and a save cycle waits for the disk once rather than once
+		 * per file. Until then the temporary file is the newest version,
+		 * readers look it up with filesync_get_tempname(). A file that
+		 * could not be synced or renamed stays pending for the next commit.
+		 * A journal lists the pending files so the saves a crash of the
+		 * process interrupted are finished on the next start.
+		 */
+		extern int filesync_open(char const * journal);
+		extern void filesync_close(void);
+		extern void filesync_add(char const * tempname, char const * path);
+		extern void filesync_drop(char const * path);
+		extern char const * filesync_get_tempname(char const * path);
+		extern char const * filesync_get_target(char const * tempname);
+		extern unsigned int filesync_get_pending(void);
+		extern int filesync_commit(void);
+
+	}
+
+}
+
+#endif
+#endif
@@ -0,0 +1,328 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#define FLIGHTREC_INTERNAL_ACCESS
+#include "flightrec.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "common/eventlog.h"
+#include "common/hexdump.h"
+#include "common/addr.h"
+#include "common/list.h"
+#include "common/packet.h"
+#include "common/xalloc.h"
+#include "connection.h"
+#include "memlimit.h"
+#include "prefs.h"
+#include "server.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* packets kept in the ring sampled from all connections */
+		static const unsigned int flightrec_global_slots = 256;
+
+		static t_flightrec * flightrec_global = NULL;
+		static unsigned long flightrec_seq = 0;
+
+		/* automatic dumps left, in 1/60 of a dump: each second adds flightrec_auto_dumps */
+		static unsigned long flightrec_bucket = 0;
+		static std::time_t flightrec_bucket_time = 0;
+		static unsigned long flightrec_suppressed = 0;
+
+
+		static t_flightrec * flightrec_alloc(unsigned int slots, unsigned int bytes)
+		{
+			t_flightrec * rec;
+			unsigned long size;
+
+			/* the entries and their data follow the header in the same block */
+			size = sizeof(t_flightrec) + slots * (sizeof(t_flightrec_entry) + bytes);
+			rec = (t_flightrec *)xmalloc(size);
+			rec->slots = slots;
+			rec->bytes = bytes;
+			rec->next = 0;
+			rec->count = 0;
+			rec->dumped = 0;
+			rec->entries = (t_flightrec_entry *)(rec + 1);
+			rec->data = (char *)(rec->entries + slots);
+			memlimit_add(size);
+
+			return rec;
+		}
+
+
+		extern t_flightrec * flightrec_create(void)
+		{
+			if (!prefs_get_flightrec_packets())
+				return NULL;
+			return flightrec_alloc(prefs_get_flightrec_packets(), prefs_get_flightrec_bytes());
+		}
+
+
+		extern void flightrec_destroy(t_flightrec * rec)
+		{
+			if (!rec)
+				return;
+			memlimit_sub(sizeof(t_flightrec) + rec->slots * (sizeof(t_flightrec_entry) + rec->bytes));
+			xfree(rec);
+		}
+
+
+		extern void flightrec_unload(void)
+		{
+			flightrec_destroy(flightrec_global);
+			flightrec_global = NULL;
+		}
+
+
+		static void flightrec_put(t_flightrec * rec, int socket, t_flightrec_dir dir, t_packet const * packet)
+		{
+			t_flightrec_entry * entry;
+			unsigned int len;
+
+			entry = &rec->entries[rec->next];
+			entry->seq = flightrec_seq;
+			entry->when = now;
+			entry->socket = socket;
+			entry->dir = (unsigned char)dir;
+			entry->cls = (unsigned char)packet_get_class(packet);
+			entry->type = packet_get_type(packet);
+			entry->size = packet_get_size(packet);
+
+			len = (entry->size < rec->bytes) ? entry->size : rec->bytes;
+			if (len)
+				std::memcpy(rec->data + rec->next * rec->bytes, packet_get_raw_data_const(packet, 0), len);
+
+			if (++rec->next == rec->slots)
+				rec->next = 0;
+			rec->count++;
+		}
+
+
+		extern void flightrec_record(t_connection * c, t_flightrec_dir dir, t_packet const * packet)
+		{
+			t_flightrec * rec = conn_get_flightrec(c);
+			unsigned int sample = prefs_get_flightrec_sample();
+
+			if (!rec && !sample)
+				return;
+
+			flightrec_seq++;
+			if (rec)
+				flightrec_put(rec, conn_get_socket(c), dir, packet);
+
+			if (sample && flightrec_seq % sample == 0)
+			{
+				if (!flightrec_global)
+					flightrec_global = flightrec_alloc(flightrec_global_slots, prefs_get_flightrec_bytes());
+				flightrec_put(flightrec_global, conn_get_socket(c), dir, packet);
+			}
+		}
+
+
+		static void flightrec_write(std::FILE * fp, t_flightrec const * rec)
+		{
+			t_flightrec_entry const * entry;
+			t_packet * packet;
+			unsigned int n, i, pos, len;
+			char timestr[EVENT_TIME_MAXLEN];
+			struct std::tm * tmwhen;
+			char const * classstr;
+			char const * typestr;
+
+			n = (rec->count < rec->slots) ? (unsigned int)rec->count : rec->slots;
+			pos = (rec->count < rec->slots) ? 0 : rec->next;
+			for (i = 0; i < n; i++, pos = (pos + 1) % rec->slots)
+			{
+				entry = &rec->entries[pos];
+				len = (entry->size < rec->bytes) ? entry->size : rec->bytes;
+				if (!(tmwhen = std::localtime(&entry->when)) || !std::strftime(timestr, sizeof(timestr), EVENT_TIME_FORMAT, tmwhen))
+					std::strcpy(timestr, "?");
+
+				/* the names are only looked up here, from the start that was kept */
+				classstr = typestr = "unknown";
+				if ((packet = packet_create((t_packet_class)entry->cls)))
+				{
+					classstr = packet_get_class_str(packet);
+					if (len && len >= packet_get_header_size(packet))
+					{
+						packet_append_data(packet, rec->data + pos * rec->bytes, len);
+						typestr = packet_get_type_str(packet, (entry->dir == flightrec_dir_recv) ? packet_dir_from_client : packet_dir_from_server);
+					}
+					packet_del_ref(packet);
+				}
+				std::fprintf(fp, "%s #%lu %d: %s class=%s[0x%02x] type=%s[0x%04x] length=%u\n",
+					timestr, entry->seq, entry->socket,
+					(entry->dir == flightrec_dir_recv) ? "recv" : "send",
+					classstr, (unsigned int)entry->cls,
+					typestr, entry->type,
+					entry->size);
+
+				hexdump(fp, rec->data + pos * rec->bytes, len);
+			}
+		}
+
+
+		static void flightrec_write_conn(std::FILE * fp, t_connection * c)
+		{
+			t_flightrec const * rec = conn_get_flightrec(c);
+			char const * user = conn_get_loggeduser(c);
+
+			std::fprintf(fp, "# [%d] %s connection from %s, user %s, last %u of %lu packets\n",
+				conn_get_socket(c), conn_class_get_str(conn_get_class(c)),
+				addr_num_to_addr_str(conn_get_addr(c), conn_get_port(c)),
+				user ? user : "(none)",
+				(rec->count < rec->slots) ? (unsigned int)rec->count : rec->slots, rec->count);
+			flightrec_write(fp, rec);
+		}
+
+
+		static std::FILE * flightrec_open(char const * reason)
+		{
+			std::FILE * fp;
+			char timestr[EVENT_TIME_MAXLEN];
+			struct std::tm * tmnow;
+
+			if (!(fp = std::fopen(prefs_get_flightrec_file(), "a")))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not open file \"{}\" for appending (std::fopen: {})", prefs_get_flightrec_file(), std::strerror(errno));
+				return NULL;
+			}
+
+			if (!(tmnow = std::localtime(&now)) || !std::strftime(timestr, sizeof(timestr), EVENT_TIME_FORMAT, tmnow))
+				std::strcpy(timestr, "?");
+			std::fprintf(fp, "# flight recorder dump at %s: %s\n", timestr, reason);
+
+			return fp;
+		}
+
+
+		static int flightrec_close(std::FILE * fp)
+		{
+			std::fprintf(fp, "# end of dump\n");
+			if (std::fclose(fp) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not close file \"{}\" after writing (std::fclose: {})", prefs_get_flightrec_file(), std::strerror(errno));
+				return -1;
+			}
+			return 0;
+		}
+
+
+		extern int flightrec_dump(t_connection * c, char const * reason)
+		{
+			std::FILE * fp;
+
+			if (!conn_get_flightrec(c))
+				return -1;
+			if (!(fp = flightrec_open(reason)))
+				return -1;
+			flightrec_write_conn(fp, c);
+
+			eventlog(eventlog_level_info, __FUNCTION__, "[{}] dumped packets to \"{}\" ({})", conn_get_socket(c), prefs_get_flightrec_file(), reason);
+			return flightrec_close(fp);
+		}
+
+
+		/*
+		 * For dumps the server triggers itself: a connection is dumped only
+		 * once, and all connections together at most flightrec_auto_dumps
+		 * times a minute, so a flood of bad packets does not become a flood
+		 * of disk writes.
+		 */
+		extern int flightrec_dump_auto(t_connection * c, char const * reason)
+		{
+			t_flightrec * rec = conn_get_flightrec(c);
+			unsigned int rate = prefs_get_flightrec_auto_dumps();
+			std::time_t elapsed;
+
+			if (!rec || rec->dumped)
+				return 0;
+			rec->dumped = 1;
+
+			if (rate)
+			{
+				elapsed = now - flightrec_bucket_time;
+				if (elapsed < 0 || elapsed > 60)
+					elapsed = 60;
+				flightrec_bucket += (unsigned long)elapsed * rate;
+				if (flightrec_bucket > 60UL * rate)
+					flightrec_bucket = 60UL * rate;
+				flightrec_bucket_time = now;
+
+				if (flightrec_bucket < 60)
+				{
+					flightrec_suppressed++;
+					return 0;
+				}
+				flightrec_bucket -= 60;
+			}
+
+			if (flightrec_suppressed)
+			{
+				eventlog(eventlog_level_warn, __FUNCTION__, "suppressed {} automatic dumps, more than {} a minute", flightrec_suppressed, rate);
+				flightrec_suppressed = 0;
+			}
+
+			return flightrec_dump(c, reason);
+		}
+
+
+		extern int flightrec_dump_all(char const * reason)
+		{
+			std::FILE * fp;
+			t_elist * curr;
+			t_connection * c;
+			unsigned int count = 0;
+
+			if (!prefs_get_flightrec_packets() && !flightrec_global)
+				return -1;
+			if (!(fp = flightrec_open(reason)))
+				return -1;
+
+			elist_for_each(curr, connlist())
+			{
+				c = connlist_get_conn(curr);
+				if (!conn_get_flightrec(c))
+					continue;
+				flightrec_write_conn(fp, c);
+				count++;
+			}
+
+			if (flightrec_global)
+			{
+				std::fprintf(fp, "# one in %u packets of all connections, last %u of %lu sampled\n",
+					prefs_get_flightrec_sample(),
+					(flightrec_global->count < flightrec_global->slots) ? (unsigned int)flightrec_global->count : flightrec_global->slots,
+					flightrec_global->count);
+				flightrec_write(fp, flightrec_global);
+			}
+
+			eventlog(eventlog_level_info, __FUNCTION__, "dumped packets of {} connections to \"{}\" ({})", count, prefs_get_flightrec_file(), reason);
+			return flightrec_close(fp);
+		}
+
+	}
+
+}
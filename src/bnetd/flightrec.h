@@ -0,0 +1,100 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef INCLUDED_FLIGHTREC_TYPES
+#define INCLUDED_FLIGHTREC_TYPES
+
+#include <ctime>
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		typedef enum
+		{
+			flightrec_dir_recv,
+			flightrec_dir_send
+		} t_flightrec_dir;
+
+		typedef struct
+		{
+			unsigned long seq;         /* server wide packet number */
+			std::time_t   when;
+			int           socket;
+			unsigned char dir;         /* t_flightrec_dir */
+			unsigned char cls;         /* t_packet_class */
+			unsigned int  type;
+			unsigned int  size;        /* full size, only the start is kept */
+		} t_flightrec_entry;
+
+		/*
+		 * A fixed ring of the last packets of a connection, or of the
+		 * packets sampled from all connections. Recording only copies the
+		 * start of a packet into the ring, nothing is written to disk until
+		 * the ring is dumped.
+		 */
+		typedef struct flightrec
+#ifdef FLIGHTREC_INTERNAL_ACCESS
+		{
+			unsigned int        slots;
+			unsigned int        bytes;   /* kept of every packet */
+			unsigned int        next;
+			unsigned long       count;   /* packets recorded so far */
+			int                 dumped;  /* an automatic dump was done */
+			t_flightrec_entry * entries;
+			char *              data;
+		}
+#endif
+		t_flightrec;
+
+	}
+
+}
+
+#endif
+
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_FLIGHTREC_PROTOS
+#define INCLUDED_FLIGHTREC_PROTOS
+
+#define JUST_NEED_TYPES
+#include "connection.h"
+#include "common/packet.h"
+#undef JUST_NEED_TYPES
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		extern t_flightrec * flightrec_create(void);
+		extern void flightrec_destroy(t_flightrec * rec);
+		extern void flightrec_unload(void);
+		extern void flightrec_record(t_connection * c, t_flightrec_dir dir, t_packet const * packet);
+		extern int flightrec_dump(t_connection * c, char const * reason);
+		extern int flightrec_dump_auto(t_connection * c, char const * reason);
+		extern int flightrec_dump_all(char const * reason);
+
+	}
+
+}
+
+#endif
+#endif
@@ -77,6 +77,7 @@
 #include "autoupdate.h"
 #include "anongame.h"
 #include "i18n.h"
+#include "flightrec.h"
 #ifdef WIN32_GUI
 #include <win32/winmain.h>
 #endif
@@ -306,9 +307,11 @@ namespace pvpgn
 				switch (handle(bnet_htable_con, packet_get_type(packet), c, packet)) {
 				case 1:
 					eventlog(eventlog_level_error, __FUNCTION__, "[{}] unknown (unlogged in) bnet packet type 0x{:04x}, len {}", conn_get_socket(c), packet_get_type(packet), packet_get_size(packet));
+					flightrec_dump_auto(c, "unknown packet");
 					break;
 				case -1:
 					eventlog(eventlog_level_error, __FUNCTION__, "[{}] (unlogged in) got error handling packet type 0x{:04x}, len {}", conn_get_socket(c), packet_get_type(packet), packet_get_size(packet));
+					flightrec_dump_auto(c, "error handling packet");
 					break;
 				};
 				break;
@@ -317,15 +320,18 @@ namespace pvpgn
 				switch (handle(bnet_htable_log, packet_get_type(packet), c, packet)) {
 				case 1:
 					eventlog(eventlog_level_error, __FUNCTION__, "[{}] unknown (logged in) bnet packet type 0x{:04x}, len {}", conn_get_socket(c), packet_get_type(packet), packet_get_size(packet));
+					flightrec_dump_auto(c, "unknown packet");
 					break;
 				case -1:
 					eventlog(eventlog_level_error, __FUNCTION__, "[{}] (logged in) got error handling packet type 0x{:04x}, len {}", conn_get_socket(c), packet_get_type(packet), packet_get_size(packet));
+					flightrec_dump_auto(c, "error handling packet");
 					break;
 				};
 				break;
 
 			case conn_state_untrusted:
 				eventlog(eventlog_level_error, __FUNCTION__, "[{}] unknown (untrusted) bnet packet type 0x{:04x}, len {}", conn_get_socket(c), packet_get_type(packet), packet_get_size(packet));
+				flightrec_dump_auto(c, "unknown packet");
 				break;
 
 			default:
@@ -3159,7 +3165,7 @@ namespace pvpgn
 					return -1;
 				}
 
-				if ((realm = realmlist_find_realm(realmname))) {
+				if ((realm = realmlist_find_realm(realmname)) && realm_get_active(realm)) {
 					unsigned int salt;
 					struct {
 						bn_int salt;
@@ -3179,6 +3185,7 @@ namespace pvpgn
 						if (prev_realm != realm) {
 							realm_add_player_number(realm, 1);
 							realm_add_player_number(prev_realm, -1);
+							realm_move_player(prev_realm, c, 0, 0);
 							conn_set_realm(c, realm);
 						}
 					}
@@ -3206,9 +3213,16 @@ namespace pvpgn
 								bn_int_set(&rpacket->u.server_realmjoinreply_109.bncs_addr1, 0x0);
 								bn_int_set(&rpacket->u.server_realmjoinreply_109.sessionnum, conn_get_sessionnum(c));
 								{	/* trans support */
-									unsigned int addr = realm_get_ip(realm);
-									unsigned short port = realm_get_port(realm);
-
+									unsigned int addr = conn_get_d2cs_ip(c);
+									unsigned short port = conn_get_d2cs_port(c);
+
+									/* a new session goes back to the d2cs the account last played on */
+									if (!addr)
+										account_get_realm_d2cs(conn_get_account(c), realm_get_name(realm), &addr, &port);
+									if (realm_select_server(realm, &addr, &port) == 0) {
+										realm_move_player(realm, c, addr, port);
+										account_set_realm_d2cs(conn_get_account(c), realm_get_name(realm), addr, port);
+									}
 									trans_net(conn_get_addr(c), &addr, &port);
 
 									bn_int_nset(&rpacket->u.server_realmjoinreply_109.addr, addr);
@@ -3615,10 +3629,10 @@ namespace pvpgn
 				packet_set_type(rpacket, SERVER_CHANNELLIST);
 				{
 					t_channel *ch;
-					t_elem const *curr;
+					t_elist *curr;
 
-					LIST_TRAVERSE_CONST(channellist(), curr) {
-						ch = (t_channel*)elem_get_data(curr);
+					elist_for_each(curr, channellist()) {
+						ch = channellist_get_channel(curr);
 						if ((!(channel_get_flags(ch) & channel_flags_clan)) && (!prefs_get_hide_temp_channels() || channel_get_permanent(ch)) && (!channel_get_clienttag(ch) || channel_get_clienttag(ch) == conn_get_clienttag(c)) && (!(channel_get_flags(ch) & channel_flags_thevoid)) &&	// don't display theVoid in channel list
 							((channel_get_max(ch) != 0) || ((channel_get_max(ch) == 0) && (account_is_operator_or_admin(conn_get_account(c), channel_get_name(ch)) == 1))))	// don't display restricted channel for no admins/ops
 							packet_append_string(rpacket, channel_get_name(ch));
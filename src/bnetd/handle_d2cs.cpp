@@ -20,6 +20,7 @@
 
 #include <cstring>
 #include <cstdio>
+#include <string>
 
 #include "compat/strcasecmp.h"
 #include "common/eventlog.h"
@@ -106,6 +107,8 @@ namespace pvpgn
 			unsigned int	try_version;
 			unsigned int	reply;
 			char const	* realmname;
+			char const	* servaddr;
+			unsigned short	port = 0;
 			t_realm		* realm;
 
 			if (packet_get_size(packet) < sizeof(t_d2cs_bnetd_authreply)) {
@@ -116,6 +119,16 @@ namespace pvpgn
 				eventlog(eventlog_level_error, __FUNCTION__, "got bad realmname");
 				return -1;
 			}
+			/* newer d2cs also send the address they listen on */
+			if ((servaddr = packet_get_str_const(packet, sizeof(t_d2cs_bnetd_authreply) + std::strlen(realmname) + 1, MAX_SERVADDRS_STR))) {
+				std::string first(servaddr, std::strcspn(servaddr, ","));
+				t_addr * addr;
+
+				if ((addr = addr_create_str(first.c_str(), 0, BNETD_REALM_PORT))) {
+					port = addr_get_port(addr);
+					addr_destroy(addr);
+				}
+			}
 			if (!(realm = realmlist_find_realm(realmname))) {
 				realm = realmlist_find_realm_by_ip(conn_get_addr(c)); /* should not fail - checked in handle_init_packet() handle_init.c */
 				eventlog(eventlog_level_warn, __FUNCTION__, "warn: realm name mismatch {} {}", realm_get_name(realm), realmname);
@@ -144,7 +157,7 @@ namespace pvpgn
 				eventlog(eventlog_level_info, __FUNCTION__, "d2cs {} authed",
 					addr_num_to_ip_str(conn_get_addr(c)));
 				conn_set_state(c, conn_state_loggedin);
-				realm_active(realm, c);
+				realm_active(realm, c, port);
 			}
 			else {
 				eventlog(eventlog_level_error, __FUNCTION__, "failed to auth d2cs {}",
@@ -257,6 +270,8 @@ namespace pvpgn
 			char const *	clienttag;
 			char *	temp;
 			unsigned int	sessionnum;
+			unsigned int	ip;
+			unsigned short	port;
 			t_realm * 	realm;
 			char const *	realmname;
 			unsigned int	pos, reply;
@@ -301,6 +316,12 @@ namespace pvpgn
 				std::sprintf(temp, "%4s%s,%s,%s", revtag, realmname, charname, portrait);
 				conn_set_charname(client, charname);
 				conn_set_realminfo(client, temp);
+				/* the character is on the d2cs it logged in through, the next
+				 * session of the account goes back there */
+				if (realm_get_server_addr(realm, c, &ip, &port) == 0) {
+					realm_move_player(realm, client, ip, port);
+					account_set_realm_d2cs(conn_get_account(client), realmname, ip, port);
+				}
 				xfree(temp);
 				eventlog(eventlog_level_debug, __FUNCTION__,
 					"loaded portrait for character {}", charname);
@@ -339,6 +360,7 @@ namespace pvpgn
 			t_packet	* packet;
 			t_game		* game;
 			t_realm		* realm;
+			t_connection	* d2cs;
 
 			if (!(c))
 			{
@@ -364,7 +386,8 @@ namespace pvpgn
 				packet_set_type(packet, BNETD_D2CS_GAMEINFOREQ);
 				bn_int_set(&packet->u.bnetd_d2cs_gameinforeq.h.seqno, 0);
 				packet_append_string(packet, game_get_name(game));
-				conn_push_outqueue(realm_get_conn(realm), packet);
+				if ((d2cs = realm_get_conn(realm, conn_get_d2cs_ip(c), conn_get_d2cs_port(c))))
+					conn_push_outqueue(d2cs, packet);
 				packet_del_ref(packet);
 			}
 			return 0;
@@ -106,7 +106,7 @@ namespace pvpgn
 				{
 					char rawname[MAX_FILENAME_STR] = {};
 
-					psock_recv(conn_get_socket(c), rawname, MAX_FILENAME_STR, 0);
+					fdwatch_recv(conn_get_fdw_idx(c), rawname, MAX_FILENAME_STR);
 					file_send(c, rawname, 0, 0, 0, 1);
 				}
 					break;
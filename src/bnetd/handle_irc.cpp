@@ -438,11 +438,11 @@ namespace pvpgn
 
 			if (numparams == 0)
 			{
-				t_elem const * curr;
+				t_elist * curr;
 				class_topic Topic;
-				LIST_TRAVERSE_CONST(channellist(), curr)
+				elist_for_each(curr, channellist())
 				{
-					t_channel const * channel = (const t_channel*)elem_get_data(curr);
+					t_channel const * channel = channellist_get_channel(curr);
 					char const * tempname = irc_convert_channel(channel, conn);
 					std::string topicstr = Topic.get(channel_get_name(channel));
 
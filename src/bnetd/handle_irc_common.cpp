@@ -257,9 +257,8 @@ namespace pvpgn
 				if ((conn_get_class(conn) != conn_class_wserv) &&
 					(conn_get_class(conn) != conn_class_wladder)) {
 
-					t_timer_data temp;
-					temp.n = prefs_get_irc_latency();
-					conn_test_latency(conn, std::time(NULL), temp);
+					conn_test_latency(conn);
+					conn_keepalive_start(conn, prefs_get_irc_latency(), 0);
 				}
 			}
 
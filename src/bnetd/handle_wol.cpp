@@ -552,7 +552,7 @@ namespace pvpgn
 		static int _handle_list_command(t_connection * conn, int numparams, char ** params, char * text)
 		{
 			char temp[MAX_IRC_MESSAGE_LEN];
-			t_elem const * curr;
+			t_elist * curr;
 
 			irc_send(conn, RPL_LISTSTART, "Channel :Users Names"); /* backward compatibility */
 
@@ -564,8 +564,8 @@ namespace pvpgn
 				 * DUNE 2000 use params[0] to determine channels by channeltype
 				 */
 
-				LIST_TRAVERSE_CONST(channellist(), curr) {
-					t_channel const * channel = (const t_channel*)elem_get_data(curr);
+				elist_for_each(curr, channellist()) {
+					t_channel const * channel = channellist_get_channel(curr);
 					char const * tempname;
 
 					tempname = irc_convert_channel(channel, conn);
@@ -27,6 +27,8 @@
 #include "common/eventlog.h"
 #include "common/tag.h"
 #include "common/bn_type.h"
+#include "common/tlv.h"
+#include "common/xalloc.h"
 
 #include "connection.h"
 #include "game.h"
@@ -593,17 +595,24 @@ namespace pvpgn
 			{ 1, NULL }
 		};
 
+		static t_tlv_index wol_gameres_index;
+		static bool wol_gameres_index_ready = false;
+
 		static int handle_wolgameres_tag(t_wol_gameres_result * game_result, t_tag gamerestag, wol_gameres_type type, int size, void const * data)
 		{
-			t_wol_gamerestag_table_row const *p;
+			int row;
 
-			for (p = wol_gamreres_htable; p->wol_gamerestag_uint != 1; p++) {
-				if (gamerestag == p->wol_gamerestag_uint) {
-					if (p->wol_gamerestag_handler != NULL)
-						return ((p->wol_gamerestag_handler)(game_result, type, size, data));
-				}
+			if (!wol_gameres_index_ready) {
+				if (tlv_index_init(&wol_gameres_index, wol_gamreres_htable, sizeof(wol_gamreres_htable) / sizeof(*wol_gamreres_htable) - 1, sizeof(*wol_gamreres_htable)) < 0)
+					return -1;
+				wol_gameres_index_ready = true;
 			}
-			return -1;
+
+			if ((row = tlv_index_find(&wol_gameres_index, gamerestag)) < 0)
+				return -1;
+			if (wol_gamreres_htable[row].wol_gamerestag_handler == NULL)
+				return -1;
+			return ((wol_gamreres_htable[row].wol_gamerestag_handler)(game_result, type, size, data));
 		}
 
 		static wol_gameres_type wol_gameres_type_from_int(int type)
@@ -627,165 +636,141 @@ namespace pvpgn
 			}
 		}
 
+		/* the handlers read a value of its type without looking at the length */
+		static bool wol_gameres_item_fits(wol_gameres_type type, t_tlv_item const * item)
+		{
+			switch (type) {
+			case wol_gameres_type_bool:
+			case wol_gameres_type_byte:
+				return item->size >= 1;
+			case wol_gameres_type_int:
+			case wol_gameres_type_time:
+				return item->size >= 4;
+			case wol_gameres_type_string:
+				return item->size >= 1 && std::memchr(item->data, '\0', item->size) != NULL;
+			default:
+				return true;
+			}
+		}
+
 		static unsigned long wol_gameres_get_long_from_data(int size, const void * data)
 		{
 			unsigned int temp = 0;
 			const char * chdata;
-			int i = 0;
+			int i;
 
 			if (!data) {
 				ERROR0("got NULL data");
 				return 0;
 			}
 
-			if (size < 4)
-				return 0;
-
 			chdata = (const char*)data;
 
-			while (i < size) {
-				temp = temp + (unsigned int)bn_int_nget(*((bn_int *)chdata));
-				i += 4;
-				if (i < size) {
-					*(chdata++);
-					*(chdata++);
-					*(chdata++);
-					*(chdata++);
-				}
-			}
+			for (i = 0; i + 4 <= size; i += 4)
+				temp = temp + (unsigned int)bn_int_nget(*((bn_int *)(chdata + i)));
 
 			return temp;
 		}
 
-		static t_wol_gameres_result * gameres_result_create()
+		/* the results array is the only allocation of a report, the game keeps it once it is reported */
+		static void gameres_result_cleanup(t_wol_gameres_result * gameres_result)
 		{
-			t_wol_gameres_result * gameres_result;
-
-			gameres_result = (t_wol_gameres_result*)xmalloc(sizeof(t_wol_gameres_result));
-
-			gameres_result->game = NULL;
+			if (gameres_result->results)
+				xfree((void *)gameres_result->results);
 			gameres_result->results = NULL;
-			gameres_result->senderid = -1;
-			gameres_result->myaccount = NULL;
-
-			return gameres_result;
-		}
-
-		static int gameres_result_destroy(t_wol_gameres_result * gameres_result)
-		{
-			if (!gameres_result) {
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL gameres_result");
-				return -1;
-			}
-
-			eventlog(eventlog_level_info, __FUNCTION__, "destroying gameres_result");
-
-			xfree(gameres_result);
-
-			return 0;
 		}
 
 		extern int handle_wol_gameres_packet(t_connection * c, t_packet const * const packet)
 		{
-			unsigned offset;
-			t_tag wgtag;
+			t_tlv_reader reader;
+			t_tlv_item item;
+			bn_int const * rngd;
 			char wgtag_str[5];
-			unsigned datatype;
-			unsigned datalen;
-			void const * data;
 			wol_gameres_type type;
-			t_wol_gameres_result * gameres_result;
+			t_wol_gameres_result gameres_result;
+			int ret;
 
 			DEBUG2("[{}] got WOL Gameres packet length {}", conn_get_socket(c), packet_get_size(packet));
-			offset = sizeof(t_wolgameres_header);
 
-			if ((unsigned int)bn_int_nget(*((bn_int *)packet_get_data_const(packet, offset, 4))) == 0)
-				offset += 4; /* Just trying to get RNGD working */
+			if (packet_get_size(packet) <= sizeof(t_wolgameres_header)) {
+				eventlog(eventlog_level_error, __FUNCTION__, "[{}] got bad WOL Gameres packet (no tags)", conn_get_socket(c));
+				return -1;
+			}
+			tlv_reader_init(&reader, packet_get_raw_data_const(packet, sizeof(t_wolgameres_header)), packet_get_size(packet) - sizeof(t_wolgameres_header));
 
-			gameres_result = gameres_result_create();
+			if ((rngd = (bn_int const *)tlv_reader_peek(&reader, 4)) && bn_int_nget(*rngd) == 0)
+				tlv_reader_take(&reader, 4); /* Just trying to get RNGD working */
 
-			while (offset < packet_get_size(packet)) {
-				if (packet_get_size(packet) < offset + 4) {
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] got bad WOL Gameres packet (missing tag)", conn_get_socket(c));
-					return -1;
-				}
-				wgtag = (unsigned int)bn_int_nget(*((bn_int *)packet_get_data_const(packet, offset, 4)));
-				offset += 4;
+			gameres_result.game = NULL;
+			gameres_result.results = NULL;
+			gameres_result.senderid = -1;
+			gameres_result.myaccount = NULL;
+			gameres_result.otheraccount = NULL;
 
-				if (packet_get_size(packet) < offset + 2) {
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] got bad WOL Gameres packet (missing datatype)", conn_get_socket(c));
-					return -1;
-				}
-				datatype = (unsigned int)bn_short_nget(*((bn_short *)packet_get_data_const(packet, offset, 2)));
-				offset += 2;
+			while ((ret = tlv_reader_next(&reader, &item)) > 0) {
+				type = wol_gameres_type_from_int(item.type);
 
-				if (packet_get_size(packet) < offset + 2) {
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] got bad WOL Gameres packet (missing datalen)", conn_get_socket(c));
-					return -1;
+				if (!wol_gameres_item_fits(type, &item)) {
+					tag_uint_to_str(wgtag_str, item.tag);
+					eventlog(eventlog_level_warn, __FUNCTION__, "[{}] got WOL Gameres tag {} with data type {} and too short data length {}", conn_get_socket(c), wgtag_str, item.type, item.size);
+					continue;
 				}
-				datalen = (unsigned int)bn_short_nget(*((bn_short *)packet_get_data_const(packet, offset, 2)));
-				offset += 2;
 
-				if (packet_get_size(packet) < offset + 1) {
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] got bad WOL Gameres packet (missing data)", conn_get_socket(c));
-					return -1;
-				}
-				data = packet_get_data_const(packet, offset, 1);
-
-				type = wol_gameres_type_from_int(datatype);
-
-				if (handle_wolgameres_tag(gameres_result, wgtag, type, datalen, data) != 0) {
+				if (handle_wolgameres_tag(&gameres_result, item.tag, type, item.size, item.data) != 0) {
 					char ch_data[255]; /* FIXME: this is not so good */
-					tag_uint_to_str(wgtag_str, wgtag);
+					tag_uint_to_str(wgtag_str, item.tag);
 
 					switch (type) {
 					case wol_gameres_type_bool:
 					case wol_gameres_type_byte:
-						std::snprintf(ch_data, sizeof(ch_data), "%" PRIu8, bn_byte_get(*((bn_byte *)data)));
+						std::snprintf(ch_data, sizeof(ch_data), "%" PRIu8, bn_byte_get(*((bn_byte *)item.data)));
 						break;
 					case wol_gameres_type_int:
 					case wol_gameres_type_time:
-						std::snprintf(ch_data, sizeof(ch_data), "%" PRIu32, bn_int_nget(*((bn_int *)data)));
+						std::snprintf(ch_data, sizeof(ch_data), "%" PRIu32, bn_int_nget(*((bn_int *)item.data)));
 						break;
 					case wol_gameres_type_string:
-						std::snprintf(ch_data, sizeof(ch_data), "%s", (char*)data);
+						std::snprintf(ch_data, sizeof(ch_data), "%s", (char*)item.data);
 						break;
 					case wol_gameres_type_bigint:
-						std::snprintf(ch_data, sizeof(ch_data), "%lu", wol_gameres_get_long_from_data(datalen, data));
+						std::snprintf(ch_data, sizeof(ch_data), "%lu", wol_gameres_get_long_from_data(item.size, item.data));
 						break;
 					default:
 						std::snprintf(ch_data, sizeof(ch_data), "UNKNOWN");
 						break;
 					}
-					eventlog(eventlog_level_warn, __FUNCTION__, "[{}] got unknown WOL Gameres tag: {}, data type {}, data lent {}, data {}", conn_get_socket(c), wgtag_str, datatype, datalen, ch_data);
+					eventlog(eventlog_level_warn, __FUNCTION__, "[{}] got unknown WOL Gameres tag: {}, data type {}, data lent {}, data {}", conn_get_socket(c), wgtag_str, item.type, item.size, ch_data);
 
 				}
+			}
 
-				datalen = 4 * ((datalen + 3) / 4);
-				offset += datalen;
+			if (ret < 0) {
+				eventlog(eventlog_level_error, __FUNCTION__, "[{}] got bad WOL Gameres packet (truncated tag)", conn_get_socket(c));
+				gameres_result_cleanup(&gameres_result);
+				return -1;
 			}
 
-			if (!(gameres_result->game)) {
+			if (!(gameres_result.game)) {
 				ERROR0("game not found (game == NULL)");
+				gameres_result_cleanup(&gameres_result);
 				return -1;
 			}
-			if (!(gameres_result->myaccount)) {
+			if (!(gameres_result.myaccount)) {
 				ERROR0("have not account of sender");
+				gameres_result_cleanup(&gameres_result);
 				return -1;
 			}
-			if (!(gameres_result->results)) {
+			if (!(gameres_result.results)) {
 				ERROR0("have not results of game");
 				return -1;
 			}
 
-			game_set_report(gameres_result->game, gameres_result->myaccount, "head", "body");
+			game_set_report(gameres_result.game, gameres_result.myaccount, "head", "body");
 
-			if (game_set_reported_results(gameres_result->game, gameres_result->myaccount, gameres_result->results) < 0)
-				xfree((void *)gameres_result->results);
+			if (game_set_reported_results(gameres_result.game, gameres_result.myaccount, gameres_result.results) < 0)
+				gameres_result_cleanup(&gameres_result);
 
-			conn_set_game(account_get_conn(gameres_result->myaccount), NULL, NULL, NULL, game_type_none, 0);
-
-			gameres_result_destroy(gameres_result);
+			conn_set_game(account_get_conn(gameres_result.myaccount), NULL, NULL, NULL, game_type_none, 0);
 
 			return 0;
 		}
@@ -839,6 +824,8 @@ namespace pvpgn
 			if ((gameidnumber) && (game = gamelist_find_game_byid(gameidnumber))) { //&& (game_get_status(game) & game_status_started)) {
 				DEBUG2("found started game \"{}\" for gameid {}", game_get_name(game), gameidnumber);
 				game_result->game = game;
+				if (game_result->results)
+					xfree((void *)game_result->results);
 				game_result->results = (t_game_result*)xmalloc(sizeof(t_game_result)* game_get_count(game));
 			}
 
@@ -2109,7 +2096,13 @@ namespace pvpgn
 		static int _cl_nam_general(t_wol_gameres_result * game_result, int num, wol_gameres_type type, int size, void const * data)
 		{
 			int senderid = game_result->senderid;
-			t_account * account = accountlist_find_account((char const *)data);
+			t_account * account;
+
+			if (type != wol_gameres_type_string) {
+				WARN2("got unknown gameres type {} for NAM{}", static_cast<int>(type), num);
+				return 0;
+			}
+			account = accountlist_find_account((char const *)data);
 
 			DEBUG2("Name of player {}: {}", num, static_cast<const char*>(data));
 
@@ -2422,6 +2415,10 @@ namespace pvpgn
 			for (; i < game_get_count(game); i++) {
 				if (game_get_player(game, i) == other_account) break;
 			}
+			if (i == game_get_count(game)) {
+				WARN1("player {} of the results is not in the game", num);
+				return 0;
+			}
 
 			switch (resultnum) {
 			case 1:
@@ -91,12 +91,13 @@ namespace pvpgn
 			try
 			{
 				t_gamelang lang;
-				const char *format = fmt::to_string(format_str).c_str();
+				const std::string original = fmt::to_string(format_str);
+				const char *format = original.c_str();
 				if (lang = conn_get_gamelang_localized(c))
 				{
-					if (!(format = _find_string(fmt::to_string(format_str).c_str(), lang)))
+					if (!(format = _find_string(original.c_str(), lang)))
 					{
-						format = fmt::to_string(format_str).c_str(); // if not found use original
+						format = original.c_str(); // if not found use original
 					}
 				}
 
@@ -52,7 +52,6 @@
 #include "tick.h"
 #include "handle_irc.h"
 #include "handle_wol.h"
-#include "command_groups.h"
 #include "topic.h"
 #include "clan.h"
 #include "command.h"
@@ -534,7 +533,29 @@ namespace pvpgn
 			return msg;
 		}
 
-		extern int irc_message_postformat(t_packet * packet, t_connection const * dest)
+		/*
+		 * The packet made by irc_message_format() holds the four fields of the
+		 * line separated by newlines and is shared by all recipients. An empty
+		 * target field is filled in with the name of the recipient, so such a
+		 * message can only be sent to the one it was formatted for.
+		 */
+		extern int irc_message_needs_dest(t_packet const * packet)
+		{
+			char const * e3;
+
+			if (!packet) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL packet");
+				return -1;
+			}
+
+			e3 = (char const *)packet_get_raw_data_const(packet, 0);
+			if (!(e3 = std::strchr(e3, '\n')) || !(e3 = std::strchr(e3 + 1, '\n')))
+				return 0; /* malformed, postformat complains */
+			return e3[1] == '\n';
+		}
+
+		/* builds the line sent to dest from the shared packet, which stays untouched */
+		extern t_packet * irc_message_postformat(t_packet const * packet, t_connection const * dest, int hide_addr)
 		{
 			/* the four elements */
 			char * e1;
@@ -542,40 +563,46 @@ namespace pvpgn
 			char * e2;
 			char * e3;
 			char * e4;
+			char * fields;
 			char const * tname = NULL;
 			char const * toname = "AUTH"; /* fallback name */
 			const char * temp;
+			t_packet * rpacket = NULL;
 
 			if (!packet) {
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL packet");
-				return -1;
+				return NULL;
 			}
 			if (!dest) {
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL dest");
-				return -1;
+				return NULL;
 			}
 
-			e1 = (char*)packet_get_raw_data(packet, 0);
+			fields = xstrdup((char const *)packet_get_raw_data_const(packet, 0));
+			e1 = fields;
 			e2 = std::strchr(e1, '\n');
 			if (!e2) {
 				eventlog(eventlog_level_warn, __FUNCTION__, "malformed message (e2 missing)");
-				return -1;
+				xfree(fields);
+				return NULL;
 			}
 			*e2++ = '\0';
 			e3 = std::strchr(e2, '\n');
 			if (!e3) {
 				eventlog(eventlog_level_warn, __FUNCTION__, "malformed message (e3 missing)");
-				return -1;
+				xfree(fields);
+				return NULL;
 			}
 			*e3++ = '\0';
 			e4 = std::strchr(e3, '\n');
 			if (!e4) {
 				eventlog(eventlog_level_warn, __FUNCTION__, "malformed message (e4 missing)");
-				return -1;
+				xfree(fields);
+				return NULL;
 			}
 			*e4++ = '\0';
 
-			if (prefs_get_hide_addr() && !(account_get_command_groups(conn_get_account(dest)) & command_get_group("/admin-addr")))
+			if (hide_addr)
 			{
 				e1_2 = std::strchr(e1, '@');
 				if (e1_2)
@@ -611,22 +638,22 @@ namespace pvpgn
 				DEBUG2("[{}] sent \"{}\"", conn_get_socket(dest), msg);
 				std::strcat(msg, "\r\n");
 
-				packet_set_size(packet, 0);
-				packet_append_data(packet, msg, std::strlen(msg));
-				if (tname)
-					conn_unget_chatname(dest, tname);
-				return 0;
+				if ((rpacket = packet_create(packet_class_raw)))
+					packet_append_data(rpacket, msg, std::strlen(msg));
+				else
+					eventlog(eventlog_level_error, __FUNCTION__, "could not create packet");
 			}
 			else {
 				/* FIXME: split up message? */
 				eventlog(eventlog_level_warn, __FUNCTION__, "maximum IRC message length exceeded");
-				if (tname)
-					conn_unget_chatname(dest, tname);
-				return -1;
 			}
+			if (tname)
+				conn_unget_chatname(dest, tname);
+			xfree(fields);
+			return rpacket;
 		}
 
-		extern int irc_message_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags)
+		extern int irc_message_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags)
 		{
 			char * msg;
 			char const * ctag;
@@ -701,6 +728,10 @@ namespace pvpgn
 											 from.nick = conn_get_chatname(me);
 											 from.host = addr_num_to_ip_str(conn_get_addr(me));
 										 }
+										 else if (srcname) {
+											 from.nick = srcname;
+											 from.host = server_get_hostname();
+										 }
 										 else {
 											 from.nick = server_get_hostname();
 											 from.host = server_get_hostname();
@@ -708,7 +739,7 @@ namespace pvpgn
 										 from.user = ctag;
 
 										 if (type == message_type_talk)
-											 dest = irc_convert_channel(conn_get_channel(me), dst); /* FIXME: support more channels and choose right one! */
+											 dest = irc_convert_channel(conn_get_channel(me ? me : dst), dst); /* FIXME: support more channels and choose right one! */
 										 else
 											 dest = ""; /* will be replaced with username in postformat */
 
@@ -1076,10 +1107,10 @@ namespace pvpgn
 				std::sprintf(temp, "%.32s :End of NAMES list", ircname);
 			}
 			else {
-				t_elem const * curr;
-				LIST_TRAVERSE_CONST(channellist(), curr)
+				t_elist * curr;
+				elist_for_each(curr, channellist())
 				{
-					channel = (t_channel*)elem_get_data(curr);
+					channel = channellist_get_channel(curr);
 					irc_send_rpl_namreply_internal(c, channel);
 				}
 				std::sprintf(temp, "* :End of NAMES list");
@@ -47,8 +47,9 @@ namespace pvpgn
 		extern char ** irc_get_ladderelems(char * list);
 		extern int irc_unget_ladderelems(char ** elems);
 		extern int irc_unget_paramelems(char ** elems);
-		extern int irc_message_postformat(t_packet * packet, t_connection const * dest);
-		extern int irc_message_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags);
+		extern int irc_message_needs_dest(t_packet const * packet);
+		extern t_packet * irc_message_postformat(t_packet const * packet, t_connection const * dest, int hide_addr);
+		extern int irc_message_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags);
 		extern int irc_send_rpl_namreply(t_connection * c, t_channel const * channel);
 		extern int irc_who(t_connection * c, char const * name);
 		extern int irc_send_motd(t_connection * conn);
@@ -50,6 +50,7 @@
 #include "i18n.h"
 
 #include "luawrapper.h"
+#include "luainterface.h"
 #include "luaobjects.h"
 
 #include "common/setup_after.h"
@@ -538,10 +539,10 @@ namespace pvpgn
 				}
 				else
 				{
-					t_elem const * curr;
-					LIST_TRAVERSE_CONST(connlist(), curr)
+					t_elist * curr;
+					elist_for_each(curr, connlist())
 					{
-						if (conn = (t_connection*)elem_get_data(curr))
+						if (conn = connlist_get_conn(curr))
 						if (account = conn_get_account(conn))
 							users.push_back(get_account_object(account));
 					}
@@ -596,10 +597,10 @@ namespace pvpgn
 			{
 				lua::stack st(L);
 
-				t_elem *   curr;
-				LIST_TRAVERSE(channellist(), curr)
+				t_elist *  curr;
+				elist_for_each(curr, channellist())
 				{
-					if (channel = (t_channel*)elem_get_data(curr))
+					if (channel = channellist_get_channel(curr))
 						channels.push_back(get_channel_object(channel));
 				}
 				st.push(channels);
@@ -642,6 +643,35 @@ namespace pvpgn
 			return 1;
 		}
 
+		/* Limit a command or channel handler to some names, nil passes all */
+		extern int __subscribe(lua_State* L)
+		{
+			char const * handler;
+			std::vector<std::string> names;
+			try
+			{
+				lua::stack st(L);
+				// get args
+				st.at(1, handler);
+				if (lua_istable(L, 2))
+				{
+					st.at(2, names);
+					lua_subscribe(handler, &names);
+				}
+				else
+					lua_subscribe(handler, NULL);
+			}
+			catch (const std::exception& e)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "{}", e.what());
+			}
+			catch (...)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
+			}
+			return 0;
+		}
+
 		/* Get customicon rank by rating */
 		extern int __icon_get_rank(lua_State* L)
 		{
@@ -848,6 +878,117 @@ namespace pvpgn
 			}
 			return 1;
 		}
+
+		/* Start a timer of the given seconds and return its id, 0 seconds is the next main loop iteration */
+		extern int __timer_start(lua_State* L)
+		{
+			int seconds;
+			unsigned int id = 0;
+			try
+			{
+				lua::stack st(L);
+				// get args
+				st.at(1, seconds);
+
+				id = lua_timer_start((seconds > 0) ? (unsigned int)seconds : 0);
+				st.push(id);
+			}
+			catch (const std::exception& e)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "{}", e.what());
+			}
+			catch (...)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
+			}
+			return 1;
+		}
+
+		/* Get the ids of the accounts online, to get them one at a time with account_get_by_id() */
+		extern int __server_get_user_ids(lua_State* L)
+		{
+			std::vector<unsigned int> ids;
+			t_connection * conn;
+			t_account * account;
+			try
+			{
+				lua::stack st(L);
+
+				t_elist * curr;
+				elist_for_each(curr, connlist())
+				{
+					if (conn = connlist_get_conn(curr))
+					if (account = conn_get_account(conn))
+						ids.push_back(account_get_uid(account));
+				}
+				st.push(ids);
+			}
+			catch (const std::exception& e)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "{}", e.what());
+			}
+			catch (...)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
+			}
+			return 1;
+		}
+
+		/* Get the game ids, to get them one at a time with game_get_by_id() */
+		extern int __server_get_game_ids(lua_State* L)
+		{
+			std::vector<unsigned int> ids;
+			t_game * game;
+			try
+			{
+				lua::stack st(L);
+
+				t_elist * curr;
+				elist_for_each(curr, gamelist())
+				{
+					if (game = elist_entry(curr, t_game, glist_link))
+						ids.push_back(game_get_id(game));
+				}
+				st.push(ids);
+			}
+			catch (const std::exception& e)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "{}", e.what());
+			}
+			catch (...)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
+			}
+			return 1;
+		}
+
+		/* Get the channel ids, to get them one at a time with channel_get_by_id() */
+		extern int __server_get_channel_ids(lua_State* L)
+		{
+			std::vector<unsigned int> ids;
+			t_channel * channel;
+			try
+			{
+				lua::stack st(L);
+
+				t_elist * curr;
+				elist_for_each(curr, channellist())
+				{
+					if (channel = channellist_get_channel(curr))
+						ids.push_back(channel_get_channelid(channel));
+				}
+				st.push(ids);
+			}
+			catch (const std::exception& e)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "{}", e.what());
+			}
+			catch (...)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
+			}
+			return 1;
+		}
 	}
 }
 #endif
\ No newline at end of file
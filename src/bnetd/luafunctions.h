@@ -57,11 +57,17 @@ namespace pvpgn
 		extern int __client_requiredwork(lua_State* L);
 
 		extern int __command_get_group(lua_State* L);
+		extern int __subscribe(lua_State* L);
 		extern int __icon_get_rank(lua_State* L);
 		extern int __describe_command(lua_State* L);
 		extern int __messagebox_show(lua_State* L);
 
 		extern int __localize(lua_State* L);
+
+		extern int __timer_start(lua_State* L);
+		extern int __server_get_user_ids(lua_State* L);
+		extern int __server_get_game_ids(lua_State* L);
+		extern int __server_get_channel_ids(lua_State* L);
 	}
 
 }
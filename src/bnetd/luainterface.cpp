@@ -45,6 +45,8 @@
 #include "friends.h"
 #include "clan.h"
 #include "prefs.h"
+#include "server.h"
+#include "slowlog.h"
 
 
 #include "luawrapper.h"
@@ -68,6 +70,60 @@ namespace pvpgn
 
 
 		void _register_functions();
+		void _load_subscriptions();
+
+		/*
+		 * Timers of the scripts, see lua/include/async.lua. The ids are never
+		 * reused, so a timer set before a rehash finds nobody waiting for it
+		 * in the new scripts.
+		 */
+		static unsigned int lua_timer_lastid = 0;
+		static std::vector<unsigned int> lua_timers_ready;
+
+
+		/*
+		 * Which handlers the loaded scripts define, looked up once at load so
+		 * an event without a handler costs a flag test. Command and channel
+		 * handlers can further be limited to some names with api.subscribe().
+		 * Keep in the order of t_luaevent_type.
+		 */
+		static struct
+		{
+			char const * name;
+			bool bound;
+			bool filtered;
+			std::vector<std::string> names;
+		} lua_events[luaevent_max] =
+		{
+			{ "handle_command" },
+			{ "handle_command_before" },
+
+			{ "handle_game_create" },
+			{ "handle_game_report" },
+			{ "handle_game_end" },
+			{ "handle_game_destroy" },
+			{ "handle_game_changestatus" },
+			{ "handle_game_userjoin" },
+			{ "handle_game_userleft" },
+
+			{ "handle_channel_message" },
+			{ "handle_channel_userjoin" },
+			{ "handle_channel_userleft" },
+
+			{ "handle_user_whisper" },
+			{ "handle_user_login" },
+			{ "handle_user_disconnect" },
+
+			{ "main" },
+			{ "handle_server_rehash" },
+			{ "handle_server_mainloop" },
+			{ "handle_server_timer" },
+
+			{ "handle_game_list" },
+			{ "handle_user_icon" },
+			{ "handle_client_readmemory" },
+			{ "handle_client_extrawork" }
+		};
 
 
 		/* Unload all the lua scripts */
@@ -85,6 +141,7 @@ namespace pvpgn
 			{
 				// init lua virtual machine
 				vm.initialize();
+				lua_timers_ready.clear();
 
 				std::vector<std::string> files = dir_getfiles(scriptdir, ".lua", true);
 
@@ -111,11 +168,111 @@ namespace pvpgn
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
 
+			_load_subscriptions();
+
 			// handle start event
 			lua_handle_server(luaevent_server_start);
 		}
 
 
+		/* Look up the handlers the scripts define, filters are set again by the scripts */
+		void _load_subscriptions()
+		{
+			lua_State * st = vm.get_st();
+			int bound = 0;
+
+			for (int i = 0; i < luaevent_max; i++)
+			{
+				lua_events[i].bound = false;
+				lua_events[i].filtered = false;
+				lua_events[i].names.clear();
+				if (!st)
+					continue;
+
+				lua_getglobal(st, lua_events[i].name);
+				if (lua_isfunction(st, -1))
+				{
+					lua_events[i].bound = true;
+					bound++;
+				}
+				lua_pop(st, 1);
+			}
+			eventlog(eventlog_level_info, __FUNCTION__, "{} of {} event handlers defined", bound, (int)luaevent_max);
+		}
+
+
+		/*
+		 * Limit a command or channel handler to the given names, NULL passes
+		 * everything again. Commands match by prefix like string.starts() in
+		 * the scripts, channels by name. An empty list passes nothing.
+		 */
+		extern int lua_subscribe(char const * handler, std::vector<std::string> const * names)
+		{
+			int i;
+
+			if (!handler)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL handler");
+				return -1;
+			}
+			for (i = 0; i < luaevent_max; i++)
+				if (std::strcmp(lua_events[i].name, handler) == 0)
+					break;
+			switch (i)
+			{
+			case luaevent_command:
+			case luaevent_command_before:
+			case luaevent_channel_message:
+			case luaevent_channel_userjoin:
+			case luaevent_channel_userleft:
+				break;
+			default:
+				eventlog(eventlog_level_error, __FUNCTION__, "can not filter \"{}\"", handler);
+				return -1;
+			}
+
+			lua_events[i].filtered = (names != NULL);
+			lua_events[i].names.clear();
+			if (names)
+			{
+				for (const auto& name : *names)
+				{
+					if (!name.empty())
+						lua_events[i].names.push_back(name);
+				}
+			}
+			return 0;
+		}
+
+
+		static bool lua_match_command(t_luaevent_type luaevent, char const * text)
+		{
+			if (!lua_events[luaevent].filtered)
+				return true;
+			for (const auto& name : lua_events[luaevent].names)
+			{
+				if (std::strncmp(text, name.c_str(), name.size()) == 0)
+					return true;
+			}
+			return false;
+		}
+
+
+		static bool lua_match_channel(t_luaevent_type luaevent, char const * channelname)
+		{
+			if (!lua_events[luaevent].filtered)
+				return true;
+			if (!channelname)
+				return false;
+			for (const auto& name : lua_events[luaevent].names)
+			{
+				if (strcasecmp(channelname, name.c_str()) == 0)
+					return true;
+			}
+			return false;
+		}
+
+
 		/* Register C++ functions to be able use them from lua scripts */
 		void _register_functions()
 		{
@@ -146,12 +303,18 @@ namespace pvpgn
 				{ "client_requiredwork", __client_requiredwork },
 
 				{ "command_get_group", __command_get_group },
+				{ "subscribe", __subscribe },
 				{ "icon_get_rank", __icon_get_rank },
 				{ "describe_command", __describe_command },
 				{ "messagebox_show", __messagebox_show },
 
 				{ "localize", __localize },
 
+				{ "timer_start", __timer_start },
+				{ "server_get_user_ids", __server_get_user_ids },
+				{ "server_get_game_ids", __server_get_game_ids },
+				{ "server_get_channel_ids", __server_get_channel_ids },
+
 				{ 0, 0 }
 			};
 			vm.reg("api", api);
@@ -245,6 +408,8 @@ namespace pvpgn
 				config.update("quota_wrapline", prefs_get_quota_wrapline());
 				config.update("quota_maxline", prefs_get_quota_maxline());
 				config.update("quota_dobae", prefs_get_quota_dobae());
+				config.update("quota_ip_lines", prefs_get_quota_ip_lines());
+				config.update("quota_channel_lines", prefs_get_quota_channel_lines());
 				config.update("mail_support", prefs_get_mail_support());
 				config.update("mail_quota", prefs_get_mail_quota());
 				config.update("log_notice", prefs_get_log_notice());
@@ -267,6 +432,10 @@ namespace pvpgn
 				config.update("servername", prefs_get_servername());
 				config.update("max_connections", prefs_get_max_connections());
 				config.update("packet_limit", prefs_get_packet_limit());
+				config.update("close_timeout", prefs_get_close_timeout());
+				config.update("close_halfclose", prefs_get_close_halfclose());
+				config.update("mem_budget", prefs_get_mem_budget());
+				config.update("mem_conn_limit", prefs_get_mem_conn_limit());
 				config.update("max_concurrent_logins", prefs_get_max_concurrent_logins());
 				config.update("use_keepalive", prefs_get_use_keepalive());
 				config.update("max_conns_per_IP", prefs_get_max_conns_per_IP());
@@ -328,6 +497,13 @@ namespace pvpgn
 			default:
 				return result;
 			}
+			if (!lua_events[luaevent].bound)
+				return result;
+			// what the scripts return for a command they don't handle
+			if (!lua_match_command(luaevent, text))
+				return (luaevent == luaevent_command) ? 1 : 0;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -345,6 +521,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, func_name);
 			return result;
 		}
 
@@ -378,6 +555,10 @@ namespace pvpgn
 			default:
 				return;
 			}
+			if (!lua_events[luaevent].bound)
+				return;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				std::map<std::string, std::string> o_game = get_game_object(game);
@@ -406,6 +587,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, func_name);
 		}
 
 		std::vector<t_game*> lua_handle_game_list(t_connection * c)
@@ -413,6 +595,10 @@ namespace pvpgn
 			t_account * account;
 			std::vector<std::string> columns, data;
 			std::vector<t_game*> result;
+			if (!lua_events[luaevent_game_list].bound)
+				return result;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -452,6 +638,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, "handle_game_list");
 			return result;
 		}
 
@@ -475,6 +662,10 @@ namespace pvpgn
 			default:
 				return 0;
 			}
+			if (!lua_events[luaevent].bound || !lua_match_channel(luaevent, channel_get_name(channel)))
+				return 0;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -498,6 +689,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, func_name);
 			return result;
 		}
 
@@ -521,6 +713,10 @@ namespace pvpgn
 			default:
 				return 0;
 			}
+			if (!lua_events[luaevent].bound)
+				return 0;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -549,6 +745,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, func_name);
 			return result;
 		}
 
@@ -556,6 +753,10 @@ namespace pvpgn
 		{
 			t_account * account;
 			const char * result = NULL;
+			if (!lua_events[luaevent_user_icon].bound)
+				return 0;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -572,6 +773,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, "handle_user_icon");
 			return result;
 		}
 
@@ -594,6 +796,11 @@ namespace pvpgn
 			default:
 				return;
 			}
+			// main() runs before the handlers are looked up
+			if (luaevent != luaevent_server_start && !lua_events[luaevent].bound)
+				return;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				lua::transaction(vm) << lua::lookup(func_name) << lua::invoke << lua::end; // invoke lua function
@@ -606,11 +813,81 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, NULL, func_name);
+		}
+
+		static void lua_handle_timer(unsigned int id)
+		{
+			if (!lua_events[luaevent_server_timer].bound)
+				return;
+			t_slowlog_mark mark = slowlog_begin();
+
+			try
+			{
+				lua::transaction(vm) << lua::lookup("handle_server_timer") << id << lua::invoke << lua::end; // invoke lua function
+			}
+			catch (const std::exception& e)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "{}", e.what());
+			}
+			catch (...)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
+			}
+			slowlog_end(mark, slowlog_lua, NULL, "handle_server_timer");
+		}
+
+		static void lua_timer_cb(t_connection * owner, std::time_t when, t_timer_data data)
+		{
+			lua_handle_timer((unsigned int)data.n);
+		}
+
+		/*
+		 * Start a timer for the scripts and return its id, handle_server_timer()
+		 * gets it when the seconds passed. A timer of 0 seconds expires in the
+		 * next main loop iteration, so scripts can split their work in slices.
+		 */
+		extern unsigned int lua_timer_start(unsigned int seconds)
+		{
+			t_timer_data data;
+
+			if (++lua_timer_lastid == 0)
+				lua_timer_lastid = 1;
+
+			if (!seconds)
+			{
+				lua_timers_ready.push_back(lua_timer_lastid);
+				return lua_timer_lastid;
+			}
+
+			/* timers expire once their time is in the past */
+			data.n = lua_timer_lastid;
+			if (timerlist_add_timer(NULL, now + (std::time_t)seconds - 1, lua_timer_cb, data) < 0)
+				return 0;
+			return lua_timer_lastid;
+		}
+
+		/* called every main loop iteration */
+		extern void lua_timer_flush(void)
+		{
+			std::vector<unsigned int> ready;
+
+			if (lua_timers_ready.empty())
+				return;
+
+			/* timers the handlers start are for the next iteration */
+			ready.swap(lua_timers_ready);
+			for (auto id : ready)
+				lua_handle_timer(id);
 		}
 
 		extern void lua_handle_client_readmemory(t_connection * c, int request_id, std::vector<int> data)
 		{
 			t_account * account;
+			if (!lua_events[luaevent_client_readmemory].bound)
+				return;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -628,11 +905,16 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, "handle_client_readmemory");
 		}
 
 		extern void lua_handle_client_extrawork(t_connection * c, int gametype, int length, const char * data)
 		{
 			t_account * account;
+			if (!lua_events[luaevent_client_extrawork].bound)
+				return;
+			t_slowlog_mark mark = slowlog_begin();
+
 			try
 			{
 				if (!(account = conn_get_account(c)))
@@ -650,6 +932,7 @@ namespace pvpgn
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "lua exception\n");
 			}
+			slowlog_end(mark, slowlog_lua, c, "handle_client_extrawork");
 		}
 #endif
 
@@ -55,12 +55,20 @@ namespace pvpgn
 			luaevent_server_start,
 			luaevent_server_rehash,
 			luaevent_server_mainloop,
+			luaevent_server_timer,
 
+			luaevent_game_list,
+			luaevent_user_icon,
+			luaevent_client_readmemory,
+			luaevent_client_extrawork,
+
+			luaevent_max // number of events, keep last
 		} t_luaevent_type;
 
 
 		extern void lua_load(char const * scriptdir);
 		extern void lua_unload();
+		extern int lua_subscribe(char const * handler, std::vector<std::string> const * names);
 
 		extern int lua_handle_command(t_connection * c, char const * text, t_luaevent_type luaevent);
 		extern void lua_handle_game(t_game * game, t_connection * c, t_luaevent_type luaevent);
@@ -70,6 +78,8 @@ namespace pvpgn
 		extern int lua_handle_user(t_connection * c, t_connection * c_dst, char const * message_text, t_luaevent_type luaevent);
 		extern const char * lua_handle_user_icon(t_connection * c, const char * iconinfo);
 		extern void lua_handle_server(t_luaevent_type luaevent);
+		extern unsigned int lua_timer_start(unsigned int seconds);
+		extern void lua_timer_flush(void);
 		
 		extern void lua_handle_client_readmemory(t_connection * c, int request_id, std::vector<int> data);
 		extern void lua_handle_client_extrawork(t_connection * c, int gametype, int length, const char * data);
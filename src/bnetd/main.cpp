@@ -88,6 +88,9 @@
 #include "handle_apireg.h"
 #include "i18n.h"
 #include "userlog.h"
+#include "flightrec.h"
+#include "memprof.h"
+#include "cluster.h"
 #ifdef WIN32
 #include "win32/windump.h"
 #endif
@@ -219,6 +222,10 @@ int eventlog_startup(void)
 		return -1;
 	}
 	eventlog(eventlog_level_info, __FUNCTION__, "logging event levels: {}", prefs_get_loglevels());
+	if (eventlog_set_module_levels(prefs_get_logmodules()) < 0)
+		eventlog(eventlog_level_error, __FUNCTION__, "could not use all of logmodules \"{}\"", prefs_get_logmodules());
+	else if (eventlog_modules)
+		eventlog(eventlog_level_info, __FUNCTION__, "logging event levels of modules: {}", eventlog_get_module_levels_str());
 	return 0;
 }
 
@@ -348,7 +355,7 @@ int pre_server_startup(void)
 		eventlog(eventlog_level_error, "pre_server_startup", "could not create matchlists");
 		return STATUS_MATCHLISTS_FAILURE;
 	}
-	if (fdwatch_init(prefs_get_max_connections())) {
+	if (fdwatch_init(prefs_get_max_connections(), prefs_get_fdwatch_backend())) {
 		eventlog(eventlog_level_error, __FUNCTION__, "error initilizing fdwatch");
 		return STATUS_FDWATCH_FAILURE;
 	}
@@ -420,6 +427,8 @@ int pre_server_startup(void)
 		eventlog(eventlog_level_error, __FUNCTION__, "could not load realm list");
 	//topiclist_load(std::string(prefs_get_topicfile()));
 	userlog_init();
+	if (cluster_init() < 0)
+		eventlog(eventlog_level_error, __FUNCTION__, "could not join the cluster");
 
 #ifdef WITH_LUA
 	lua_load(prefs_get_scriptdir());
@@ -434,6 +443,7 @@ void post_server_shutdown(int status)
 	switch (status)
 	{
 	case 0:
+		cluster_destroy();
 		//topiclist_unload();
 		realmlist_destroy();
 		teamlist_unload();
@@ -467,6 +477,7 @@ void post_server_shutdown(int status)
 		timerlist_destroy();
 		gamelist_destroy();
 		connlist_destroy();
+		flightrec_unload();
 		fdwatch_close();
 	case STATUS_FDWATCH_FAILURE:
 		anongame_matchlists_destroy();
@@ -563,6 +574,8 @@ extern int main(int argc, char ** argv)
 			return -1;
 		/* eventlog goes to std::log file from here on... */
 
+		memprof_apply_prefs();
+
 		/* Give up root privileges */
 		/* Hakan: That's way too late to give up root privileges... Have to look for a better place */
 		if (give_up_root_privileges(prefs_get_effective_user(), prefs_get_effective_group()) < 0) {
@@ -608,6 +621,8 @@ extern int main(int argc, char ** argv)
 
 		if (a == 0)
 			eventlog(eventlog_level_info, __FUNCTION__, "server has shut down");
+		// last, so the shutdown dump shows what the cleanup left allocated
+		memprof_unload();
 		prefs_unload();
 		cmdline_unload();
 		//guiOnClose
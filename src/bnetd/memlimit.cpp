@@ -0,0 +1,157 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "memlimit.h"
+
+#include "common/eventlog.h"
+#include "common/packet.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* stage thresholds in percent of mem_budget */
+		static const unsigned int memlimit_shed_percent = 70;
+		static const unsigned int memlimit_nologin_percent = 85;
+		/* a connection holding less than this is keeping up and never sheds */
+		static const unsigned long memlimit_backlog_min = 8 * sizeof(t_packet);
+
+		static t_memlimit_stage memlimit_stage = memlimit_stage_normal;
+		static t_memlimit_stats memlimit_stats = { 0, 0, 0, 0, 0 };
+
+
+		static char const * memlimit_stage_get_str(t_memlimit_stage stage)
+		{
+			switch (stage)
+			{
+			case memlimit_stage_normal:
+				return "normal";
+			case memlimit_stage_shed:
+				return "shedding chat";
+			case memlimit_stage_nologin:
+				return "refusing connections";
+			case memlimit_stage_disconnect:
+				return "disconnecting";
+			default:
+				return "unknown";
+			}
+		}
+
+
+		/*
+		 * The accounted figure is what connections pin in their queues and
+		 * line buffers plus the loaded account attributes. A queued packet is
+		 * counted at its full allocation size for every connection it is
+		 * queued on, so the figure is an upper bound of what would be freed.
+		 */
+		extern void memlimit_add(unsigned long bytes)
+		{
+			memlimit_stats.used += bytes;
+			if (memlimit_stats.used > memlimit_stats.peak)
+				memlimit_stats.peak = memlimit_stats.used;
+		}
+
+
+		extern void memlimit_sub(unsigned long bytes)
+		{
+			if (bytes > memlimit_stats.used)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "accounting underflow ({} > {})", bytes, memlimit_stats.used);
+				memlimit_stats.used = 0;
+				return;
+			}
+			memlimit_stats.used -= bytes;
+		}
+
+
+		extern t_memlimit_stage memlimit_get_stage(void)
+		{
+			return memlimit_stage;
+		}
+
+
+		extern int memlimit_is_backlogged(unsigned long bytes)
+		{
+			return bytes >= memlimit_backlog_min;
+		}
+
+
+		/*
+		 * Called once a second from the main loop with mem_budget in bytes.
+		 * Returns how many bytes the connections have to give back when
+		 * the budget is used up, 0 otherwise.
+		 */
+		extern unsigned long memlimit_check(unsigned long budget)
+		{
+			unsigned long nologin;
+			t_memlimit_stage stage;
+
+			nologin = budget / 100 * memlimit_nologin_percent;
+
+			if (!budget)
+				stage = memlimit_stage_normal;
+			else if (memlimit_stats.used >= budget)
+				stage = memlimit_stage_disconnect;
+			else if (memlimit_stats.used >= nologin)
+				stage = memlimit_stage_nologin;
+			else if (memlimit_stats.used >= budget / 100 * memlimit_shed_percent)
+				stage = memlimit_stage_shed;
+			else
+				stage = memlimit_stage_normal;
+
+			if (stage != memlimit_stage)
+			{
+				eventlog((stage > memlimit_stage) ? eventlog_level_warn : eventlog_level_info, __FUNCTION__, "memory pressure {} -> {} ({} of {} KB in use)",
+					memlimit_stage_get_str(memlimit_stage), memlimit_stage_get_str(stage), memlimit_stats.used / 1024, budget / 1024);
+				memlimit_stage = stage;
+			}
+
+			/* get back under the login threshold in one go */
+			if (stage == memlimit_stage_disconnect)
+				return memlimit_stats.used - nologin;
+			return 0;
+		}
+
+
+		extern void memlimit_count_shed(void)
+		{
+			memlimit_stats.shed++;
+		}
+
+
+		extern void memlimit_count_refused(void)
+		{
+			memlimit_stats.refused++;
+		}
+
+
+		extern void memlimit_count_kicked(unsigned int count)
+		{
+			memlimit_stats.kicked += count;
+		}
+
+
+		extern void memlimit_get_stats(t_memlimit_stats * stats)
+		{
+			*stats = memlimit_stats;
+		}
+
+	}
+
+}
@@ -0,0 +1,79 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef INCLUDED_MEMLIMIT_TYPES
+#define INCLUDED_MEMLIMIT_TYPES
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/*
+		 * How far the server degrades as the accounted memory approaches
+		 * mem_budget. Every stage includes the measures of the previous ones.
+		 */
+		typedef enum
+		{
+			memlimit_stage_normal,
+			memlimit_stage_shed,       /* drop chat lines to clients that are behind */
+			memlimit_stage_nologin,    /* refuse new connections */
+			memlimit_stage_disconnect  /* disconnect the biggest connections */
+		} t_memlimit_stage;
+
+		typedef struct
+		{
+			unsigned long used;     /* bytes currently accounted */
+			unsigned long peak;
+			unsigned long shed;     /* chat lines dropped */
+			unsigned long refused;  /* connections refused */
+			unsigned long kicked;   /* connections disconnected */
+		} t_memlimit_stats;
+
+	}
+
+}
+
+#endif
+
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_MEMLIMIT_PROTOS
+#define INCLUDED_MEMLIMIT_PROTOS
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		extern void memlimit_add(unsigned long bytes);
+		extern void memlimit_sub(unsigned long bytes);
+		extern t_memlimit_stage memlimit_get_stage(void);
+		extern int memlimit_is_backlogged(unsigned long bytes);
+		extern unsigned long memlimit_check(unsigned long budget);
+		extern void memlimit_count_shed(void);
+		extern void memlimit_count_refused(void);
+		extern void memlimit_count_kicked(unsigned int count);
+		extern void memlimit_get_stats(t_memlimit_stats * stats);
+
+	}
+
+}
+
+#endif
+#endif
@@ -0,0 +1,135 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "memprof.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "common/eventlog.h"
+#include "common/xalloc.h"
+#include "prefs.h"
+#include "server.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* sites written by a dump, the rest only shows in the totals */
+		static const unsigned int memprof_dump_sites = 50;
+
+		static std::time_t memprof_dumptime = 0;
+
+
+		/* start or stop the profiler as memprof says, called after every load of bnetd.conf */
+		extern void memprof_apply_prefs(void)
+		{
+			if (prefs_get_memprof() && !xalloc_profile_running())
+			{
+				xalloc_profile_start();
+				memprof_dumptime = std::time(NULL);
+				eventlog(eventlog_level_info, __FUNCTION__, "allocation profiler started");
+			}
+			else if (!prefs_get_memprof() && xalloc_profile_running())
+			{
+				xalloc_profile_stop();
+				eventlog(eventlog_level_info, __FUNCTION__, "allocation profiler stopped");
+			}
+		}
+
+
+		/* called from the main loop, dumps every memprof_secs while the profiler runs */
+		extern void memprof_check(void)
+		{
+			if (!prefs_get_memprof_secs() || !xalloc_profile_running())
+				return;
+			/* started or reset by /memprof since the last dump */
+			if (memprof_dumptime < xalloc_profile_get_since())
+				memprof_dumptime = xalloc_profile_get_since();
+			if (memprof_dumptime + (std::time_t)prefs_get_memprof_secs() > now)
+				return;
+			memprof_dump("periodic");
+		}
+
+
+		extern int memprof_dump(char const * reason)
+		{
+			std::FILE * fp;
+			t_xalloc_site sites[memprof_dump_sites];
+			unsigned int n, i;
+			unsigned long live = 0;
+			std::time_t secs;
+			char timestr[EVENT_TIME_MAXLEN];
+			struct std::tm * tmnow;
+
+			memprof_dumptime = now;
+			if (!xalloc_profile_get_length())
+				return -1;
+
+			if (!(fp = std::fopen(prefs_get_memprof_file(), "a")))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not open file \"{}\" for appending (std::fopen: {})", prefs_get_memprof_file(), std::strerror(errno));
+				return -1;
+			}
+
+			if (!(tmnow = std::localtime(&now)) || !std::strftime(timestr, sizeof(timestr), EVENT_TIME_FORMAT, tmnow))
+				std::strcpy(timestr, "?");
+			secs = now - xalloc_profile_get_since();
+			if (secs < 1)
+				secs = 1;
+			std::fprintf(fp, "# allocation profile at %s: %s, %u sites over %lu seconds\n",
+				timestr, reason, xalloc_profile_get_length(), (unsigned long)secs);
+			std::fprintf(fp, "# %10s %10s %8s %10s %8s  site\n", "live", "peak", "blocks", "allocs", "allocs/s");
+
+			n = xalloc_profile_get_top(sites, memprof_dump_sites);
+			for (i = 0; i < n; i++)
+			{
+				std::fprintf(fp, "%12lu %10lu %8lu %10lu %8lu  %s:%u %s()\n",
+					sites[i].live, sites[i].peak, sites[i].blocks, sites[i].allocs,
+					sites[i].allocs / (unsigned long)secs,
+					sites[i].file, sites[i].line, sites[i].func);
+				live += sites[i].live;
+			}
+
+			std::fprintf(fp, "# end of profile, %lu bytes live in the sites above\n", live);
+			if (std::fclose(fp) < 0)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not close file \"{}\" after writing (std::fclose: {})", prefs_get_memprof_file(), std::strerror(errno));
+				return -1;
+			}
+
+			eventlog(eventlog_level_info, __FUNCTION__, "dumped allocation profile to \"{}\" ({})", prefs_get_memprof_file(), reason);
+			return 0;
+		}
+
+
+		/* what is still live after the server is torn down are the leaks */
+		extern void memprof_unload(void)
+		{
+			if (!xalloc_profile_running())
+				return;
+			memprof_dump("shutdown");
+			xalloc_profile_stop();
+		}
+
+	}
+
+}
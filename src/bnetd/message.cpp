@@ -46,6 +46,7 @@
 #include "connection.h"
 #include "irc.h"
 #include "command.h"
+#include "command_groups.h"
 #include "i18n.h"
 #include "common/setup_after.h"
 
@@ -55,10 +56,11 @@ namespace pvpgn
 	namespace bnetd
 	{
 
-		static int message_telnet_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags);
-		static int message_bot_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags);
-		static int message_bnet_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags);
-		static t_packet * message_cache_lookup(t_message * message, t_connection *dst, unsigned int flags);
+		static int message_telnet_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags);
+		static int message_bot_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags);
+		static int message_bnet_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags);
+		static t_packet * message_cache_lookup(t_message * message, t_connection *dst, unsigned int flags, unsigned int * index);
+		static t_packet * message_irc_variant(t_message * message, unsigned int index, t_connection * dst);
 
 		static char const * message_type_get_str(t_message_type type)
 		{
@@ -313,7 +315,7 @@ namespace pvpgn
 		}
 
 
-		static int message_telnet_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags)
+		static int message_telnet_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags)
 		{
 			char * msgtemp;
 
@@ -428,6 +430,8 @@ namespace pvpgn
 
 					if (me)
 						tname = conn_get_chatcharname(me, dst);
+					else if (srcname)
+						tname = srcname;
 					else
 						tname = prefs_get_servername();
 
@@ -460,6 +464,8 @@ namespace pvpgn
 
 					if (me)
 						tname = conn_get_chatcharname(me, dst);
+					else if (srcname)
+						tname = srcname;
 					else
 						tname = prefs_get_servername();
 
@@ -520,7 +526,7 @@ namespace pvpgn
 				msgtemp = xstrdup("");
 				break;
 			case message_type_whisperack:
-				if (!me)
+				if (!me && !srcname)
 				{
 					eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection for {}", message_type_get_str(type));
 					return -1;
@@ -534,7 +540,7 @@ namespace pvpgn
 					char const * tname;
 					char const * newtext;
 
-					tname = conn_get_chatcharname(me, dst);
+					tname = me ? conn_get_chatcharname(me, dst) : srcname;
 					if ((newtext = escape_chars(text, std::strlen(text))))
 					{
 						msgtemp = (char*)xmalloc(std::strlen(tname) + 8 + std::strlen(newtext) + 4);
@@ -546,7 +552,8 @@ namespace pvpgn
 						msgtemp = (char*)xmalloc(std::strlen(tname) + 8 + std::strlen(text) + 4);
 						std::sprintf(msgtemp, "<to %s> %s\r\n", tname, text);
 					}
-					conn_unget_chatcharname(me, tname);
+					if (me)
+						conn_unget_chatcharname(me, tname);
 				}
 				break;
 			case message_type_friendwhisperack:   // [zap-zero] 20020518
@@ -695,7 +702,7 @@ namespace pvpgn
 		}
 
 
-		static int message_bot_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags)
+		static int message_bot_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags)
 		{
 			char * msgtemp;
 			char clienttag_str[5];
@@ -808,6 +815,8 @@ namespace pvpgn
 
 						if (me)
 							tname = conn_get_chatcharname(me, dst);
+						else if (srcname)
+							tname = srcname;
 						else
 							tname = prefs_get_servername();
 
@@ -818,7 +827,7 @@ namespace pvpgn
 					}
 					break;
 				case message_type_talk:
-					if (!me)
+					if (!me && !srcname)
 					{
 						eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection for {}", message_type_get_str(type));
 						return -1;
@@ -833,10 +842,11 @@ namespace pvpgn
 					{
 						char const * tname;
 
-						tname = conn_get_chatcharname(me, dst);
+						tname = me ? conn_get_chatcharname(me, dst) : srcname;
 						msgtemp = (char*)xmalloc(32 + std::strlen(tname) + 32 + std::strlen(text));
-						std::sprintf(msgtemp, "%u %s %s %04x \"%s\"\r\n", EID_TALK, "TALK", tname, conn_get_flags(me) | dstflags, text);
-						conn_unget_chatcharname(me, tname);
+						std::sprintf(msgtemp, "%u %s %s %04x \"%s\"\r\n", EID_TALK, "TALK", tname, me ? conn_get_flags(me) | dstflags : dstflags, text);
+						if (me)
+							conn_unget_chatcharname(me, tname);
 					}
 					break;
 				case message_type_broadcast:
@@ -875,7 +885,7 @@ namespace pvpgn
 					}
 					break;
 				case message_type_whisperack:
-					if (!me)
+					if (!me && !srcname)
 					{
 						eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection for {}", message_type_get_str(type));
 						return -1;
@@ -888,10 +898,11 @@ namespace pvpgn
 					{
 						char const * tname;
 
-						tname = conn_get_chatcharname(me, dst);
+						tname = me ? conn_get_chatcharname(me, dst) : srcname;
 						msgtemp = (char*)xmalloc(32 + std::strlen(tname) + 32 + std::strlen(text));
-						std::sprintf(msgtemp, "%u %s %s %04x \"%s\"\r\n", EID_WHISPERSENT, "WHISPER", tname, conn_get_flags(me) | dstflags, text);
-						conn_unget_chatcharname(me, tname);
+						std::sprintf(msgtemp, "%u %s %s %04x \"%s\"\r\n", EID_WHISPERSENT, "WHISPER", tname, me ? conn_get_flags(me) | dstflags : dstflags, text);
+						if (me)
+							conn_unget_chatcharname(me, tname);
 					}
 					break;
 				case message_type_friendwhisperack: // [zap-zero] 20020518
@@ -981,7 +992,7 @@ namespace pvpgn
 		}
 
 
-		static int message_bnet_format(t_packet * packet, t_message_type type, t_connection * me, t_connection * dst, char const * text, unsigned int dstflags)
+		static int message_bnet_format(t_packet * packet, t_message_type type, t_connection * me, char const * srcname, t_connection * dst, char const * text, unsigned int dstflags)
 		{
 			if (!packet)
 			{
@@ -1103,6 +1114,8 @@ namespace pvpgn
 					packet_append_string(packet, tname);
 					conn_unget_chatcharname(me, tname);
 				}
+				else if (srcname)
+					packet_append_string(packet, srcname);
 				else
 					packet_append_string(packet, prefs_get_servername());
 
@@ -1110,7 +1123,7 @@ namespace pvpgn
 
 				break;
 			case message_type_talk:
-				if (!me)
+				if (!me && !srcname)
 				{
 					eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection for {}", message_type_get_str(type));
 					return -1;
@@ -1123,16 +1136,19 @@ namespace pvpgn
 				if (dstflags&MF_X)
 					return -1; /* player is ignored */
 				bn_int_set(&packet->u.server_message.type, SERVER_MESSAGE_TYPE_TALK);
-				bn_int_set(&packet->u.server_message.flags, conn_get_flags(me) | dstflags);
-				bn_int_set(&packet->u.server_message.latency, conn_get_latency(me));
+				bn_int_set(&packet->u.server_message.flags, me ? conn_get_flags(me) | dstflags : dstflags);
+				bn_int_set(&packet->u.server_message.latency, me ? conn_get_latency(me) : 0);
+				if (me)
 				{
 					char const * tname;
 
 					tname = conn_get_chatcharname(me, dst);
 					packet_append_string(packet, tname);
 					conn_unget_chatcharname(me, tname);
-					packet_append_string(packet, text);
 				}
+				else
+					packet_append_string(packet, srcname);
+				packet_append_string(packet, text);
 				break;
 			case message_type_broadcast:
 				if (!text)
@@ -1210,7 +1226,7 @@ namespace pvpgn
 				}
 				break;
 			case message_type_whisperack:
-				if (!me)
+				if (!me && !srcname)
 				{
 					eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection for {}", message_type_get_str(type));
 					return -1;
@@ -1221,16 +1237,19 @@ namespace pvpgn
 					return -1;
 				}
 				bn_int_set(&packet->u.server_message.type, SERVER_MESSAGE_TYPE_WHISPERACK);
-				bn_int_set(&packet->u.server_message.flags, conn_get_flags(me) | dstflags);
-				bn_int_set(&packet->u.server_message.latency, conn_get_latency(me));
+				bn_int_set(&packet->u.server_message.flags, me ? conn_get_flags(me) | dstflags : dstflags);
+				bn_int_set(&packet->u.server_message.latency, me ? conn_get_latency(me) : 0);
+				if (me)
 				{
 					char const * tname;
 
 					tname = conn_get_chatcharname(me, dst);
 					packet_append_string(packet, tname);
 					conn_unget_chatcharname(me, tname);
-					packet_append_string(packet, text);
 				}
+				else
+					packet_append_string(packet, srcname);
+				packet_append_string(packet, text);
 				break;
 			case message_type_friendwhisperack:  // [zap-zero] 20020518
 				if (!me)
@@ -1358,14 +1377,78 @@ namespace pvpgn
 			message->classes = NULL;
 			message->dstflags = NULL;
 			message->mclasses = NULL;
+			message->variants = NULL;
+			message->addr_group_known = 0;
+			message->addr_group = 0;
 			message->type = type;
 			message->src = src;
+			message->srcname = NULL;
 			message->text = text;
 
 			return message;
 		}
 
 
+		/* a message of a user logged on to another cluster node, srcname stands in for the connection */
+		extern t_message * message_create_remote(t_message_type type, char const * srcname, char const * text)
+		{
+			t_message * message;
+
+			if (!srcname)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL srcname");
+				return NULL;
+			}
+
+			message = message_create(type, NULL, text);
+			message->srcname = srcname;
+
+			return message;
+		}
+
+
+		/*
+		 * Formats the message for "dst" as message_send() would, whether or not
+		 * "dst" ignores the sender, without sending it. Once prepared for all
+		 * its recipients a message can be sent after its sender is gone, see
+		 * message_detach().
+		 */
+		extern int message_prepare(t_message * message, t_connection * dst)
+		{
+			unsigned int index;
+
+			if (!message)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL message");
+				return -1;
+			}
+			if (!dst)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL dst connection");
+				return -1;
+			}
+
+			message_cache_lookup(message, dst, 0, &index);
+			message_cache_lookup(message, dst, MF_X, &index);
+
+			return 0;
+		}
+
+
+		/* srcname stands in for the sender from now on, it has to outlive the message */
+		extern void message_detach(t_message * message, char const * srcname)
+		{
+			if (!message)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL message");
+				return;
+			}
+
+			message->src = NULL;
+			message->srcname = srcname;
+		}
+
+
 		extern int message_destroy(t_message * message)
 		{
 			unsigned int i;
@@ -1391,13 +1474,22 @@ namespace pvpgn
 				xfree(message->dstflags);
 			if (message->mclasses)
 				xfree(message->mclasses);
+			if (message->variants)
+			{
+				for (i = 0; i < message->num_cached * 2; i++)
+				{
+					if (message->variants[i])
+						packet_del_ref(message->variants[i]);
+				}
+				xfree(message->variants);
+			}
 			xfree(message);
 
 			return 0;
 		}
 
 
-		static t_packet * message_cache_lookup(t_message * message, t_connection *dst, unsigned int dstflags)
+		static t_packet * message_cache_lookup(t_message * message, t_connection *dst, unsigned int dstflags, unsigned int * index)
 		{
 			unsigned int i = 0;
 			t_packet * packet;
@@ -1419,7 +1511,10 @@ namespace pvpgn
 				{
 					if (message->classes[i] == cclass && message->dstflags[i] == dstflags
 						&& message->mclasses[i] == mclass)
+					{
+						*index = i;
 						return message->packets[i];
+					}
 				}
 			}
 			{
@@ -1427,6 +1522,7 @@ namespace pvpgn
 				t_conn_class * temp_classes;
 				unsigned int * temp_dstflags;
 				t_message_class *temp_mclasses;
+				t_packet * *   temp_variants;
 
 				if (!message->packets)
 					temp_packets = (t_packet**)xmalloc(sizeof(t_packet *)*(message->num_cached + 1));
@@ -1448,10 +1544,18 @@ namespace pvpgn
 				else
 					temp_mclasses = (t_message_class*)xrealloc(message->mclasses, sizeof(t_message_class)*(message->num_cached + 1));
 
+				if (!message->variants)
+					temp_variants = (t_packet**)xmalloc(sizeof(t_packet *)*(message->num_cached + 1) * 2);
+				else
+					temp_variants = (t_packet**)xrealloc(message->variants, sizeof(t_packet *)*(message->num_cached + 1) * 2);
+				temp_variants[i * 2] = NULL;
+				temp_variants[i * 2 + 1] = NULL;
+
 				message->packets = temp_packets;
 				message->classes = temp_classes;
 				message->dstflags = temp_dstflags;
 				message->mclasses = temp_mclasses;
+				message->variants = temp_variants;
 			}
 
 			switch (cclass)
@@ -1462,7 +1566,7 @@ namespace pvpgn
 					eventlog(eventlog_level_error, __FUNCTION__, "could not create packet");
 					return NULL;
 				}
-				if (message_telnet_format(packet, message->type, message->src, dst, message->text, dstflags) < 0)
+				if (message_telnet_format(packet, message->type, message->src, message->srcname, dst, message->text, dstflags) < 0)
 				{
 					packet_del_ref(packet);
 					packet = NULL; /* we can cache the NULL too */
@@ -1474,7 +1578,7 @@ namespace pvpgn
 					eventlog(eventlog_level_error, __FUNCTION__, "could not create packet");
 					return NULL;
 				}
-				if (message_bot_format(packet, message->type, message->src, dst, message->text, dstflags) < 0)
+				if (message_bot_format(packet, message->type, message->src, message->srcname, dst, message->text, dstflags) < 0)
 				{
 					packet_del_ref(packet);
 					packet = NULL; /* we can cache the NULL too */
@@ -1486,7 +1590,7 @@ namespace pvpgn
 					eventlog(eventlog_level_error, __FUNCTION__, "could not create packet");
 					return NULL;
 				}
-				if (message_bnet_format(packet, message->type, message->src, dst, message->text, dstflags) < 0)
+				if (message_bnet_format(packet, message->type, message->src, message->srcname, dst, message->text, dstflags) < 0)
 				{
 					packet_del_ref(packet);
 					packet = NULL; /* we can cache the NULL too */
@@ -1502,7 +1606,7 @@ namespace pvpgn
 					return NULL;
 				}
 				/* irc_message_format() is in irc.c */
-				if (irc_message_format(packet, message->type, message->src, dst, message->text, dstflags) < 0)
+				if (irc_message_format(packet, message->type, message->src, message->srcname, dst, message->text, dstflags) < 0)
 				{
 					packet_del_ref(packet);
 					packet = NULL; /* we can cache the NULL too */
@@ -1525,15 +1629,53 @@ namespace pvpgn
 			message->classes[i] = cclass;
 			message->dstflags[i] = dstflags;
 			message->mclasses[i] = mclass;
+			*index = i;
 
 			return packet;
 		}
 
 
+		/*
+		 * IRC style messages are cached without the recipient specific parts
+		 * (see irc_message_postformat()). The lines are finished once for
+		 * recipients that see addresses and once for those that do not, and
+		 * reused for all others of the same kind. Only a message that names
+		 * its recipient is finished for every recipient.
+		 */
+		static t_packet * message_irc_variant(t_message * message, unsigned int index, t_connection * dst)
+		{
+			t_packet * packet = message->packets[index];
+			t_packet * * variant;
+			t_account * account;
+			int hide_addr = 0;
+
+			if (prefs_get_hide_addr())
+			{
+				if (!message->addr_group_known)
+				{
+					message->addr_group = command_get_group("/admin-addr");
+					message->addr_group_known = 1;
+				}
+				/* not logged in yet, no command groups */
+				account = conn_get_account(dst);
+				hide_addr = !account || !(account_get_command_groups(account) & message->addr_group);
+			}
+
+			if (irc_message_needs_dest(packet))
+				return irc_message_postformat(packet, dst, hide_addr);
+
+			variant = &message->variants[index * 2 + hide_addr];
+			if (!*variant && !(*variant = irc_message_postformat(packet, dst, hide_addr)))
+				return NULL;
+			return packet_add_ref(*variant);
+		}
+
+
 		extern int message_send(t_message * message, t_connection * dst)
 		{
 			t_packet *   packet;
 			unsigned int dstflags;
+			unsigned int index;
 
 			if (!message)
 			{
@@ -1559,26 +1701,22 @@ namespace pvpgn
 				if (tname)
 					conn_unget_chatname(message->src, tname);
 			}
+			else if (message->srcname && conn_check_ignoring(dst, message->srcname) == 1)
+				dstflags |= MF_X;
 
-			if (!(packet = message_cache_lookup(message, dst, dstflags)))
+			if (!(packet = message_cache_lookup(message, dst, dstflags, &index)))
 				return -1;
 
-			/* FIXME: this is not needed now, message has dst */
 			if ((conn_get_class(dst) == conn_class_irc) || (conn_get_class(dst) == conn_class_wol) || (conn_get_class(dst) == conn_class_wserv) || (conn_get_class(dst) == conn_class_wgameres)) {
-				/* HACK: IRC message always need the recipient and are therefore bad to cache. */
-				/*       So we only cache a pseudo packet and convert it to a real packet later ... */
-				packet = packet_duplicate(packet); /* we want to modify packet so we have to create a copy ... */
-				if (irc_message_postformat(packet, dst) < 0) {
-					packet_del_ref(packet); /* we don't need the previously created copy anymore ... */
+				if (!(packet = message_irc_variant(message, index, dst)))
 					return -1;
-				}
+				conn_push_outqueue(dst, packet);
+				packet_del_ref(packet);
+				return 0;
 			}
 
 			conn_push_outqueue(dst, packet);
 
-			if ((conn_get_class(dst) == conn_class_irc) || (conn_get_class(dst) == conn_class_wol) || (conn_get_class(dst) == conn_class_wserv) || (conn_get_class(dst) == conn_class_wgameres))
-				packet_del_ref(packet); /* we don't need the previously created copy anymore ... */
-
 			return 0;
 		}
 
@@ -1586,7 +1724,7 @@ namespace pvpgn
 		extern int message_send_all(t_message * message)
 		{
 			t_connection * c;
-			t_elem const * curr;
+			t_elist      * curr;
 			int            rez;
 
 			if (!message)
@@ -1596,9 +1734,9 @@ namespace pvpgn
 			}
 
 			rez = -1;
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				c = (t_connection*)elem_get_data(curr);
+				c = connlist_get_conn(curr);
 				if (message_send(message, c) == 0)
 					rez = 0;
 			}
@@ -1633,13 +1771,13 @@ namespace pvpgn
 
 		extern int message_send_admins(t_connection * src, t_message_type type, char const * text)
 		{
-			t_elem	const * curr;
+			t_elist *	curr;
 			t_connection *	tc;
 			int			counter = 0;
 
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				tc = (t_connection*)elem_get_data(curr);
+				tc = connlist_get_conn(curr);
 				if (!tc)
 					continue;
 				if (account_get_auth_admin(conn_get_account(tc), NULL) == 1 && tc != src)
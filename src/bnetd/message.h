@@ -99,9 +99,13 @@ namespace pvpgn
 			t_conn_class * classes;    /* classes of cached message connections */
 			unsigned int * dstflags;   /* overlaid flags of cached messages */
 			t_message_class * mclasses; /* classes of cached messages */
+			t_packet * *   variants;   /* IRC lines made from cached messages, two each: address visible and hidden */
+			int            addr_group_known;
+			unsigned int   addr_group; /* command group of /admin-addr */
 			/* ---- */
 			t_message_type type;       /* format of message */
 			t_connection * src;        /* originator message */
+			char const *   srcname;    /* originator on another cluster node when src is NULL */
 			char const *   text;       /* text of message */
 		}
 #endif
@@ -133,6 +137,9 @@ namespace pvpgn
 
 		extern char * message_format_line(t_connection const * c, char const * in);
 		extern t_message * message_create(t_message_type type, t_connection * src, char const * text);
+		extern t_message * message_create_remote(t_message_type type, char const * srcname, char const * text);
+		extern int message_prepare(t_message * message, t_connection * dst);
+		extern void message_detach(t_message * message, char const * srcname);
 		extern int message_destroy(t_message * message);
 		extern int message_send(t_message * message, t_connection * dst);
 		extern int message_send_all(t_message * message);
@@ -31,6 +31,9 @@
 #include "prefs.h"
 #include "game.h"
 #include "channel.h"
+#include "memlimit.h"
+#include "attr.h"
+#include "attrgroup.h"
 #include "connection.h"
 #include "account.h"
 #include "server.h"
@@ -93,7 +96,7 @@ namespace pvpgn
 
 		int output_standard_writer(std::FILE * fp)
 		{
-			t_elem const	*curr;
+			t_elist	*curr;
 			t_connection	*conn;
 			t_channel const	*channel;
 			t_game *game;
@@ -102,6 +105,18 @@ namespace pvpgn
 			int			number;
 			char		clienttag_str[5];
 			int uptime = server_get_uptime();
+			unsigned long presence_sent;
+			unsigned long presence_saved;
+			t_memlimit_stats mem;
+			t_attrgroup_stats attrs;
+			t_attr_key_stats keys;
+			unsigned long logins;
+
+			channellist_presence_get_stats(&presence_sent, &presence_saved);
+			memlimit_get_stats(&mem);
+			attrgroup_get_stats(&attrs);
+			attr_key_get_stats(&keys);
+			logins = connlist_total_logins();
 
 
 			if (prefs_get_XML_status_output())
@@ -127,9 +142,9 @@ namespace pvpgn
 				std::fprintf(fp, "\t\t<Users>\n");
 				std::fprintf(fp, "\t\t<Number>%d</Number>\n", connlist_login_get_length());
 
-				LIST_TRAVERSE_CONST(connlist(), curr)
+				elist_for_each(curr, connlist())
 				{
-					conn = (t_connection*)elem_get_data(curr);
+					conn = connlist_get_conn(curr);
 					if (conn_get_account(conn))
 					{
 						std::fprintf(fp, "\t\t<user><name>%s</name><clienttag>%s</clienttag><version>%s</version>", conn_get_username(conn), tag_uint_to_str(clienttag_str, conn_get_clienttag(conn)), conn_get_clientver(conn));
@@ -154,25 +169,48 @@ namespace pvpgn
 				std::fprintf(fp, "\t\t<Channels>\n");
 				std::fprintf(fp, "\t\t<Number>%d</Number>\n", channellist_get_length());
 
-				LIST_TRAVERSE_CONST(channellist(), curr)
+				elist_for_each(curr, channellist())
 				{
-					channel = (t_channel*)elem_get_data(curr);
+					channel = channellist_get_channel(curr);
 					channel_name = channel_get_name(channel);
 					std::fprintf(fp, "\t\t<channel>%s</channel>\n", channel_name);
 				}
 
 				std::fprintf(fp, "\t\t</Channels>\n");
+				std::fprintf(fp, "\t\t<Presence>\n");
+				std::fprintf(fp, "\t\t\t<Sent>%lu</Sent>\n", presence_sent);
+				std::fprintf(fp, "\t\t\t<Saved>%lu</Saved>\n", presence_saved);
+				std::fprintf(fp, "\t\t</Presence>\n");
+				std::fprintf(fp, "\t\t<Memory>\n");
+				std::fprintf(fp, "\t\t\t<Used>%lu</Used>\n", mem.used / 1024);
+				std::fprintf(fp, "\t\t\t<Peak>%lu</Peak>\n", mem.peak / 1024);
+				std::fprintf(fp, "\t\t\t<Stage>%d</Stage>\n", (int)memlimit_get_stage());
+				std::fprintf(fp, "\t\t\t<Shed>%lu</Shed>\n", mem.shed);
+				std::fprintf(fp, "\t\t\t<Refused>%lu</Refused>\n", mem.refused);
+				std::fprintf(fp, "\t\t\t<Kicked>%lu</Kicked>\n", mem.kicked);
+				std::fprintf(fp, "\t\t</Memory>\n");
+				std::fprintf(fp, "\t\t<Attributes>\n");
+				std::fprintf(fp, "\t\t\t<Reads>%lu</Reads>\n", attrs.reads);
+				std::fprintf(fp, "\t\t\t<Saved>%lu</Saved>\n", attrs.saved);
+				std::fprintf(fp, "\t\t\t<SavedPerLogin>%lu</SavedPerLogin>\n", logins ? attrs.saved / logins : 0);
+				std::fprintf(fp, "\t\t\t<Keys>%u</Keys>\n", keys.keys);
+				std::fprintf(fp, "\t\t\t<Loaded>%lu</Loaded>\n", keys.refs);
+				std::fprintf(fp, "\t\t</Attributes>\n");
 				std::fprintf(fp, "</status>\n");
 				return 0;
 			}
 			else
 			{
 				std::fprintf(fp, "[STATUS]\nVersion=%s\nUptime=%s\nGames=%d\nUsers=%d\nChannels=%d\nUserAccounts=%d\n", PVPGN_VERSION, seconds_to_timestr(uptime), gamelist_get_length(), connlist_login_get_length(), channellist_get_length(), accountlist_get_length()); // Status
+				std::fprintf(fp, "PresenceSent=%lu\nPresenceSaved=%lu\n", presence_sent, presence_saved);
+				std::fprintf(fp, "MemUsed=%lu\nMemPeak=%lu\nMemStage=%d\nMemShed=%lu\nMemRefused=%lu\nMemKicked=%lu\n", mem.used / 1024, mem.peak / 1024, (int)memlimit_get_stage(), mem.shed, mem.refused, mem.kicked);
+				std::fprintf(fp, "AttrReads=%lu\nAttrSaved=%lu\nAttrSavedPerLogin=%lu\n", attrs.reads, attrs.saved, logins ? attrs.saved / logins : 0);
+				std::fprintf(fp, "AttrKeys=%u\nAttrLoaded=%lu\n", keys.keys, keys.refs);
 				std::fprintf(fp, "[CHANNELS]\n");
 				number = 1;
-				LIST_TRAVERSE_CONST(channellist(), curr)
+				elist_for_each(curr, channellist())
 				{
-					channel = (t_channel*)elem_get_data(curr);
+					channel = channellist_get_channel(curr);
 					channel_name = channel_get_name(channel);
 					std::fprintf(fp, "channel%d=%s\n", number, channel_name);
 					number++;
@@ -184,9 +222,9 @@ namespace pvpgn
 
 				std::fprintf(fp, "[USERS]\n");
 				number = 1;
-				LIST_TRAVERSE_CONST(connlist(), curr)
+				elist_for_each(curr, connlist())
 				{
-					conn = (t_connection*)elem_get_data(curr);
+					conn = connlist_get_conn(curr);
 					if (conn_get_account(conn))
 					{
 						std::fprintf(fp, "user%d=%s,%s,%s", number, tag_uint_to_str(clienttag_str, conn_get_clienttag(conn)), conn_get_username(conn), conn_get_clientver(conn));
@@ -43,6 +43,7 @@ namespace pvpgn
 			char const * storage_path;
 			char const * logfile;
 			char const * loglevels;
+			char const * logmodules;
 			char const * localizefile;
 			char const * motdfile;
 			char const * motdw3file;
@@ -108,6 +109,10 @@ namespace pvpgn
 			unsigned int quota_maxline;
 			unsigned int ladder_init_rating;
 			unsigned int quota_dobae;
+			unsigned int quota_ip_lines;
+			unsigned int quota_channel_lines;
+			unsigned int presence_coalesce_size;
+			unsigned int presence_coalesce_window;
 			char const * realmfile;
 			char const * issuefile;
 			char const * effective_user;
@@ -161,7 +166,30 @@ namespace pvpgn
 			char const * ladder_games;
 			char const * ladder_prefix;
 			unsigned int max_connections;
+			char const * fdwatch_backend;
 			unsigned int packet_limit;
+			unsigned int conn_read_packets;
+			unsigned int conn_read_bytes;
+			unsigned int conn_read_pause;
+			unsigned int close_timeout;
+			unsigned int close_halfclose;
+			unsigned int mem_budget;
+			unsigned int mem_conn_limit;
+			unsigned int flightrec_packets;
+			unsigned int flightrec_bytes;
+			unsigned int flightrec_sample;
+			unsigned int flightrec_auto_dumps;
+			char const * flightrec_file;
+			unsigned int memprof;
+			unsigned int memprof_secs;
+			char const * memprof_file;
+			unsigned int slowlog_threshold;
+			char const * cluster_node;
+			char const * cluster_addr;
+			char const * cluster_peers;
+			char const * cluster_secret;
+			unsigned int cluster_uid_stride;
+			unsigned int cluster_uid_offset;
 			unsigned int sync_on_logoff;
 			char const * irc_network_name;
 			unsigned int localize_by_country;
@@ -179,6 +207,7 @@ namespace pvpgn
 			char const * wol_autoupdate_serverhost;
 			char const * wol_autoupdate_username;
 			char const * wol_autoupdate_password;
+			unsigned int wol_match_region_wait;
 		} prefs_runtime_config;
 
 		static int conf_set_filedir(const char *valstr);
@@ -201,6 +230,10 @@ namespace pvpgn
 		static const char *conf_get_loglevels(void);
 		static int conf_setdef_loglevels(void);
 
+		static int conf_set_logmodules(const char *valstr);
+		static const char *conf_get_logmodules(void);
+		static int conf_setdef_logmodules(void);
+
 		static int conf_set_localizefile(const char *valstr);
 		static const char *conf_get_localizefile(void);
 		static int conf_setdef_localizefile(void);
@@ -453,6 +486,22 @@ namespace pvpgn
 		static const char *conf_get_quota_dobae(void);
 		static int conf_setdef_quota_dobae(void);
 
+		static int conf_set_quota_ip_lines(const char *valstr);
+		static const char *conf_get_quota_ip_lines(void);
+		static int conf_setdef_quota_ip_lines(void);
+
+		static int conf_set_quota_channel_lines(const char *valstr);
+		static const char *conf_get_quota_channel_lines(void);
+		static int conf_setdef_quota_channel_lines(void);
+
+		static int conf_set_presence_coalesce_size(const char *valstr);
+		static const char *conf_get_presence_coalesce_size(void);
+		static int conf_setdef_presence_coalesce_size(void);
+
+		static int conf_set_presence_coalesce_window(const char *valstr);
+		static const char *conf_get_presence_coalesce_window(void);
+		static int conf_setdef_presence_coalesce_window(void);
+
 		static int conf_set_realmfile(const char *valstr);
 		static const char *conf_get_realmfile(void);
 		static int conf_setdef_realmfile(void);
@@ -649,10 +698,102 @@ namespace pvpgn
 		static const char *conf_get_max_connections(void);
 		static int conf_setdef_max_connections(void);
 
+		static int conf_set_fdwatch_backend(const char *valstr);
+		static const char *conf_get_fdwatch_backend(void);
+		static int conf_setdef_fdwatch_backend(void);
+
 		static int conf_set_packet_limit(const char *valstr);
 		static const char *conf_get_packet_limit(void);
 		static int conf_setdef_packet_limit(void);
 
+		static int conf_set_conn_read_packets(const char *valstr);
+		static const char *conf_get_conn_read_packets(void);
+		static int conf_setdef_conn_read_packets(void);
+
+		static int conf_set_conn_read_bytes(const char *valstr);
+		static const char *conf_get_conn_read_bytes(void);
+		static int conf_setdef_conn_read_bytes(void);
+
+		static int conf_set_conn_read_pause(const char *valstr);
+		static const char *conf_get_conn_read_pause(void);
+		static int conf_setdef_conn_read_pause(void);
+
+		static int conf_set_close_timeout(const char *valstr);
+		static const char *conf_get_close_timeout(void);
+		static int conf_setdef_close_timeout(void);
+
+		static int conf_set_close_halfclose(const char *valstr);
+		static const char *conf_get_close_halfclose(void);
+		static int conf_setdef_close_halfclose(void);
+
+		static int conf_set_mem_budget(const char *valstr);
+		static const char *conf_get_mem_budget(void);
+		static int conf_setdef_mem_budget(void);
+
+		static int conf_set_mem_conn_limit(const char *valstr);
+		static const char *conf_get_mem_conn_limit(void);
+		static int conf_setdef_mem_conn_limit(void);
+
+		static int conf_set_flightrec_packets(const char *valstr);
+		static const char *conf_get_flightrec_packets(void);
+		static int conf_setdef_flightrec_packets(void);
+
+		static int conf_set_flightrec_bytes(const char *valstr);
+		static const char *conf_get_flightrec_bytes(void);
+		static int conf_setdef_flightrec_bytes(void);
+
+		static int conf_set_flightrec_sample(const char *valstr);
+		static const char *conf_get_flightrec_sample(void);
+		static int conf_setdef_flightrec_sample(void);
+
+		static int conf_set_flightrec_auto_dumps(const char *valstr);
+		static const char *conf_get_flightrec_auto_dumps(void);
+		static int conf_setdef_flightrec_auto_dumps(void);
+
+		static int conf_set_flightrec_file(const char *valstr);
+		static const char *conf_get_flightrec_file(void);
+		static int conf_setdef_flightrec_file(void);
+
+		static int conf_set_memprof(const char *valstr);
+		static const char *conf_get_memprof(void);
+		static int conf_setdef_memprof(void);
+
+		static int conf_set_memprof_secs(const char *valstr);
+		static const char *conf_get_memprof_secs(void);
+		static int conf_setdef_memprof_secs(void);
+
+		static int conf_set_memprof_file(const char *valstr);
+		static const char *conf_get_memprof_file(void);
+		static int conf_setdef_memprof_file(void);
+
+		static int conf_set_slowlog_threshold(const char *valstr);
+		static const char *conf_get_slowlog_threshold(void);
+		static int conf_setdef_slowlog_threshold(void);
+
+		static int conf_set_cluster_node(const char *valstr);
+		static const char *conf_get_cluster_node(void);
+		static int conf_setdef_cluster_node(void);
+
+		static int conf_set_cluster_addr(const char *valstr);
+		static const char *conf_get_cluster_addr(void);
+		static int conf_setdef_cluster_addr(void);
+
+		static int conf_set_cluster_peers(const char *valstr);
+		static const char *conf_get_cluster_peers(void);
+		static int conf_setdef_cluster_peers(void);
+
+		static int conf_set_cluster_secret(const char *valstr);
+		static const char *conf_get_cluster_secret(void);
+		static int conf_setdef_cluster_secret(void);
+
+		static int conf_set_cluster_uid_stride(const char *valstr);
+		static const char *conf_get_cluster_uid_stride(void);
+		static int conf_setdef_cluster_uid_stride(void);
+
+		static int conf_set_cluster_uid_offset(const char *valstr);
+		static const char *conf_get_cluster_uid_offset(void);
+		static int conf_setdef_cluster_uid_offset(void);
+
 		static int conf_set_sync_on_logoff(const char *valstr);
 		static const char *conf_get_sync_on_logoff(void);
 		static int conf_setdef_sync_on_logoff(void);
@@ -722,6 +863,10 @@ namespace pvpgn
 		static const char *conf_get_wol_autoupdate_password(void);
 		static int conf_setdef_wol_autoupdate_password(void);
 
+		static int conf_set_wol_match_region_wait(const char *valstr);
+		static const char *conf_get_wol_match_region_wait(void);
+		static int conf_setdef_wol_match_region_wait(void);
+
 		/*    directive                 set method                     get method         */
 		static t_conf_entry conf_table[] =
 		{
@@ -730,6 +875,7 @@ namespace pvpgn
 			{ "storage_path", conf_set_storage_path, conf_get_storage_path, conf_setdef_storage_path },
 			{ "logfile", conf_set_logfile, conf_get_logfile, conf_setdef_logfile },
 			{ "loglevels", conf_set_loglevels, conf_get_loglevels, conf_setdef_loglevels },
+			{ "logmodules", conf_set_logmodules, conf_get_logmodules, conf_setdef_logmodules },
 			{ "localizefile", conf_set_localizefile, conf_get_localizefile, conf_setdef_localizefile },
 			{ "motdfile", conf_set_motdfile, conf_get_motdfile, conf_setdef_motdfile },
 			{ "motdw3file", conf_set_motdw3file, conf_get_motdw3file, conf_setdef_motdw3file },
@@ -793,6 +939,10 @@ namespace pvpgn
 			{ "quota_maxline", conf_set_quota_maxline, conf_get_quota_maxline, conf_setdef_quota_maxline },
 			{ "ladder_init_rating", conf_set_ladder_init_rating, conf_get_ladder_init_rating, conf_setdef_ladder_init_rating },
 			{ "quota_dobae", conf_set_quota_dobae, conf_get_quota_dobae, conf_setdef_quota_dobae },
+			{ "quota_ip_lines", conf_set_quota_ip_lines, conf_get_quota_ip_lines, conf_setdef_quota_ip_lines },
+			{ "quota_channel_lines", conf_set_quota_channel_lines, conf_get_quota_channel_lines, conf_setdef_quota_channel_lines },
+			{ "presence_coalesce_size", conf_set_presence_coalesce_size, conf_get_presence_coalesce_size, conf_setdef_presence_coalesce_size },
+			{ "presence_coalesce_window", conf_set_presence_coalesce_window, conf_get_presence_coalesce_window, conf_setdef_presence_coalesce_window },
 			{ "realmfile", conf_set_realmfile, conf_get_realmfile, conf_setdef_realmfile },
 			{ "issuefile", conf_set_issuefile, conf_get_issuefile, conf_setdef_issuefile },
 			{ "effective_user", conf_set_effective_user, conf_get_effective_user, conf_setdef_effective_user },
@@ -842,7 +992,30 @@ namespace pvpgn
 			{ "allowed_clients", conf_set_allowed_clients, conf_get_allowed_clients, conf_setdef_allowed_clients },
 			{ "ladder_games", conf_set_ladder_games, conf_get_ladder_games, conf_setdef_ladder_games },
 			{ "max_connections", conf_set_max_connections, conf_get_max_connections, conf_setdef_max_connections },
+			{ "fdwatch_backend", conf_set_fdwatch_backend, conf_get_fdwatch_backend, conf_setdef_fdwatch_backend },
 			{ "packet_limit", conf_set_packet_limit, conf_get_packet_limit, conf_setdef_packet_limit },
+			{ "conn_read_packets", conf_set_conn_read_packets, conf_get_conn_read_packets, conf_setdef_conn_read_packets },
+			{ "conn_read_bytes", conf_set_conn_read_bytes, conf_get_conn_read_bytes, conf_setdef_conn_read_bytes },
+			{ "conn_read_pause", conf_set_conn_read_pause, conf_get_conn_read_pause, conf_setdef_conn_read_pause },
+			{ "close_timeout", conf_set_close_timeout, conf_get_close_timeout, conf_setdef_close_timeout },
+			{ "close_halfclose", conf_set_close_halfclose, conf_get_close_halfclose, conf_setdef_close_halfclose },
+			{ "mem_budget", conf_set_mem_budget, conf_get_mem_budget, conf_setdef_mem_budget },
+			{ "mem_conn_limit", conf_set_mem_conn_limit, conf_get_mem_conn_limit, conf_setdef_mem_conn_limit },
+			{ "flightrec_packets", conf_set_flightrec_packets, conf_get_flightrec_packets, conf_setdef_flightrec_packets },
+			{ "flightrec_bytes", conf_set_flightrec_bytes, conf_get_flightrec_bytes, conf_setdef_flightrec_bytes },
+			{ "flightrec_sample", conf_set_flightrec_sample, conf_get_flightrec_sample, conf_setdef_flightrec_sample },
+			{ "flightrec_auto_dumps", conf_set_flightrec_auto_dumps, conf_get_flightrec_auto_dumps, conf_setdef_flightrec_auto_dumps },
+			{ "flightrec_file", conf_set_flightrec_file, conf_get_flightrec_file, conf_setdef_flightrec_file },
+			{ "memprof", conf_set_memprof, conf_get_memprof, conf_setdef_memprof },
+			{ "memprof_secs", conf_set_memprof_secs, conf_get_memprof_secs, conf_setdef_memprof_secs },
+			{ "memprof_file", conf_set_memprof_file, conf_get_memprof_file, conf_setdef_memprof_file },
+			{ "slowlog_threshold", conf_set_slowlog_threshold, conf_get_slowlog_threshold, conf_setdef_slowlog_threshold },
+			{ "cluster_node", conf_set_cluster_node, conf_get_cluster_node, conf_setdef_cluster_node },
+			{ "cluster_addr", conf_set_cluster_addr, conf_get_cluster_addr, conf_setdef_cluster_addr },
+			{ "cluster_peers", conf_set_cluster_peers, conf_get_cluster_peers, conf_setdef_cluster_peers },
+			{ "cluster_secret", conf_set_cluster_secret, conf_get_cluster_secret, conf_setdef_cluster_secret },
+			{ "cluster_uid_stride", conf_set_cluster_uid_stride, conf_get_cluster_uid_stride, conf_setdef_cluster_uid_stride },
+			{ "cluster_uid_offset", conf_set_cluster_uid_offset, conf_get_cluster_uid_offset, conf_setdef_cluster_uid_offset },
 			{ "sync_on_logoff", conf_set_sync_on_logoff, conf_get_sync_on_logoff, conf_setdef_sync_on_logoff },
 			{ "ladder_prefix", conf_set_ladder_prefix, conf_get_ladder_prefix, conf_setdef_ladder_prefix },
 			{ "irc_network_name", conf_set_irc_network_name, conf_get_irc_network_name, conf_setdef_irc_network_name },
@@ -861,6 +1034,7 @@ namespace pvpgn
 			{ "wol_autoupdate_serverhost", conf_set_wol_autoupdate_serverhost, conf_get_wol_autoupdate_serverhost, conf_setdef_wol_autoupdate_serverhost },
 			{ "wol_autoupdate_username", conf_set_wol_autoupdate_username, conf_get_wol_autoupdate_username, conf_setdef_wol_autoupdate_username },
 			{ "wol_autoupdate_password", conf_set_wol_autoupdate_password, conf_get_wol_autoupdate_password, conf_setdef_wol_autoupdate_password },
+			{ "wol_match_region_wait", conf_set_wol_match_region_wait, conf_get_wol_match_region_wait, conf_setdef_wol_match_region_wait },
 
 			{ NULL, NULL, NULL, NONE },
 		};
@@ -1002,6 +1176,27 @@ namespace pvpgn
 		}
 
 
+		extern char const * prefs_get_logmodules(void)
+		{
+			return prefs_runtime_config.logmodules;
+		}
+
+		static int conf_set_logmodules(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.logmodules, valstr, NULL);
+		}
+
+		static int conf_setdef_logmodules(void)
+		{
+			return conf_set_str(&prefs_runtime_config.logmodules, NULL, "");
+		}
+
+		static const char* conf_get_logmodules(void)
+		{
+			return prefs_runtime_config.logmodules;
+		}
+
+
 		extern char const * prefs_get_localizefile(void)
 		{
 			return prefs_runtime_config.localizefile;
@@ -2333,6 +2528,103 @@ namespace pvpgn
 		}
 
 
+		extern unsigned int prefs_get_quota_ip_lines(void)
+		{
+			unsigned int rez;
+
+			rez = prefs_runtime_config.quota_ip_lines;
+			if (rez>1000) rez = 1000;
+			return rez;
+		}
+
+		static int conf_set_quota_ip_lines(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.quota_ip_lines, valstr, 0);
+		}
+
+		static int conf_setdef_quota_ip_lines(void)
+		{
+			return conf_set_int(&prefs_runtime_config.quota_ip_lines, NULL, 0);
+		}
+
+		static const char* conf_get_quota_ip_lines(void)
+		{
+			return conf_get_int(prefs_runtime_config.quota_ip_lines);
+		}
+
+
+		extern unsigned int prefs_get_quota_channel_lines(void)
+		{
+			unsigned int rez;
+
+			rez = prefs_runtime_config.quota_channel_lines;
+			if (rez>1000) rez = 1000;
+			return rez;
+		}
+
+		static int conf_set_quota_channel_lines(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.quota_channel_lines, valstr, 0);
+		}
+
+		static int conf_setdef_quota_channel_lines(void)
+		{
+			return conf_set_int(&prefs_runtime_config.quota_channel_lines, NULL, 0);
+		}
+
+		static const char* conf_get_quota_channel_lines(void)
+		{
+			return conf_get_int(prefs_runtime_config.quota_channel_lines);
+		}
+
+
+		extern unsigned int prefs_get_presence_coalesce_size(void)
+		{
+			return prefs_runtime_config.presence_coalesce_size;
+		}
+
+		static int conf_set_presence_coalesce_size(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.presence_coalesce_size, valstr, 0);
+		}
+
+		static int conf_setdef_presence_coalesce_size(void)
+		{
+			return conf_set_int(&prefs_runtime_config.presence_coalesce_size, NULL, 0);
+		}
+
+		static const char* conf_get_presence_coalesce_size(void)
+		{
+			return conf_get_int(prefs_runtime_config.presence_coalesce_size);
+		}
+
+
+		extern unsigned int prefs_get_presence_coalesce_window(void)
+		{
+			unsigned int rez;
+
+			rez = prefs_runtime_config.presence_coalesce_window;
+			if (rez<1) rez = 1;
+			if (rez>60) rez = 60;
+			return rez;
+		}
+
+		static int conf_set_presence_coalesce_window(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.presence_coalesce_window, valstr, 0);
+		}
+
+		static int conf_setdef_presence_coalesce_window(void)
+		{
+			return conf_set_int(&prefs_runtime_config.presence_coalesce_window, NULL, BNETD_PRESENCE_WINDOW);
+		}
+
+		static const char* conf_get_presence_coalesce_window(void)
+		{
+			return conf_get_int(prefs_runtime_config.presence_coalesce_window);
+		}
+
+
 		extern char const * prefs_get_realmfile(void)
 		{
 			return prefs_runtime_config.realmfile;
@@ -3417,6 +3709,27 @@ namespace pvpgn
 		}
 
 
+		extern char const * prefs_get_fdwatch_backend(void)
+		{
+			return prefs_runtime_config.fdwatch_backend;
+		}
+
+		static int conf_set_fdwatch_backend(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.fdwatch_backend, valstr, NULL);
+		}
+
+		static int conf_setdef_fdwatch_backend(void)
+		{
+			return conf_set_str(&prefs_runtime_config.fdwatch_backend, NULL, "");
+		}
+
+		static const char* conf_get_fdwatch_backend(void)
+		{
+			return prefs_runtime_config.fdwatch_backend;
+		}
+
+
 		extern unsigned int prefs_get_packet_limit(void)
 		{
 			return prefs_runtime_config.packet_limit;
@@ -3438,6 +3751,468 @@ namespace pvpgn
 		}
 
 
+		extern unsigned int prefs_get_conn_read_packets(void)
+		{
+			return prefs_runtime_config.conn_read_packets;
+		}
+
+		static int conf_set_conn_read_packets(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.conn_read_packets, valstr, 0);
+		}
+
+		static int conf_setdef_conn_read_packets(void)
+		{
+			return conf_set_int(&prefs_runtime_config.conn_read_packets, NULL, BNETD_READ_PACKETS);
+		}
+
+		static const char* conf_get_conn_read_packets(void)
+		{
+			return conf_get_int(prefs_runtime_config.conn_read_packets);
+		}
+
+
+		extern unsigned int prefs_get_conn_read_bytes(void)
+		{
+			return prefs_runtime_config.conn_read_bytes;
+		}
+
+		static int conf_set_conn_read_bytes(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.conn_read_bytes, valstr, 0);
+		}
+
+		static int conf_setdef_conn_read_bytes(void)
+		{
+			return conf_set_int(&prefs_runtime_config.conn_read_bytes, NULL, BNETD_READ_BYTES);
+		}
+
+		static const char* conf_get_conn_read_bytes(void)
+		{
+			return conf_get_int(prefs_runtime_config.conn_read_bytes);
+		}
+
+
+		extern unsigned int prefs_get_conn_read_pause(void)
+		{
+			return prefs_runtime_config.conn_read_pause;
+		}
+
+		static int conf_set_conn_read_pause(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.conn_read_pause, valstr, 0);
+		}
+
+		static int conf_setdef_conn_read_pause(void)
+		{
+			return conf_set_int(&prefs_runtime_config.conn_read_pause, NULL, BNETD_READ_PAUSE);
+		}
+
+		static const char* conf_get_conn_read_pause(void)
+		{
+			return conf_get_int(prefs_runtime_config.conn_read_pause);
+		}
+
+
+		extern unsigned int prefs_get_close_timeout(void)
+		{
+			return prefs_runtime_config.close_timeout;
+		}
+
+		static int conf_set_close_timeout(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.close_timeout, valstr, 0);
+		}
+
+		static int conf_setdef_close_timeout(void)
+		{
+			return conf_set_int(&prefs_runtime_config.close_timeout, NULL, BNETD_CLOSE_TIMEOUT);
+		}
+
+		static const char* conf_get_close_timeout(void)
+		{
+			return conf_get_int(prefs_runtime_config.close_timeout);
+		}
+
+
+		extern unsigned int prefs_get_close_halfclose(void)
+		{
+			return prefs_runtime_config.close_halfclose;
+		}
+
+		static int conf_set_close_halfclose(const char *valstr)
+		{
+			return conf_set_bool(&prefs_runtime_config.close_halfclose, valstr, 0);
+		}
+
+		static int conf_setdef_close_halfclose(void)
+		{
+			return conf_set_bool(&prefs_runtime_config.close_halfclose, NULL, 0);
+		}
+
+		static const char* conf_get_close_halfclose(void)
+		{
+			return conf_get_bool(prefs_runtime_config.close_halfclose);
+		}
+
+
+		extern unsigned int prefs_get_mem_budget(void)
+		{
+			return prefs_runtime_config.mem_budget;
+		}
+
+		static int conf_set_mem_budget(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.mem_budget, valstr, 0);
+		}
+
+		static int conf_setdef_mem_budget(void)
+		{
+			return conf_set_int(&prefs_runtime_config.mem_budget, NULL, 0);
+		}
+
+		static const char* conf_get_mem_budget(void)
+		{
+			return conf_get_int(prefs_runtime_config.mem_budget);
+		}
+
+
+		extern unsigned int prefs_get_mem_conn_limit(void)
+		{
+			return prefs_runtime_config.mem_conn_limit;
+		}
+
+		static int conf_set_mem_conn_limit(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.mem_conn_limit, valstr, 0);
+		}
+
+		static int conf_setdef_mem_conn_limit(void)
+		{
+			return conf_set_int(&prefs_runtime_config.mem_conn_limit, NULL, 0);
+		}
+
+		static const char* conf_get_mem_conn_limit(void)
+		{
+			return conf_get_int(prefs_runtime_config.mem_conn_limit);
+		}
+
+
+		extern unsigned int prefs_get_flightrec_packets(void)
+		{
+			return prefs_runtime_config.flightrec_packets;
+		}
+
+		static int conf_set_flightrec_packets(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_packets, valstr, 16);
+		}
+
+		static int conf_setdef_flightrec_packets(void)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_packets, NULL, 16);
+		}
+
+		static const char* conf_get_flightrec_packets(void)
+		{
+			return conf_get_int(prefs_runtime_config.flightrec_packets);
+		}
+
+
+		extern unsigned int prefs_get_flightrec_bytes(void)
+		{
+			return prefs_runtime_config.flightrec_bytes;
+		}
+
+		static int conf_set_flightrec_bytes(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_bytes, valstr, 64);
+		}
+
+		static int conf_setdef_flightrec_bytes(void)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_bytes, NULL, 64);
+		}
+
+		static const char* conf_get_flightrec_bytes(void)
+		{
+			return conf_get_int(prefs_runtime_config.flightrec_bytes);
+		}
+
+
+		extern unsigned int prefs_get_flightrec_sample(void)
+		{
+			return prefs_runtime_config.flightrec_sample;
+		}
+
+		static int conf_set_flightrec_sample(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_sample, valstr, 64);
+		}
+
+		static int conf_setdef_flightrec_sample(void)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_sample, NULL, 64);
+		}
+
+		static const char* conf_get_flightrec_sample(void)
+		{
+			return conf_get_int(prefs_runtime_config.flightrec_sample);
+		}
+
+
+		extern unsigned int prefs_get_flightrec_auto_dumps(void)
+		{
+			return prefs_runtime_config.flightrec_auto_dumps;
+		}
+
+		static int conf_set_flightrec_auto_dumps(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_auto_dumps, valstr, 10);
+		}
+
+		static int conf_setdef_flightrec_auto_dumps(void)
+		{
+			return conf_set_int(&prefs_runtime_config.flightrec_auto_dumps, NULL, 10);
+		}
+
+		static const char* conf_get_flightrec_auto_dumps(void)
+		{
+			return conf_get_int(prefs_runtime_config.flightrec_auto_dumps);
+		}
+
+
+		extern char const * prefs_get_flightrec_file(void)
+		{
+			return prefs_runtime_config.flightrec_file;
+		}
+
+		static int conf_set_flightrec_file(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.flightrec_file, valstr, NULL);
+		}
+
+		static int conf_setdef_flightrec_file(void)
+		{
+			return conf_set_str(&prefs_runtime_config.flightrec_file, NULL, BNETD_FLIGHTREC_FILE);
+		}
+
+		static const char* conf_get_flightrec_file(void)
+		{
+			return prefs_runtime_config.flightrec_file;
+		}
+
+
+		extern unsigned int prefs_get_memprof(void)
+		{
+			return prefs_runtime_config.memprof;
+		}
+
+		static int conf_set_memprof(const char *valstr)
+		{
+			return conf_set_bool(&prefs_runtime_config.memprof, valstr, 0);
+		}
+
+		static int conf_setdef_memprof(void)
+		{
+			return conf_set_bool(&prefs_runtime_config.memprof, NULL, 0);
+		}
+
+		static const char* conf_get_memprof(void)
+		{
+			return conf_get_bool(prefs_runtime_config.memprof);
+		}
+
+
+		extern unsigned int prefs_get_memprof_secs(void)
+		{
+			return prefs_runtime_config.memprof_secs;
+		}
+
+		static int conf_set_memprof_secs(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.memprof_secs, valstr, 300);
+		}
+
+		static int conf_setdef_memprof_secs(void)
+		{
+			return conf_set_int(&prefs_runtime_config.memprof_secs, NULL, 300);
+		}
+
+		static const char* conf_get_memprof_secs(void)
+		{
+			return conf_get_int(prefs_runtime_config.memprof_secs);
+		}
+
+
+		extern char const * prefs_get_memprof_file(void)
+		{
+			return prefs_runtime_config.memprof_file;
+		}
+
+		static int conf_set_memprof_file(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.memprof_file, valstr, NULL);
+		}
+
+		static int conf_setdef_memprof_file(void)
+		{
+			return conf_set_str(&prefs_runtime_config.memprof_file, NULL, BNETD_MEMPROF_FILE);
+		}
+
+		static const char* conf_get_memprof_file(void)
+		{
+			return prefs_runtime_config.memprof_file;
+		}
+
+
+		extern unsigned int prefs_get_slowlog_threshold(void)
+		{
+			return prefs_runtime_config.slowlog_threshold;
+		}
+
+		static int conf_set_slowlog_threshold(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.slowlog_threshold, valstr, 100);
+		}
+
+		static int conf_setdef_slowlog_threshold(void)
+		{
+			return conf_set_int(&prefs_runtime_config.slowlog_threshold, NULL, 100);
+		}
+
+		static const char* conf_get_slowlog_threshold(void)
+		{
+			return conf_get_int(prefs_runtime_config.slowlog_threshold);
+		}
+
+
+		extern char const * prefs_get_cluster_node(void)
+		{
+			return prefs_runtime_config.cluster_node;
+		}
+
+		static int conf_set_cluster_node(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_node, valstr, NULL);
+		}
+
+		static int conf_setdef_cluster_node(void)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_node, NULL, "");
+		}
+
+		static const char* conf_get_cluster_node(void)
+		{
+			return prefs_runtime_config.cluster_node;
+		}
+
+
+		extern char const * prefs_get_cluster_addr(void)
+		{
+			return prefs_runtime_config.cluster_addr;
+		}
+
+		static int conf_set_cluster_addr(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_addr, valstr, NULL);
+		}
+
+		static int conf_setdef_cluster_addr(void)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_addr, NULL, BNETD_CLUSTER_ADDR);
+		}
+
+		static const char* conf_get_cluster_addr(void)
+		{
+			return prefs_runtime_config.cluster_addr;
+		}
+
+
+		extern char const * prefs_get_cluster_peers(void)
+		{
+			return prefs_runtime_config.cluster_peers;
+		}
+
+		static int conf_set_cluster_peers(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_peers, valstr, NULL);
+		}
+
+		static int conf_setdef_cluster_peers(void)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_peers, NULL, "");
+		}
+
+		static const char* conf_get_cluster_peers(void)
+		{
+			return prefs_runtime_config.cluster_peers;
+		}
+
+
+		extern char const * prefs_get_cluster_secret(void)
+		{
+			return prefs_runtime_config.cluster_secret;
+		}
+
+		static int conf_set_cluster_secret(const char *valstr)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_secret, valstr, NULL);
+		}
+
+		static int conf_setdef_cluster_secret(void)
+		{
+			return conf_set_str(&prefs_runtime_config.cluster_secret, NULL, "");
+		}
+
+		static const char* conf_get_cluster_secret(void)
+		{
+			return prefs_runtime_config.cluster_secret;
+		}
+
+
+		extern unsigned int prefs_get_cluster_uid_stride(void)
+		{
+			return prefs_runtime_config.cluster_uid_stride;
+		}
+
+		static int conf_set_cluster_uid_stride(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.cluster_uid_stride, valstr, 16);
+		}
+
+		static int conf_setdef_cluster_uid_stride(void)
+		{
+			return conf_set_int(&prefs_runtime_config.cluster_uid_stride, NULL, 16);
+		}
+
+		static const char* conf_get_cluster_uid_stride(void)
+		{
+			return conf_get_int(prefs_runtime_config.cluster_uid_stride);
+		}
+
+
+		extern unsigned int prefs_get_cluster_uid_offset(void)
+		{
+			return prefs_runtime_config.cluster_uid_offset;
+		}
+
+		static int conf_set_cluster_uid_offset(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.cluster_uid_offset, valstr, 0);
+		}
+
+		static int conf_setdef_cluster_uid_offset(void)
+		{
+			return conf_set_int(&prefs_runtime_config.cluster_uid_offset, NULL, 0);
+		}
+
+		static const char* conf_get_cluster_uid_offset(void)
+		{
+			return conf_get_int(prefs_runtime_config.cluster_uid_offset);
+		}
+
+
 		extern unsigned int prefs_get_sync_on_logoff(void)
 		{
 			return prefs_runtime_config.sync_on_logoff;
@@ -3767,6 +4542,26 @@ namespace pvpgn
 			return conf_set_str(&prefs_runtime_config.wol_autoupdate_password, NULL, 0);
 		}
 
+		extern unsigned int prefs_get_wol_match_region_wait(void)
+		{
+			return prefs_runtime_config.wol_match_region_wait;
+		}
+
+		static int conf_set_wol_match_region_wait(const char *valstr)
+		{
+			return conf_set_int(&prefs_runtime_config.wol_match_region_wait, valstr, 0);
+		}
+
+		static int conf_setdef_wol_match_region_wait(void)
+		{
+			return conf_set_int(&prefs_runtime_config.wol_match_region_wait, NULL, 0);
+		}
+
+		static const char* conf_get_wol_match_region_wait(void)
+		{
+			return conf_get_int(prefs_runtime_config.wol_match_region_wait);
+		}
+
 	}
 
 }
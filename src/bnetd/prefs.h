@@ -40,6 +40,7 @@ namespace pvpgn
 		extern char const * prefs_get_i18ndir(void);
 		extern char const * prefs_get_logfile(void);
 		extern char const * prefs_get_loglevels(void);
+		extern char const * prefs_get_logmodules(void);
 		extern char const * prefs_get_localizefile(void);
 		extern char const * prefs_get_motdfile(void);
 		extern char const * prefs_get_motdw3file(void);
@@ -103,6 +104,10 @@ namespace pvpgn
 		extern unsigned int prefs_get_quota_maxline(void);
 		extern unsigned int prefs_get_ladder_init_rating(void);
 		extern unsigned int prefs_get_quota_dobae(void);
+		extern unsigned int prefs_get_quota_ip_lines(void);
+		extern unsigned int prefs_get_quota_channel_lines(void);
+		extern unsigned int prefs_get_presence_coalesce_size(void);
+		extern unsigned int prefs_get_presence_coalesce_window(void);
 		extern char const * prefs_get_realmfile(void);
 		extern char const * prefs_get_issuefile(void);
 		extern char const * prefs_get_effective_user(void);
@@ -175,7 +180,30 @@ namespace pvpgn
 		extern char const * prefs_get_ladder_games(void);
 		extern char const * prefs_get_ladder_prefix(void);
 		extern unsigned int prefs_get_max_connections(void);
+		extern char const * prefs_get_fdwatch_backend(void);
 		extern unsigned int prefs_get_packet_limit(void);
+		extern unsigned int prefs_get_conn_read_packets(void);
+		extern unsigned int prefs_get_conn_read_bytes(void);
+		extern unsigned int prefs_get_conn_read_pause(void);
+		extern unsigned int prefs_get_close_timeout(void);
+		extern unsigned int prefs_get_close_halfclose(void);
+		extern unsigned int prefs_get_mem_budget(void);
+		extern unsigned int prefs_get_mem_conn_limit(void);
+		extern unsigned int prefs_get_flightrec_packets(void);
+		extern unsigned int prefs_get_flightrec_bytes(void);
+		extern unsigned int prefs_get_flightrec_sample(void);
+		extern unsigned int prefs_get_flightrec_auto_dumps(void);
+		extern char const * prefs_get_flightrec_file(void);
+		extern unsigned int prefs_get_memprof(void);
+		extern unsigned int prefs_get_memprof_secs(void);
+		extern char const * prefs_get_memprof_file(void);
+		extern unsigned int prefs_get_slowlog_threshold(void);
+		extern char const * prefs_get_cluster_node(void);
+		extern char const * prefs_get_cluster_addr(void);
+		extern char const * prefs_get_cluster_peers(void);
+		extern char const * prefs_get_cluster_secret(void);
+		extern unsigned int prefs_get_cluster_uid_stride(void);
+		extern unsigned int prefs_get_cluster_uid_offset(void);
 		extern unsigned int prefs_get_sync_on_logoff(void);
 		extern char const * prefs_get_irc_network_name(void);
 		extern unsigned int prefs_get_localize_by_country(void);
@@ -196,6 +224,7 @@ namespace pvpgn
 		extern char const * prefs_get_wol_autoupdate_serverhost(void);
 		extern char const * prefs_get_wol_autoupdate_username(void);
 		extern char const * prefs_get_wol_autoupdate_password(void);
+		extern unsigned int prefs_get_wol_match_region_wait(void);
 	}
 
 }
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2000  Dizzy
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "quota.h"
+
+#include <cstring>
+
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* the per address buckets live in a fixed open addressing table */
+		static const unsigned int quota_addr_table_size = 4096; /* must be a power of 2 */
+		static const unsigned int quota_addr_probes = 8;
+		/* upper bound for a bucket level so a flooder can't overflow it */
+		static const unsigned int quota_level_max = 1U << 24;
+
+		typedef struct
+		{
+			unsigned int addr;
+			t_quota      quota;
+		} t_quota_addr;
+
+		static t_quota_addr quota_addr_table[quota_addr_table_size];
+
+
+		static void quota_drain(t_quota * quota, std::time_t now, unsigned int lines)
+		{
+			std::time_t elapsed;
+
+			if (now <= quota->last)
+				return;
+
+			elapsed = now - quota->last;
+			quota->last = now;
+			if (quota->level == 0)
+				return;
+			if ((unsigned long)elapsed >= (unsigned long)(quota->level / lines + 1))
+				quota->level = 0;
+			else
+			{
+				unsigned long drained = (unsigned long)elapsed * lines;
+				quota->level = (drained >= quota->level) ? 0 : quota->level - (unsigned int)drained;
+			}
+		}
+
+
+		extern void quota_init(t_quota * quota)
+		{
+			quota->level = 0;
+			quota->last = 0;
+		}
+
+
+		/*
+		 * Account for "count" lines and return how many lines are now in the
+		 * bucket. A caller configured for "lines per period" considers the quota
+		 * exceeded when the result reaches "lines".
+		 */
+		extern unsigned int quota_add(t_quota * quota, unsigned int count, std::time_t now, unsigned int lines, unsigned int period)
+		{
+			if (lines < 1)
+				lines = 1;
+			if (period < 1)
+				period = 1;
+
+			quota_drain(quota, now, lines);
+
+			if (count > (quota_level_max - quota->level) / period)
+				quota->level = quota_level_max;
+			else
+				quota->level += count * period;
+
+			return quota->level / period;
+		}
+
+
+		/*
+		 * Return the aggregate bucket shared by all connections from "addr", or
+		 * NULL if no slot is available (in which case the address is not limited).
+		 */
+		extern t_quota * quota_get_by_addr(unsigned int addr, std::time_t now, unsigned int lines, unsigned int period)
+		{
+			unsigned int hash;
+			unsigned int i;
+			t_quota_addr * slot;
+			t_quota_addr * freeslot = NULL;
+
+			if (lines < 1)
+				lines = 1;
+
+			hash = addr * 2654435761U;
+			hash ^= hash >> 16;
+			for (i = 0; i < quota_addr_probes; i++)
+			{
+				slot = &quota_addr_table[(hash + i) & (quota_addr_table_size - 1)];
+				if (slot->addr == addr && slot->quota.last != 0)
+					return &slot->quota;
+				if (!freeslot)
+				{
+					quota_drain(&slot->quota, now, lines);
+					if (slot->quota.level == 0)
+						freeslot = slot;
+				}
+			}
+
+			if (!freeslot)
+				return NULL;
+
+			freeslot->addr = addr;
+			freeslot->quota.level = 0;
+			freeslot->quota.last = now;
+			return &freeslot->quota;
+		}
+
+
+		extern void quota_addr_reset(void)
+		{
+			std::memset(quota_addr_table, 0, sizeof(quota_addr_table));
+		}
+
+	}
+
+}
@@ -20,30 +20,22 @@
 
 #include <ctime>
 
-#ifdef JUST_NEED_TYPES
-# include "common/list.h"
-#else
-# define JUST_NEED_TYPES
-# include "common/list.h"
-# undef JUST_NEED_TYPES
-#endif
-
 namespace pvpgn
 {
 
 	namespace bnetd
 	{
 
+		/*
+		 * Leaky bucket flood meter. The level is kept in "line-seconds": every
+		 * line adds quota_time units and every elapsed second drains quota_lines
+		 * units, so level/quota_time is the number of lines still "in" the
+		 * quota_time window. No memory is allocated per line.
+		 */
 		typedef struct
 		{
-			std::time_t	 inf;
-			unsigned int count;
-		} t_qline;
-
-		typedef struct
-		{
-			unsigned int totcount;
-			t_list *     list;
+			unsigned int level;
+			std::time_t  last;
 		} t_quota;
 
 	}
@@ -51,3 +43,27 @@ namespace pvpgn
 }
 
 #endif
+
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_QUOTA_PROTOS
+#define INCLUDED_QUOTA_PROTOS
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		extern void quota_init(t_quota * quota);
+		extern unsigned int quota_add(t_quota * quota, unsigned int count, std::time_t now, unsigned int lines, unsigned int period);
+		extern t_quota * quota_get_by_addr(unsigned int addr, std::time_t now, unsigned int lines, unsigned int period);
+		extern void quota_addr_reset(void);
+
+	}
+
+}
+
+#endif
+#endif
@@ -44,10 +44,12 @@ namespace pvpgn
 
 		static t_list * realmlist_head = NULL;
 
-		static t_realm * realm_create(char const * name, char const * description, unsigned int ip, unsigned int port);
+		static t_realm * realm_create(char const * name, char const * description);
 		static int realm_destroy(t_realm * realm);
+		static int realm_add_server(t_realm * realm, unsigned int ip, unsigned short port);
+		static void realm_server_deactive(t_realm * realm, t_realm_server * server);
 
-		static t_realm * realm_create(char const * name, char const * description, unsigned int ip, unsigned int port)
+		static t_realm * realm_create(char const * name, char const * description)
 		{
 			t_realm * realm;
 
@@ -74,14 +76,10 @@ namespace pvpgn
 			}
 			if (realm->description != NULL) xfree((void *)realm->description);
 			realm->description = xstrdup(description);
-			realm->ip = ip;
-			realm->port = port;
-			realm->conn = NULL;
 			realm->active = 0;
 			realm->player_number = 0;
 			realm->game_number = 0;
-			realm->sessionnum = 0;
-			realm->tcp_sock = 0;
+			realm->servers = list_create();
 			rcm_init(&realm->rcm);
 
 			eventlog(eventlog_level_info, __FUNCTION__, "created realm \"{}\"", name);
@@ -91,14 +89,24 @@ namespace pvpgn
 
 		static int realm_destroy(t_realm * realm)
 		{
+			t_elem * curr;
+			t_realm_server * server;
+
 			if (!realm)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
 				return -1;
 			}
 
-			if (realm->active)
-				realm_deactive(realm);
+			LIST_TRAVERSE(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->active)
+					realm_server_deactive(realm, server);
+				xfree((void *)server);
+				list_remove_elem(realm->servers, &curr);
+			}
+			list_destroy(realm->servers);
 
 			xfree((void *)realm->name); /* avoid warning */
 			xfree((void *)realm->description); /* avoid warning */
@@ -108,6 +116,34 @@ namespace pvpgn
 		}
 
 
+		static int realm_add_server(t_realm * realm, unsigned int ip, unsigned short port)
+		{
+			t_elem const * curr;
+			t_realm_server * server;
+
+			LIST_TRAVERSE_CONST(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->ip == ip && server->port == port)
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "realm \"{}\" already has d2cs {}", realm->name, addr_num_to_addr_str(ip, port));
+					return -1;
+				}
+			}
+
+			server = (t_realm_server*)xmalloc(sizeof(t_realm_server));
+			server->ip = ip;
+			server->port = port;
+			server->active = 0;
+			server->tcp_sock = 0;
+			server->conn = NULL;
+			server->player_number = 0;
+			list_append_data(realm->servers, server);
+
+			return 0;
+		}
+
+
 		extern char const * realm_get_name(t_realm const * realm)
 		{
 			if (!realm)
@@ -164,28 +200,6 @@ namespace pvpgn
 		}
 
 
-		extern unsigned short realm_get_port(t_realm const * realm)
-		{
-			if (!realm)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
-				return 0;
-			}
-			return realm->port;
-		}
-
-
-		extern unsigned int realm_get_ip(t_realm const * realm)
-		{
-			if (!realm)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
-				return 0;
-			}
-			return realm->ip;
-		}
-
-
 		extern unsigned int realm_get_active(t_realm const * realm)
 		{
 			if (!realm)
@@ -196,18 +210,6 @@ namespace pvpgn
 			return realm->active;
 		}
 
-		extern int realm_set_active(t_realm * realm, unsigned int active)
-		{
-			if (!realm)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
-				return -1;
-			}
-
-			realm->active = active;
-			return 0;
-		}
-
 		extern unsigned int realm_get_player_number(t_realm const * realm)
 		{
 			if (!realm)
@@ -250,8 +252,49 @@ namespace pvpgn
 			return 0;
 		}
 
-		extern int realm_active(t_realm * realm, t_connection * c)
+		/*
+		 * Which realm line a d2cs registers as. Newer d2cs tell the port they
+		 * listen on; older ones only have their address, those take the first
+		 * line with it that is not in use.
+		 */
+		static t_realm_server * realm_match_server(t_realm * realm, unsigned int ip, unsigned short port)
 		{
+			t_elem const * curr;
+			t_realm_server * server;
+			t_realm_server * idle = NULL;
+			t_realm_server * same = NULL;
+			t_realm_server * first = NULL;
+
+			LIST_TRAVERSE_CONST(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->ip == ip)
+				{
+					if (port && server->port == port)
+						return server;
+					if (!same)
+						same = server;
+					if (!server->active && !idle)
+						idle = server;
+				}
+				if (!first)
+					first = server;
+			}
+
+			if (port)
+				eventlog(eventlog_level_warn, __FUNCTION__, "realm \"{}\" has no d2cs {} configured", realm->name, addr_num_to_addr_str(ip, port));
+			if (idle)
+				return idle;
+			if (same)
+				return same;
+			return first;
+		}
+
+
+		extern int realm_active(t_realm * realm, t_connection * c, unsigned short port)
+		{
+			t_realm_server * server;
+
 			if (!realm)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
@@ -262,49 +305,192 @@ namespace pvpgn
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL connection");
 				return -1;
 			}
-			if (realm->active)
+			if (!(server = realm_match_server(realm, conn_get_addr(c), port)))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "realm {} has no d2cs configured", realm->name);
+				return -1;
+			}
+			if (server->active)
 			{
-				eventlog(eventlog_level_debug, __FUNCTION__, "realm {} is already actived,destroy previous one", realm->name);
-				realm_deactive(realm);
+				eventlog(eventlog_level_debug, __FUNCTION__, "realm {} d2cs {} is already actived,destroy previous one", realm->name, addr_num_to_addr_str(server->ip, server->port));
+				realm_server_deactive(realm, server);
 			}
-			realm->active = 1;
-			realm->conn = c;
+			server->active = 1;
+			server->conn = c;
+			server->tcp_sock = conn_get_socket(c);
+			server->player_number = 0;
+			realm->active++;
 			conn_set_realm(c, realm);
-			realm->sessionnum = conn_get_sessionnum(c);
-			realm->tcp_sock = conn_get_socket(c);
-			eventlog(eventlog_level_info, __FUNCTION__, "realm {} actived", realm->name);
+			eventlog(eventlog_level_info, __FUNCTION__, "realm {} actived (d2cs {}, {} of {} up)", realm->name, addr_num_to_addr_str(server->ip, server->port), realm->active, list_get_length(realm->servers));
 			return 0;
 		}
 
-		extern int realm_deactive(t_realm * realm)
+
+		static void realm_server_deactive(t_realm * realm, t_realm_server * server)
 		{
-			t_connection * c;
+			if (server->conn)
+				conn_set_state(server->conn, conn_state_destroy);
+
+			server->active = 0;
+			server->conn = NULL;
+			server->tcp_sock = 0;
+			/* the clients sent there find another d2cs when they join again */
+			server->player_number = 0;
+			realm->active--;
+			/*
+			realm->player_number=0;
+			realm->game_number=0;
+			*/
+			eventlog(eventlog_level_info, __FUNCTION__, "realm {} d2cs {} deactived ({} of {} up)", realm->name, addr_num_to_addr_str(server->ip, server->port), realm->active, list_get_length(realm->servers));
+		}
+
+
+		extern int realm_deactive(t_realm * realm, t_connection * c)
+		{
+			t_elem const * curr;
+			t_realm_server * server;
 
 			if (!realm)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
 				return -1;
 			}
-			if (!realm->active)
+
+			LIST_TRAVERSE_CONST(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->active && server->conn == c)
+				{
+					realm_server_deactive(realm, server);
+					return 0;
+				}
+			}
+
+			eventlog(eventlog_level_error, __FUNCTION__, "realm {} is not actived by this d2cs", realm->name);
+			return -1;
+		}
+
+
+		/* the active d2cs of the realm with this address, the realm.conf line
+		 * it registered as; lines keep their address across a reload */
+		static t_realm_server * realm_find_server(t_realm * realm, unsigned int ip, unsigned short port)
+		{
+			t_elem const * curr;
+			t_realm_server * server;
+
+			if (!ip)
+				return NULL;
+
+			LIST_TRAVERSE_CONST(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->active && server->ip == ip && server->port == port)
+					return server;
+			}
+
+			return NULL;
+		}
+
+
+		/*
+		 * Picks the d2cs a client joining the realm is sent to: the one at
+		 * *ip:*port (where the client or its account was last) while that is
+		 * up, so a character comes back to the d2cs it played on, otherwise
+		 * the one with the fewest clients. The address of the d2cs picked is
+		 * returned in *ip and *port.
+		 */
+		extern int realm_select_server(t_realm * realm, unsigned int * ip, unsigned short * port)
+		{
+			t_elem const * curr;
+			t_realm_server * server;
+			t_realm_server * best;
+
+			if (!realm)
 			{
-				eventlog(eventlog_level_error, __FUNCTION__, "realm {} is not actived", realm->name);
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realm");
 				return -1;
 			}
-			if ((c = realm_get_conn(realm)))
-				conn_set_state(c, conn_state_destroy);
 
-			realm->active = 0;
-			realm->sessionnum = 0;
-			realm->tcp_sock = 0;
-			/*
-			realm->player_number=0;
-			realm->game_number=0;
-			*/
-			eventlog(eventlog_level_info, __FUNCTION__, "realm {} deactived", realm->name);
+			if (!(best = realm_find_server(realm, *ip, *port)))
+			{
+				LIST_TRAVERSE_CONST(realm->servers, curr)
+				{
+					server = (t_realm_server*)elem_get_data(curr);
+					if (!server->active)
+						continue;
+					if (!best || server->player_number < best->player_number)
+						best = server;
+				}
+			}
+
+			if (!best)
+				return -1;
+
+			*ip = best->ip;
+			*port = best->port;
+
 			return 0;
 		}
 
 
+		/* the address of the d2cs on connection c, -1 if it is not one of the realm */
+		extern int realm_get_server_addr(t_realm * realm, t_connection * c, unsigned int * ip, unsigned short * port)
+		{
+			t_elem const * curr;
+			t_realm_server * server;
+
+			if (!realm || !c)
+				return -1;
+
+			LIST_TRAVERSE_CONST(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->active && server->conn == c)
+				{
+					*ip = server->ip;
+					*port = server->port;
+					return 0;
+				}
+			}
+
+			return -1;
+		}
+
+
+		/* client c moves to the d2cs at ip:port of the realm, ip 0 is none */
+		extern void realm_move_player(t_realm * realm, t_connection * c, unsigned int ip, unsigned short port)
+		{
+			t_realm_server * server;
+
+			if (!realm || !c)
+				return;
+			if (conn_get_d2cs_ip(c) == ip && conn_get_d2cs_port(c) == port)
+				return;
+
+			if ((server = realm_find_server(realm, conn_get_d2cs_ip(c), conn_get_d2cs_port(c))) && server->player_number > 0)
+				server->player_number--;
+			if ((server = realm_find_server(realm, ip, port)))
+				server->player_number++;
+			conn_set_d2cs_addr(c, ip, port);
+		}
+
+
+		static t_realm * realmlist_find_realm_in(t_list const * list_head, char const * realmname)
+		{
+			t_elem const *  curr;
+			t_realm * realm;
+
+			LIST_TRAVERSE_CONST(list_head, curr)
+			{
+				realm = (t_realm*)elem_get_data(curr);
+				if (strcasecmp(realm->name, realmname) == 0)
+					return realm;
+			}
+
+			return NULL;
+		}
+
+
 		t_list * realmlist_load(char const * filename)
 		{
 			std::FILE *          fp;
@@ -410,20 +596,25 @@ namespace pvpgn
 					continue;
 				}
 
-				if (!(realm = realm_create(name, desc, addr_get_ip(raddr), addr_get_port(raddr))))
+				/* more lines with the same name are more d2cs for the realm */
+				if (!(realm = realmlist_find_realm_in(list_head, name)))
 				{
-					eventlog(eventlog_level_error, __FUNCTION__, "could not create realm");
-					addr_destroy(raddr);
-					xfree(name);
-					xfree(desc);
-					continue;
+					if (!(realm = realm_create(name, desc)))
+					{
+						eventlog(eventlog_level_error, __FUNCTION__, "could not create realm");
+						addr_destroy(raddr);
+						xfree(name);
+						xfree(desc);
+						continue;
+					}
+					list_prepend_data(list_head, realm);
 				}
 
+				realm_add_server(realm, addr_get_ip(raddr), addr_get_port(raddr));
+
 				addr_destroy(raddr);
 				xfree(name);
 				xfree(desc);
-
-				list_prepend_data(list_head, realm);
 			}
 			file_get_line(NULL); // clear file_get_line buffer
 			if (std::fclose(fp) < 0)
@@ -536,44 +727,52 @@ namespace pvpgn
 
 		extern t_realm * realmlist_find_realm(char const * realmname)
 		{
-			t_elem const *  curr;
-			t_realm * realm;
-
 			if (!realmname)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "got NULL realmname");
 				return NULL;
 			}
 
-			LIST_TRAVERSE_CONST(realmlist_head, curr)
-			{
-				realm = (t_realm*)elem_get_data(curr);
-				if (strcasecmp(realm->name, realmname) == 0)
-					return realm;
-			}
-
-			return NULL;
+			return realmlist_find_realm_in(realmlist_head, realmname);
 		}
 
 		extern t_realm * realmlist_find_realm_by_ip(unsigned long ip)
 		{
 			t_elem const *  curr;
+			t_elem const *  scurr;
 			t_realm * realm;
 
 			LIST_TRAVERSE_CONST(realmlist_head, curr)
 			{
 				realm = (t_realm*)elem_get_data(curr);
-				if (realm->ip == ip)
-					return realm;
+				LIST_TRAVERSE_CONST(realm->servers, scurr)
+				{
+					if (((t_realm_server*)elem_get_data(scurr))->ip == ip)
+						return realm;
+				}
 			}
 			return NULL;
 		}
 
-		extern t_connection * realm_get_conn(t_realm * realm)
+		/* the d2cs a client is on, or any of the realm if that one is gone */
+		extern t_connection * realm_get_conn(t_realm * realm, unsigned int ip, unsigned short port)
 		{
+			t_elem const * curr;
+			t_realm_server * server;
+
 			assert(realm);
 
-			return realm->conn;
+			if ((server = realm_find_server(realm, ip, port)))
+				return server->conn;
+
+			LIST_TRAVERSE_CONST(realm->servers, curr)
+			{
+				server = (t_realm_server*)elem_get_data(curr);
+				if (server->active)
+					return server->conn;
+			}
+
+			return NULL;
 		}
 
 		extern t_realm * realm_get(t_realm * realm, t_rcm_regref * regref)
@@ -20,10 +20,12 @@
 
 #ifdef JUST_NEED_TYPES
 # include "connection.h"
+# include "common/list.h"
 # include "common/rcm.h"
 #else
 #define JUST_NEED_TYPES
 # include "connection.h"
+# include "common/list.h"
 # include "common/rcm.h"
 #undef JUST_NEED_TYPES
 #endif
@@ -36,19 +38,29 @@ namespace pvpgn
 
 		struct connection;
 
+		/* one d2cs serving the realm, a realm line in realm.conf each */
+		typedef struct realm_server
+#ifdef REALM_INTERNAL_ACCESS
+		{
+			unsigned int   ip;
+			unsigned short port;
+			unsigned int   active;
+			int		   tcp_sock;
+			struct	   connection * conn;
+			unsigned int   player_number; /* clients sent to this d2cs */
+		}
+#endif
+		t_realm_server;
+
 		typedef struct realm
 #ifdef REALM_INTERNAL_ACCESS
 		{
 			char const *   name;
 			char const *   description;
-			unsigned int   sessionnum;
-			unsigned int   active;
-			unsigned int   ip;
-			unsigned short port;
+			unsigned int   active;        /* number of active d2cs */
 			unsigned int   player_number;
 			unsigned int   game_number;
-			int		   tcp_sock;
-			struct	   connection * conn;
+			t_list *	   servers;       /* t_realm_server */
 			t_rcm	   rcm;
 		}
 #endif
@@ -80,17 +92,17 @@ namespace pvpgn
 
 		extern char const * realm_get_name(t_realm const * realm);
 		extern char const * realm_get_description(t_realm const * realm);
-		extern unsigned short realm_get_port(t_realm const * realm);
-		extern unsigned int realm_get_ip(t_realm const * realm);
 		extern int realm_set_name(t_realm * realm, char const * name);
 		extern unsigned int realm_get_active(t_realm const * realm);
 		extern unsigned int realm_get_player_number(t_realm const * realm);
 		extern int realm_add_player_number(t_realm * realm, int number);
 		extern unsigned int realm_get_game_number(t_realm const * realm);
 		extern int realm_add_game_number(t_realm * realm, int number);
-		extern int realm_set_active(t_realm * realm, unsigned int active);
-		extern int realm_active(t_realm * realm, struct connection * c);
-		extern int realm_deactive(t_realm * realm);
+		extern int realm_active(t_realm * realm, struct connection * c, unsigned short port);
+		extern int realm_deactive(t_realm * realm, struct connection * c);
+		extern int realm_select_server(t_realm * realm, unsigned int * ip, unsigned short * port);
+		extern int realm_get_server_addr(t_realm * realm, struct connection * c, unsigned int * ip, unsigned short * port);
+		extern void realm_move_player(t_realm * realm, struct connection * c, unsigned int ip, unsigned short port);
 
 		extern int realmlist_create(char const * filename);
 		extern int realmlist_destroy(void);
@@ -99,7 +111,7 @@ namespace pvpgn
 		extern t_realm * realmlist_find_realm_by_ip(unsigned long ip); /* ??? */
 		extern t_list * realmlist(void);
 
-		extern struct connection * realm_get_conn(t_realm * realm);
+		extern struct connection * realm_get_conn(t_realm * realm, unsigned int ip, unsigned short port);
 
 		extern t_realm * realm_get(t_realm * realm, t_rcm_regref * regref);
 		extern void realm_put(t_realm * realm, t_rcm_regref * regref);
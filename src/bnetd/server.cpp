@@ -50,6 +50,11 @@
 #include "common/util.h"
 
 #include "prefs.h"
+#include "memlimit.h"
+#include "cluster.h"
+#include "flightrec.h"
+#include "memprof.h"
+#include "slowlog.h"
 #include "connection.h"
 #include "ipban.h"
 #include "timer.h"
@@ -61,6 +66,7 @@
 #include "handle_d2cs.h"
 #include "handle_irc_common.h"
 #include "handle_udp.h"
+#include "udptest_send.h"
 #include "handle_apireg.h"
 #include "handle_wol_gameres.h"
 #include "anongame.h"
@@ -85,6 +91,7 @@
 #include "tournament.h"
 #include "icons.h"
 #include "anongame_infos.h"
+#include "anongame_wol.h"
 #include "topic.h"
 #include "i18n.h"
 
@@ -114,6 +121,7 @@ namespace pvpgn
 		static void quit_sig_handle(int unused);
 		static void restart_sig_handle(int unused);
 		static void save_sig_handle(int unused);
+		static void flightrec_sig_handle(int unused);
 #ifdef HAVE_SETITIMER
 		static void timer_sig_handle(int unused);
 #endif
@@ -126,6 +134,7 @@ namespace pvpgn
 		static volatile std::time_t sigexittime = 0;
 		static volatile int do_restart = 0;
 		static volatile int do_save = 0;
+		static volatile int do_flightrec = 0;
 		static volatile int got_epipe = 0;
 		static char const * server_hostname = NULL;
 
@@ -174,6 +183,11 @@ namespace pvpgn
 			do_save = 1;
 		}
 
+		static void flightrec_sig_handle(int unused)
+		{
+			do_flightrec = 1;
+		}
+
 		static void pipe_sig_handle(int unused)
 		{
 			got_epipe = 1;
@@ -283,6 +297,14 @@ namespace pvpgn
 				return 0;
 			}
 
+			/* nor while short on memory */
+			if (memlimit_get_stage() >= memlimit_stage_nologin) {
+				memlimit_count_refused();
+				psock_shutdown(csocket, PSOCK_SHUT_RDWR);
+				psock_close(csocket);
+				return 0;
+			}
+
 			char addrstr[INET_ADDRSTRLEN] = { 0 };
 			if (ipbanlist_check(inet_ntop(AF_INET, &(caddr.sin_addr), addrstr, sizeof(addrstr))) != 0)
 			{
@@ -401,11 +423,53 @@ namespace pvpgn
 		}
 
 
+		/*
+		 * The packets UDP datagrams are read into, kept from one read to the
+		 * next. A packet somebody still holds a reference to is left to them
+		 * and replaced.
+		 */
+#define UDP_RECV_BATCH 32
+		static t_packet * udp_packets[UDP_RECV_BATCH];
+
+
+		static void sd_udppacket(t_addr * const curr_laddr, int usocket, t_packet * upacket, struct sockaddr_in const * fromaddr, int len)
+		{
+			if (fromaddr->sin_family != PSOCK_AF_INET)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "got UDP datagram with bad address family {}", (int)fromaddr->sin_family);
+				return;
+			}
+
+			packet_set_size(upacket, len);
+
+			if (hexstrm)
+			{
+				char tempa[32];
+
+				if (!addr_get_addr_str(curr_laddr, tempa, sizeof(tempa)))
+					std::strcpy(tempa, "x.x.x.x:x");
+				std::fprintf(hexstrm, "%d: recv class=%s[0x%02x] type=%s[0x%04x] from=%s to=%s length=%u\n",
+					usocket,
+					packet_get_class_str(upacket), (unsigned int)packet_get_class(upacket),
+					packet_get_type_str(upacket, packet_dir_from_client), packet_get_type(upacket),
+					addr_num_to_addr_str(ntohl(fromaddr->sin_addr.s_addr), ntohs(fromaddr->sin_port)),
+					tempa,
+					packet_get_size(upacket));
+				hexdump(hexstrm, packet_get_raw_data(upacket, 0), packet_get_size(upacket));
+			}
+
+			handle_udp_packet(usocket, ntohl(fromaddr->sin_addr.s_addr), ntohs(fromaddr->sin_port), upacket);
+		}
+
+
 		static int sd_udpinput(t_addr * const curr_laddr, t_laddr_info const * laddr_info, int ssocket, int usocket)
 		{
-			int             err;
-			psock_t_socklen errlen;
-			t_packet *      upacket;
+			int                err;
+			psock_t_socklen    errlen;
+			struct sockaddr_in fromaddrs[UDP_RECV_BATCH];
+			int                lens[UDP_RECV_BATCH];
+			int                count;
+			int                i;
 
 			err = 0;
 			errlen = sizeof(err);
@@ -419,19 +483,43 @@ namespace pvpgn
 				eventlog(eventlog_level_error, __FUNCTION__, "[{}] async UDP socket error notification (psock_getsockopt: {})", usocket, pstrerror(err));
 				return -1;
 			}
-			if (!(upacket = packet_create(packet_class_udp)))
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "could not allocate raw packet for input");
-				return -1;
-			}
+
+			for (i = 0; i < UDP_RECV_BATCH; i++)
+				if (!udp_packets[i] && !(udp_packets[i] = packet_create(packet_class_udp)))
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "could not allocate raw packet for input");
+					return -1;
+				}
 
 			{
-				struct sockaddr_in fromaddr;
-				psock_t_socklen    fromlen;
-				int                len;
+#ifdef HAVE_RECVMMSG
+				/* everything that is waiting, up to a batch, in one call */
+				struct mmsghdr msgs[UDP_RECV_BATCH];
+				struct iovec   iovs[UDP_RECV_BATCH];
 
-				fromlen = sizeof(fromaddr);
-				if ((len = psock_recvfrom(usocket, packet_get_raw_data_build(upacket, 0), MAX_PACKET_SIZE, 0, (struct sockaddr *)&fromaddr, &fromlen)) < 0)
+				std::memset(msgs, 0, sizeof(msgs));
+				for (i = 0; i < UDP_RECV_BATCH; i++)
+				{
+					iovs[i].iov_base = packet_get_raw_data_build(udp_packets[i], 0);
+					iovs[i].iov_len = MAX_PACKET_SIZE;
+					msgs[i].msg_hdr.msg_name = &fromaddrs[i];
+					msgs[i].msg_hdr.msg_namelen = sizeof(fromaddrs[i]);
+					msgs[i].msg_hdr.msg_iov = &iovs[i];
+					msgs[i].msg_hdr.msg_iovlen = 1;
+				}
+				count = recvmmsg(usocket, msgs, UDP_RECV_BATCH, MSG_DONTWAIT, NULL);
+				for (i = 0; i < count; i++)
+					lens[i] = msgs[i].msg_len;
+#else
+				psock_t_socklen fromlen;
+
+				fromlen = sizeof(fromaddrs[0]);
+				if ((lens[0] = psock_recvfrom(usocket, packet_get_raw_data_build(udp_packets[0], 0), MAX_PACKET_SIZE, 0, (struct sockaddr *)&fromaddrs[0], &fromlen)) < 0)
+					count = -1;
+				else
+					count = 1;
+#endif
+				if (count < 0)
 				{
 					if (
 #ifdef PSOCK_EINTR
@@ -451,46 +539,34 @@ namespace pvpgn
 #endif
 											 1)
 											 eventlog(eventlog_level_error, __FUNCTION__, "could not recv UDP datagram (psock_recvfrom: {})", pstrerror(psock_errno()));
-					packet_del_ref(upacket);
 					return -1;
 				}
+			}
 
-				if (fromaddr.sin_family != PSOCK_AF_INET)
-				{
-					eventlog(eventlog_level_error, __FUNCTION__, "got UDP datagram with bad address family {}", (int)fromaddr.sin_family);
-					packet_del_ref(upacket);
-					return -1;
-				}
-
-				packet_set_size(upacket, len);
-
-				if (hexstrm)
+			for (i = 0; i < count; i++)
+			{
+				sd_udppacket(curr_laddr, usocket, udp_packets[i], &fromaddrs[i], lens[i]);
+				if (udp_packets[i]->ref > 1)
 				{
-					char tempa[32];
-
-					if (!addr_get_addr_str(curr_laddr, tempa, sizeof(tempa)))
-						std::strcpy(tempa, "x.x.x.x:x");
-					std::fprintf(hexstrm, "%d: recv class=%s[0x%02x] type=%s[0x%04x] from=%s to=%s length=%u\n",
-						usocket,
-						packet_get_class_str(upacket), (unsigned int)packet_get_class(upacket),
-						packet_get_type_str(upacket, packet_dir_from_client), packet_get_type(upacket),
-						addr_num_to_addr_str(ntohl(fromaddr.sin_addr.s_addr), ntohs(fromaddr.sin_port)),
-						tempa,
-						packet_get_size(upacket));
-					hexdump(hexstrm, packet_get_raw_data(upacket, 0), packet_get_size(upacket));
+					packet_del_ref(udp_packets[i]);
+					udp_packets[i] = NULL;
 				}
-
-				handle_udp_packet(usocket, ntohl(fromaddr.sin_addr.s_addr), ntohs(fromaddr.sin_port), upacket);
-				packet_del_ref(upacket);
 			}
 
 			return 0;
 		}
 
 
-		static int sd_tcpinput(t_connection * c)
+		/*
+		 * Reads once from the connection and handles the packet when it is
+		 * complete. Returns 2 when a packet was handled, 1 when only some
+		 * bytes came in, 0 when nothing was there to read and -1/-2 like
+		 * sd_tcpinput().
+		 */
+		static int sd_tcpinput_packet(t_connection * c, unsigned int * bytes)
 		{
 			unsigned int currsize;
+			unsigned int prevsize;
 			t_packet *   packet;
 			int		 csocket = conn_get_socket(c);
 			bool	 skip;
@@ -580,7 +656,8 @@ namespace pvpgn
 			}
 
 			packet = conn_get_in_queue(c);
-			switch (net_recv_packet(csocket, packet, &currsize))
+			prevsize = currsize;
+			switch (net_recv_packet(csocket, packet, &currsize, conn_get_fdw_idx(c)))
 			{
 			case -1:
 				eventlog(eventlog_level_debug, __FUNCTION__, "[{}] read returned -1 (closing connection)", conn_get_socket(c));
@@ -590,9 +667,13 @@ namespace pvpgn
 			case 0: /* still working on it */
 				/* eventlog(eventlog_level_debug,__FUNCTION__,"[{}] still reading \"{}\" packet ({} of {} bytes so far)",conn_get_socket(c),packet_get_class_str(packet),conn_get_in_size(c),packet_get_size(packet)); */
 				conn_set_in_size(c, currsize);
+				if (currsize == prevsize)
+					return 0; /* nothing more for now */
+				*bytes += currsize - prevsize;
 				break;
 
 			case 1: /* done reading */
+				*bytes += currsize - prevsize;
 				switch (conn_get_class(c))
 				{
 				case conn_class_bot:
@@ -657,6 +738,8 @@ namespace pvpgn
 
 				if (!skip) {
 					conn_put_in_queue(c, NULL);
+					conn_keepalive_touch(c);
+					flightrec_record(c, flightrec_dir_recv, packet);
 
 					if (hexstrm)
 					{
@@ -680,6 +763,8 @@ namespace pvpgn
 
 					{
 						int ret;
+						t_slowlog_mark mark = slowlog_begin();
+						unsigned long usec;
 
 						switch (conn_get_class(c))
 						{
@@ -721,19 +806,66 @@ namespace pvpgn
 							eventlog(eventlog_level_error, __FUNCTION__, "[{}] bad packet class {} (closing connection)", conn_get_socket(c), (int)packet_get_class(packet));
 							ret = -1;
 						}
+						if ((usec = slowlog_elapsed(mark)))
+							slowlog_add(slowlog_packet, c, NULL, packet_get_type_str(packet, packet_dir_from_client), usec);
 						packet_del_ref(packet);
 						if (ret < 0)
 						{
+							flightrec_dump_auto(c, "protocol error");
 							conn_close_read(c);
 							return -2;
 						}
 					}
 
 					conn_set_in_size(c, 0);
+					return 2;
 				}
 			}
 
-			return 0;
+			return 1;
+		}
+
+
+		/*
+		 * Handles what the connection sent until it has nothing more to read
+		 * or its share of this main loop iteration (conn_read_packets and
+		 * conn_read_bytes) is used up. The rest waits for the next iteration,
+		 * so one busy client can't hold up the others.
+		 */
+		static int sd_tcpinput(t_connection * c)
+		{
+			unsigned int packets = 0;
+			unsigned int bytes = 0;
+			int          ret;
+
+			if (conn_get_halfclosed(c))
+			{
+				char discard[256];
+
+				/* we are only waiting for the peer to close, drop what it still sends */
+				if (fdwatch_recv(conn_get_fdw_idx(c), discard, sizeof(discard)) < 0)
+					conn_close_done(c);
+				return -2;
+			}
+
+			for (;;)
+			{
+				if ((ret = sd_tcpinput_packet(c, &bytes)) <= 0)
+					return ret;
+				if (ret == 2)
+					packets++;
+
+				/* closing, or too much queued to it (see conn_push_outqueue()) */
+				if (conn_get_state(c) == conn_state_destroy || conn_get_read_paused(c))
+					return 0;
+
+				if ((prefs_get_conn_read_packets() && packets >= prefs_get_conn_read_packets()) ||
+					(prefs_get_conn_read_bytes() && bytes >= prefs_get_conn_read_bytes()))
+				{
+					conn_read_budget_hit(c);
+					return 0;
+				}
+			}
 		}
 
 
@@ -752,7 +884,7 @@ namespace pvpgn
 				if ((packet = conn_peek_outqueue(c)) == NULL)
 					return -2;
 
-				switch (net_send_packet(csocket, packet, &currsize)) /* avoid warning */
+				switch (net_send_packet(csocket, packet, &currsize, conn_get_fdw_idx(c))) /* avoid warning */
 				{
 				case -1:
 					/* marking connection as "destroyed", memory will be freed later */
@@ -765,6 +897,8 @@ namespace pvpgn
 					return 0; /* bail out */
 
 				case 1: /* done sending */
+					flightrec_record(c, flightrec_dir_send, packet);
+
 					if (hexstrm)
 					{
 						std::fprintf(hexstrm, "%d: send class=%s[0x%02x] type=%s[0x%04x] length=%u\n",
@@ -1133,6 +1267,7 @@ namespace pvpgn
 				struct sigaction quit_action;
 				struct sigaction restart_action;
 				struct sigaction save_action;
+				struct sigaction flightrec_action;
 				struct sigaction pipe_action;
 #ifdef	HAVE_SETITIMER
 				struct sigaction timer_action;
@@ -1154,6 +1289,11 @@ namespace pvpgn
 					eventlog(eventlog_level_error, __FUNCTION__, "could not initialize std::signal set (sigemptyset: {})", pstrerror(errno));
 				save_action.sa_flags = SA_RESTART;
 
+				flightrec_action.sa_handler = flightrec_sig_handle;
+				if (sigemptyset(&flightrec_action.sa_mask) < 0)
+					eventlog(eventlog_level_error, __FUNCTION__, "could not initialize std::signal set (sigemptyset: {})", pstrerror(errno));
+				flightrec_action.sa_flags = SA_RESTART;
+
 				pipe_action.sa_handler = pipe_sig_handle;
 				if (sigemptyset(&pipe_action.sa_mask) < 0)
 					eventlog(eventlog_level_error, __FUNCTION__, "could not initialize std::signal set (sigemptyset: {})", pstrerror(errno));
@@ -1177,6 +1317,8 @@ namespace pvpgn
 					eventlog(eventlog_level_error, __FUNCTION__, "could not set SIGTERM std::signal handler (sigaction: {})", pstrerror(errno));
 				if (sigaction(SIGUSR1, &save_action, NULL) < 0)
 					eventlog(eventlog_level_error, __FUNCTION__, "could not set SIGUSR1 std::signal handler (sigaction: {})", pstrerror(errno));
+				if (sigaction(SIGUSR2, &flightrec_action, NULL) < 0)
+					eventlog(eventlog_level_error, __FUNCTION__, "could not set SIGUSR2 std::signal handler (sigaction: {})", pstrerror(errno));
 				if (sigaction(SIGPIPE, &pipe_action, NULL) < 0)
 					eventlog(eventlog_level_error, __FUNCTION__, "could not set SIGPIPE std::signal handler (sigaction: {})", pstrerror(errno));
 #ifdef HAVE_SETITIMER
@@ -1249,6 +1391,8 @@ namespace pvpgn
 			std::time_t          war3_ladder_updatetime;
 			std::time_t          output_updatetime;
 			std::time_t prev_time = 0;
+			int ready;
+			unsigned long reclaim;
 
 			starttime = std::time(NULL);
 			track_time = starttime - prefs_get_track();
@@ -1289,6 +1433,7 @@ namespace pvpgn
 					/* no need for accountlist_save() when using "force" */
 					accountlist_save(FS_FORCE | FS_ALL);
 					accountlist_flush(FS_FORCE | FS_ALL);
+					slowlog_loop_end();
 					break;
 				}
 				if (prev_exittime != curr_exittime)
@@ -1349,6 +1494,7 @@ namespace pvpgn
 					output_write_to_file();
 				}
 
+				memprof_check();
 
 				if (do_save)
 				{
@@ -1358,6 +1504,12 @@ namespace pvpgn
 					do_save = 0;
 				}
 
+				if (do_flightrec)
+				{
+					flightrec_dump_all("signal");
+					do_flightrec = 0;
+				}
+
 				if (do_restart)
 				{
 					if (do_restart == restart_mode_all)
@@ -1371,6 +1523,9 @@ namespace pvpgn
 						else
 						if (prefs_load(BNETD_DEFAULT_CONF_FILE) < 0)
 							eventlog(eventlog_level_error, __FUNCTION__, "using default configuration");
+						memprof_apply_prefs();
+						if (eventlog_set_module_levels(prefs_get_logmodules()) < 0)
+							eventlog(eventlog_level_error, __FUNCTION__, "could not use all of logmodules \"{}\"", prefs_get_logmodules());
 
 						if (eventlog_open(prefs_get_logfile()) < 0)
 							eventlog(eventlog_level_error, __FUNCTION__, "could not use the file \"{}\" for the eventlog", prefs_get_logfile());
@@ -1516,6 +1671,11 @@ namespace pvpgn
 				{
 					prev_time = now;
 					timerlist_check_timers(now);
+					channellist_presence_flush(now);
+					anongame_wol_check(now);
+					if ((reclaim = memlimit_check((unsigned long)prefs_get_mem_budget() * 1024UL)))
+						memlimit_count_kicked(connlist_reclaim_memory(reclaim));
+					cluster_check(now);
 #ifdef WITH_LUA
 					lua_handle_server(luaevent_server_mainloop);
 #endif
@@ -1524,8 +1684,13 @@ namespace pvpgn
 				/* no need to populate the fdwatch structures as they are populated on the fly
 				 * by sd_accept, conn_push_outqueue, conn_pull_outqueue, conn_destory */
 
+				/* the wait for the sockets is not part of an iteration */
+				slowlog_loop_end();
+
 				/* find which sockets need servicing */
-				switch (fdwatch(BNETD_POLL_INTERVAL))
+				ready = fdwatch(BNETD_POLL_INTERVAL);
+				slowlog_loop_begin();
+				switch (ready)
 				{
 				case -1: /* error */
 					if (
@@ -1535,13 +1700,21 @@ namespace pvpgn
 						1)
 						eventlog(eventlog_level_error, __FUNCTION__, "fdwatch() failed (errno: {})", pstrerror(psock_errno()));
 				case 0: /* timeout... no sockets need checking */
-					continue;
+					break;
+				default:
+					/* cycle through the ready sockets and handle them */
+					fdwatch_handle();
 				}
 
-				/* cycle through the ready sockets and handle them */
-				fdwatch_handle();
+				/* the UDP tests asked for while handling them */
+				udptest_flush();
+
+#ifdef WITH_LUA
+				/* the scripts that split their work over iterations */
+				lua_timer_flush();
+#endif
 
-				/* reap dead connections */
+				/* reap dead connections, also when idle so close deadlines expire */
 				connlist_reap();
 
 			}
@@ -1550,14 +1723,11 @@ namespace pvpgn
 
 		static void _shutdown_conns(void)
 		{
-			t_elem *ccurr;
-			t_connection *c;
+			t_elist *ccurr;
+			t_elist *save;
 
-			LIST_TRAVERSE(connlist(), ccurr)
-			{
-				c = (t_connection *)elem_get_data(ccurr);
-				conn_destroy(c, &ccurr, DESTROY_FROM_CONNLIST);
-			}
+			elist_for_each_safe(ccurr, connlist(), save)
+				conn_destroy(connlist_get_conn(ccurr));
 		}
 
 
@@ -1580,6 +1750,14 @@ namespace pvpgn
 				}
 			}
 			addrlist_destroy(laddrs);
+
+			for (unsigned int i = 0; i < UDP_RECV_BATCH; i++)
+				if (udp_packets[i])
+				{
+					packet_del_ref(udp_packets[i]);
+					udp_packets[i] = NULL;
+				}
+			udptest_unload();
 		}
 
 		extern int server_process(void)
@@ -0,0 +1,237 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "slowlog.h"
+
+#include <chrono>
+#include <cstdio>
+
+#include "common/eventlog.h"
+#include "connection.h"
+#include "prefs.h"
+#include "server.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		/* slow operations kept for /slowlog */
+		static const unsigned int slowlog_slots = 128;
+
+		static t_slowlog_entry slowlog_ring[slowlog_slots];
+		static unsigned int    slowlog_next = 0;
+		static unsigned long   slowlog_count = 0;
+		static unsigned long   slowlog_iteration = 0;
+		static t_slowlog_mark  slowlog_loop_mark = 0; /* start of the running iteration */
+
+
+		static t_slowlog_mark slowlog_now(void)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+
+		static void slowlog_log(t_slowlog_entry const * entry)
+		{
+			if (entry->loopusec)
+				eventlog(eventlog_level_warn, __FUNCTION__, "subsystem={} what=\"{}\" socket={} account=\"{}\" took={:.1f}ms loop={:.1f}ms iteration={}",
+					slowlog_subsys_get_str((t_slowlog_subsys)entry->subsys), entry->what, entry->socket, entry->account,
+					entry->usec / 1000.0, entry->loopusec / 1000.0, entry->iteration);
+			else
+				eventlog(eventlog_level_warn, __FUNCTION__, "subsystem={} what=\"{}\" socket={} account=\"{}\" took={:.1f}ms (outside of the main loop)",
+					slowlog_subsys_get_str((t_slowlog_subsys)entry->subsys), entry->what, entry->socket, entry->account,
+					entry->usec / 1000.0);
+		}
+
+
+		static t_slowlog_entry * slowlog_put(t_slowlog_subsys subsys, t_connection * c, char const * account, char const * what, unsigned long usec)
+		{
+			t_slowlog_entry * entry;
+
+			if (c && !account)
+				account = conn_get_loggeduser(c);
+
+			entry = &slowlog_ring[slowlog_next];
+			entry->iteration = slowlog_iteration;
+			entry->when = now;
+			entry->subsys = (unsigned char)subsys;
+			entry->socket = c ? conn_get_socket(c) : -1;
+			std::snprintf(entry->account, sizeof(entry->account), "%s", account ? account : "");
+			std::snprintf(entry->what, sizeof(entry->what), "%s", what ? what : "");
+			entry->usec = usec;
+			entry->loopusec = 0;
+
+			if (++slowlog_next == slowlog_slots)
+				slowlog_next = 0;
+			slowlog_count++;
+
+			return entry;
+		}
+
+
+		/* returns 0 when the tracer is off, so slowlog_elapsed() costs nothing either */
+		extern t_slowlog_mark slowlog_begin(void)
+		{
+			if (!prefs_get_slowlog_threshold())
+				return 0;
+			return slowlog_now();
+		}
+
+
+		/* the microseconds since the mark if they are over the threshold, 0 otherwise */
+		extern unsigned long slowlog_elapsed(t_slowlog_mark mark)
+		{
+			t_slowlog_mark usec;
+
+			if (!mark)
+				return 0;
+			usec = slowlog_now() - mark;
+			if (usec < (t_slowlog_mark)prefs_get_slowlog_threshold() * 1000)
+				return 0;
+
+			return usec ? (unsigned long)usec : 1;
+		}
+
+
+		/*
+		 * Operations of the main loop are logged when the iteration ends,
+		 * so the line can tell how long the whole iteration took.
+		 */
+		extern void slowlog_add(t_slowlog_subsys subsys, t_connection * c, char const * account, char const * what, unsigned long usec)
+		{
+			t_slowlog_entry * entry;
+
+			entry = slowlog_put(subsys, c, account, what, usec);
+			if (!slowlog_loop_mark)
+				slowlog_log(entry);
+		}
+
+
+		extern void slowlog_end(t_slowlog_mark mark, t_slowlog_subsys subsys, t_connection * c, char const * what)
+		{
+			unsigned long usec;
+
+			if ((usec = slowlog_elapsed(mark)))
+				slowlog_add(subsys, c, NULL, what, usec);
+		}
+
+
+		extern void slowlog_loop_begin(void)
+		{
+			slowlog_loop_mark = slowlog_begin();
+			if (slowlog_loop_mark)
+				slowlog_iteration++;
+		}
+
+
+		extern void slowlog_loop_end(void)
+		{
+			t_slowlog_entry * entry;
+			unsigned long     usec;
+			unsigned int      n, pending, i;
+
+			if (!slowlog_loop_mark)
+				return;
+			usec = (unsigned long)(slowlog_now() - slowlog_loop_mark);
+			if (!usec)
+				usec = 1;
+			slowlog_loop_mark = 0;
+
+			/* the operations of this iteration are the newest in the ring */
+			n = (slowlog_count < slowlog_slots) ? (unsigned int)slowlog_count : slowlog_slots;
+			for (pending = 0; pending < n; pending++)
+			{
+				entry = &slowlog_ring[(slowlog_next + slowlog_slots - 1 - pending) % slowlog_slots];
+				if (entry->iteration != slowlog_iteration || entry->loopusec)
+					break;
+			}
+
+			if (!pending)
+			{
+				/* many quick operations can stall the loop as well */
+				if (usec >= (unsigned long)prefs_get_slowlog_threshold() * 1000)
+				{
+					entry = slowlog_put(slowlog_loop, NULL, NULL, "main loop", usec);
+					entry->loopusec = usec;
+					slowlog_log(entry);
+				}
+				return;
+			}
+
+			for (i = pending; i > 0; i--)
+			{
+				entry = &slowlog_ring[(slowlog_next + slowlog_slots - i) % slowlog_slots];
+				entry->loopusec = usec;
+				slowlog_log(entry);
+			}
+		}
+
+
+		/* newest first */
+		extern unsigned int slowlog_get(t_slowlog_entry * entries, unsigned int max)
+		{
+			unsigned int n, i;
+
+			n = (slowlog_count < slowlog_slots) ? (unsigned int)slowlog_count : slowlog_slots;
+			if (n > max)
+				n = max;
+			for (i = 0; i < n; i++)
+				entries[i] = slowlog_ring[(slowlog_next + slowlog_slots - 1 - i) % slowlog_slots];
+
+			return n;
+		}
+
+
+		extern unsigned long slowlog_get_count(void)
+		{
+			return slowlog_count;
+		}
+
+
+		extern void slowlog_clear(void)
+		{
+			slowlog_next = 0;
+			slowlog_count = 0;
+		}
+
+
+		extern char const * slowlog_subsys_get_str(t_slowlog_subsys subsys)
+		{
+			switch (subsys)
+			{
+			case slowlog_packet:
+				return "packet";
+			case slowlog_command:
+				return "command";
+			case slowlog_storage:
+				return "storage";
+			case slowlog_timer:
+				return "timer";
+			case slowlog_lua:
+				return "lua";
+			case slowlog_loop:
+				return "loop";
+			default:
+				return "unknown";
+			}
+		}
+
+	}
+
+}
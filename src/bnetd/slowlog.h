@@ -0,0 +1,92 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef INCLUDED_SLOWLOG_TYPES
+#define INCLUDED_SLOWLOG_TYPES
+
+#include <ctime>
+
+#include "common/field_sizes.h"
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		typedef enum
+		{
+			slowlog_packet,
+			slowlog_command,
+			slowlog_storage,
+			slowlog_timer,
+			slowlog_lua,
+			slowlog_loop
+		} t_slowlog_subsys;
+
+		/* microseconds of a monotonic clock, 0 while the tracer is off */
+		typedef unsigned long long t_slowlog_mark;
+
+		typedef struct
+		{
+			unsigned long iteration;   /* of the main loop */
+			std::time_t   when;
+			unsigned char subsys;      /* t_slowlog_subsys */
+			int           socket;      /* -1 without a connection */
+			char          account[MAX_USERNAME_LEN];
+			char          what[64];    /* packet type, command, hook... */
+			unsigned long usec;
+			unsigned long loopusec;    /* the whole iteration, 0 until it ended */
+		} t_slowlog_entry;
+
+	}
+
+}
+
+#endif
+
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_SLOWLOG_PROTOS
+#define INCLUDED_SLOWLOG_PROTOS
+
+#define JUST_NEED_TYPES
+#include "connection.h"
+#undef JUST_NEED_TYPES
+
+namespace pvpgn
+{
+
+	namespace bnetd
+	{
+
+		extern t_slowlog_mark slowlog_begin(void);
+		extern unsigned long slowlog_elapsed(t_slowlog_mark mark);
+		extern void slowlog_add(t_slowlog_subsys subsys, t_connection * c, char const * account, char const * what, unsigned long usec);
+		extern void slowlog_end(t_slowlog_mark mark, t_slowlog_subsys subsys, t_connection * c, char const * what);
+		extern void slowlog_loop_begin(void);
+		extern void slowlog_loop_end(void);
+		extern unsigned int slowlog_get(t_slowlog_entry * entries, unsigned int max);
+		extern unsigned long slowlog_get_count(void);
+		extern void slowlog_clear(void);
+		extern char const * slowlog_subsys_get_str(t_slowlog_subsys subsys);
+
+	}
+
+}
+
+#endif
+#endif
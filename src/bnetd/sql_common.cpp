@@ -28,12 +28,15 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <map>
+#include <string>
 
 #include "compat/strcasecmp.h"
 #include "common/eventlog.h"
 #include "common/flags.h"
 #include "common/list.h"
 #include "common/tag.h"
+#include "common/xstring.h"
 #define CLAN_INTERNAL_ACCESS
 #define TEAM_INTERNAL_ACCESS
 #include "team.h"
@@ -74,6 +77,11 @@ namespace pvpgn
 
 		static char query[1024];
 
+		/* statements prepared on the current connection, keyed by their text */
+		static std::map<std::string, t_sql_stmt *> sql_stmts;
+		/* statements over this are prepared for a single use */
+		static const std::size_t sql_stmts_max = 128;
+
 		extern int sql_init(const char *dbpath)
 		{
 			char *tok, *path, *tmp, *p;
@@ -190,7 +198,7 @@ namespace pvpgn
 					{
 						eventlog(eventlog_level_error, __FUNCTION__, "got error init db");
 						sql = NULL;
-						free((void *)path);
+						xfree((void *)path);
 						return -1;
 					}
 					break;
@@ -216,6 +224,10 @@ namespace pvpgn
 				return -1;
 			}
 
+			for (std::map<std::string, t_sql_stmt *>::iterator it = sql_stmts.begin(); it != sql_stmts.end(); ++it)
+				sql->finalize(it->second);
+			sql_stmts.clear();
+
 			sql->close();
 			sql = NULL;
 			if (strcmp(tab_prefix, SQL_DEFAULT_PREFIX) != 0) {
@@ -226,6 +238,95 @@ namespace pvpgn
 			return 0;
 		}
 
+		/* *cached points to the cache entry if the statement was prepared by an earlier query */
+		static t_sql_stmt * sql_get_stmt(const char * query, std::map<std::string, t_sql_stmt *>::iterator * cached)
+		{
+			std::map<std::string, t_sql_stmt *>::iterator it;
+			t_sql_stmt * stmt;
+
+			if ((it = sql_stmts.find(query)) != sql_stmts.end())
+			{
+				*cached = it;
+				return it->second;
+			}
+			*cached = sql_stmts.end();
+
+			if ((stmt = sql->prepare(query)) == NULL)
+				return NULL;
+			if (sql_stmts.size() < sql_stmts_max)
+				sql_stmts[query] = stmt;
+			else
+				eventlog(eventlog_level_debug, __FUNCTION__, "statement cache full, not keeping \"{}\"", query);
+
+			return stmt;
+		}
+
+		static void sql_put_stmt(const char * query, t_sql_stmt * stmt)
+		{
+			if (sql_stmts.find(query) == sql_stmts.end())
+				sql->finalize(stmt);
+		}
+
+		/* A statement prepared earlier may have gone stale (the server reconnected or a
+		 * table it reads got altered), so it is prepared once more when it fails. */
+		static void sql_drop_stmt(std::map<std::string, t_sql_stmt *>::iterator it)
+		{
+			sql->finalize(it->second);
+			sql_stmts.erase(it);
+		}
+
+		extern t_sql_res * sql_prepared_query_res(const char * query, unsigned int nparams, const char * const * params)
+		{
+			std::map<std::string, t_sql_stmt *>::iterator cached;
+			t_sql_stmt * stmt;
+			t_sql_res * result;
+
+			if (sql == NULL)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "sql not initilized");
+				return NULL;
+			}
+
+			if ((stmt = sql_get_stmt(query, &cached)) == NULL)
+				return NULL;
+			if ((result = sql->execute_res(stmt, nparams, params)) == NULL && cached != sql_stmts.end())
+			{
+				sql_drop_stmt(cached);
+				if ((stmt = sql_get_stmt(query, &cached)) == NULL)
+					return NULL;
+				result = sql->execute_res(stmt, nparams, params);
+			}
+			sql_put_stmt(query, stmt);
+
+			return result;
+		}
+
+		extern int sql_prepared_query(const char * query, unsigned int nparams, const char * const * params)
+		{
+			std::map<std::string, t_sql_stmt *>::iterator cached;
+			t_sql_stmt * stmt;
+			int result;
+
+			if (sql == NULL)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "sql not initilized");
+				return -1;
+			}
+
+			if ((stmt = sql_get_stmt(query, &cached)) == NULL)
+				return -1;
+			if ((result = sql->execute(stmt, nparams, params)) != 0 && cached != sql_stmts.end())
+			{
+				sql_drop_stmt(cached);
+				if ((stmt = sql_get_stmt(query, &cached)) == NULL)
+					return -1;
+				result = sql->execute(stmt, nparams, params);
+			}
+			sql_put_stmt(query, stmt);
+
+			return result;
+		}
+
 		extern unsigned sql_read_maxuserid(void)
 		{
 			t_sql_res *result;
@@ -353,6 +454,8 @@ namespace pvpgn
 			t_clan *clan;
 			int member_uid;
 			t_clanmember *member;
+			std::string scid;
+			const char *params[1];
 
 			if (!sql)
 			{
@@ -403,9 +506,11 @@ namespace pvpgn
 					clan->channel_type = prefs_get_clan_channel_default_private();
 					clan->members = list_create();
 
-					std::snprintf(query, sizeof(query), "SELECT " SQL_UID_FIELD ", status, join_time FROM %sclanmember WHERE cid='%u'", tab_prefix, clan->clanid);
-					eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-					if ((result2 = sql->query_res(query)) != NULL)
+					std::snprintf(query, sizeof(query), "SELECT " SQL_UID_FIELD ", status, join_time FROM %sclanmember WHERE cid = ?", tab_prefix);
+					eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, clan->clanid);
+					scid = std_to_string(clan->clanid);
+					params[0] = scid.c_str();
+					if ((result2 = sql_prepared_query_res(query, 1, params)) != NULL)
 					{
 						if (sql->num_rows(result2) >= 1)
 						while ((row2 = sql->fetch_row(result2)) != NULL)
@@ -460,13 +565,14 @@ namespace pvpgn
 
 		extern int sql_write_clan(void *data)
 		{
-			char esc_motd[CLAN_MOTD_MAX * 2 + 1];
 			t_sql_res *result;
 			t_sql_row *row;
 			t_elem *curr;
 			t_clanmember *member;
 			t_clan *clan = (t_clan *)data;
 			int num;
+			std::string scid, stag, stime, suid, sstatus, sjoin;
+			const char *params[5];
 
 			if (!sql)
 			{
@@ -474,9 +580,14 @@ namespace pvpgn
 				return -1;
 			}
 
-			std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sclan WHERE cid='%u'", tab_prefix, clan->clanid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			if ((result = sql->query_res(query)) != NULL)
+			scid = std_to_string(clan->clanid);
+			stag = std_to_string(clan->tag);
+			stime = std_to_string((unsigned)clan->creation_time);
+
+			std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sclan WHERE cid = ?", tab_prefix);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, clan->clanid);
+			params[0] = scid.c_str();
+			if ((result = sql_prepared_query_res(query, 1, params)) != NULL)
 			{
 				row = sql->fetch_row(result);
 				if (row == NULL || row[0] == NULL)
@@ -487,14 +598,18 @@ namespace pvpgn
 				}
 				num = std::atol(row[0]);
 				sql->free_result(result);
-				sql->escape_string(esc_motd, clan->clan_motd, std::strlen(clan->clan_motd));
+				params[0] = stag.c_str();
+				params[1] = clan->clanname;
+				params[2] = clan->clan_motd;
+				params[3] = stime.c_str();
+				params[4] = scid.c_str();
 				if (num < 1)
-					std::snprintf(query, sizeof(query), "INSERT INTO %sclan (cid, short, name, motd, creation_time) VALUES('%u', '%d', '%s', '%s', '%u')", tab_prefix, clan->clanid, clan->tag, clan->clanname, esc_motd, (unsigned)clan->creation_time);
+					std::snprintf(query, sizeof(query), "INSERT INTO %sclan (short, name, motd, creation_time, cid) VALUES(?, ?, ?, ?, ?)", tab_prefix);
 				else
-					std::snprintf(query, sizeof(query), "UPDATE %sclan SET short='%d', name='%s', motd='%s', creation_time='%u' WHERE cid='%u'", tab_prefix, clan->tag, clan->clanname, esc_motd, (unsigned)clan->creation_time, clan->clanid);
-				eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-				
-				if (sql->query(query) < 0)
+					std::snprintf(query, sizeof(query), "UPDATE %sclan SET short = ?, name = ?, motd = ?, creation_time = ? WHERE cid = ?", tab_prefix);
+				eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, clan->clanid);
+
+				if (sql_prepared_query(query, 5, params) < 0)
 				{
 					eventlog(eventlog_level_error, __FUNCTION__, "error trying query: \"{}\"", query);
 					return -1;
@@ -518,9 +633,11 @@ namespace pvpgn
 					if (member->modified)
 					{
 						uid = account_get_uid(member->memberacc);
-						std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sclanmember WHERE " SQL_UID_FIELD "='%u'", tab_prefix, uid);
-						eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-						if ((result = sql->query_res(query)) != NULL)
+						suid = std_to_string(uid);
+						std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sclanmember WHERE " SQL_UID_FIELD " = ?", tab_prefix);
+						eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, uid);
+						params[0] = suid.c_str();
+						if ((result = sql_prepared_query_res(query, 1, params)) != NULL)
 						{
 							row = sql->fetch_row(result);
 							if (row == NULL || row[0] == NULL)
@@ -531,12 +648,18 @@ namespace pvpgn
 							}
 							num = std::atol(row[0]);
 							sql->free_result(result);
+							sstatus = std_to_string(member->status);
+							sjoin = std_to_string((unsigned)member->join_time);
+							params[0] = scid.c_str();
+							params[1] = sstatus.c_str();
+							params[2] = sjoin.c_str();
+							params[3] = suid.c_str();
 							if (num < 1)
-								std::snprintf(query, sizeof(query), "INSERT INTO %sclanmember (cid, " SQL_UID_FIELD ", status, join_time) VALUES('%u', '%u', '%d', '%u')", tab_prefix, clan->clanid, uid, member->status, (unsigned)member->join_time);
+								std::snprintf(query, sizeof(query), "INSERT INTO %sclanmember (cid, status, join_time, " SQL_UID_FIELD ") VALUES(?, ?, ?, ?)", tab_prefix);
 							else
-								std::snprintf(query, sizeof(query), "UPDATE %sclanmember SET cid='%u', status='%d', join_time='%u' WHERE " SQL_UID_FIELD "='%u'", tab_prefix, clan->clanid, member->status, (unsigned)member->join_time, uid);
-							eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-							if (sql->query(query) < 0)
+								std::snprintf(query, sizeof(query), "UPDATE %sclanmember SET cid = ?, status = ?, join_time = ? WHERE " SQL_UID_FIELD " = ?", tab_prefix);
+							eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, uid);
+							if (sql_prepared_query(query, 4, params) < 0)
 							{
 								eventlog(eventlog_level_error, __FUNCTION__, "error trying query: \"{}\"", query);
 								return -1;
@@ -729,6 +852,9 @@ namespace pvpgn
 			t_sql_row *row;
 			t_team *team = (t_team *)data;
 			int num;
+			std::string values[13];
+			const char *params[13];
+			unsigned int i;
 
 			if (!sql)
 			{
@@ -736,9 +862,23 @@ namespace pvpgn
 				return -1;
 			}
 
-			std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sarrangedteam WHERE teamid='%u'", tab_prefix, team->teamid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			if ((result = sql->query_res(query)) != NULL)
+			values[0] = std::string(1, (char)(team->size + '0'));
+			values[1] = clienttag_uint_to_str(team->clienttag);
+			values[2] = std_to_string((unsigned int)team->lastgame);
+			for (i = 0; i < 4; i++)
+				values[3 + i] = std_to_string(team->teammembers[i]);
+			values[7] = std_to_string(team->wins);
+			values[8] = std_to_string(team->losses);
+			values[9] = std_to_string(team->xp);
+			values[10] = std_to_string(team->level);
+			values[11] = std_to_string(team->rank);
+			values[12] = std_to_string(team->teamid);
+			for (i = 0; i < 13; i++)
+				params[i] = values[i].c_str();
+
+			std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sarrangedteam WHERE teamid = ?", tab_prefix);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, team->teamid);
+			if ((result = sql_prepared_query_res(query, 1, &params[12])) != NULL)
 			{
 				row = sql->fetch_row(result);
 				if (row == NULL || row[0] == NULL)
@@ -750,11 +890,11 @@ namespace pvpgn
 				num = std::atol(row[0]);
 				sql->free_result(result);
 				if (num < 1)
-					std::snprintf(query, sizeof(query), "INSERT INTO %sarrangedteam (teamid, size, clienttag, lastgame, member1, member2, member3, member4, wins,losses, xp, level, rank) VALUES('%u', '%c', '%s', '%u', '%u', '%u', '%u', '%u', '%d', '%d', '%d', '%d', '%d')", tab_prefix, team->teamid, team->size + '0', clienttag_uint_to_str(team->clienttag), (unsigned int)team->lastgame, team->teammembers[0], team->teammembers[1], team->teammembers[2], team->teammembers[3], team->wins, team->losses, team->xp, team->level, team->rank);
+					std::snprintf(query, sizeof(query), "INSERT INTO %sarrangedteam (size, clienttag, lastgame, member1, member2, member3, member4, wins,losses, xp, level, rank, teamid) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", tab_prefix);
 				else
-					std::snprintf(query, sizeof(query), "UPDATE %sarrangedteam SET size='%c', clienttag='%s', lastgame='%u', member1='%u', member2='%u', member3='%u', member4='%u', wins='%d', losses='%d', xp='%d', level='%d', rank='%d' WHERE teamid='%u'", tab_prefix, team->size + '0', clienttag_uint_to_str(team->clienttag), (unsigned int)team->lastgame, team->teammembers[0], team->teammembers[1], team->teammembers[2], team->teammembers[3], team->wins, team->losses, team->xp, team->level, team->rank, team->teamid);
-				eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-				if (sql->query(query) < 0)
+					std::snprintf(query, sizeof(query), "UPDATE %sarrangedteam SET size = ?, clienttag = ?, lastgame = ?, member1 = ?, member2 = ?, member3 = ?, member4 = ?, wins = ?, losses = ?, xp = ?, level = ?, rank = ? WHERE teamid = ?", tab_prefix);
+				eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, team->teamid);
+				if (sql_prepared_query(query, 13, params) < 0)
 				{
 					eventlog(eventlog_level_error, __FUNCTION__, "error trying query: \"{}\"", query);
 					return -1;
@@ -30,6 +30,9 @@ namespace pvpgn
 		/* used as a pointer to it */
 #define t_sql_res void
 
+		/* used as a pointer to it */
+#define t_sql_stmt void
+
 		typedef char * t_sql_row;
 
 		typedef char * t_sql_field;
@@ -47,6 +50,11 @@ namespace pvpgn
 			t_sql_field * (*fetch_fields)(t_sql_res *);
 			int(*free_fields)(t_sql_field *);
 			void(*escape_string)(char *, const char *, int);
+			/* statements use '?' placeholders, every value is bound as a string (NULL for SQL NULL) */
+			t_sql_stmt * (*prepare)(const char *);
+			t_sql_res * (*execute_res)(t_sql_stmt *, unsigned int, const char * const *);
+			int(*execute)(t_sql_stmt *, unsigned int, const char * const *);
+			void(*finalize)(t_sql_stmt *);
 		} t_sql_engine;
 
 	}
@@ -81,8 +89,8 @@ namespace pvpgn
 #define STORAGE_SQL_DEFAULT_UID	0
 #define SQL_DEFAULT_PREFIX	""
 
-/* FIXME: (HarpyWar) do not define SQL_ON_DEMAND - instead it will cause a lot of sql queries (one attribute selection = one query)
-		  https://github.com/pvpgn/pvpgn-server/issues/85 */
+/* with SQL_ON_DEMAND any table named by an attribute key is read, not only the ones in sql_tables;
+   either way a table is read with one query for all its attributes (https://github.com/pvpgn/pvpgn-server/issues/85) */
 //#define SQL_ON_DEMAND	1
 
 		extern t_sql_engine *sql;
@@ -95,6 +103,8 @@ namespace pvpgn
 
 		extern int sql_init(const char *);
 		extern int sql_close(void);
+		extern t_sql_res * sql_prepared_query_res(const char * query, unsigned int nparams, const char * const * params);
+		extern int sql_prepared_query(const char * query, unsigned int nparams, const char * const * params);
 		extern unsigned sql_read_maxuserid(void);
 		extern int sql_read_accounts(int flag, t_read_accounts_func cb, void *data);
 		extern int sql_cmp_info(t_storage_info * info1, t_storage_info * info2);
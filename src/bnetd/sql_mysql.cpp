@@ -25,7 +25,12 @@
 #include <windows.h>
 #endif
 #include <mysql.h>
+/* MySQL 8 dropped my_bool for bool, MariaDB still has it */
+#if !defined(MARIADB_BASE_VERSION) && !defined(MARIADB_PACKAGE_VERSION) && MYSQL_VERSION_ID >= 80001
+typedef bool my_bool;
+#endif
 #include <cstdlib>
+#include <cstring>
 
 #include "common/eventlog.h"
 #include "common/xalloc.h"
@@ -51,6 +56,10 @@ namespace pvpgn
 		static t_sql_field * sql_mysql_fetch_fields(t_sql_res *);
 		static int sql_mysql_free_fields(t_sql_field *);
 		static void sql_mysql_escape_string(char *, const char *, int);
+		static t_sql_stmt * sql_mysql_prepare(const char *);
+		static t_sql_res * sql_mysql_execute_res(t_sql_stmt *, unsigned int, const char * const *);
+		static int sql_mysql_execute(t_sql_stmt *, unsigned int, const char * const *);
+		static void sql_mysql_finalize(t_sql_stmt *);
 
 		t_sql_engine sql_mysql = {
 			sql_mysql_init,
@@ -64,10 +73,23 @@ namespace pvpgn
 			sql_mysql_affected_rows,
 			sql_mysql_fetch_fields,
 			sql_mysql_free_fields,
-			sql_mysql_escape_string
+			sql_mysql_escape_string,
+			sql_mysql_prepare,
+			sql_mysql_execute_res,
+			sql_mysql_execute,
+			sql_mysql_finalize
 		};
 
+		typedef struct {
+			MYSQL_RES *res;		/* result of a plain query */
+			char **cells;		/* or the rows of a prepared statement, the first "row" holds the field names */
+			unsigned int rows;
+			unsigned int fields;
+			unsigned int crow;
+		} t_mysql_res;
+
 		static MYSQL *mysql = NULL;
+		static unsigned int lastarows = 0;
 
 #ifndef RUNTIME_LIBS
 #define p_mysql_affected_rows		mysql_affected_rows
@@ -83,6 +105,20 @@ namespace pvpgn
 #define p_mysql_real_connect		mysql_real_connect
 #define p_mysql_real_escape_string	mysql_real_escape_string
 #define p_mysql_store_result		mysql_store_result
+#define p_mysql_stmt_affected_rows	mysql_stmt_affected_rows
+#define p_mysql_stmt_bind_param		mysql_stmt_bind_param
+#define p_mysql_stmt_bind_result	mysql_stmt_bind_result
+#define p_mysql_stmt_close		mysql_stmt_close
+#define p_mysql_stmt_execute		mysql_stmt_execute
+#define p_mysql_stmt_fetch		mysql_stmt_fetch
+#define p_mysql_stmt_fetch_column	mysql_stmt_fetch_column
+#define p_mysql_stmt_free_result	mysql_stmt_free_result
+#define p_mysql_stmt_init		mysql_stmt_init
+#define p_mysql_stmt_num_rows		mysql_stmt_num_rows
+#define p_mysql_stmt_param_count	mysql_stmt_param_count
+#define p_mysql_stmt_prepare		mysql_stmt_prepare
+#define p_mysql_stmt_result_metadata	mysql_stmt_result_metadata
+#define p_mysql_stmt_store_result	mysql_stmt_store_result
 #else
 		/* RUNTIME_LIBS */
 		static int mysql_load_dll(void);
@@ -100,6 +136,20 @@ namespace pvpgn
 		typedef MYSQL*		(STDCALL *f_mysql_real_connect)(MYSQL*, const char*, const char*, const char*, const char*, unsigned int, const char*, unsigned long);
 		typedef unsigned long	(STDCALL *f_mysql_real_escape_string)(MYSQL*, char*, const char*, unsigned long);
 		typedef MYSQL_RES*	(STDCALL *f_mysql_store_result)(MYSQL*);
+		typedef my_ulonglong(STDCALL *f_mysql_stmt_affected_rows)(MYSQL_STMT*);
+		typedef my_bool(STDCALL *f_mysql_stmt_bind_param)(MYSQL_STMT*, MYSQL_BIND*);
+		typedef my_bool(STDCALL *f_mysql_stmt_bind_result)(MYSQL_STMT*, MYSQL_BIND*);
+		typedef my_bool(STDCALL *f_mysql_stmt_close)(MYSQL_STMT*);
+		typedef int		(STDCALL *f_mysql_stmt_execute)(MYSQL_STMT*);
+		typedef int		(STDCALL *f_mysql_stmt_fetch)(MYSQL_STMT*);
+		typedef int		(STDCALL *f_mysql_stmt_fetch_column)(MYSQL_STMT*, MYSQL_BIND*, unsigned int, unsigned long);
+		typedef my_bool(STDCALL *f_mysql_stmt_free_result)(MYSQL_STMT*);
+		typedef MYSQL_STMT*	(STDCALL *f_mysql_stmt_init)(MYSQL*);
+		typedef my_ulonglong(STDCALL *f_mysql_stmt_num_rows)(MYSQL_STMT*);
+		typedef unsigned long	(STDCALL *f_mysql_stmt_param_count)(MYSQL_STMT*);
+		typedef int		(STDCALL *f_mysql_stmt_prepare)(MYSQL_STMT*, const char*, unsigned long);
+		typedef MYSQL_RES*	(STDCALL *f_mysql_stmt_result_metadata)(MYSQL_STMT*);
+		typedef int		(STDCALL *f_mysql_stmt_store_result)(MYSQL_STMT*);
 
 		static f_mysql_affected_rows		p_mysql_affected_rows;
 		static f_mysql_close			p_mysql_close;
@@ -114,6 +164,20 @@ namespace pvpgn
 		static f_mysql_real_connect		p_mysql_real_connect;
 		static f_mysql_real_escape_string	p_mysql_real_escape_string;
 		static f_mysql_store_result		p_mysql_store_result;
+		static f_mysql_stmt_affected_rows	p_mysql_stmt_affected_rows;
+		static f_mysql_stmt_bind_param		p_mysql_stmt_bind_param;
+		static f_mysql_stmt_bind_result		p_mysql_stmt_bind_result;
+		static f_mysql_stmt_close		p_mysql_stmt_close;
+		static f_mysql_stmt_execute		p_mysql_stmt_execute;
+		static f_mysql_stmt_fetch		p_mysql_stmt_fetch;
+		static f_mysql_stmt_fetch_column	p_mysql_stmt_fetch_column;
+		static f_mysql_stmt_free_result		p_mysql_stmt_free_result;
+		static f_mysql_stmt_init		p_mysql_stmt_init;
+		static f_mysql_stmt_num_rows		p_mysql_stmt_num_rows;
+		static f_mysql_stmt_param_count		p_mysql_stmt_param_count;
+		static f_mysql_stmt_prepare		p_mysql_stmt_prepare;
+		static f_mysql_stmt_result_metadata	p_mysql_stmt_result_metadata;
+		static f_mysql_stmt_store_result	p_mysql_stmt_store_result;
 
 #include "compat/runtime_libs.h" /* defines OpenLibrary(), GetFunction(), CloseLibrary() & MYSQL_LIB */
 
@@ -135,7 +199,21 @@ namespace pvpgn
 				((p_mysql_query = (f_mysql_query)GetFunction(handle, "mysql_query")) == NULL) ||
 				((p_mysql_real_connect = (f_mysql_real_connect)GetFunction(handle, "mysql_real_connect")) == NULL) ||
 				((p_mysql_real_escape_string = (f_mysql_real_escape_string)GetFunction(handle, "mysql_real_escape_string")) == NULL) ||
-				((p_mysql_store_result = (f_mysql_store_result)GetFunction(handle, "mysql_store_result")) == NULL))
+				((p_mysql_store_result = (f_mysql_store_result)GetFunction(handle, "mysql_store_result")) == NULL) ||
+				((p_mysql_stmt_affected_rows = (f_mysql_stmt_affected_rows)GetFunction(handle, "mysql_stmt_affected_rows")) == NULL) ||
+				((p_mysql_stmt_bind_param = (f_mysql_stmt_bind_param)GetFunction(handle, "mysql_stmt_bind_param")) == NULL) ||
+				((p_mysql_stmt_bind_result = (f_mysql_stmt_bind_result)GetFunction(handle, "mysql_stmt_bind_result")) == NULL) ||
+				((p_mysql_stmt_close = (f_mysql_stmt_close)GetFunction(handle, "mysql_stmt_close")) == NULL) ||
+				((p_mysql_stmt_execute = (f_mysql_stmt_execute)GetFunction(handle, "mysql_stmt_execute")) == NULL) ||
+				((p_mysql_stmt_fetch = (f_mysql_stmt_fetch)GetFunction(handle, "mysql_stmt_fetch")) == NULL) ||
+				((p_mysql_stmt_fetch_column = (f_mysql_stmt_fetch_column)GetFunction(handle, "mysql_stmt_fetch_column")) == NULL) ||
+				((p_mysql_stmt_free_result = (f_mysql_stmt_free_result)GetFunction(handle, "mysql_stmt_free_result")) == NULL) ||
+				((p_mysql_stmt_init = (f_mysql_stmt_init)GetFunction(handle, "mysql_stmt_init")) == NULL) ||
+				((p_mysql_stmt_num_rows = (f_mysql_stmt_num_rows)GetFunction(handle, "mysql_stmt_num_rows")) == NULL) ||
+				((p_mysql_stmt_param_count = (f_mysql_stmt_param_count)GetFunction(handle, "mysql_stmt_param_count")) == NULL) ||
+				((p_mysql_stmt_prepare = (f_mysql_stmt_prepare)GetFunction(handle, "mysql_stmt_prepare")) == NULL) ||
+				((p_mysql_stmt_result_metadata = (f_mysql_stmt_result_metadata)GetFunction(handle, "mysql_stmt_result_metadata")) == NULL) ||
+				((p_mysql_stmt_store_result = (f_mysql_stmt_store_result)GetFunction(handle, "mysql_stmt_store_result")) == NULL))
 			{
 				CloseLibrary(handle);
 				handle = NULL;
@@ -223,7 +301,8 @@ namespace pvpgn
 
 		static t_sql_res * sql_mysql_query_res(const char * query)
 		{
-			t_sql_res *res;
+			t_mysql_res *res;
+			MYSQL_RES *myres;
 
 			if (mysql == NULL) {
 				eventlog(eventlog_level_error, __FUNCTION__, "mysql driver not initilized");
@@ -240,12 +319,19 @@ namespace pvpgn
 				return NULL;
 			}
 
-			res = p_mysql_store_result(mysql);
-			if (res == NULL) {
+			myres = p_mysql_store_result(mysql);
+			if (myres == NULL) {
 				eventlog(eventlog_level_error, __FUNCTION__, "got error from store result");
 				return NULL;
 			}
 
+			res = (t_mysql_res *)xmalloc(sizeof(t_mysql_res));
+			res->res = myres;
+			res->cells = NULL;
+			res->rows = 0;
+			res->fields = 0;
+			res->crow = 0;
+
 			return res;
 		}
 
@@ -261,7 +347,11 @@ namespace pvpgn
 				return -1;
 			}
 
-			return p_mysql_query(mysql, query) == 0 ? 0 : -1;
+			if (p_mysql_query(mysql, query))
+				return -1;
+
+			lastarows = (unsigned int)p_mysql_affected_rows(mysql);
+			return 0;
 		}
 
 		static t_sql_row * sql_mysql_fetch_row(t_sql_res *result)
@@ -271,7 +361,11 @@ namespace pvpgn
 				return NULL;
 			}
 
-			return p_mysql_fetch_row((MYSQL_RES *)result);
+			t_mysql_res *res = (t_mysql_res *)result;
+
+			if (res->res)
+				return p_mysql_fetch_row(res->res);
+			return res->crow < res->rows ? (res->cells + res->fields * (++res->crow)) : NULL;
 		}
 
 		static void sql_mysql_free_result(t_sql_res *result)
@@ -281,7 +375,19 @@ namespace pvpgn
 				return;
 			}
 
-			p_mysql_free_result((MYSQL_RES *)result);
+			t_mysql_res *res = (t_mysql_res *)result;
+
+			if (res->res)
+				p_mysql_free_result(res->res);
+			if (res->cells) {
+				unsigned int i;
+
+				for (i = 0; i < (res->rows + 1) * res->fields; i++)
+				if (res->cells[i])
+					xfree((void *)res->cells[i]);
+				xfree((void *)res->cells);
+			}
+			xfree(result);
 		}
 
 		static unsigned int sql_mysql_num_rows(t_sql_res *result)
@@ -291,7 +397,9 @@ namespace pvpgn
 				return 0;
 			}
 
-			return p_mysql_num_rows((MYSQL_RES *)result);
+			t_mysql_res *res = (t_mysql_res *)result;
+
+			return res->res ? p_mysql_num_rows(res->res) : res->rows;
 		}
 
 		static unsigned int sql_mysql_num_fields(t_sql_res *result)
@@ -301,16 +409,19 @@ namespace pvpgn
 				return 0;
 			}
 
-			return p_mysql_num_fields((MYSQL_RES *)result);
+			t_mysql_res *res = (t_mysql_res *)result;
+
+			return res->res ? p_mysql_num_fields(res->res) : res->fields;
 		}
 
 		static unsigned int sql_mysql_affected_rows(void)
 		{
-			return p_mysql_affected_rows(mysql);
+			return lastarows;
 		}
 
 		static t_sql_field * sql_mysql_fetch_fields(t_sql_res *result)
 		{
+			t_mysql_res *res = (t_mysql_res *)result;
 			MYSQL_FIELD *fields;
 			unsigned fieldno, i;
 			t_sql_field *rfields;
@@ -320,8 +431,16 @@ namespace pvpgn
 				return NULL;
 			}
 
-			fieldno = p_mysql_num_fields((MYSQL_RES *)result);
-			fields = p_mysql_fetch_fields((MYSQL_RES *)result);
+			if (res->res == NULL) {
+				rfields = (t_sql_field *)xmalloc(sizeof(t_sql_field)* (res->fields + 1));
+				for (i = 0; i < res->fields; i++)
+					rfields[i] = res->cells[i];
+				rfields[i] = NULL;
+				return rfields;
+			}
+
+			fieldno = p_mysql_num_fields(res->res);
+			fields = p_mysql_fetch_fields(res->res);
 
 			rfields = (t_sql_field *)xmalloc(sizeof(t_sql_field)* (fieldno + 1));
 			for (i = 0; i < fieldno; i++)
@@ -351,6 +470,192 @@ namespace pvpgn
 			p_mysql_real_escape_string(mysql, escape, from, len);
 		}
 
+		static t_sql_stmt * sql_mysql_prepare(const char * query)
+		{
+			MYSQL_STMT *stmt;
+
+			if (mysql == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "mysql driver not initilized");
+				return NULL;
+			}
+
+			if (query == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL query");
+				return NULL;
+			}
+
+			if ((stmt = p_mysql_stmt_init(mysql)) == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got error from mysql_stmt_init");
+				return NULL;
+			}
+
+			if (p_mysql_stmt_prepare(stmt, query, std::strlen(query))) {
+				//        eventlog(eventlog_level_debug, __FUNCTION__, "got error from prepare ({})", query);
+				p_mysql_stmt_close(stmt);
+				return NULL;
+			}
+
+			return stmt;
+		}
+
+		static int _mysql_execute(MYSQL_STMT *stmt, unsigned int nparams, const char * const * params)
+		{
+			MYSQL_BIND *bind;
+			unsigned long *lengths;
+			unsigned int i;
+			int res;
+
+			if (mysql == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "mysql driver not initilized");
+				return -1;
+			}
+
+			if (stmt == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return -1;
+			}
+
+			if (nparams != p_mysql_stmt_param_count(stmt)) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got {} parameters for {} placeholders", nparams, p_mysql_stmt_param_count(stmt));
+				return -1;
+			}
+
+			if (nparams) {
+				bind = (MYSQL_BIND *)xcalloc(nparams, sizeof(MYSQL_BIND));
+				lengths = (unsigned long *)xmalloc(sizeof(unsigned long)* nparams);
+				for (i = 0; i < nparams; i++) {
+					if (params[i] == NULL) {
+						bind[i].buffer_type = MYSQL_TYPE_NULL;
+						continue;
+					}
+					lengths[i] = std::strlen(params[i]);
+					bind[i].buffer_type = MYSQL_TYPE_STRING;
+					bind[i].buffer = (void *)params[i];
+					bind[i].buffer_length = lengths[i];
+					bind[i].length = &lengths[i];
+				}
+				res = p_mysql_stmt_bind_param(stmt, bind) ? -1 : 0;
+				/* the values are read by mysql_stmt_execute() so keep the binds until then */
+				if (!res)
+					res = p_mysql_stmt_execute(stmt) ? -1 : 0;
+				xfree((void *)lengths);
+				xfree((void *)bind);
+			}
+			else
+				res = p_mysql_stmt_execute(stmt) ? -1 : 0;
+
+			return res;
+		}
+
+		static t_sql_res * sql_mysql_execute_res(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			MYSQL_STMT *st = (MYSQL_STMT *)stmt;
+			MYSQL_RES *meta;
+			MYSQL_FIELD *fields;
+			MYSQL_BIND *bind;
+			unsigned long *lengths;
+			my_bool *nulls;
+			t_mysql_res *res;
+			unsigned int i, row;
+
+			if (_mysql_execute(st, nparams, params))
+				return NULL;
+
+			if ((meta = p_mysql_stmt_result_metadata(st)) == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "statement returned no result set");
+				p_mysql_stmt_free_result(st);
+				return NULL;
+			}
+
+			if (p_mysql_stmt_store_result(st)) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got error from store result");
+				p_mysql_free_result(meta);
+				return NULL;
+			}
+
+			res = (t_mysql_res *)xmalloc(sizeof(t_mysql_res));
+			res->res = NULL;
+			res->fields = p_mysql_num_fields(meta);
+			res->rows = (unsigned int)p_mysql_stmt_num_rows(st);
+			res->crow = 0;
+			/* same layout as sqlite3_get_table(), the first "row" holds the field names */
+			res->cells = (char **)xcalloc((res->rows + 1) * res->fields + 1, sizeof(char *));
+
+			fields = p_mysql_fetch_fields(meta);
+			bind = (MYSQL_BIND *)xcalloc(res->fields + 1, sizeof(MYSQL_BIND));
+			lengths = (unsigned long *)xcalloc(res->fields + 1, sizeof(unsigned long));
+			nulls = (my_bool *)xcalloc(res->fields + 1, sizeof(my_bool));
+			/* no buffers: mysql_stmt_fetch() only tells the length of each value as text,
+			 * which then gets fetched into a cell of that size */
+			for (i = 0; i < res->fields; i++) {
+				res->cells[i] = xstrdup(fields[i].name);
+				bind[i].buffer_type = MYSQL_TYPE_STRING;
+				bind[i].length = &lengths[i];
+				bind[i].is_null = &nulls[i];
+			}
+
+			row = 0;
+			if (p_mysql_stmt_bind_result(st, bind) == 0)
+			for (row = 1; row <= res->rows; row++) {
+				int fetched = p_mysql_stmt_fetch(st);
+
+				if (fetched != 0 && fetched != MYSQL_DATA_TRUNCATED)
+					break;
+				for (i = 0; i < res->fields; i++) {
+					char *cell;
+
+					if (nulls[i])
+						continue;
+					cell = (char *)xmalloc(lengths[i] + 1);
+					cell[lengths[i]] = '\0';
+					if (lengths[i]) {
+						MYSQL_BIND column;
+
+						std::memset(&column, 0, sizeof(column));
+						column.buffer_type = MYSQL_TYPE_STRING;
+						column.buffer = cell;
+						column.buffer_length = lengths[i] + 1;
+						if (p_mysql_stmt_fetch_column(st, &column, i, 0))
+							eventlog(eventlog_level_error, __FUNCTION__, "got error fetching column {}", i);
+					}
+					res->cells[row * res->fields + i] = cell;
+				}
+			}
+			if (row == 0 || row <= res->rows) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got {} of {} rows", row ? row - 1 : 0, res->rows);
+				res->rows = row ? row - 1 : 0;
+			}
+
+			xfree((void *)nulls);
+			xfree((void *)lengths);
+			xfree((void *)bind);
+			p_mysql_stmt_free_result(st);
+			p_mysql_free_result(meta);
+
+			return res;
+		}
+
+		static int sql_mysql_execute(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			MYSQL_STMT *st = (MYSQL_STMT *)stmt;
+
+			if (_mysql_execute(st, nparams, params))
+				return -1;
+
+			lastarows = (unsigned int)p_mysql_stmt_affected_rows(st);
+			return 0;
+		}
+
+		static void sql_mysql_finalize(t_sql_stmt *stmt)
+		{
+			if (stmt == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return;
+			}
+
+			p_mysql_stmt_close((MYSQL_STMT *)stmt);
+		}
+
 	}
 
 }
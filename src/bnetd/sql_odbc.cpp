@@ -22,6 +22,7 @@
 #endif
 #include <sqlext.h>
 #include <cctype>
+#include <cstring>
 #include "common/eventlog.h"
 #include "common/xalloc.h"
 #include "common/xstring.h"
@@ -48,6 +49,10 @@ namespace pvpgn
 		static t_sql_field * sql_odbc_fetch_fields(t_sql_res *);
 		static int sql_odbc_free_fields(t_sql_field *);
 		static void sql_odbc_escape_string(char *, const char *, int);
+		static t_sql_stmt * sql_odbc_prepare(const char *);
+		static t_sql_res * sql_odbc_execute_res(t_sql_stmt *, unsigned int, const char * const *);
+		static int sql_odbc_execute(t_sql_stmt *, unsigned int, const char * const *);
+		static void sql_odbc_finalize(t_sql_stmt *);
 
 		t_sql_engine sql_odbc = {
 			sql_odbc_init,
@@ -61,7 +66,11 @@ namespace pvpgn
 			sql_odbc_affected_rows,
 			sql_odbc_fetch_fields,
 			sql_odbc_free_fields,
-			sql_odbc_escape_string
+			sql_odbc_escape_string,
+			sql_odbc_prepare,
+			sql_odbc_execute_res,
+			sql_odbc_execute,
+			sql_odbc_finalize
 		};
 
 		struct t_odbc_rowSet_{
@@ -75,10 +84,13 @@ namespace pvpgn
 			t_odbc_rowSet *curRow;
 			t_odbc_rowSet *rowSet;
 			unsigned int rowCount;
+			int prepared;	/* stmt belongs to a prepared statement and outlives the result */
 		} t_odbc_res;
 
-		static t_sql_row *odbc_alloc_row(t_odbc_res *result, SQLINTEGER *sizes);
+		static t_sql_row *odbc_alloc_row(t_odbc_res *result, SQLLEN **sizes);
 		static t_odbc_rowSet *odbc_alloc_rowSet();
+		static int odbc_store_rows(t_odbc_res *res);
+		static int odbc_bind_execute(HSTMT stmt, unsigned int nparams, const char * const * params);
 		static int odbc_Result(SQLRETURN retCode);
 		static void odbc_Error(SQLSMALLINT type, void *obj, t_eventlog_level level, const char *function);
 		static int odbc_Fail();
@@ -86,19 +98,31 @@ namespace pvpgn
 		static HENV env = SQL_NULL_HENV;
 		static HDBC con = SQL_NULL_HDBC;
 
-		static SQLINTEGER ROWCOUNT = 0;
+		static SQLLEN ROWCOUNT = 0;
 
 #ifndef RUNTIME_LIBS
+#ifndef WIN32
+/* the driver managers there take the ANSI calls under their plain names */
+#define SQLColAttributeA	SQLColAttribute
+#define SQLConnectA		SQLConnect
+#define SQLExecDirectA		SQLExecDirect
+#define SQLPrepareA		SQLPrepare
+#define SQLGetDiagRecA		SQLGetDiagRec
+#endif
 #define p_SQLAllocEnv		SQLAllocEnv
 #define p_SQLAllocConnect	SQLAllocConnect
 #define p_SQLAllocStmt		SQLAllocStmt
 #define p_SQLBindCol		SQLBindCol
+#define p_SQLBindParameter	SQLBindParameter
 #define p_SQLColAttribute	SQLColAttributeA
 #define p_SQLConnect		SQLConnectA
 #define p_SQLDisconnect		SQLDisconnect
 #define p_SQLExecDirect		SQLExecDirectA
+#define p_SQLExecute		SQLExecute
 #define p_SQLFetch		SQLFetch
 #define p_SQLFreeHandle		SQLFreeHandle
+#define p_SQLFreeStmt		SQLFreeStmt
+#define p_SQLPrepare		SQLPrepareA
 #define p_SQLRowCount		SQLRowCount
 #define p_SQLGetDiagRec		SQLGetDiagRecA
 #define p_SQLNumResultCols	SQLNumResultCols
@@ -110,12 +134,16 @@ namespace pvpgn
 		typedef SQLRETURN(SQL_API *f_SQLAllocConnect)(SQLHENV, SQLHDBC*);
 		typedef SQLRETURN(SQL_API *f_SQLAllocStmt)(SQLHDBC, SQLHSTMT*);
 		typedef SQLRETURN(SQL_API *f_SQLBindCol)(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN*);
+		typedef SQLRETURN(SQL_API *f_SQLBindParameter)(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLULEN, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN*);
 		typedef SQLRETURN(SQL_API *f_SQLColAttribute)(SQLHSTMT, SQLUSMALLINT, SQLUSMALLINT, SQLPOINTER, SQLSMALLINT, SQLSMALLINT*, SQLPOINTER);
 		typedef SQLRETURN(SQL_API *f_SQLConnect)(SQLHDBC, SQLCHAR*, SQLSMALLINT, SQLCHAR*, SQLSMALLINT, SQLCHAR*, SQLSMALLINT);
 		typedef SQLRETURN(SQL_API *f_SQLDisconnect)(SQLHDBC);
 		typedef SQLRETURN(SQL_API *f_SQLExecDirect)(SQLHSTMT, SQLCHAR*, SQLINTEGER);
+		typedef SQLRETURN(SQL_API *f_SQLExecute)(SQLHSTMT);
 		typedef SQLRETURN(SQL_API *f_SQLFetch)(SQLHSTMT);
 		typedef SQLRETURN(SQL_API *f_SQLFreeHandle)(SQLSMALLINT, SQLHANDLE);
+		typedef SQLRETURN(SQL_API *f_SQLFreeStmt)(SQLHSTMT, SQLUSMALLINT);
+		typedef SQLRETURN(SQL_API *f_SQLPrepare)(SQLHSTMT, SQLCHAR*, SQLINTEGER);
 		typedef SQLRETURN(SQL_API *f_SQLRowCount)(SQLHSTMT, SQLLEN*);
 		typedef SQLRETURN(SQL_API *f_SQLGetDiagRec)(SQLSMALLINT, SQLHANDLE, SQLSMALLINT, SQLCHAR*, SQLINTEGER*, SQLCHAR*, SQLSMALLINT, SQLSMALLINT*);
 		typedef SQLRETURN(SQL_API *f_SQLNumResultCols)(SQLHSTMT, SQLSMALLINT*);
@@ -124,12 +152,16 @@ namespace pvpgn
 		static f_SQLAllocConnect	p_SQLAllocConnect;
 		static f_SQLAllocStmt		p_SQLAllocStmt;
 		static f_SQLBindCol		p_SQLBindCol;
+		static f_SQLBindParameter	p_SQLBindParameter;
 		static f_SQLColAttribute	p_SQLColAttribute;
 		static f_SQLConnect		p_SQLConnect;
 		static f_SQLDisconnect		p_SQLDisconnect;
 		static f_SQLExecDirect		p_SQLExecDirect;
+		static f_SQLExecute		p_SQLExecute;
 		static f_SQLFetch		p_SQLFetch;
 		static f_SQLFreeHandle		p_SQLFreeHandle;
+		static f_SQLFreeStmt		p_SQLFreeStmt;
+		static f_SQLPrepare		p_SQLPrepare;
 		static f_SQLRowCount		p_SQLRowCount;
 		static f_SQLGetDiagRec		p_SQLGetDiagRec;
 		static f_SQLNumResultCols	p_SQLNumResultCols;
@@ -146,12 +178,16 @@ namespace pvpgn
 				((p_SQLAllocConnect = (f_SQLAllocConnect)GetFunction(handle, "SQLAllocConnect")) == NULL) ||
 				((p_SQLAllocStmt = (f_SQLAllocStmt)GetFunction(handle, "SQLAllocStmt")) == NULL) ||
 				((p_SQLBindCol = (f_SQLBindCol)GetFunction(handle, "SQLBindCol")) == NULL) ||
+				((p_SQLBindParameter = (f_SQLBindParameter)GetFunction(handle, "SQLBindParameter")) == NULL) ||
 				((p_SQLColAttribute = (f_SQLColAttribute)GetFunction(handle, "SQLColAttribute")) == NULL) ||
 				((p_SQLConnect = (f_SQLConnect)GetFunction(handle, "SQLConnect")) == NULL) ||
 				((p_SQLDisconnect = (f_SQLDisconnect)GetFunction(handle, "SQLDisconnect")) == NULL) ||
 				((p_SQLExecDirect = (f_SQLExecDirect)GetFunction(handle, "SQLExecDirect")) == NULL) ||
+				((p_SQLExecute = (f_SQLExecute)GetFunction(handle, "SQLExecute")) == NULL) ||
 				((p_SQLFetch = (f_SQLFetch)GetFunction(handle, "SQLFetch")) == NULL) ||
 				((p_SQLFreeHandle = (f_SQLFreeHandle)GetFunction(handle, "SQLFreeHandle")) == NULL) ||
+				((p_SQLFreeStmt = (f_SQLFreeStmt)GetFunction(handle, "SQLFreeStmt")) == NULL) ||
+				((p_SQLPrepare = (f_SQLPrepare)GetFunction(handle, "SQLPrepare")) == NULL) ||
 				((p_SQLRowCount = (f_SQLRowCount)GetFunction(handle, "SQLRowCount")) == NULL) ||
 				((p_SQLGetDiagRec = (f_SQLGetDiagRec)GetFunction(handle, "SQLGetDiagRec")) == NULL) ||
 				((p_SQLNumResultCols = (f_SQLNumResultCols)GetFunction(handle, "SQLNumResultCols")) == NULL))
@@ -222,7 +258,6 @@ namespace pvpgn
 			t_odbc_res *res = NULL;
 			HSTMT stmt = SQL_NULL_HSTMT;
 			SQLRETURN result = 0;
-			t_odbc_rowSet *rowSet = NULL;
 			ROWCOUNT = 0;
 
 			/* Validate query. */
@@ -244,38 +279,8 @@ namespace pvpgn
 			/* Create a result. */
 			res = (t_odbc_res *)xmalloc(sizeof *res);
 			res->stmt = stmt;
-			rowSet = odbc_alloc_rowSet();
-			res->rowSet = rowSet;
-			res->curRow = rowSet;
-			res->rowCount = 0;
-
-			/* Store rows. */
-			do {
-				SQLINTEGER *sizes = NULL;
-				t_sql_row *row = odbc_alloc_row(res, sizes);
-				if (!row) {
-					sql_odbc_free_result(res);
-					return NULL;
-				}
-				result = p_SQLFetch(stmt);
-				if (odbc_Result(result)) {
-					rowSet->row = row;
-					rowSet->next = odbc_alloc_rowSet();
-					rowSet = rowSet->next;
-					res->rowCount++;
-				}
-				else {
-					sql_odbc_free_fields(row);
-				}
-				if (sizes) xfree(sizes);
-			} while (odbc_Result(result));
-			ROWCOUNT = res->rowCount;
-			if (result == SQL_NO_DATA_FOUND) {
-				return res;
-			}
-			else if (!odbc_Result(result)) {
-				eventlog(eventlog_level_error, __FUNCTION__, "Unable to fetch row - ODBC error {}.", result);
-				odbc_Error(SQL_HANDLE_STMT, stmt, eventlog_level_error, __FUNCTION__);
+			res->prepared = 0;
+			if (odbc_store_rows(res)) {
 				sql_odbc_free_result(res);
 				return NULL;
 			}
@@ -327,7 +332,7 @@ namespace pvpgn
 		{
 			if (result) {
 				t_odbc_res *res = (t_odbc_res*)result;
-				if (res->stmt) {
+				if (res->stmt && !res->prepared) {
 					p_SQLFreeHandle(SQL_HANDLE_STMT, res->stmt);
 					res->stmt = NULL;
 				}
@@ -434,11 +439,84 @@ namespace pvpgn
 			escape[i] = 0;
 		}
 
+		static t_sql_stmt * sql_odbc_prepare(const char *query)
+		{
+			HSTMT stmt = SQL_NULL_HSTMT;
+
+			/* Validate query. */
+			if (query == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "Got a NULL query!");
+				return NULL;
+			}
+
+			p_SQLAllocStmt(con, &stmt);
+			if (!odbc_Result(p_SQLPrepare(stmt, (SQLCHAR*)query, SQL_NTS))) {
+				//		odbc_Error(SQL_HANDLE_STMT, stmt, eventlog_level_debug, __FUNCTION__);
+				p_SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+				return NULL;
+			}
+			return stmt;
+		}
+
+		static t_sql_res * sql_odbc_execute_res(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			t_odbc_res *res = NULL;
+			int result;
+			ROWCOUNT = 0;
+
+			if (!stmt) {
+				eventlog(eventlog_level_error, __FUNCTION__, "Got NULL statement.");
+				return NULL;
+			}
+
+			if (odbc_bind_execute((HSTMT)stmt, nparams, params))
+				return NULL;
+
+			/* Create a result. */
+			res = (t_odbc_res *)xmalloc(sizeof *res);
+			res->stmt = (HSTMT)stmt;
+			res->prepared = 1;
+			result = odbc_store_rows(res);
+			/* The rows are stored, so the statement can run again while the result is in use. */
+			p_SQLFreeStmt((HSTMT)stmt, SQL_CLOSE);
+			p_SQLFreeStmt((HSTMT)stmt, SQL_UNBIND);
+			if (result) {
+				sql_odbc_free_result(res);
+				return NULL;
+			}
+			return res;
+		}
+
+		static int sql_odbc_execute(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			if (!stmt) {
+				eventlog(eventlog_level_error, __FUNCTION__, "Got NULL statement.");
+				return -1;
+			}
+
+			if (odbc_bind_execute((HSTMT)stmt, nparams, params))
+				return -1;
+
+			p_SQLRowCount((HSTMT)stmt, &ROWCOUNT);
+			p_SQLFreeStmt((HSTMT)stmt, SQL_CLOSE);
+			return 0;
+		}
+
+		static void sql_odbc_finalize(t_sql_stmt *stmt)
+		{
+			if (!stmt) {
+				eventlog(eventlog_level_error, __FUNCTION__, "Got NULL statement.");
+				return;
+			}
+
+			p_SQLFreeHandle(SQL_HANDLE_STMT, (HSTMT)stmt);
+		}
+
 		/************************************************
 			End t_sql_engine Interface methods.
 			************************************************/
 
-		static t_sql_row* odbc_alloc_row(t_odbc_res *result, SQLINTEGER *sizes)
+		static t_sql_row* odbc_alloc_row(t_odbc_res *result, SQLLEN **sizes)
 		{
 			int i, fieldCount;
 			HSTMT stmt = result->stmt;
@@ -451,7 +529,7 @@ namespace pvpgn
 				return NULL;
 			}
 			row[fieldCount] = NULL;
-			sizes = (SQLINTEGER *)xcalloc(sizeof *sizes, fieldCount);
+			*sizes = (SQLLEN *)xcalloc(sizeof **sizes, fieldCount);
 
 			for (i = 0; i < fieldCount; i++)
 			{
@@ -462,13 +540,79 @@ namespace pvpgn
 				{
 					return NULL;
 				}
-				p_SQLBindCol(stmt, i + 1, SQL_C_CHAR, cell, cellSz, &sizes[i]);
+				p_SQLBindCol(stmt, i + 1, SQL_C_CHAR, cell, cellSz, &(*sizes)[i]);
 
 				row[i] = cell;
 			}
 			return row;
 		}
 
+		static int odbc_store_rows(t_odbc_res *res)
+		{
+			HSTMT stmt = res->stmt;
+			SQLRETURN result = 0;
+			t_odbc_rowSet *rowSet = odbc_alloc_rowSet();
+
+			res->rowSet = rowSet;
+			res->curRow = rowSet;
+			res->rowCount = 0;
+
+			/* Store rows. */
+			do {
+				SQLLEN *sizes = NULL;
+				t_sql_row *row = odbc_alloc_row(res, &sizes);
+				if (!row) {
+					return -1;
+				}
+				result = p_SQLFetch(stmt);
+				if (odbc_Result(result)) {
+					rowSet->row = row;
+					rowSet->next = odbc_alloc_rowSet();
+					rowSet = rowSet->next;
+					res->rowCount++;
+				}
+				else {
+					sql_odbc_free_fields(row);
+				}
+				if (sizes) xfree(sizes);
+			} while (odbc_Result(result));
+			ROWCOUNT = res->rowCount;
+			if (result != SQL_NO_DATA_FOUND && !odbc_Result(result)) {
+				eventlog(eventlog_level_error, __FUNCTION__, "Unable to fetch row - ODBC error {}.", result);
+				odbc_Error(SQL_HANDLE_STMT, stmt, eventlog_level_error, __FUNCTION__);
+				return -1;
+			}
+			return 0;
+		}
+
+		static int odbc_bind_execute(HSTMT stmt, unsigned int nparams, const char * const * params)
+		{
+			SQLLEN *ind = NULL;
+			unsigned int i;
+			int result = -1;
+
+			if (nparams)
+				ind = (SQLLEN *)xcalloc(sizeof *ind, nparams);
+			for (i = 0; i < nparams; i++) {
+				SQLULEN len = params[i] ? std::strlen(params[i]) : 0;
+				ind[i] = params[i] ? SQL_NTS : SQL_NULL_DATA;
+				if (!odbc_Result(p_SQLBindParameter(stmt, i + 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, len ? len : 1, 0, (SQLPOINTER)params[i], len, &ind[i]))) {
+					odbc_Error(SQL_HANDLE_STMT, stmt, eventlog_level_error, __FUNCTION__);
+					break;
+				}
+			}
+			/* The parameters are read by SQLExecute(), the buffers are the caller's. */
+			if (i == nparams && odbc_Result(p_SQLExecute(stmt))) {
+				result = 0;
+			}
+			else {
+				//		odbc_Error(SQL_HANDLE_STMT, stmt, eventlog_level_debug, __FUNCTION__);
+			}
+			p_SQLFreeStmt(stmt, SQL_RESET_PARAMS);
+			if (ind) xfree(ind);
+			return result;
+		}
+
 		static t_odbc_rowSet* odbc_alloc_rowSet()
 		{
 			t_odbc_rowSet *rowSet = (t_odbc_rowSet *)xmalloc(sizeof *rowSet);
@@ -480,14 +624,14 @@ namespace pvpgn
 		static void odbc_Error(SQLSMALLINT type, void *obj, t_eventlog_level level, const char *function)
 		{
 			SQLCHAR mState[6] = "\0";
-			long native = 0;
+			SQLINTEGER native = 0;
 			SQLSMALLINT mTextLen;
 			short i = 0;
 
 			while (p_SQLGetDiagRec(type, obj, ++i, NULL, NULL, NULL, 0, &mTextLen) != SQL_NO_DATA) {
 				SQLCHAR *mText = (SQLCHAR *)xcalloc(sizeof *mText, ++mTextLen);
 				p_SQLGetDiagRec(type, obj, i, mState, &native, mText, mTextLen, NULL);
-				eventlog(level, function, "ODBC Error: State {}, Native {}: {}", mState, native, mText);
+				eventlog(level, function, "ODBC Error: State {}, Native {}: {}", (const char *)mState, native, (const char *)mText);
 				xfree(mText);
 			}
 		}
@@ -20,8 +20,11 @@
 #include "common/setup_before.h"
 #include <libpq-fe.h>
 #include <cstdlib>
+#include <cstdio>
+#include <string>
 #include "common/eventlog.h"
 #include "common/xalloc.h"
+#include "common/xstring.h"
 #include "storage_sql.h"
 #include "sql_pgsql.h"
 #include "common/setup_after.h"
@@ -44,6 +47,10 @@ namespace pvpgn
 		static t_sql_field * sql_pgsql_fetch_fields(t_sql_res *);
 		static int sql_pgsql_free_fields(t_sql_field *);
 		static void sql_pgsql_escape_string(char *, const char *, int);
+		static t_sql_stmt * sql_pgsql_prepare(const char *);
+		static t_sql_res * sql_pgsql_execute_res(t_sql_stmt *, unsigned int, const char * const *);
+		static int sql_pgsql_execute(t_sql_stmt *, unsigned int, const char * const *);
+		static void sql_pgsql_finalize(t_sql_stmt *);
 
 		t_sql_engine sql_pgsql = {
 			sql_pgsql_init,
@@ -57,7 +64,11 @@ namespace pvpgn
 			sql_pgsql_affected_rows,
 			sql_pgsql_fetch_fields,
 			sql_pgsql_free_fields,
-			sql_pgsql_escape_string
+			sql_pgsql_escape_string,
+			sql_pgsql_prepare,
+			sql_pgsql_execute_res,
+			sql_pgsql_execute,
+			sql_pgsql_finalize
 		};
 
 		static PGconn *pgsql = NULL;
@@ -69,17 +80,26 @@ namespace pvpgn
 			PGresult *pgres;
 		} t_pgsql_res;
 
+		typedef struct {
+			char name[32];
+			unsigned int nparams;
+		} t_pgsql_stmt;
+
+		static unsigned int stmtcount = 0;
+
 #ifndef RUNTIME_LIBS
 #define p_PQclear		PQclear
 #define p_PQcmdTuples		PQcmdTuples
 #define p_PQerrorMessage	PQerrorMessage
 #define p_PQescapeString	PQescapeString
 #define p_PQexec		PQexec
+#define p_PQexecPrepared	PQexecPrepared
 #define p_PQfinish		PQfinish
 #define p_PQfname		PQfname
 #define p_PQgetvalue		PQgetvalue
 #define p_PQnfields		PQnfields
 #define p_PQntuples		PQntuples
+#define p_PQprepare		PQprepare
 #define p_PQresultStatus	PQresultStatus
 #define p_PQsetdbLogin		PQsetdbLogin
 #define p_PQstatus		PQstatus
@@ -92,11 +112,13 @@ namespace pvpgn
 		typedef char*		(*f_PQerrorMessage)(const PGconn*);
 		typedef size_t(*f_PQescapeString)(char*, const char*, size_t);
 		typedef PGresult*	(*f_PQexec)(PGconn*, const char*);
+		typedef PGresult*	(*f_PQexecPrepared)(PGconn*, const char*, int, const char* const*, const int*, const int*, int);
 		typedef void(*f_PQfinish)(PGconn*);
 		typedef char*		(*f_PQfname)(const PGresult*, int);
 		typedef char*		(*f_PQgetvalue)(const PGresult*, int, int);
 		typedef int(*f_PQnfields)(const PGresult*);
 		typedef int(*f_PQntuples)(const PGresult*);
+		typedef PGresult*	(*f_PQprepare)(PGconn*, const char*, const char*, int, const Oid*);
 		typedef ExecStatusType(*f_PQresultStatus)(const PGresult*);
 		typedef PGconn*		(*f_PQsetdbLogin)(const char*, const char*, const char*, const char*, const char*, const char*, const char*);
 		typedef ConnStatusType(*f_PQstatus)(const PGconn*);
@@ -106,11 +128,13 @@ namespace pvpgn
 		static f_PQerrorMessage	p_PQerrorMessage;
 		static f_PQescapeString	p_PQescapeString;
 		static f_PQexec		p_PQexec;
+		static f_PQexecPrepared	p_PQexecPrepared;
 		static f_PQfinish	p_PQfinish;
 		static f_PQfname	p_PQfname;
 		static f_PQgetvalue	p_PQgetvalue;
 		static f_PQnfields	p_PQnfields;
 		static f_PQntuples	p_PQntuples;
+		static f_PQprepare	p_PQprepare;
 		static f_PQresultStatus	p_PQresultStatus;
 		static f_PQsetdbLogin	p_PQsetdbLogin;
 		static f_PQstatus	p_PQstatus;
@@ -128,11 +152,13 @@ namespace pvpgn
 				((p_PQerrorMessage = (f_PQerrorMessage)GetFunction(handle, "PQerrorMessage")) == NULL) ||
 				((p_PQescapeString = (f_PQescapeString)GetFunction(handle, "PQescapeString")) == NULL) ||
 				((p_PQexec = (f_PQexec)GetFunction(handle, "PQexec")) == NULL) ||
+				((p_PQexecPrepared = (f_PQexecPrepared)GetFunction(handle, "PQexecPrepared")) == NULL) ||
 				((p_PQfinish = (f_PQfinish)GetFunction(handle, "PQfinish")) == NULL) ||
 				((p_PQfname = (f_PQfname)GetFunction(handle, "PQfname")) == NULL) ||
 				((p_PQgetvalue = (f_PQgetvalue)GetFunction(handle, "PQgetvalue")) == NULL) ||
 				((p_PQnfields = (f_PQnfields)GetFunction(handle, "PQnfields")) == NULL) ||
 				((p_PQntuples = (f_PQntuples)GetFunction(handle, "PQntuples")) == NULL) ||
+				((p_PQprepare = (f_PQprepare)GetFunction(handle, "PQprepare")) == NULL) ||
 				((p_PQresultStatus = (f_PQresultStatus)GetFunction(handle, "PQresultStatus")) == NULL) ||
 				((p_PQsetdbLogin = (f_PQsetdbLogin)GetFunction(handle, "PQsetdbLogin")) == NULL) ||
 				((p_PQstatus = (f_PQstatus)GetFunction(handle, "PQstatus")) == NULL))
@@ -365,6 +391,131 @@ namespace pvpgn
 			p_PQescapeString(escape, from, len);
 		}
 
+		static t_sql_stmt * sql_pgsql_prepare(const char * query)
+		{
+			t_pgsql_stmt *stmt;
+			PGresult *pgres;
+			std::string text;
+			const char *p;
+			bool literal = false;
+			int res;
+
+			if (pgsql == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "pgsql driver not initilized");
+				return NULL;
+			}
+
+			if (query == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL query");
+				return NULL;
+			}
+
+			stmt = (t_pgsql_stmt *)xmalloc(sizeof(t_pgsql_stmt));
+			std::snprintf(stmt->name, sizeof(stmt->name), "pvpgn_%u", ++stmtcount);
+			stmt->nparams = 0;
+
+			/* PostgreSQL numbers its placeholders, a '?' in a string literal is none */
+			for (p = query; *p; p++)
+			{
+				if (*p == '\'')
+					literal = !literal;
+				if (*p == '?' && !literal)
+					text += "$" + std_to_string(++stmt->nparams);
+				else
+					text += *p;
+			}
+
+			if ((pgres = p_PQprepare(pgsql, stmt->name, text.c_str(), stmt->nparams, NULL)) == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "not enough memory for result");
+				xfree((void*)stmt);
+				return NULL;
+			}
+
+			res = p_PQresultStatus(pgres) == PGRES_COMMAND_OK ? 0 : -1;
+			p_PQclear(pgres);
+			if (res) {
+				/*        eventlog(eventlog_level_debug, __FUNCTION__, "got error from prepare ({})", query); */
+				xfree((void*)stmt);
+				return NULL;
+			}
+
+			return stmt;
+		}
+
+		static PGresult * _pgsql_execute(t_pgsql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			if (pgsql == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "pgsql driver not initilized");
+				return NULL;
+			}
+
+			if (stmt == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return NULL;
+			}
+
+			if (nparams != stmt->nparams) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got {} parameters for {} placeholders", nparams, stmt->nparams);
+				return NULL;
+			}
+
+			return p_PQexecPrepared(pgsql, stmt->name, nparams, params, NULL, NULL, 0);
+		}
+
+		static t_sql_res * sql_pgsql_execute_res(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			t_pgsql_res *res;
+			PGresult *pgres;
+
+			if ((pgres = _pgsql_execute((t_pgsql_stmt *)stmt, nparams, params)) == NULL)
+				return NULL;
+
+			if (p_PQresultStatus(pgres) != PGRES_TUPLES_OK) {
+				p_PQclear(pgres);
+				return NULL;
+			}
+
+			res = (t_pgsql_res *)xmalloc(sizeof(t_pgsql_res));
+			res->rowbuf = (char **)xmalloc(sizeof(char *)* p_PQnfields(pgres));
+			res->pgres = pgres;
+			res->crow = 0;
+
+			return res;
+		}
+
+		static int sql_pgsql_execute(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			PGresult *pgres;
+			int res;
+
+			if ((pgres = _pgsql_execute((t_pgsql_stmt *)stmt, nparams, params)) == NULL)
+				return -1;
+
+			res = p_PQresultStatus(pgres) == PGRES_COMMAND_OK ? 0 : -1;
+			if (!res) _pgsql_update_arows(p_PQcmdTuples(pgres));
+			p_PQclear(pgres);
+
+			return res;
+		}
+
+		static void sql_pgsql_finalize(t_sql_stmt *stmt)
+		{
+			t_pgsql_stmt *st = (t_pgsql_stmt *)stmt;
+			char query[64];
+
+			if (st == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return;
+			}
+
+			/* not through sql_pgsql_query(), the affected rows of the last statement are kept */
+			if (pgsql) {
+				std::snprintf(query, sizeof(query), "DEALLOCATE %s", st->name);
+				p_PQclear(p_PQexec(pgsql, query));
+			}
+			xfree((void*)st);
+		}
+
 	}
 
 }
@@ -37,6 +37,7 @@ namespace pvpgn
 			int rows;
 			int columns;
 			int crow;
+			int copied;	/* results built from a prepared statement, not by sqlite3_get_table() */
 		} t_sqlite3_res;
 
 		static int sql_sqlite3_init(const char *, const char *, const char *, const char *, const char *, const char *);
@@ -51,6 +52,10 @@ namespace pvpgn
 		static t_sql_field * sql_sqlite3_fetch_fields(t_sql_res *);
 		static int sql_sqlite3_free_fields(t_sql_field *);
 		static void sql_sqlite3_escape_string(char *, const char *, int);
+		static t_sql_stmt * sql_sqlite3_prepare(const char *);
+		static t_sql_res * sql_sqlite3_execute_res(t_sql_stmt *, unsigned int, const char * const *);
+		static int sql_sqlite3_execute(t_sql_stmt *, unsigned int, const char * const *);
+		static void sql_sqlite3_finalize(t_sql_stmt *);
 
 		t_sql_engine sql_sqlite3 = {
 			sql_sqlite3_init,
@@ -64,41 +69,75 @@ namespace pvpgn
 			sql_sqlite3_affected_rows,
 			sql_sqlite3_fetch_fields,
 			sql_sqlite3_free_fields,
-			sql_sqlite3_escape_string
+			sql_sqlite3_escape_string,
+			sql_sqlite3_prepare,
+			sql_sqlite3_execute_res,
+			sql_sqlite3_execute,
+			sql_sqlite3_finalize
 		};
 
 		static sqlite3 *db = NULL;
 
 #ifndef RUNTIME_LIBS
+# define p_sqlite3_bind_null	sqlite3_bind_null
+# define p_sqlite3_bind_text	sqlite3_bind_text
 # define p_sqlite3_changes	sqlite3_changes
+# define p_sqlite3_clear_bindings	sqlite3_clear_bindings
 # define p_sqlite3_close	sqlite3_close
+# define p_sqlite3_column_count	sqlite3_column_count
+# define p_sqlite3_column_name	sqlite3_column_name
+# define p_sqlite3_column_text	sqlite3_column_text
 # define p_sqlite3_errmsg	sqlite3_errmsg
 # define p_sqlite3_exec		sqlite3_exec
+# define p_sqlite3_finalize	sqlite3_finalize
 # define p_sqlite3_free_table	sqlite3_free_table
 # define p_sqlite3_get_table	sqlite3_get_table
 # define p_sqlite3_open		sqlite3_open
+# define p_sqlite3_prepare_v2	sqlite3_prepare_v2
+# define p_sqlite3_reset	sqlite3_reset
 # define p_sqlite3_snprintf	sqlite3_snprintf
+# define p_sqlite3_step		sqlite3_step
 #else
 		/* RUNTIME_LIBS */
 		static int sqlite_load_library(void);
 
+		typedef int(*f_sqlite3_bind_null)(sqlite3_stmt*, int);
+		typedef int(*f_sqlite3_bind_text)(sqlite3_stmt*, int, const char*, int, void(*)(void*));
 		typedef int(*f_sqlite3_changes)(sqlite3*);
+		typedef int(*f_sqlite3_clear_bindings)(sqlite3_stmt*);
 		typedef int(*f_sqlite3_close)(sqlite3*);
+		typedef int(*f_sqlite3_column_count)(sqlite3_stmt*);
+		typedef const char*	(*f_sqlite3_column_name)(sqlite3_stmt*, int);
+		typedef const unsigned char*	(*f_sqlite3_column_text)(sqlite3_stmt*, int);
 		typedef const char*	(*f_sqlite3_errmsg)(sqlite3*);
 		typedef int(*f_sqlite3_exec)(sqlite3*, const char*, sqlite3_callback, void*, char**);
+		typedef int(*f_sqlite3_finalize)(sqlite3_stmt*);
 		typedef void(*f_sqlite3_free_table)(char **);
 		typedef int(*f_sqlite3_get_table)(sqlite3*, const char*, char***, int*, int*, char**);
 		typedef int(*f_sqlite3_open)(const char*, sqlite3**);
+		typedef int(*f_sqlite3_prepare_v2)(sqlite3*, const char*, int, sqlite3_stmt**, const char**);
+		typedef int(*f_sqlite3_reset)(sqlite3_stmt*);
 		typedef char*		(*f_sqlite3_snprintf)(int, char*, const char*, ...);
+		typedef int(*f_sqlite3_step)(sqlite3_stmt*);
 
+		static f_sqlite3_bind_null	p_sqlite3_bind_null = NULL;
+		static f_sqlite3_bind_text	p_sqlite3_bind_text = NULL;
 		static f_sqlite3_changes	p_sqlite3_changes = NULL;
+		static f_sqlite3_clear_bindings	p_sqlite3_clear_bindings = NULL;
 		static f_sqlite3_close		p_sqlite3_close = NULL;
+		static f_sqlite3_column_count	p_sqlite3_column_count = NULL;
+		static f_sqlite3_column_name	p_sqlite3_column_name = NULL;
+		static f_sqlite3_column_text	p_sqlite3_column_text = NULL;
 		static f_sqlite3_errmsg		p_sqlite3_errmsg = NULL;
 		static f_sqlite3_exec		p_sqlite3_exec = NULL;
+		static f_sqlite3_finalize	p_sqlite3_finalize = NULL;
 		static f_sqlite3_free_table	p_sqlite3_free_table = NULL;
 		static f_sqlite3_get_table	p_sqlite3_get_table = NULL;
 		static f_sqlite3_open		p_sqlite3_open = NULL;
+		static f_sqlite3_prepare_v2	p_sqlite3_prepare_v2 = NULL;
+		static f_sqlite3_reset		p_sqlite3_reset = NULL;
 		static f_sqlite3_snprintf	p_sqlite3_snprintf = NULL;
+		static f_sqlite3_step		p_sqlite3_step = NULL;
 
 #include "compat/runtime_libs.h" /* defines OpenLibrary(), GetFunction(), CloseLibrary() & SQLITE3_LIB */
 
@@ -108,14 +147,24 @@ namespace pvpgn
 		{
 			if ((handle = OpenLibrary(SQLITE3_LIB)) == NULL) return -1;
 
-			if (((p_sqlite3_changes = (f_sqlite3_changes)GetFunction(handle, "sqlite3_changes")) == NULL) ||
+			if (((p_sqlite3_bind_null = (f_sqlite3_bind_null)GetFunction(handle, "sqlite3_bind_null")) == NULL) ||
+				((p_sqlite3_bind_text = (f_sqlite3_bind_text)GetFunction(handle, "sqlite3_bind_text")) == NULL) ||
+				((p_sqlite3_changes = (f_sqlite3_changes)GetFunction(handle, "sqlite3_changes")) == NULL) ||
+				((p_sqlite3_clear_bindings = (f_sqlite3_clear_bindings)GetFunction(handle, "sqlite3_clear_bindings")) == NULL) ||
 				((p_sqlite3_close = (f_sqlite3_close)GetFunction(handle, "sqlite3_close")) == NULL) ||
+				((p_sqlite3_column_count = (f_sqlite3_column_count)GetFunction(handle, "sqlite3_column_count")) == NULL) ||
+				((p_sqlite3_column_name = (f_sqlite3_column_name)GetFunction(handle, "sqlite3_column_name")) == NULL) ||
+				((p_sqlite3_column_text = (f_sqlite3_column_text)GetFunction(handle, "sqlite3_column_text")) == NULL) ||
 				((p_sqlite3_errmsg = (f_sqlite3_errmsg)GetFunction(handle, "sqlite3_errmsg")) == NULL) ||
 				((p_sqlite3_exec = (f_sqlite3_exec)GetFunction(handle, "sqlite3_exec")) == NULL) ||
+				((p_sqlite3_finalize = (f_sqlite3_finalize)GetFunction(handle, "sqlite3_finalize")) == NULL) ||
 				((p_sqlite3_free_table = (f_sqlite3_free_table)GetFunction(handle, "sqlite3_free_table")) == NULL) ||
 				((p_sqlite3_get_table = (f_sqlite3_get_table)GetFunction(handle, "sqlite3_get_table")) == NULL) ||
 				((p_sqlite3_open = (f_sqlite3_open)GetFunction(handle, "sqlite3_open")) == NULL) ||
-				((p_sqlite3_snprintf = (f_sqlite3_snprintf)GetFunction(handle, "sqlite3_snprintf")) == NULL))
+				((p_sqlite3_prepare_v2 = (f_sqlite3_prepare_v2)GetFunction(handle, "sqlite3_prepare_v2")) == NULL) ||
+				((p_sqlite3_reset = (f_sqlite3_reset)GetFunction(handle, "sqlite3_reset")) == NULL) ||
+				((p_sqlite3_snprintf = (f_sqlite3_snprintf)GetFunction(handle, "sqlite3_snprintf")) == NULL) ||
+				((p_sqlite3_step = (f_sqlite3_step)GetFunction(handle, "sqlite3_step")) == NULL))
 			{
 				CloseLibrary(handle);
 				handle = NULL;
@@ -185,6 +234,7 @@ namespace pvpgn
 			}
 
 			res->crow = 0;
+			res->copied = 0;
 
 			return res;
 		}
@@ -223,7 +273,18 @@ namespace pvpgn
 				return;
 			}
 
-			p_sqlite3_free_table(((t_sqlite3_res *)result)->results);
+			t_sqlite3_res *res = (t_sqlite3_res *)result;
+
+			if (res->copied) {
+				int i;
+
+				for (i = 0; i < (res->rows + 1) * res->columns; i++)
+				if (res->results[i])
+					xfree((void *)res->results[i]);
+				xfree((void *)res->results);
+			}
+			else
+				p_sqlite3_free_table(res->results);
 			xfree(result);
 		}
 
@@ -282,6 +343,126 @@ namespace pvpgn
 			p_sqlite3_snprintf(len * 2 + 1, escape, "%q", from);
 		}
 
+		static t_sql_stmt * sql_sqlite3_prepare(const char *query)
+		{
+			sqlite3_stmt *stmt;
+
+			if (db == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "sqlite3 driver not initilized");
+				return NULL;
+			}
+
+			if (query == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL query");
+				return NULL;
+			}
+
+			if (p_sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK) {
+				/*        eventlog(eventlog_level_debug, __FUNCTION__, "got error ({}) from prepare ({})", p_sqlite3_errmsg(db), query); */
+				return NULL;
+			}
+
+			return stmt;
+		}
+
+		static int sql_sqlite3_bind_params(sqlite3_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			unsigned int i;
+			int rc;
+
+			p_sqlite3_reset(stmt);
+			p_sqlite3_clear_bindings(stmt);
+			for (i = 0; i < nparams; i++) {
+				if (params[i])
+					rc = p_sqlite3_bind_text(stmt, i + 1, params[i], -1, SQLITE_STATIC);
+				else
+					rc = p_sqlite3_bind_null(stmt, i + 1);
+				if (rc != SQLITE_OK) {
+					eventlog(eventlog_level_error, __FUNCTION__, "could not bind parameter {} ({})", i + 1, p_sqlite3_errmsg(db));
+					return -1;
+				}
+			}
+
+			return 0;
+		}
+
+		static t_sql_res * sql_sqlite3_execute_res(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			sqlite3_stmt *st = (sqlite3_stmt *)stmt;
+			t_sqlite3_res *res;
+			const char *val;
+			int size, i, rc;
+
+			if (stmt == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return NULL;
+			}
+
+			if (sql_sqlite3_bind_params(st, nparams, params))
+				return NULL;
+
+			/* same layout as sqlite3_get_table(), the first "row" holds the field names */
+			res = (t_sqlite3_res *)xmalloc(sizeof(t_sqlite3_res));
+			res->columns = p_sqlite3_column_count(st);
+			res->rows = 0;
+			res->crow = 0;
+			res->copied = 1;
+			size = 4;
+			res->results = (char **)xmalloc(sizeof(char *)* (size * res->columns + 1));
+			for (i = 0; i < res->columns; i++)
+				res->results[i] = xstrdup(p_sqlite3_column_name(st, i));
+
+			while ((rc = p_sqlite3_step(st)) == SQLITE_ROW) {
+				res->rows++;
+				if (res->rows + 1 > size) {
+					size *= 2;
+					res->results = (char **)xrealloc(res->results, sizeof(char *)* (size * res->columns + 1));
+				}
+				for (i = 0; i < res->columns; i++) {
+					val = (const char *)p_sqlite3_column_text(st, i);
+					res->results[res->rows * res->columns + i] = val ? xstrdup(val) : NULL;
+				}
+			}
+			p_sqlite3_reset(st);
+
+			if (rc != SQLITE_DONE) {
+				/*        eventlog(eventlog_level_debug, __FUNCTION__, "got error ({}) from step", p_sqlite3_errmsg(db)); */
+				sql_sqlite3_free_result(res);
+				return NULL;
+			}
+
+			return res;
+		}
+
+		static int sql_sqlite3_execute(t_sql_stmt *stmt, unsigned int nparams, const char * const * params)
+		{
+			sqlite3_stmt *st = (sqlite3_stmt *)stmt;
+			int rc;
+
+			if (stmt == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return -1;
+			}
+
+			if (sql_sqlite3_bind_params(st, nparams, params))
+				return -1;
+
+			while ((rc = p_sqlite3_step(st)) == SQLITE_ROW);
+			p_sqlite3_reset(st);
+
+			return rc == SQLITE_DONE ? 0 : -1;
+		}
+
+		static void sql_sqlite3_finalize(t_sql_stmt *stmt)
+		{
+			if (stmt == NULL) {
+				eventlog(eventlog_level_error, __FUNCTION__, "got NULL statement");
+				return;
+			}
+
+			p_sqlite3_finalize((sqlite3_stmt *)stmt);
+		}
+
 	}
 
 }
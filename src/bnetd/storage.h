@@ -59,6 +59,7 @@ namespace pvpgn
 			int(*load_teams)(t_load_teams_func);
 			int(*write_team)(void *);
 			int(*remove_team)(unsigned int);
+			int(*sync)(void);	/* end of a save cycle, make the writes durable */
 		} t_storage;
 
 	}
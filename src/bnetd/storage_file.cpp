@@ -44,6 +44,7 @@
 #include "team.h"
 #include "account.h"
 #include "file_plain.h"
+#include "filesync.h"
 #include "prefs.h"
 #include "clan.h"
 #undef CLAN_INTERNAL_ACCESS
@@ -78,6 +79,7 @@ namespace pvpgn
 		static int file_load_teams(t_load_teams_func);
 		static int file_write_team(void *);
 		static int file_remove_team(unsigned int);
+		static int file_sync(void);
 
 		/* storage struct populated with the functions above */
 
@@ -101,7 +103,8 @@ namespace pvpgn
 			file_remove_clanmember,
 			file_load_teams,
 			file_write_team,
-			file_remove_team
+			file_remove_team,
+			file_sync
 		};
 
 		/* start of actual file storage code */
@@ -110,6 +113,7 @@ namespace pvpgn
 		static const char *clansdir = NULL;
 		static const char *teamsdir = NULL;
 		static const char *defacct = NULL;
+		static char *journal = NULL;
 		static t_file_engine *file = NULL;
 
 		static unsigned file_read_maxuserid(void)
@@ -184,11 +188,23 @@ namespace pvpgn
 
 			xfree((void *)copy);
 
+			/* finish the saves a crash interrupted before the accounts are read */
+			journal = (char*)xmalloc(std::strlen(accountsdir) + 1 + std::strlen(BNETD_ACCOUNT_TMP) + 8 + 1);
+			std::sprintf(journal, "%s/%s-journal", accountsdir, BNETD_ACCOUNT_TMP);
+			filesync_open(journal);
+
 			return 0;
 		}
 
 		static int file_close(void)
 		{
+			filesync_commit();
+			filesync_close();
+
+			if (journal)
+				xfree((void *)journal);
+			journal = NULL;
+
 			if (accountsdir)
 				xfree((void *)accountsdir);
 			accountsdir = NULL;
@@ -242,7 +258,7 @@ namespace pvpgn
 			else
 			{
 				temp = (char*)xmalloc(std::strlen(accountsdir) + 1 + 8 + 1);	/* dir + / + uid + NUL */
-				std::sprintf(temp, "%s/%06u", accountsdir, maxuserid + 1);	/* FIXME: hmm, maybe up the %06 to %08... */
+				std::sprintf(temp, "%s/%06u", accountsdir, accountlist_next_uid());	/* FIXME: hmm, maybe up the %06 to %08... */
 			}
 
 			return temp;
@@ -251,6 +267,7 @@ namespace pvpgn
 		static int file_write_attrs(t_storage_info * info, const t_hlist *attributes)
 		{
 			char *tempname;
+			char const *base;
 
 			if (accountsdir == NULL || file == NULL)
 			{
@@ -270,30 +287,36 @@ namespace pvpgn
 				return -1;
 			}
 
-			tempname = (char*)xmalloc(std::strlen(accountsdir) + 1 + std::strlen(BNETD_ACCOUNT_TMP) + 1);
-			std::sprintf(tempname, "%s/%s", accountsdir, BNETD_ACCOUNT_TMP);
+			/* one temporary file per account, they are all renamed at the end of the save cycle */
+			base = std::strrchr((const char *)info, '/');
+			base = base ? base + 1 : (const char *)info;
+			tempname = (char*)xmalloc(std::strlen(accountsdir) + 1 + std::strlen(BNETD_ACCOUNT_TMP) + 1 + std::strlen(base) + 1);
+			std::sprintf(tempname, "%s/%s.%s", accountsdir, BNETD_ACCOUNT_TMP, base);
 
 			if (file->write_attrs(tempname, attributes))
 			{
 				/* no eventlog here, it should be reported from the file layer */
+				/* an earlier save of this cycle went into the same file, it is gone too */
+				filesync_drop((const char *)info);
 				xfree(tempname);
 				return -1;
 			}
 
-			if (p_rename(tempname, (const char *)info) < 0)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "could not std::rename account file to \"{}\" (std::rename: {})", (char *)info, std::strerror(errno));
-				xfree(tempname);
-				return -1;
-			}
-
+			filesync_add(tempname, (const char *)info);
 			xfree(tempname);
 
 			return 0;
 		}
 
+		static int file_sync(void)
+		{
+			return filesync_commit();
+		}
+
 		static int file_read_attrs(t_storage_info * info, t_read_attr_func cb, void *data, const char *ktab)
 		{
+			char const *name;
+
 			if (accountsdir == NULL || file == NULL)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "file storage not initilized");
@@ -312,9 +335,13 @@ namespace pvpgn
 				return -1;
 			}
 
-			eventlog(eventlog_level_debug, __FUNCTION__, "loading \"{}\"", reinterpret_cast<const char*>(info));
+			/* the last save of the account may still be waiting for its rename */
+			if (!(name = filesync_get_tempname((const char *)info)))
+				name = (const char *)info;
 
-			if (file->read_attrs((const char *)info, cb, data))
+			eventlog(eventlog_level_debug, __FUNCTION__, "loading \"{}\"", name);
+
+			if (file->read_attrs(name, cb, data))
 			{
 				/* no eventlog, error reported earlier */
 				return -1;
@@ -325,6 +352,8 @@ namespace pvpgn
 
 		static t_attr *file_read_attr(t_storage_info * info, const char *key)
 		{
+			char const *name;
+
 			if (accountsdir == NULL || file == NULL)
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "file storage not initilized");
@@ -343,7 +372,10 @@ namespace pvpgn
 				return NULL;
 			}
 
-			return file->read_attr((const char *)info, key);
+			if (!(name = filesync_get_tempname((const char *)info)))
+				name = (const char *)info;
+
+			return file->read_attr(name, key);
 		}
 
 		static int file_free_info(t_storage_info * info)
@@ -386,6 +418,25 @@ namespace pvpgn
 				char const *dentry;
 				while ((dentry = accdir.read())) {
 					std::ostringstream ostr;
+
+					if (!std::strncmp(dentry, BNETD_ACCOUNT_TMP, std::strlen(BNETD_ACCOUNT_TMP))) {
+						char const *target;
+
+						ostr << accountsdir << '/' << dentry;
+						if (!std::strcmp(ostr.str().c_str(), journal))
+							continue;
+						/* saved in this cycle, an account that has no file of its own yet is read from it */
+						if ((target = filesync_get_target(ostr.str().c_str()))) {
+							if (access(target, F_OK))
+								cb(xstrdup(target), data);
+							continue;
+						}
+						/* not in the journal, the crash came while it was written; the account file is still the old one */
+						WARN1("removing stale temporary file \"{}\"", ostr.str());
+						std::remove(ostr.str().c_str());
+						continue;
+					}
+
 					ostr << accountsdir << '/' << dentry;
 
 					cb(xstrdup(ostr.str().c_str()), data);
@@ -415,7 +466,7 @@ namespace pvpgn
 			if (accname && prefs_get_savebyname()) {
 				pathname = (char*)xmalloc(std::strlen(accountsdir) + 1 + std::strlen(accname) + 1);	/* dir + / + file + NUL */
 				std::sprintf(pathname, "%s/%s", accountsdir, accname);
-				if (access(pathname, F_OK))	/* if it doesn't exist */
+				if (!filesync_get_tempname(pathname) && access(pathname, F_OK))	/* if it doesn't exist, not even unsaved */
 				{
 					xfree((void *)pathname);
 					return NULL;
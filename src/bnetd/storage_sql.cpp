@@ -53,6 +53,7 @@ namespace pvpgn
 		static int sql_write_attrs(t_storage_info *, const t_hlist *);
 		static t_storage_info * sql_read_account(const char *, unsigned);
 		static const char *sql_escape_key(const char *);
+		static int sql_sync(void);
 
 		t_storage storage_sql = {
 			sql_init,
@@ -74,7 +75,8 @@ namespace pvpgn
 			sql_remove_clanmember,
 			sql_load_teams,
 			sql_write_team,
-			sql_remove_team
+			sql_remove_team,
+			sql_sync
 		};
 
 		// Attribute names that are assurance exist in database
@@ -82,8 +84,6 @@ namespace pvpgn
 
 		static char query[512];
 
-#ifndef SQL_ON_DEMAND
-
 		static const char *_db_add_tab(const char *tab, const char *key)
 		{
 			static char nkey[DB_MAX_ATTRKEY];
@@ -95,8 +95,6 @@ namespace pvpgn
 			return nkey;
 		}
 
-#endif	/* SQL_ON_DEMAND */
-
 		static int _db_get_tab(const char *key, char **ptab, char **pcol)
 		{
 			static char tab[DB_MAX_ATTRKEY];
@@ -122,9 +120,13 @@ namespace pvpgn
 		{
 			t_sql_res *result = NULL;
 			t_sql_row *row;
-			int uid = maxuserid + 1;
+			int uid = accountlist_next_uid();
 			t_storage_info *info;
 			char *user;
+			const char *params[2];
+			std::string suid;
+			char const * const *tab;
+			static char const * const tabs[] = { "profile", "Record", "friend", NULL };
 
 			if (!sql)
 			{
@@ -134,10 +136,11 @@ namespace pvpgn
 
 			user = xstrdup(username);
 			strtolower(user);
-			std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sBNET WHERE username='%s'", tab_prefix, user);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
+			std::snprintf(query, sizeof(query), "SELECT count(*) FROM %sBNET WHERE username = ?", tab_prefix);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, user);
 
-			if ((result = sql->query_res(query)) != NULL)
+			params[0] = user;
+			if ((result = sql_prepared_query_res(query, 1, params)) != NULL)
 			{
 				int num;
 
@@ -164,48 +167,33 @@ namespace pvpgn
 
 			info = xmalloc(sizeof(t_sql_info));
 			*((unsigned int *)info) = uid;
-			std::snprintf(query, sizeof(query), "DELETE FROM %sBNET WHERE " SQL_UID_FIELD " = '%u'", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			sql->query(query);
-			std::snprintf(query, sizeof(query), "INSERT INTO %sBNET (" SQL_UID_FIELD ",username) VALUES('%u','%s')", tab_prefix, uid, user);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			if (sql->query(query))
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "user insert failed (query: '{}')", query);
-				goto err_info;
-			}
-
-			std::snprintf(query, sizeof(query), "DELETE FROM %sprofile WHERE " SQL_UID_FIELD " = '%u'", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			sql->query(query);
-			std::snprintf(query, sizeof(query), "INSERT INTO %sprofile (" SQL_UID_FIELD ") VALUES('%u')", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			if (sql->query(query))
+			suid = std_to_string(uid);
+			params[0] = suid.c_str();
+			params[1] = user;
+
+			std::snprintf(query, sizeof(query), "DELETE FROM %sBNET WHERE " SQL_UID_FIELD " = ?", tab_prefix);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, uid);
+			sql_prepared_query(query, 1, params);
+			std::snprintf(query, sizeof(query), "INSERT INTO %sBNET (" SQL_UID_FIELD ",username) VALUES(?,?)", tab_prefix);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({}, {})", query, uid, user);
+			if (sql_prepared_query(query, 2, params))
 			{
 				eventlog(eventlog_level_error, __FUNCTION__, "user insert failed (query: '{}')", query);
 				goto err_info;
 			}
 
-			std::snprintf(query, sizeof(query), "DELETE FROM %sRecord WHERE " SQL_UID_FIELD " = '%u'", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			sql->query(query);
-			std::snprintf(query, sizeof(query), "INSERT INTO %sRecord (" SQL_UID_FIELD ") VALUES('%u')", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			if (sql->query(query))
+			for (tab = tabs; *tab; tab++)
 			{
-				eventlog(eventlog_level_error, __FUNCTION__, "user insert failed (query: '{}')", query);
-				goto err_info;
-			}
-
-			std::snprintf(query, sizeof(query), "DELETE FROM %sfriend WHERE " SQL_UID_FIELD " = '%u'", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			sql->query(query);
-			std::snprintf(query, sizeof(query), "INSERT INTO %sfriend (" SQL_UID_FIELD ") VALUES('%u')", tab_prefix, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-			if (sql->query(query))
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "user insert failed (query: '{}')", query);
-				goto err_info;
+				std::snprintf(query, sizeof(query), "DELETE FROM %s%s WHERE " SQL_UID_FIELD " = ?", tab_prefix, *tab);
+				eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, uid);
+				sql_prepared_query(query, 1, params);
+				std::snprintf(query, sizeof(query), "INSERT INTO %s%s (" SQL_UID_FIELD ") VALUES(?)", tab_prefix, *tab);
+				eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, uid);
+				if (sql_prepared_query(query, 1, params))
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "user insert failed (query: '{}')", query);
+					goto err_info;
+				}
 			}
 
 			xfree(user);
@@ -222,12 +210,15 @@ namespace pvpgn
 
 		static int sql_read_attrs(t_storage_info * info, t_read_attr_func cb, void *data, const char *ktab)
 		{
-#ifndef SQL_ON_DEMAND
 			t_sql_res *result = NULL;
 			t_sql_row *row;
+#ifndef SQL_ON_DEMAND
 			char **tab;
+#endif
 			unsigned int uid;
 			unsigned int num_fields;
+			std::string suid;
+			const char *params[1];
 
 			if (!sql)
 			{
@@ -248,160 +239,99 @@ namespace pvpgn
 			}
 
 			uid = *((unsigned int *)info);
+			suid = std_to_string(uid);
+			params[0] = suid.c_str();
 
+#ifndef SQL_ON_DEMAND
+			// process only a table where the attribute is in
 			for (tab = const_cast<char **>(sql_tables); *tab; tab++)
-			{
-				// process only a table where the attribute is in
-				if (strcmp(ktab, *tab) != 0)
-					continue;
-
-				std::snprintf(query, sizeof(query), "SELECT * FROM %s%s WHERE " SQL_UID_FIELD "='%u'", tab_prefix, *tab, uid);
-				eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
-
-				if ((result = sql->query_res(query)) != NULL && sql->num_rows(result) == 1 && (num_fields = sql->num_fields(result)) > 1)
-				{
-					unsigned int i;
-					t_sql_field *fields, *fentry;
-
-					if ((fields = sql->fetch_fields(result)) == NULL)
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "could not fetch the fields");
-						sql->free_result(result);
-						return -1;
-					}
-
-					if (!(row = sql->fetch_row(result)))
-					{
-						eventlog(eventlog_level_error, __FUNCTION__, "could not fetch row");
-						sql->free_fields(fields);
-						sql->free_result(result);
-						return -1;
-					}
-
-					for (i = 0, fentry = fields; *fentry; fentry++, i++)
-					{
-						char *output;
-
-						// (HarpyWar) fix for sqlite3, cause it return columns+rows in "fields", unlike only columns in other databases
-						//            and this row[i] goes beyond the bounds of the array. This restriction handles it.
-						if (i >= num_fields)
-							break;
-						
-						/* we have to skip "uid" */
-						/* we ignore the field used internally by sql */
-						if (std::strcmp(*fentry, SQL_UID_FIELD) == 0)
-							continue;
-
-						//              eventlog(eventlog_level_trace, __FUNCTION__, "read key (step1): '{}' val: '{}'", _db_add_tab(*tab, *fentry), unescape_chars(row[i]));
-						if (row[i] == NULL)
-							continue;	/* its an NULL value sql field */
-
-						//              eventlog(eventlog_level_trace, __FUNCTION__, "read key (step2): '{}' val: '{}'", _db_add_tab(*tab, *fentry), unescape_chars(row[i]));
-						if (cb(_db_add_tab(*tab, *fentry), (output = unescape_chars(row[i])), data))
-							eventlog(eventlog_level_error, __FUNCTION__, "got error from callback on UID: {}", uid);
-						if (output)
-							xfree((void *)output);
-						//              eventlog(eventlog_level_trace, __FUNCTION__, "read key (final): '{}' val: '{}'", _db_add_tab(*tab, *fentry), unescape_chars(row[i]));
-					}
-
-					sql->free_fields(fields);
-				}
-				if (result)
-					sql->free_result(result);
-			}
-#endif				/* SQL_ON_DEMAND */
-			return 0;
-		}
-
-		static t_attr *sql_read_attr(t_storage_info * info, const char *key)
-		{
-#ifdef SQL_ON_DEMAND
-			t_sql_res *result = NULL;
-			t_sql_row *row;
-			char *tab, *col;
-			unsigned int uid;
-			t_attr    *attr;
-
-			if (!sql)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "sql layer not initilized");
-				return NULL;
-			}
+			if (strcmp(ktab, *tab) == 0)
+				break;
+			if (!*tab)
+				return 0;
+#endif
 
-			if (info == NULL)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL storage info");
-				return NULL;
-			}
+			/* the whole row is read at once, the attrgroup asks for it on the
+			 * first lookup of any attribute of the table */
+			std::snprintf(query, sizeof(query), "SELECT * FROM %s%s WHERE " SQL_UID_FIELD " = ?", tab_prefix, ktab);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, uid);
 
-			if (key == NULL)
+			if ((result = sql_prepared_query_res(query, 1, params)) == NULL)
 			{
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL key");
-				return NULL;
+				/* unlike a missing row this must not be taken as an empty table */
+				eventlog(eventlog_level_error, __FUNCTION__, "error reading table \"{}\" for UID: {}", ktab, uid);
+				return -1;
 			}
 
-			uid = *((unsigned int *)info);
-
-			if (_db_get_tab(key, &tab, &col) < 0)
+			if (sql->num_rows(result) == 1 && (num_fields = sql->num_fields(result)) > 1)
 			{
-				eventlog(eventlog_level_error, __FUNCTION__, "error from _db_get_tab");
-				return NULL;
-			}
+				unsigned int i;
+				t_sql_field *fields, *fentry;
 
-			std::snprintf(query, sizeof(query), "SELECT %s FROM %s%s WHERE " SQL_UID_FIELD " = %u", col, tab_prefix, tab, uid);
-			eventlog(eventlog_level_trace, __FUNCTION__, query);
-			if ((result = sql->query_res(query)) == NULL)
-				return NULL;
+				if ((fields = sql->fetch_fields(result)) == NULL)
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "could not fetch the fields");
+					sql->free_result(result);
+					return -1;
+				}
 
-			if (sql->num_rows(result) != 1)
-			{
-				//      eventlog(eventlog_level_debug, __FUNCTION__, "wrong numer of rows from query ({})", query);
-				sql->free_result(result);
-				return NULL;
-			}
+				if (!(row = sql->fetch_row(result)))
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "could not fetch row");
+					sql->free_fields(fields);
+					sql->free_result(result);
+					return -1;
+				}
 
-			if (!(row = sql->fetch_row(result)))
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "could not fetch row");
-				sql->free_result(result);
-				return NULL;
-			}
+				for (i = 0, fentry = fields; *fentry; fentry++, i++)
+				{
+					char *output;
 
-			if (row[0] == NULL)
-			{
-				//      eventlog(eventlog_level_debug, __FUNCTION__, "NULL value from query ({})", query);
-				sql->free_result(result);
-				return NULL;
-			}
+					// (HarpyWar) fix for sqlite3, cause it return columns+rows in "fields", unlike only columns in other databases
+					//            and this row[i] goes beyond the bounds of the array. This restriction handles it.
+					if (i >= num_fields)
+						break;
+					
+					/* we have to skip "uid" */
+					/* we ignore the field used internally by sql */
+					if (std::strcmp(*fentry, SQL_UID_FIELD) == 0)
+						continue;
+
+					//              eventlog(eventlog_level_trace, __FUNCTION__, "read key (step1): '{}' val: '{}'", _db_add_tab(ktab, *fentry), unescape_chars(row[i]));
+					if (row[i] == NULL)
+						continue;	/* its an NULL value sql field */
+
+					//              eventlog(eventlog_level_trace, __FUNCTION__, "read key (step2): '{}' val: '{}'", _db_add_tab(ktab, *fentry), unescape_chars(row[i]));
+					if (cb(_db_add_tab(ktab, *fentry), (output = unescape_chars(row[i])), data))
+						eventlog(eventlog_level_error, __FUNCTION__, "got error from callback on UID: {}", uid);
+					if (output)
+						xfree((void *)output);
+					//              eventlog(eventlog_level_trace, __FUNCTION__, "read key (final): '{}' val: '{}'", _db_add_tab(ktab, *fentry), unescape_chars(row[i]));
+				}
 
-			/* Because we are double quoting the column name
-			sqlite3 treats it as a string when the column does not exist
-			and returns the column name as the result.
-			We need to return NULL under this condition */
-			if (std::strcmp(row[0], col) == 0)
-			{
-				sql->free_result(result);
-				return NULL;
+				sql->free_fields(fields);
 			}
-
-			attr = attr_create(key, row[0]);
 			sql->free_result(result);
+			return 0;
+		}
 
-			return attr;
-#else
+		/* attributes are only read a table at a time by sql_read_attrs, a key
+		 * which was not in the row is not set for the account */
+		static t_attr *sql_read_attr(t_storage_info * info, const char *key)
+		{
 			return NULL;
-#endif				/* SQL_ON_DEMAND */
 		}
 
 		/* write ONLY dirty attributes */
 		int sql_write_attrs(t_storage_info * info, const t_hlist *attrs)
 		{
-			char escape[DB_MAX_ATTRVAL * 2 + 1];	/* sql docs say the escape can take a maximum of double original size + 1 */
 			char safeval[DB_MAX_ATTRVAL];
-			char *p, *tab, *col;
+			char *tab, *col;
 			t_attr *attr;
 			t_hlist *curr;
 			unsigned int uid;
+			std::string suid;
+			const char *params[2];
 
 			if (!sql)
 			{
@@ -422,8 +352,10 @@ namespace pvpgn
 			}
 
 			uid = *((unsigned int *)info);
+			suid = std_to_string(uid);
 
 			std::map<std::string, std::string > queries;
+			std::map<std::string, std::vector<std::string> > values;
 
 			hlist_for_each(curr, (t_hlist*)attrs) 
 			{
@@ -449,17 +381,13 @@ namespace pvpgn
 
 				std::strncpy(safeval, attr_get_val(attr), DB_MAX_ATTRVAL - 1);
 				safeval[DB_MAX_ATTRVAL - 1] = 0;
-				for (p = safeval; *p; p++)
-				if (*p == '\'')	/* value shouldn't contain ' */
-					*p = '"';
 
-				sql->escape_string(escape, safeval, std::strlen(safeval));
-				
 				// if attribute found in known attributes list
 				if (std::find(knownattributes[tab].begin(), knownattributes[tab].end(), col) != knownattributes[tab].end())
 				{
 					// append new field and value
-					queries[tab] += std::string(col) + " = '" + std::string(escape) + "', ";
+					queries[tab] += std::string(col) + " = ?, ";
+					values[tab].push_back(safeval);
 
 					/* PASS NEXT CODE EXECUTION
 					(MERGED QUERIES WILL BE EXECUTED AT THE END OF THE FUNCTION) */
@@ -467,10 +395,12 @@ namespace pvpgn
 				}
 
 				/* FIRST TIME UPDATE EACH ATTRIBUTE IN A SINGLE QUERY AND SAVE ATTRIBUTE NAME IN 'knownattributes' */
-				std::snprintf(query, sizeof(query), "UPDATE %s%s SET %s = '%s' WHERE " SQL_UID_FIELD " = '%u'", tab_prefix, tab, col, escape, uid);
-				eventlog(eventlog_level_trace, "db_set", "{}", query);
+				std::snprintf(query, sizeof(query), "UPDATE %s%s SET %s = ? WHERE " SQL_UID_FIELD " = ?", tab_prefix, tab, col);
+				eventlog(eventlog_level_trace, "db_set", "{} ({}, {})", query, safeval, uid);
+				params[0] = safeval;
+				params[1] = suid.c_str();
 
-				if (sql->query(query) || !sql->affected_rows()) {
+				if (sql_prepared_query(query, 2, params) || !sql->affected_rows()) {
 					char query2[512];
 
 					//	    eventlog(eventlog_level_debug, __FUNCTION__, "trying to insert new column {}", col);
@@ -481,12 +411,14 @@ namespace pvpgn
 
 					/* try query again */
 					//          eventlog(eventlog_level_trace, "db_set", "retry insert query: {}", query);
-					if (sql->query(query) || !sql->affected_rows()) {
+					if (sql_prepared_query(query, 2, params) || !sql->affected_rows()) {
 						// Tried everything, now trying to insert that user to the table for the first time
-						std::snprintf(query2, sizeof(query2), "INSERT INTO %s%s (" SQL_UID_FIELD ",%s) VALUES ('%u','%s')", tab_prefix, tab, col, uid, escape);
-						eventlog(eventlog_level_trace, __FUNCTION__, "{}", query2);
+						std::snprintf(query2, sizeof(query2), "INSERT INTO %s%s (" SQL_UID_FIELD ",%s) VALUES (?,?)", tab_prefix, tab, col);
+						eventlog(eventlog_level_trace, __FUNCTION__, "{} ({}, {})", query2, uid, safeval);
 						//              eventlog(eventlog_level_error, __FUNCTION__, "update failed so tried INSERT for the last chance");
-						if (sql->query(query2))
+						params[0] = suid.c_str();
+						params[1] = safeval;
+						if (sql_prepared_query(query2, 2, params))
 						{
 							eventlog(eventlog_level_error, __FUNCTION__, "could not INSERT attribute '{}'->'{}'", attr_get_key(attr), attr_get_val(attr));
 							continue;
@@ -504,14 +436,20 @@ namespace pvpgn
 			}
 			
 			std::string query_s;
+			std::vector<const char *> qparams;
 			// iterate all queries
 			for (std::map<std::string, std::string>::iterator q = queries.begin(); q != queries.end(); ++q)
 			{
 				query_s = "UPDATE " + std::string(tab_prefix) + q->first + " SET ";
 				query_s += q->second.substr(0, q->second.size() - 2); // remove last reduntant comma at the end of the string with parameters
-				query_s += " WHERE " SQL_UID_FIELD " = '" + std_to_string(uid) + "'";
+				query_s += " WHERE " SQL_UID_FIELD " = ?";
+
+				qparams.clear();
+				for (std::vector<std::string>::iterator v = values[q->first].begin(); v != values[q->first].end(); ++v)
+					qparams.push_back(v->c_str());
+				qparams.push_back(suid.c_str());
 
-				if (!sql->query(query_s.c_str()))
+				if (!sql_prepared_query(query_s.c_str(), qparams.size(), &qparams[0]))
 				{
 					eventlog(eventlog_level_trace, __FUNCTION__, "multi-update query: {}", query_s.c_str());
 				}
@@ -530,6 +468,8 @@ namespace pvpgn
 			t_sql_res *result = NULL;
 			t_sql_row *row;
 			t_storage_info *info;
+			std::string key;
+			const char *params[1];
 
 			if (!sql)
 			{
@@ -542,16 +482,20 @@ namespace pvpgn
 			if (name) {
 				char *user = xstrdup(name);
 				strtolower(user);
-
-				std::snprintf(query, sizeof(query), "SELECT " SQL_UID_FIELD " FROM %sBNET WHERE username='%s'", tab_prefix, user);
+				key = user;
 				xfree(user);
+
+				std::snprintf(query, sizeof(query), "SELECT " SQL_UID_FIELD " FROM %sBNET WHERE username = ?", tab_prefix);
+			}
+			else {
+				key = std_to_string(uid);
+				std::snprintf(query, sizeof(query), "SELECT " SQL_UID_FIELD " FROM %sBNET WHERE " SQL_UID_FIELD " = ?", tab_prefix);
 			}
-			else
-				std::snprintf(query, sizeof(query), "SELECT " SQL_UID_FIELD " FROM %sBNET WHERE " SQL_UID_FIELD " = '%u'", tab_prefix, uid);
 			
-			eventlog(eventlog_level_trace, __FUNCTION__, "{}", query);
+			eventlog(eventlog_level_trace, __FUNCTION__, "{} ({})", query, key);
 
-			result = sql->query_res(query);
+			params[0] = key.c_str();
+			result = sql_prepared_query_res(query, 1, params);
 			if (!result) {
 				eventlog(eventlog_level_error, __FUNCTION__, "error query db (query:\"{}\")", query);
 				return NULL;
@@ -606,6 +550,12 @@ namespace pvpgn
 			return newkey;
 		}
 
+		static int sql_sync(void)
+		{
+			/* every write is its own query, nothing is left to do */
+			return 0;
+		}
+
 	}
 
 }
@@ -20,10 +20,12 @@
 #include "common/setup_before.h"
 #include "timer.h"
 #include <cstdlib>
+#include <cstdio>
 #include "common/elist.h"
 #include "connection.h"
 #include "common/eventlog.h"
 #include "common/xalloc.h"
+#include "slowlog.h"
 #include "common/setup_after.h"
 
 namespace pvpgn
@@ -35,17 +37,12 @@ namespace pvpgn
 		static t_elist timerlist_head;
 
 
+		/* timers without an owner belong to the server, they only go away when they expire */
 		extern int timerlist_add_timer(t_connection * owner, std::time_t when, t_timer_cb cb, t_timer_data data)
 		{
 			t_timer * timer, *ctimer;
 			t_elist * curr;
 
-			if (!owner)
-			{
-				eventlog(eventlog_level_error, __FUNCTION__, "got NULL owner");
-				return -1;
-			}
-
 			timer = (t_timer*)xmalloc(sizeof(t_timer));
 			timer->owner = owner;
 			timer->when = when;
@@ -61,7 +58,10 @@ namespace pvpgn
 			elist_add_tail(curr, &timer->timers);
 
 			/* add it to the t_conn timers list */
-			elist_add_tail(conn_get_timer(owner), &timer->owners);
+			if (owner)
+				elist_add_tail(conn_get_timer(owner), &timer->owners);
+			else
+				elist_init(&timer->owners);
 
 			return 0;
 		}
@@ -100,10 +100,22 @@ namespace pvpgn
 			elist_for_each_safe(curr, &timerlist_head, save)
 			{
 				timer = elist_entry(curr, t_timer, timers);
-				if (timer->owner && timer->when < when)
+				if (timer->when < when)
 				{
 					if (timer->cb)
+					{
+						t_slowlog_mark mark = slowlog_begin();
+						unsigned long usec;
+						char what[32];
+
 						timer->cb(timer->owner, timer->when, timer->data);
+						if ((usec = slowlog_elapsed(mark)))
+						{
+							/* the callback by address, addr2line can name it */
+							std::snprintf(what, sizeof(what), "callback %p", (void *)timer->cb);
+							slowlog_add(slowlog_timer, timer->owner, NULL, what, usec);
+						}
+					}
 					elist_del(&timer->owners);
 					elist_del(&timer->timers);
 					xfree((void*)timer);
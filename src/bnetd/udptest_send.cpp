@@ -40,57 +40,176 @@ namespace pvpgn
 	namespace bnetd
 	{
 
-		extern int udptest_send(t_connection const * c)
+		/*
+		 * Every client logging in with a game gets two UDPTEST packets. They
+		 * are queued and sent at the end of the server loop, with one
+		 * sendmmsg() for each run of the same game socket. A packet that
+		 * could not be sent is tried again in the next loop.
+		 */
+#define UDPTEST_QUEUE_MAX 512
+#define UDPTEST_BATCH 64
+#define UDPTEST_TRIES 3
+
+		typedef struct
 		{
-			t_packet *         upacket;
+			int            usock;   /* game socket to send from */
+			int            csock;   /* socket of the connection, for the log */
+			unsigned int   addr;
+			unsigned short port;
+			unsigned int   tries;
+		} t_udptest;
+
+		static t_udptest udptest_queue[UDPTEST_QUEUE_MAX];
+		static unsigned int udptest_count = 0;
+		static t_packet * udptest_packet = NULL;	/* they are all the same */
+
+
+		static int udptest_build(void)
+		{
+			if (udptest_packet)
+				return 0;
+
+			if (!(udptest_packet = packet_create(packet_class_udp)))
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "could not allocate memory for packet");
+				return -1;
+			}
+			packet_set_size(udptest_packet, sizeof(t_server_udptest));
+			packet_set_type(udptest_packet, SERVER_UDPTEST);
+			bn_int_tag_set(&udptest_packet->u.server_udptest.bnettag, BNETTAG);
+			return 0;
+		}
+
+
+		static void udptest_set_addr(struct sockaddr_in * caddr, t_udptest const * test)
+		{
+			std::memset(caddr, 0, sizeof(*caddr));
+			caddr->sin_family = PSOCK_AF_INET;
+			caddr->sin_port = htons(test->port);
+			caddr->sin_addr.s_addr = htonl(test->addr);
+		}
+
+
+		/* how many of the tests were sent, -1 if not even the first one */
+		static int udptest_send_batch(t_udptest const * tests, unsigned int count)
+		{
+#ifdef HAVE_SENDMMSG
+			struct mmsghdr     msgs[UDPTEST_BATCH];
+			struct iovec       iov;
+			struct sockaddr_in caddrs[UDPTEST_BATCH];
+			unsigned int       i;
+
+			if (count > UDPTEST_BATCH)
+				count = UDPTEST_BATCH;
+
+			iov.iov_base = (void *)packet_get_raw_data_const(udptest_packet, 0);
+			iov.iov_len = packet_get_size(udptest_packet);
+			std::memset(msgs, 0, count * sizeof(*msgs));
+			for (i = 0; i < count; i++)
+			{
+				udptest_set_addr(&caddrs[i], &tests[i]);
+				msgs[i].msg_hdr.msg_name = &caddrs[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(caddrs[i]);
+				msgs[i].msg_hdr.msg_iov = &iov;
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			return sendmmsg(tests[0].usock, msgs, count, 0);
+#else
 			struct sockaddr_in caddr;
-			unsigned int       tries, successes;
 
-			std::memset(&caddr, 0, sizeof(caddr));
-			caddr.sin_family = PSOCK_AF_INET;
-			caddr.sin_port = htons(conn_get_game_port(c));
-			caddr.sin_addr.s_addr = htonl(conn_get_game_addr(c));
+			udptest_set_addr(&caddr, &tests[0]);
+			if (psock_sendto(tests[0].usock,
+				packet_get_raw_data_const(udptest_packet, 0), packet_get_size(udptest_packet),
+				0, (struct sockaddr *)&caddr, (psock_t_socklen)sizeof(caddr)) != (int)packet_get_size(udptest_packet))
+				return -1;
+			return 1;
+#endif
+		}
+
+
+		static void udptest_hexdump(t_udptest const * test)
+		{
+			std::fprintf(hexstrm, "%d: send class=%s[0x%02x] type=%s[0x%04x] ",
+				test->usock,
+				packet_get_class_str(udptest_packet), (unsigned int)packet_get_class(udptest_packet),
+				packet_get_type_str(udptest_packet, packet_dir_from_server), packet_get_type(udptest_packet));
+			std::fprintf(hexstrm, "to=%s ",
+				addr_num_to_addr_str(test->addr, test->port));
+			std::fprintf(hexstrm, "length=%u\n",
+				packet_get_size(udptest_packet));
+			hexdump(hexstrm, packet_get_raw_data(udptest_packet, 0), packet_get_size(udptest_packet));
+		}
+
 
-			for (tries = successes = 0; successes != 2 && tries < 5; tries++)
+		extern void udptest_send(t_connection const * c)
+		{
+			unsigned int i;
+
+			if (udptest_count + 2 > UDPTEST_QUEUE_MAX)
+				udptest_flush();
+			if (udptest_count + 2 > UDPTEST_QUEUE_MAX)
+			{
+				eventlog(eventlog_level_error, __FUNCTION__, "[{}] UDPTEST queue is full, not testing {}", conn_get_socket(c), addr_num_to_addr_str(conn_get_game_addr(c), conn_get_game_port(c)));
+				return;
+			}
+
+			for (i = 0; i < 2; i++)
+			{
+				t_udptest * test = &udptest_queue[udptest_count++];
+
+				test->usock = conn_get_game_socket(c);
+				test->csock = conn_get_socket(c);
+				test->addr = conn_get_game_addr(c);
+				test->port = conn_get_game_port(c);
+				test->tries = 0;
+			}
+		}
+
+
+		extern void udptest_flush(void)
+		{
+			unsigned int i, n, kept;
+			int          sent;
+
+			if (!udptest_count || udptest_build() < 0)
+				return;
+
+			for (i = kept = 0; i < udptest_count; i += n)
 			{
-				if (!(upacket = packet_create(packet_class_udp)))
+				/* a run of tests from the same socket */
+				for (n = 1; i + n < udptest_count && udptest_queue[i + n].usock == udptest_queue[i].usock; n++);
+
+				if ((sent = udptest_send_batch(&udptest_queue[i], n)) <= 0)
 				{
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] could not allocate memory for packet", conn_get_socket(c));
+					t_udptest * test = &udptest_queue[i];
+
+					if (++test->tries < UDPTEST_TRIES)
+						udptest_queue[kept++] = *test;
+					else
+						eventlog(eventlog_level_error, __FUNCTION__, "[{}] failed to send UDPTEST to {} (attempt {}) (psock_sendto: {})", test->csock, addr_num_to_addr_str(test->addr, test->port), test->tries, pstrerror(psock_errno()));
+					n = 1;
 					continue;
 				}
-				packet_set_size(upacket, sizeof(t_server_udptest));
-				packet_set_type(upacket, SERVER_UDPTEST);
-				bn_int_tag_set(&upacket->u.server_udptest.bnettag, BNETTAG);
 
+				n = sent;
 				if (hexstrm)
-				{
-					std::fprintf(hexstrm, "%d: send class=%s[0x%02x] type=%s[0x%04x] ",
-						conn_get_game_socket(c),
-						packet_get_class_str(upacket), (unsigned int)packet_get_class(upacket),
-						packet_get_type_str(upacket, packet_dir_from_server), packet_get_type(upacket));
-					std::fprintf(hexstrm, "from=%s ",
-						addr_num_to_addr_str(conn_get_game_addr(c), conn_get_game_port(c)));
-					std::fprintf(hexstrm, "to=%s ",
-						addr_num_to_addr_str(ntohl(caddr.sin_addr.s_addr), ntohs(caddr.sin_port)));
-					std::fprintf(hexstrm, "length=%u\n",
-						packet_get_size(upacket));
-					hexdump(hexstrm, packet_get_raw_data(upacket, 0), packet_get_size(upacket));
-				}
-
-				if (psock_sendto(conn_get_game_socket(c),
-					packet_get_raw_data_const(upacket, 0), packet_get_size(upacket),
-					0, (struct sockaddr *)&caddr, (psock_t_socklen)sizeof(caddr)) != (int)packet_get_size(upacket))
-					eventlog(eventlog_level_error, __FUNCTION__, "[{}] failed to send UDPTEST to {} (attempt {}) (psock_sendto: {})", conn_get_socket(c), addr_num_to_addr_str(ntohl(caddr.sin_addr.s_addr), conn_get_game_port(c)), tries + 1, pstrerror(psock_errno()));
-				else
-					successes++;
-
-				packet_del_ref(upacket);
+					for (unsigned int j = 0; j < n; j++)
+						udptest_hexdump(&udptest_queue[i + j]);
 			}
 
-			if (successes != 2)
-				return -1;
+			udptest_count = kept;
+		}
 
-			return 0;
+
+		extern void udptest_unload(void)
+		{
+			udptest_count = 0;
+			if (udptest_packet)
+			{
+				packet_del_ref(udptest_packet);
+				udptest_packet = NULL;
+			}
 		}
 
 	}
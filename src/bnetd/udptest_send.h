@@ -27,7 +27,9 @@ namespace pvpgn
 	namespace bnetd
 	{
 
-		extern int udptest_send(t_connection const * c);
+		extern void udptest_send(t_connection const * c);
+		extern void udptest_flush(void);
+		extern void udptest_unload(void);
 
 	}
 
@@ -24,6 +24,7 @@
 #include "message.h"
 #include "friends.h"
 #include "prefs.h"
+#include "cluster.h"
 #include "common/setup_after.h"
 
 
@@ -122,8 +123,25 @@ namespace pvpgn
 				}
 			}
 
+		/* the notice comes from the user itself, by name if it is logged on to another cluster node */
+		static int watch_send(t_connection * dst, t_connection * src, char const * srcname, char const * text)
+		{
+			t_message * message;
+			int         rez;
+
+			if (!srcname)
+				return message_send_text(dst, message_type_whisper, src, text);
+
+			if (!(message = message_create_remote(message_type_whisper, srcname, text)))
+				return -1;
+			rez = message_send(message, dst);
+			message_destroy(message);
+
+			return rez;
+		}
+
 		int
-			WatchComponent::dispatch_whisper(t_account *account, char const *gamename, t_clienttag clienttag, Watch::EventType event) const
+			WatchComponent::dispatch_whisper(t_account *account, char const *gamename, t_clienttag clienttag, Watch::EventType event, bool remote) const
 		{
 				t_elem const * curr;
 				char msg[512];
@@ -133,6 +151,7 @@ namespace pvpgn
 				t_connection * dest_c, *my_c;
 				t_friend * fr;
 				char const * game_title;
+				char const * srcname;
 
 				if (!(myusername = account_get_name(account)))
 				{
@@ -141,6 +160,7 @@ namespace pvpgn
 				}
 
 				my_c = account_get_conn(account);
+				srcname = remote ? myusername : NULL;
 
 				game_title = clienttag_get_title(clienttag);
 
@@ -181,7 +201,7 @@ namespace pvpgn
 						else {
 							cnt++;	/* keep track of successful whispers */
 							if (friend_get_mutual(fr))
-								message_send_text(dest_c, message_type_whisper, my_c, msg);
+								watch_send(dest_c, my_c, srcname, msg);
 						}
 					}
 				}
@@ -212,7 +232,7 @@ namespace pvpgn
 				{
 					if (it->getOwner() && (!it->getAccount() || it->getAccount() == account) && (!it->getClientTag() || (clienttag == it->getClientTag())) && (it->getEventMask() & event))
 					{
-						message_send_text(it->getOwner(), message_type_whisper, my_c, msg);
+						watch_send(it->getOwner(), my_c, srcname, msg);
 					}
 				}
 
@@ -228,7 +248,8 @@ namespace pvpgn
 				case Watch::ET_logout:
 				case Watch::ET_joingame:
 				case Watch::ET_leavegame:
-					return dispatch_whisper(who, gamename, clienttag, event);
+					cluster_watch(who, gamename, clienttag, event);
+					return dispatch_whisper(who, gamename, clienttag, event, false);
 				default:
 					eventlog(eventlog_level_error, __FUNCTION__, "got unknown event {}", (unsigned int)event);
 					return -1;
@@ -236,6 +257,13 @@ namespace pvpgn
 				return 0;
 			}
 
+		/* an event on another cluster node, only notify the local users */
+		int
+			WatchComponent::dispatch_remote(t_account * who, char const * gamename, t_clienttag clienttag, Watch::EventType event) const
+		{
+				return dispatch_whisper(who, gamename, clienttag, event, true);
+			}
+
 
 		WatchComponent::WatchComponent()
 			:wlist()
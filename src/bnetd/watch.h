@@ -71,13 +71,14 @@ namespace pvpgn
 			int del(t_connection * owner, t_account * who, t_clienttag clienttag, unsigned events);
 			void del(t_connection * owner);
 			int dispatch(t_account * who, char const * gamename, t_clienttag clienttag, Watch::EventType event) const;
+			int dispatch_remote(t_account * who, char const * gamename, t_clienttag clienttag, Watch::EventType event) const;
 
 		private:
 			typedef std::list<Watch> WatchList;
 
 			WatchList wlist;
 
-			int dispatch_whisper(t_account *account, char const *gamename, t_clienttag clienttag, Watch::EventType event) const;
+			int dispatch_whisper(t_account *account, char const *gamename, t_clienttag clienttag, Watch::EventType event, bool remote) const;
 		};
 
 		extern scoped_ptr<WatchComponent> watchlist;
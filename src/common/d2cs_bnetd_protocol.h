@@ -48,6 +48,7 @@ namespace pvpgn
 		t_d2cs_bnetd_header	h;
 		bn_int			version;
 		/* realm name */
+		/* listen addresses (servaddrs), optional */
 	} t_d2cs_bnetd_authreply;
 
 #define BNETD_D2CS_AUTHREPLY				0x02
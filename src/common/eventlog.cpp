@@ -21,12 +21,14 @@
 
 #include <cerrno>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <fmt/format.h>
 
@@ -52,6 +54,32 @@ namespace pvpgn
 		;
 	/* FIXME: maybe this should be default for win32 */
 	extern int eventlog_debugmode = 0;
+	unsigned eventlog_modules = 0;
+
+	/* functions or source files with levels other than currlevel */
+	typedef struct
+	{
+		std::string name;
+		unsigned    level;
+	} t_eventlog_module;
+
+	static std::vector<t_eventlog_module> eventlog_module_list;
+	static unsigned eventlog_module_gen = 0;
+
+	/*
+	 * What the list says about a module of a file, looked up again after
+	 * each change of it. The file is part of the key, as the linker may
+	 * merge the names of same named functions of different files.
+	 */
+	static const unsigned eventlog_cache_size = 512;
+	static const unsigned eventlog_level_global = ~0U;
+	static struct
+	{
+		char const * module;
+		char const * file;
+		unsigned     gen;
+		unsigned     level;
+	} eventlog_cache[eventlog_cache_size];
 
 	extern void eventlog_set_debugmode(int debugmode)
 	{
@@ -235,6 +263,236 @@ namespace pvpgn
 		}
 	}
 
+	static int eventlog_get_level_by_name(char const * levelname, unsigned * level)
+	{
+		static const struct
+		{
+			char const * name;
+			unsigned     level;
+		} names[] = {
+			{ "none", eventlog_level_none },
+			{ "trace", eventlog_level_trace },
+			{ "debug", eventlog_level_debug },
+			{ "info", eventlog_level_info },
+			{ "warn", eventlog_level_warn },
+			{ "error", eventlog_level_error },
+			{ "fatal", eventlog_level_fatal },
+#ifdef WIN32_GUI
+			{ "gui", eventlog_level_gui },
+#endif
+			{ "all", eventlog_level_trace | eventlog_level_debug | eventlog_level_info | eventlog_level_warn | eventlog_level_error | eventlog_level_fatal }
+		};
+
+		for (unsigned i = 0; i < sizeof(names) / sizeof(*names); i++)
+			if (strcasecmp(levelname, names[i].name) == 0)
+			{
+				*level = names[i].level;
+				return 0;
+			}
+		return -1;
+	}
+
+
+	/* a comma separated list as in the loglevels setting */
+	extern int eventlog_parse_levels(char const * levels, unsigned * mask)
+	{
+		std::string name;
+		unsigned    level;
+		char const * end;
+
+		*mask = 0;
+		for (;; levels = end + 1)
+		{
+			if (!(end = std::strchr(levels, ',')))
+				end = levels + std::strlen(levels);
+			name.assign(levels, end - levels);
+			if (eventlog_get_level_by_name(name.c_str(), &level) < 0)
+				return -1;
+			*mask |= level;
+			if (!*end)
+				return 0;
+		}
+	}
+
+
+	extern std::string eventlog_get_levels_str(unsigned mask)
+	{
+		static const t_eventlog_level levels[] = {
+			eventlog_level_fatal, eventlog_level_error, eventlog_level_warn,
+			eventlog_level_info, eventlog_level_debug, eventlog_level_trace
+		};
+		std::string str;
+
+		for (unsigned i = 0; i < sizeof(levels) / sizeof(*levels); i++)
+			if (mask & levels[i])
+			{
+				if (!str.empty())
+					str += ',';
+				str += eventlog_get_levelname_str(levels[i]);
+				/* without the padding of the log lines */
+				str.erase(str.find_last_not_of(' ') + 1);
+			}
+		return str.empty() ? "none" : str;
+	}
+
+
+	static void eventlog_modules_changed(void)
+	{
+		/* the cache holds generations, start it over before one comes around again */
+		if (++eventlog_module_gen == 0)
+		{
+			std::memset(eventlog_cache, 0, sizeof(eventlog_cache));
+			eventlog_module_gen = 1;
+		}
+		eventlog_modules = eventlog_module_list.empty() ? 0 : eventlog_module_gen;
+	}
+
+
+	/*
+	 * A name is a function, as it is written before the colon of a log
+	 * line, or a source file without its directory ("file_plain.cpp").
+	 * The levels replace currlevel for its messages, a function wins
+	 * over its file. levels NULL or "default" drops the name again.
+	 */
+	extern int eventlog_set_module_level(char const * name, char const * levels)
+	{
+		std::vector<t_eventlog_module>::iterator it;
+		unsigned mask = 0;
+
+		if (!name || !*name)
+		{
+			eventlog(eventlog_level_error, __FUNCTION__, "got NULL or empty name");
+			return -1;
+		}
+		if (levels && strcasecmp(levels, "default") != 0 && eventlog_parse_levels(levels, &mask) < 0)
+		{
+			eventlog(eventlog_level_error, __FUNCTION__, "got bad levels \"{}\" for \"{}\"", levels, name);
+			return -1;
+		}
+
+		for (it = eventlog_module_list.begin(); it != eventlog_module_list.end(); ++it)
+			if (it->name == name)
+				break;
+
+		if (!levels || strcasecmp(levels, "default") == 0)
+		{
+			if (it != eventlog_module_list.end())
+				eventlog_module_list.erase(it);
+		}
+		else if (it != eventlog_module_list.end())
+			it->level = mask;
+		else
+		{
+			t_eventlog_module module;
+			module.name = name;
+			module.level = mask;
+			eventlog_module_list.push_back(module);
+		}
+
+		eventlog_modules_changed();
+		return 0;
+	}
+
+
+	/* "name=levels" separated by blanks or semicolons, replaces all of them */
+	extern int eventlog_set_module_levels(char const * spec)
+	{
+		std::istringstream in(spec ? spec : "");
+		std::string token;
+		std::string::size_type pos;
+		int ret = 0;
+
+		eventlog_clear_module_levels();
+		while (in >> token)
+		{
+			for (std::string::size_type start = 0; start < token.size(); start = pos + 1)
+			{
+				std::string::size_type eq;
+				std::string entry;
+
+				if ((pos = token.find(';', start)) == std::string::npos)
+					pos = token.size();
+				entry = token.substr(start, pos - start);
+				if (entry.empty())
+					continue;
+				if ((eq = entry.find('=')) == std::string::npos || eq == 0)
+				{
+					eventlog(eventlog_level_error, __FUNCTION__, "bad module level \"{}\", expected name=levels", entry);
+					ret = -1;
+					continue;
+				}
+				if (eventlog_set_module_level(entry.substr(0, eq).c_str(), entry.c_str() + eq + 1) < 0)
+					ret = -1;
+			}
+		}
+		return ret;
+	}
+
+
+	extern void eventlog_clear_module_levels(void)
+	{
+		eventlog_module_list.clear();
+		eventlog_modules_changed();
+	}
+
+
+	extern std::string eventlog_get_module_levels_str(void)
+	{
+		std::string str;
+
+		for (std::vector<t_eventlog_module>::const_iterator it = eventlog_module_list.begin(); it != eventlog_module_list.end(); ++it)
+		{
+			if (!str.empty())
+				str += ' ';
+			str += it->name + '=' + eventlog_get_levels_str(it->level);
+		}
+		return str;
+	}
+
+
+	extern unsigned eventlog_get_module_level(char const * module, char const * file)
+	{
+		std::uintptr_t key = (std::uintptr_t)module ^ ((std::uintptr_t)file >> 3);
+		unsigned idx = (unsigned)((key ^ (key >> 9)) % eventlog_cache_size);
+		char const * base;
+
+		if (eventlog_cache[idx].module != module || eventlog_cache[idx].file != file || eventlog_cache[idx].gen != eventlog_modules)
+		{
+			unsigned level = eventlog_level_global;
+
+			base = NULL;
+			if (file)
+			{
+				base = std::strrchr(file, '/');
+#ifdef WIN32
+				if (std::strrchr(file, '\\') > base)
+					base = std::strrchr(file, '\\');
+#endif
+				base = base ? base + 1 : file;
+			}
+
+			for (std::vector<t_eventlog_module>::const_iterator it = eventlog_module_list.begin(); it != eventlog_module_list.end(); ++it)
+			{
+				if (module && it->name == module)
+				{
+					level = it->level;
+					break;
+				}
+				if (base && it->name == base)
+					level = it->level;
+			}
+
+			eventlog_cache[idx].module = module;
+			eventlog_cache[idx].file = file;
+			eventlog_cache[idx].gen = eventlog_modules;
+			eventlog_cache[idx].level = level;
+		}
+
+		/* modules without levels of their own follow changes of currlevel */
+		return (eventlog_cache[idx].level == eventlog_level_global) ? currlevel : eventlog_cache[idx].level;
+	}
+
+
 	extern void eventlog_hexdump_data(void const * data, unsigned int len)
 	{
 		unsigned int i;
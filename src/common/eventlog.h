@@ -71,20 +71,24 @@ namespace pvpgn
 	extern int eventlog_add_level(char const * levelname);
 	extern int eventlog_del_level(char const * levelname);
 	extern char const * eventlog_get_levelname_str(t_eventlog_level level);
+	extern int eventlog_parse_levels(char const * levels, unsigned * mask);
+	extern std::string eventlog_get_levels_str(unsigned mask);
+	extern int eventlog_set_module_level(char const * name, char const * levels);
+	extern int eventlog_set_module_levels(char const * spec);
+	extern void eventlog_clear_module_levels(void);
+	extern std::string eventlog_get_module_levels_str(void);
+	extern unsigned eventlog_get_module_level(char const * module, char const * file);
 	extern void eventlog_hexdump_data(void const * data, unsigned int len);
 
 	extern std::FILE *eventstrm;
 	extern unsigned currlevel;
 	extern int eventlog_debugmode;
+	extern unsigned eventlog_modules;	/* 0 while no module has levels of its own */
 
+	/* only called through eventlog(), which checks the level first */
 	template <typename... Args>
-	void eventlog(t_eventlog_level level, const char* module, fmt::string_view format_str, const Args& ... args)
+	void eventlog_write(t_eventlog_level level, const char* module, fmt::string_view format_str, const Args& ... args)
 	{
-		if (!(level & currlevel))
-		{
-			return;
-		}
-
 		if (!eventstrm)
 		{
 			return;
@@ -174,6 +178,16 @@ namespace pvpgn
 
 	extern void eventlog_step(char const * filename, t_eventlog_level level, char const * module, char const * fmt, ...) PRINTF_ATTR(4, 5);
 
+	/*
+	 * The arguments of a message are only evaluated when its level is
+	 * logged, for the module (the function) or for the source file it
+	 * comes from, see eventlog_set_module_level().
+	 */
+#define eventlog_enabled(level,module) \
+	((level) & (::pvpgn::eventlog_modules ? ::pvpgn::eventlog_get_module_level(module, __FILE__) : ::pvpgn::currlevel))
+#define eventlog(level,module,...) \
+	(eventlog_enabled(level, module) ? ::pvpgn::eventlog_write(level, module, __VA_ARGS__) : (void)0)
+
 #define ERROR0(fmt) eventlog(eventlog_level_error,__FUNCTION__,fmt)
 #define ERROR1(fmt,arg1) eventlog(eventlog_level_error,__FUNCTION__,fmt,arg1)
 #define ERROR2(fmt,arg1,arg2) eventlog(eventlog_level_error,__FUNCTION__,fmt,arg1,arg2)
@@ -30,6 +30,7 @@
 #include "fdwatch_poll.h"
 #include "fdwatch_kqueue.h"
 #include "fdwatch_epoll.h"
+#include "fdwatch_iouring.h"
 #include "fdwbackend.h"
 #include "common/setup_after.h"
 
@@ -47,9 +48,44 @@ namespace pvpgn
 		FDWList freelist(&t_fdwatch_fd::freelist);
 		FDWList uselist(&t_fdwatch_fd::uselist);
 
+		/* tried in this order when no backend is configured */
+		char const * const default_backends[] = { "iouring", "epoll", "kqueue", "poll", "select" };
+
+		/* the backend called name, NULL if it is not built in or fails to start */
+		FDWBackend * fdwatch_create(char const * name, int maxcons)
+		{
+			try {
+#ifdef HAVE_IO_URING
+				if (!std::strcmp(name, "iouring"))
+					return new FDWIouringBackend(maxcons);
+#endif
+#ifdef HAVE_EPOLL
+				if (!std::strcmp(name, "epoll"))
+					return new FDWEpollBackend(maxcons);
+#endif
+#ifdef HAVE_KQUEUE
+				if (!std::strcmp(name, "kqueue"))
+					return new FDWKqueueBackend(maxcons);
+#endif
+#ifdef HAVE_POLL
+				if (!std::strcmp(name, "poll"))
+					return new FDWPollBackend(maxcons);
+#endif
+#ifdef HAVE_SELECT
+				if (!std::strcmp(name, "select"))
+					return new FDWSelectBackend(maxcons);
+#endif
+			}
+			catch (const FDWBackend::InitError& e) {
+				INFO2("fdwatch {} layer not available ({})", name, e.what());
+			}
+
+			return NULL;
+		}
+
 	}
 
-	extern int fdwatch_init(int maxcons)
+	extern int fdwatch_init(int maxcons, char const * backend)
 	{
 		unsigned i;
 		int maxsys;
@@ -67,38 +103,15 @@ namespace pvpgn
 		for (i = 0; i < fdw_maxcons; i++)
 			freelist.push_back(fdw_fds[i]);
 
-#ifdef HAVE_EPOLL
-		try {
-			fdw = new FDWEpollBackend(fdw_maxcons);
-			return 0;
-		}
-		catch (const FDWBackend::InitError&) {
-		}
-#endif
-#ifdef HAVE_KQUEUE
-		try {
-			fdw = new FDWKqueueBackend(fdw_maxcons);
-			return 0;
-		}
-		catch (const FDWBackend::InitError&) {
-		}
-#endif
-#ifdef HAVE_POLL
-		try {
-			fdw = new FDWPollBackend(fdw_maxcons);
-			return 0;
-		}
-		catch (const FDWBackend::InitError&) {
+		if (backend && backend[0]) {
+			if ((fdw = fdwatch_create(backend, fdw_maxcons)))
+				return 0;
+			eventlog(eventlog_level_warn, __FUNCTION__, "fdwatch backend \"{}\" is not available, using the default", backend);
 		}
-#endif
-#ifdef HAVE_SELECT
-		try {
-			fdw = new FDWSelectBackend(fdw_maxcons);
-			return 0;
-		}
-		catch (const FDWBackend::InitError&) {
-		}
-#endif
+
+		for (i = 0; i < sizeof(default_backends) / sizeof(default_backends[0]); i++)
+			if ((fdw = fdwatch_create(default_backends[i], fdw_maxcons)))
+				return 0;
 
 		eventlog(eventlog_level_fatal, __FUNCTION__, "Found no working fdwatch layer");
 		fdw = NULL;
@@ -116,13 +129,14 @@ namespace pvpgn
 		return 0;
 	}
 
-	extern int fdwatch_add_fd(int fd, unsigned rw, fdwatch_handler h, void *data)
+	static int fdwatch_add(int fd, unsigned rw, fdwatch_handler h, void *data, bool io)
 	{
 		/* max sockets reached */
 		if (freelist.empty()) return -1;
 
 		t_fdwatch_fd *cfd = &freelist.front();
 		fdw_fd(cfd) = fd;
+		cfd->io = io;
 
 		if (fdw->add(fdw_idx(cfd), rw)) return -1;
 
@@ -137,6 +151,16 @@ namespace pvpgn
 		return fdw_idx(cfd);
 	}
 
+	extern int fdwatch_add_fd(int fd, unsigned rw, fdwatch_handler h, void *data)
+	{
+		return fdwatch_add(fd, rw, h, data, false);
+	}
+
+	extern int fdwatch_add_io_fd(int fd, unsigned rw, fdwatch_handler h, void *data)
+	{
+		return fdwatch_add(fd, rw, h, data, true);
+	}
+
 	extern int fdwatch_update_fd(int idx, unsigned rw)
 	{
 		if (idx < 0 || idx >= fdw_maxcons) {
@@ -182,6 +206,7 @@ namespace pvpgn
 
 		fdw_fd(cfd) = 0;
 		fdw_rw(cfd) = 0;
+		cfd->io = false;
 		fdw_data(cfd) = NULL;
 		fdw_hnd(cfd) = NULL;
 
@@ -205,4 +230,19 @@ namespace pvpgn
 		}
 	}
 
+	extern int fdwatch_recv(int idx, void *buff, int len)
+	{
+		return fdw->recv(idx, buff, len);
+	}
+
+	extern int fdwatch_send(int idx, void const *buff, int len)
+	{
+		return fdw->send(idx, buff, len);
+	}
+
+	extern void fdwatch_flush(int idx)
+	{
+		fdw->flush(idx);
+	}
+
 }
@@ -38,13 +38,14 @@ namespace pvpgn
 	struct t_fdwatch_fd {
 		int fd;
 		int rw;
+		bool io;	/* the handlers use fdwatch_recv() and fdwatch_send() */
 		fdwatch_handler hnd;
 		void *data;
 
 		elist_node<t_fdwatch_fd> uselist;
 		elist_node<t_fdwatch_fd> freelist;
 
-		t_fdwatch_fd() :fd(0), rw(0), hnd(0), data(0), uselist(), freelist() {}
+		t_fdwatch_fd() :fd(0), rw(0), io(false), hnd(0), data(0), uselist(), freelist() {}
 	};
 
 	typedef int(*t_fdw_cb)(t_fdwatch_fd *cfd, void *data);
@@ -57,14 +58,23 @@ namespace pvpgn
 #define fdw_rw(ptr) ((ptr)->rw)
 #define fdw_data(ptr) ((ptr)->data)
 #define fdw_hnd(ptr) ((ptr)->hnd)
-	extern int fdwatch_init(int maxcons);
+	extern int fdwatch_init(int maxcons, char const * backend);
 	extern int fdwatch_close(void);
 	extern int fdwatch_add_fd(int fd, unsigned rw, fdwatch_handler h, void *data);
+	/* like fdwatch_add_fd() for a socket the handlers read and write only
+	 * with fdwatch_recv() and fdwatch_send(), which lets the backend do the
+	 * reads and writes itself */
+	extern int fdwatch_add_io_fd(int fd, unsigned rw, fdwatch_handler h, void *data);
 	extern int fdwatch_update_fd(int idx, unsigned rw);
 	extern int fdwatch_del_fd(int idx);
 	extern int fdwatch(long timeout_msecs);
 	extern void fdwatch_handle(void);
 	extern void fdwatch_traverse(t_fdw_cb cb, void *data);
+	/* net_recv() and net_send() on the socket of a slot */
+	extern int fdwatch_recv(int idx, void *buff, int len);
+	extern int fdwatch_send(int idx, void const *buff, int len);
+	/* hands what fdwatch_send() took to the socket, before a shutdown() */
+	extern void fdwatch_flush(int idx);
 
 }
 
@@ -0,0 +1,804 @@
+/*
+  * Abstraction API/layer for the various ways PvPGN can inspect sockets state
+  *
+  * Linux io_uring(7) based backend
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+  */
+
+#include "common/setup_before.h"
+#ifdef HAVE_IO_URING
+#include "fdwatch_iouring.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <endian.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "common/eventlog.h"
+#include "fdwatch.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	namespace
+	{
+
+		/* per socket read through the ring, a bnet packet mostly fits in one read */
+		const unsigned rbufsize = 2048;
+		/* and written through it, a full buffer waits for its write to complete */
+		const unsigned sbufsize = 6144;
+
+		/* what a request is for, in the top byte of its user_data */
+		enum {
+			tag_poll = 0,
+			tag_read = 1,
+			tag_write = 2
+		};
+
+		/* user_data of the poll removals and cancellations, their completions are ignored */
+		const __u64 remove_tag = ~(__u64)0;
+
+		__u64 make_tag(unsigned kind, unsigned gen, int id)
+		{
+			return ((__u64)kind << 56) | ((__u64)(gen & 0xffffff) << 32) | (unsigned)id;
+		}
+
+		unsigned tag_kind(__u64 tag)
+		{
+			return (unsigned)(tag >> 56);
+		}
+
+		unsigned tag_gen(__u64 tag)
+		{
+			return (unsigned)(tag >> 32) & 0xffffff;
+		}
+
+		int tag_id(__u64 tag)
+		{
+			return (int)(tag & 0xffffffff);
+		}
+
+	}
+
+	FDWIouringBackend::FDWIouringBackend(int nfds_)
+		:FDWBackend(nfds_), ringfd(-1), ring(MAP_FAILED), ringsize(0), sqes((struct io_uring_sqe *)MAP_FAILED), sqessize(0),
+		sq_local(0), region((char *)MAP_FAILED), regionsize(0), regfailed(false), sr(0), readysize(0), nretries(0), nfreebufs(0), nflushes(0),
+		nrunq(0), nrunning(0)
+	{
+		struct io_uring_params params;
+
+		/* room for a read and a write of every socket in one loop, twice
+		 * that for their completions and the cancellations */
+		std::memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+		params.cq_entries = nfds * 4;
+		/* also fails with EPERM where io_uring is disabled or filtered */
+		if ((ringfd = syscall(__NR_io_uring_setup, nfds * 2, &params)) < 0)
+			throw InitError("failed to set up io_uring");
+
+		if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+			close(ringfd);
+			throw InitError("io_uring lacks needed features");
+		}
+
+		ringsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		if (ringsize < params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe))
+			ringsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		ring = mmap(NULL, ringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+		sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+		sqes = (struct io_uring_sqe *)mmap(NULL, sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+		if (ring == MAP_FAILED || sqes == (struct io_uring_sqe *)MAP_FAILED) {
+			if (ring != MAP_FAILED)
+				munmap(ring, ringsize);
+			if (sqes != (struct io_uring_sqe *)MAP_FAILED)
+				munmap(sqes, sqessize);
+			close(ringfd);
+			throw InitError("failed to map io_uring");
+		}
+
+		char *base = (char *)ring;
+		sq_head = (unsigned *)(base + params.sq_off.head);
+		sq_tail = (unsigned *)(base + params.sq_off.tail);
+		sq_array = (unsigned *)(base + params.sq_off.array);
+		sq_mask = *(unsigned *)(base + params.sq_off.ring_mask);
+		sq_entries = params.sq_entries;
+		sq_local = *sq_tail;
+		cq_head = (unsigned *)(base + params.cq_off.head);
+		cq_tail = (unsigned *)(base + params.cq_off.tail);
+		cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+		cq_mask = *(unsigned *)(base + params.cq_off.ring_mask);
+
+		slots.reset(new Slot[nfds]);
+		std::memset(slots.get(), 0, sizeof(Slot) * nfds);
+		readysize = params.cq_entries;
+		ready.reset(new Ready[readysize]);
+		retries.reset(new int[nfds]);
+		bufs.reset(new Buf[nfds]);
+		std::memset(bufs.get(), 0, sizeof(Buf) * nfds);
+		freebufs.reset(new int[nfds]);
+		flushes.reset(new int[nfds]);
+		runq.reset(new int[nfds]);
+		running.reset(new int[nfds]);
+		for (int i = nfds - 1; i >= 0; i--) {
+			slots[i].buf = -1;
+			bufs[i].idx = -1;
+			freebufs[nfreebufs++] = i;
+		}
+
+		INFO1("fdwatch io_uring based layer initialized (max {} sockets)", nfds);
+	}
+
+	FDWIouringBackend::~FDWIouringBackend() throw()
+	{
+		/* closing the ring cancels what is left on it and unregisters the buffers */
+		munmap(sqes, sqessize);
+		munmap(ring, ringsize);
+		close(ringfd);
+		if (region != (char *)MAP_FAILED)
+			munmap(region, regionsize);
+	}
+
+	/* the buffers are set up when the first socket needs them, a program
+	 * which only has sockets polled has none */
+	bool
+		FDWIouringBackend::register_buffers()
+	{
+			struct iovec iov;
+
+			if (region != (char *)MAP_FAILED)
+				return true;
+			if (regfailed)
+				return false;
+
+			/* they are pinned, which counts against RLIMIT_MEMLOCK */
+			regionsize = (size_t)nfds * (rbufsize + sbufsize);
+			region = (char *)mmap(NULL, regionsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			iov.iov_base = region;
+			iov.iov_len = regionsize;
+			if (region == (char *)MAP_FAILED || syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+				WARN2("could not register {} KB of io_uring buffers ({}), the sockets are polled instead", regionsize / 1024, std::strerror(errno));
+				if (region != (char *)MAP_FAILED)
+					munmap(region, regionsize);
+				region = (char *)MAP_FAILED;
+				regfailed = true;
+				return false;
+			}
+
+			INFO1("registered {} KB of io_uring buffers", regionsize / 1024);
+			return true;
+		}
+
+	char *
+		FDWIouringBackend::rbuf(int b) const
+	{
+			return region + (size_t)b * (rbufsize + sbufsize);
+		}
+
+	char *
+		FDWIouringBackend::sbuf(int b) const
+	{
+			return region + (size_t)b * (rbufsize + sbufsize) + rbufsize;
+		}
+
+	int
+		FDWIouringBackend::enter(unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+	{
+			return syscall(__NR_io_uring_enter, ringfd, to_submit, min_complete, flags, arg, argsz);
+		}
+
+	/* hands the queued requests to the kernel without waiting */
+	int
+		FDWIouringBackend::submit()
+	{
+			unsigned pending;
+
+			__atomic_store_n(sq_tail, sq_local, __ATOMIC_RELEASE);
+			pending = sq_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+			if (!pending)
+				return 0;
+
+			while (enter(pending, 0, 0, NULL, 0) < 0) {
+				if (errno == EINTR)
+					continue;
+				ERROR1("got error from io_uring_enter() ({})", std::strerror(errno));
+				return -1;
+			}
+
+			return 0;
+		}
+
+	struct io_uring_sqe *
+		FDWIouringBackend::get_sqe()
+	{
+			struct io_uring_sqe *sqe;
+			unsigned pos;
+
+			/* the ring is sized for a loop of requests, a full one is rare;
+			 * if the kernel takes nothing now the caller has to wait */
+			if (sq_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+				if (submit() < 0 || sq_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+					return NULL;
+			}
+
+			pos = sq_local & sq_mask;
+			sqe = sqes + pos;
+			std::memset(sqe, 0, sizeof(*sqe));
+			sq_array[pos] = pos;
+			sq_local++;
+
+			return sqe;
+		}
+
+	/* a read into the socket's empty receive buffer */
+	int
+		FDWIouringBackend::start_read(int b)
+	{
+			Buf *buf = bufs.get() + b;
+			struct io_uring_sqe *sqe;
+
+			if (!(sqe = get_sqe()))
+				return -1;
+
+			sqe->opcode = IORING_OP_READ_FIXED;
+			sqe->fd = fdw_fd(fdw_fds + buf->idx);
+			sqe->addr = (__u64)(unsigned long)rbuf(b);
+			sqe->len = rbufsize;
+			sqe->buf_index = 0;
+			sqe->user_data = make_tag(tag_read, 0, b);
+
+			buf->reading = true;
+			buf->rpos = buf->rend = 0;
+
+			return 0;
+		}
+
+	/* a write of what the handlers sent and is not on the ring yet */
+	int
+		FDWIouringBackend::start_write(int b)
+	{
+			Buf *buf = bufs.get() + b;
+			struct io_uring_sqe *sqe;
+
+			if (!(sqe = get_sqe()))
+				return -1;
+
+			sqe->opcode = IORING_OP_WRITE_FIXED;
+			sqe->fd = fdw_fd(fdw_fds + buf->idx);
+			sqe->addr = (__u64)(unsigned long)(sbuf(b) + buf->shead);
+			sqe->len = buf->stail - buf->shead;
+			sqe->buf_index = 0;
+			sqe->user_data = make_tag(tag_write, 0, b);
+
+			buf->writing = true;
+
+			return 0;
+		}
+
+	void
+		FDWIouringBackend::cancel(__u64 tag)
+	{
+			struct io_uring_sqe *sqe;
+
+			if (!(sqe = get_sqe())) {
+				ERROR0("io_uring is full, a removed socket stays open until its request completes");
+				return;
+			}
+
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = tag;
+			sqe->user_data = remove_tag;
+		}
+
+	/* the kernel is done with the buffers of a removed socket */
+	void
+		FDWIouringBackend::release(int b)
+	{
+			Buf *buf = bufs.get() + b;
+
+			buf->rpos = buf->rend = 0;
+			buf->rerr = 0;
+			buf->shead = buf->stail = 0;
+			buf->serr = 0;
+			freebufs[nfreebufs++] = b;
+		}
+
+	void
+		FDWIouringBackend::enqueue(int idx)
+	{
+			Slot *slot = slots.get() + idx;
+
+			if (slot->queued)
+				return;
+			slot->queued = true;
+			runq[nrunq++] = idx;
+		}
+
+	bool
+		FDWIouringBackend::readable(int idx) const
+	{
+			Buf const *buf = bufs.get() + slots[idx].buf;
+
+			return buf->rpos < buf->rend || buf->rerr;
+		}
+
+	bool
+		FDWIouringBackend::writable(int idx) const
+	{
+			Buf const *buf = bufs.get() + slots[idx].buf;
+
+			return buf->serr || buf->stail < sbufsize || (!buf->writing && buf->shead);
+		}
+
+	/* a socket read and written through the ring: what is there is handled
+	 * in the next loop, a read goes on the ring once the buffer is empty */
+	void
+		FDWIouringBackend::settle(int idx)
+	{
+			Slot *slot = slots.get() + idx;
+			unsigned rw = fdw_rw(fdw_fds + idx);
+
+			if (rw & fdwatch_type_read) {
+				if (readable(idx))
+					enqueue(idx);
+				else if (!bufs[slot->buf].reading && start_read(slot->buf) && !slot->retry) {
+					slot->retry = true;
+					retries[nretries++] = idx;
+				}
+			}
+			if (rw & fdwatch_type_write && writable(idx))
+				enqueue(idx);
+		}
+
+	/* a read or write of a socket's buffers is done */
+	void
+		FDWIouringBackend::complete(struct io_uring_cqe const *cqe)
+	{
+			int b = tag_id(cqe->user_data);
+			Buf *buf = bufs.get() + b;
+
+			if (b < 0 || b >= nfds)
+				return;
+
+			if (tag_kind(cqe->user_data) == tag_read) {
+				buf->reading = false;
+				if (cqe->res > 0)
+					buf->rend = cqe->res;
+				else if (!cqe->res)
+					buf->rerr = -1;
+				else if (cqe->res != -EAGAIN && cqe->res != -EINTR)
+					buf->rerr = -cqe->res;
+			}
+			else {
+				buf->writing = false;
+				if (cqe->res >= 0) {
+					buf->shead += cqe->res;
+					if (buf->shead == buf->stail)
+						buf->shead = buf->stail = 0;
+				}
+				else if (cqe->res != -EAGAIN && cqe->res != -EINTR) {
+					/* what is left can not be sent anymore, the next send() reports it */
+					buf->serr = -cqe->res;
+					buf->shead = buf->stail = 0;
+				}
+				if (buf->shead < buf->stail && !buf->flushing) {
+					buf->flushing = true;
+					flushes[nflushes++] = b;
+				}
+			}
+
+			if (buf->idx < 0) {
+				if (!buf->reading && !buf->writing)
+					release(b);
+				return;
+			}
+			/* read again or run the handlers, whichever is due */
+			enqueue(buf->idx);
+		}
+
+	int
+		FDWIouringBackend::arm(int idx, unsigned rw)
+	{
+			Slot *slot = slots.get() + idx;
+			struct io_uring_sqe *sqe;
+			unsigned events = 0;
+
+			if (!(sqe = get_sqe())) {
+				/* watch() arms it once the ring has room again */
+				if (!slot->retry) {
+					slot->retry = true;
+					retries[nretries++] = idx;
+				}
+				return -1;
+			}
+
+			if (rw & fdwatch_type_read)
+				events |= POLLIN;
+			if (rw & fdwatch_type_write)
+				events |= POLLOUT;
+
+			slot->gen++;
+			slot->events = events;
+			slot->armed = true;
+
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = fdw_fd(fdw_fds + idx);
+#if __BYTE_ORDER == __BIG_ENDIAN
+			events = (events << 16) | (events >> 16);
+#endif
+			sqe->poll32_events = events;
+			sqe->user_data = make_tag(tag_poll, slot->gen, idx);
+
+			return 0;
+		}
+
+	int
+		FDWIouringBackend::disarm(int idx)
+	{
+			Slot *slot = slots.get() + idx;
+			struct io_uring_sqe *sqe;
+
+			if (!(sqe = get_sqe()))
+				return -1;
+
+			sqe->opcode = IORING_OP_POLL_REMOVE;
+			sqe->addr = make_tag(tag_poll, slot->gen, idx);
+			sqe->user_data = remove_tag;
+
+			/* a completion of the old request which is already on its way is stale */
+			slot->gen++;
+			slot->armed = false;
+
+			return 0;
+		}
+
+	int
+		FDWIouringBackend::add(int idx, unsigned rw)
+	{
+			//    eventlog(eventlog_level_trace, __FUNCTION__, "called fd: {} rw: {}", fd, rw);
+			Slot *slot = slots.get() + idx;
+			unsigned events = 0;
+
+			/* a new socket, read and written through the ring if its handlers
+			 * let us and there are buffers left, polled otherwise */
+			if (!fdw_rw(fdw_fds + idx) && fdw_fds[idx].io && nfreebufs && register_buffers()) {
+				Buf *buf;
+
+				slot->buf = freebufs[--nfreebufs];
+				buf = bufs.get() + slot->buf;
+				buf->idx = idx;
+				buf->reading = buf->writing = false;
+			}
+
+			if (slot->buf >= 0) {
+				/* settle() looks at the interest it is given */
+				unsigned old = fdw_rw(fdw_fds + idx);
+
+				fdw_rw(fdw_fds + idx) = rw;
+				settle(idx);
+				fdw_rw(fdw_fds + idx) = old;
+				return 0;
+			}
+
+			if (rw & fdwatch_type_read)
+				events |= POLLIN;
+			if (rw & fdwatch_type_write)
+				events |= POLLOUT;
+
+			if (slot->armed) {
+				if (slot->events == events)
+					return 0;
+				/* keeps the old request, the caller keeps the old interest */
+				if (disarm(idx))
+					return -1;
+			}
+			/* handle() arms it with whatever interest is left, watch() if
+			 * the ring is full */
+			if (!slot->handling)
+				arm(idx, rw);
+
+			return 0;
+		}
+
+	int
+		FDWIouringBackend::del(int idx)
+	{
+			//    eventlog(eventlog_level_trace, __FUNCTION__, "called fd: {}", fd);
+			Slot *slot = slots.get() + idx;
+
+			if (slot->buf >= 0) {
+				int b = slot->buf;
+				Buf *buf = bufs.get() + b;
+
+				flush(idx);
+
+				/* the requests hold on to the socket, drop them now so the
+				 * caller's close() really closes it; the buffers are the
+				 * kernel's until they complete */
+				if (buf->reading)
+					cancel(make_tag(tag_read, 0, b));
+				if (buf->writing)
+					cancel(make_tag(tag_write, 0, b));
+				buf->idx = -1;
+				slot->buf = -1;
+				if (!buf->reading && !buf->writing) {
+					release(b);
+					return 0;
+				}
+				return submit();
+			}
+
+			if (!slot->armed)
+				return 0;
+
+			/* the poll request holds on to the socket, drop it now so the
+			 * caller's close() really closes it */
+			if (disarm(idx)) {
+				/* forget it anyway, its completion must not reach the next user of the slot */
+				slot->gen++;
+				slot->armed = false;
+				ERROR1("io_uring is full, socket {} stays open until its poll completes", fdw_fd(fdw_fds + idx));
+				return -1;
+			}
+			return submit();
+		}
+
+	int
+		FDWIouringBackend::recv(int idx, void *buff, int len)
+	{
+			Slot *slot = slots.get() + idx;
+			Buf *buf;
+			unsigned n;
+
+			if (slot->buf < 0)
+				return FDWBackend::recv(idx, buff, len);
+			buf = bufs.get() + slot->buf;
+
+			if (buf->rpos < buf->rend) {
+				n = buf->rend - buf->rpos;
+				if (n > (unsigned)len)
+					n = len;
+				std::memcpy(buff, rbuf(slot->buf) + buf->rpos, n);
+				buf->rpos += n;
+				return n;
+			}
+
+			if (buf->rerr) {
+				/* as net_recv() */
+				if (buf->rerr > 0 && buf->rerr != ECONNRESET && buf->rerr != ENOTCONN)
+					DEBUG2("[{}] receive error (closing connection) (io_uring read: {})", fdw_fd(fdw_fds + idx), std::strerror(buf->rerr));
+				return -1;
+			}
+
+			/* the read on the ring has not completed yet */
+			return 0;
+		}
+
+	int
+		FDWIouringBackend::send(int idx, void const *buff, int len)
+	{
+			Slot *slot = slots.get() + idx;
+			Buf *buf;
+			unsigned n;
+
+			if (slot->buf < 0)
+				return FDWBackend::send(idx, buff, len);
+			buf = bufs.get() + slot->buf;
+
+			if (buf->serr) {
+				/* as net_send() */
+				if (buf->serr != EPIPE && buf->serr != ECONNRESET)
+					DEBUG2("[{}] could not send data (closing connection) (io_uring write: {})", fdw_fd(fdw_fds + idx), std::strerror(buf->serr));
+				return -1;
+			}
+
+			/* what is on the ring stays where it is */
+			if (!buf->writing && buf->shead) {
+				std::memmove(sbuf(slot->buf), sbuf(slot->buf) + buf->shead, buf->stail - buf->shead);
+				buf->stail -= buf->shead;
+				buf->shead = 0;
+			}
+
+			n = sbufsize - buf->stail;
+			if (n > (unsigned)len)
+				n = len;
+			if (!n)
+				return 0;	/* writable again when the write completes */
+			std::memcpy(sbuf(slot->buf) + buf->stail, buff, n);
+			buf->stail += n;
+
+			if (!buf->flushing) {
+				buf->flushing = true;
+				flushes[nflushes++] = slot->buf;
+			}
+
+			return n;
+		}
+
+	/* hands what the handlers sent to the socket now, as much as it takes,
+	 * unless a write of it waits on the ring for room already */
+	void
+		FDWIouringBackend::flush(int idx)
+	{
+			Slot *slot = slots.get() + idx;
+			Buf *buf;
+			ssize_t n;
+
+			if (slot->buf < 0)
+				return;
+			buf = bufs.get() + slot->buf;
+			if (buf->writing || buf->serr || buf->shead == buf->stail)
+				return;
+
+			if ((n = ::send(fdw_fd(fdw_fds + idx), sbuf(slot->buf) + buf->shead, buf->stail - buf->shead, MSG_DONTWAIT | MSG_NOSIGNAL)) > 0) {
+				buf->shead += n;
+				if (buf->shead == buf->stail)
+					buf->shead = buf->stail = 0;
+			}
+		}
+
+	int
+		FDWIouringBackend::watch(long timeout_msec)
+	{
+			struct io_uring_getevents_arg arg;
+			struct __kernel_timespec ts;
+			unsigned head, tail;
+			int ret;
+
+			/* sockets the ring had no room for, they are queued again if it still has none */
+			while (nretries) {
+				int idx = retries[--nretries];
+
+				slots[idx].retry = false;
+				if (!fdw_rw(fdw_fds + idx))
+					continue;
+				if (slots[idx].buf >= 0)
+					settle(idx);
+				else if (!slots[idx].armed && arm(idx, fdw_rw(fdw_fds + idx)))
+					break;
+			}
+
+			/* the writes of what the handlers sent in the last loop */
+			while (nflushes) {
+				int b = flushes[nflushes - 1];
+				Buf *buf = bufs.get() + b;
+
+				if (buf->idx >= 0 && !buf->writing && !buf->serr && buf->shead < buf->stail && start_write(b))
+					break;
+				buf->flushing = false;
+				nflushes--;
+			}
+
+			std::memset(&arg, 0, sizeof(arg));
+			if (timeout_msec >= 0) {
+				ts.tv_sec = timeout_msec / 1000;
+				ts.tv_nsec = (timeout_msec % 1000) * 1000000;
+				arg.ts = (__u64)(unsigned long)&ts;
+			}
+
+			/* submit everything queued since the last loop and wait, unless
+			 * some sockets still have data the handlers did not take */
+			__atomic_store_n(sq_tail, sq_local, __ATOMIC_RELEASE);
+			ret = enter(sq_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE), nrunq ? 0 : 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+			if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+				ERROR1("got error from io_uring_enter() ({})", std::strerror(errno));
+				return -1;
+			}
+
+			sr = 0;
+			head = *cq_head;
+			tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+			for (; head != tail && sr < (int)readysize; head++) {
+				struct io_uring_cqe *cqe = cqes + (head & cq_mask);
+				int idx = tag_id(cqe->user_data);
+
+				if (cqe->user_data == remove_tag)
+					continue;
+				if (tag_kind(cqe->user_data) != tag_poll) {
+					complete(cqe);
+					continue;
+				}
+				/* polls cancelled or replaced since */
+				if (idx < 0 || idx >= nfds)
+					continue;
+				if (!slots[idx].armed || (slots[idx].gen & 0xffffff) != tag_gen(cqe->user_data))
+					continue;
+				ready[sr].user_data = cqe->user_data;
+				ready[sr].res = cqe->res;
+				sr++;
+			}
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+			if (!sr && !nrunq && ret < 0 && errno == EINTR)
+				return -1;
+
+			return sr + nrunq;
+		}
+
+	void
+		FDWIouringBackend::handle()
+	{
+			//    eventlog(eventlog_level_trace, __FUNCTION__, "called");
+			for (Ready *ev = ready.get(); sr; sr--, ev++)
+			{
+				int idx = tag_id(ev->user_data);
+				Slot *slot = slots.get() + idx;
+				t_fdwatch_fd *cfd = fdw_fds + idx;
+				unsigned revents;
+
+				/* removed or re-armed by an earlier handler */
+				if (!slot->armed || (slot->gen & 0xffffff) != tag_gen(ev->user_data))
+					continue;
+				slot->armed = false;
+
+				/* a failed poll is reported to the handlers as an error */
+				revents = (ev->res < 0) ? POLLERR : (unsigned)ev->res;
+
+				slot->handling = true;
+				if (fdw_rw(cfd) & fdwatch_type_read && revents & (POLLIN | POLLERR | POLLHUP)) {
+					if (fdw_hnd(cfd) (fdw_data(cfd), fdwatch_type_read) == -2)
+						revents = 0;
+				}
+
+				if (fdw_rw(cfd) & fdwatch_type_write && revents & (POLLOUT | POLLERR | POLLHUP))
+					fdw_hnd(cfd) (fdw_data(cfd), fdwatch_type_write);
+				slot->handling = false;
+
+				/* the slot may have been closed or even reused meanwhile */
+				if (fdw_rw(cfd) && slot->buf < 0 && !slot->armed)
+					arm(idx, fdw_rw(cfd));
+			}
+			sr = 0;
+
+			/* the sockets read and written through the ring, those queued
+			 * while this runs are for the next loop */
+			for (int i = 0; i < nrunq; i++)
+				running[i] = runq[i];
+			nrunning = nrunq;
+			nrunq = 0;
+			for (int i = 0; i < nrunning; i++)
+			{
+				int idx = running[i];
+				Slot *slot = slots.get() + idx;
+				t_fdwatch_fd *cfd = fdw_fds + idx;
+
+				slot->queued = false;
+				if (!fdw_rw(cfd) || slot->buf < 0)
+					continue;
+
+				slot->handling = true;
+				if (!(fdw_rw(cfd) & fdwatch_type_read && readable(idx) && fdw_hnd(cfd) (fdw_data(cfd), fdwatch_type_read) == -2)) {
+					if (fdw_rw(cfd) & fdwatch_type_write && slot->buf >= 0 && writable(idx))
+						fdw_hnd(cfd) (fdw_data(cfd), fdwatch_type_write);
+				}
+				slot->handling = false;
+
+				/* the slot may have been closed or even reused meanwhile */
+				if (fdw_rw(cfd) && slot->buf >= 0)
+					settle(idx);
+			}
+			nrunning = 0;
+		}
+
+}
+
+#endif				/* HAVE_IO_URING */
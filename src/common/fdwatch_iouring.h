@@ -0,0 +1,150 @@
+/*
+  * Abstraction API/layer for the various ways PvPGN can inspect sockets state
+  *
+  * Linux io_uring(7) based backend
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+  */
+#ifndef __INCLUDED_FDWATCH_IOURING__
+#define __INCLUDED_FDWATCH_IOURING__
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+
+#include "scoped_array.h"
+#include "fdwbackend.h"
+
+namespace pvpgn
+{
+
+	/*
+	 * Sockets whose handlers read and write with fdwatch_recv() and
+	 * fdwatch_send() are read and written through the ring: each has a
+	 * receive and a send buffer in one region registered with the kernel,
+	 * a read is kept on the ring into the receive buffer and what the
+	 * handlers send is written from the send buffer. The handlers run on
+	 * the completions and copy from and to the buffers. Other sockets get
+	 * a one shot poll request which is armed again after their handlers
+	 * ran. The requests of a loop are submitted and its completions
+	 * harvested in a single io_uring_enter().
+	 */
+	class FDWIouringBackend : public FDWBackend
+	{
+	public:
+		explicit FDWIouringBackend(int nfds_);
+		~FDWIouringBackend() throw();
+
+		int add(int idx, unsigned rw);
+		int del(int idx);
+		int watch(long timeout_msecs);
+		void handle();
+		int recv(int idx, void *buff, int len);
+		int send(int idx, void const *buff, int len);
+		void flush(int idx);
+
+	private:
+		struct Slot {
+			unsigned gen;		/* tags the poll request armed last */
+			unsigned events;	/* poll mask of the armed request */
+			bool armed;
+			bool handling;		/* handlers running, arm afterwards */
+			bool retry;		/* the ring was full, arm in watch() */
+			bool queued;		/* on the run queue */
+			int buf;		/* its buffers, -1 when it is polled */
+		};
+
+		/* a socket's buffers, they are taken back once the kernel is done
+		 * with them, which may be after the socket was removed */
+		struct Buf {
+			int idx;		/* slot using it, -1 if none */
+			bool reading;		/* a read is on the ring */
+			bool writing;		/* a write is on the ring */
+			bool flushing;		/* on the flush list */
+			unsigned rpos;		/* received and not yet taken */
+			unsigned rend;
+			int rerr;		/* end of stream (-1) or errno after the data */
+			unsigned shead;		/* taken by send() and not yet written */
+			unsigned stail;
+			int serr;		/* errno of the last write */
+		};
+
+		struct Ready {
+			__u64 user_data;
+			__s32 res;
+		};
+
+		int ringfd;
+		void *ring;
+		size_t ringsize;
+		struct io_uring_sqe *sqes;
+		size_t sqessize;
+
+		unsigned *sq_head;
+		unsigned *sq_tail;
+		unsigned *sq_array;
+		unsigned sq_mask;
+		unsigned sq_entries;
+		unsigned sq_local;	/* our tail, published on submit */
+
+		unsigned *cq_head;
+		unsigned *cq_tail;
+		struct io_uring_cqe *cqes;
+		unsigned cq_mask;
+
+		char *region;		/* the registered buffers */
+		size_t regionsize;
+		bool regfailed;
+
+		int sr;
+		scoped_array<Slot> slots;
+		scoped_array<Ready> ready;
+		unsigned readysize;
+		scoped_array<int> retries;	/* slots with retry set */
+		int nretries;
+		scoped_array<Buf> bufs;
+		scoped_array<int> freebufs;
+		int nfreebufs;
+		scoped_array<int> flushes;	/* buffers with data to write */
+		int nflushes;
+		scoped_array<int> runq;		/* slots handle() runs without a completion */
+		int nrunq;
+		scoped_array<int> running;
+		int nrunning;
+
+		bool register_buffers();
+		struct io_uring_sqe * get_sqe();
+		int enter(unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz);
+		int submit();
+		int arm(int idx, unsigned rw);
+		int disarm(int idx);
+		int start_read(int b);
+		int start_write(int b);
+		void cancel(__u64 tag);
+		void complete(struct io_uring_cqe const *cqe);
+		void release(int b);
+		void enqueue(int idx);
+		bool readable(int idx) const;
+		bool writable(int idx) const;
+		void settle(int idx);
+		char * rbuf(int b) const;
+		char * sbuf(int b) const;
+	};
+
+}
+
+#endif /* HAVE_IO_URING */
+
+#endif /* __INCLUDED_FDWATCH_IOURING__ */
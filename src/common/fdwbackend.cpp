@@ -21,6 +21,9 @@
 
 #include "common/setup_before.h"
 #include "fdwbackend.h"
+
+#include "common/fdwatch.h"
+#include "common/network.h"
 #include "common/setup_after.h"
 
 namespace pvpgn
@@ -33,4 +36,18 @@ namespace pvpgn
 	FDWBackend::~FDWBackend() throw()
 	{}
 
+	int FDWBackend::recv(int idx, void *buff, int len)
+	{
+		return net_recv(fdw_fd(fdw_fds + idx), buff, len);
+	}
+
+	int FDWBackend::send(int idx, void const *buff, int len)
+	{
+		return net_send(fdw_fd(fdw_fds + idx), buff, len);
+	}
+
+	void FDWBackend::flush(int idx)
+	{
+	}
+
 }
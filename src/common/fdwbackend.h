@@ -46,6 +46,10 @@ namespace pvpgn
 		virtual int del(int idx) = 0;
 		virtual int watch(long timeout_msecs) = 0;
 		virtual void handle() = 0;
+		/* for the readiness based backends these are net_recv() and net_send() */
+		virtual int recv(int idx, void *buff, int len);
+		virtual int send(int idx, void const *buff, int len);
+		virtual void flush(int idx);
 
 	protected:
 		int nfds;
@@ -30,6 +30,7 @@
 #include "common/packet.h"
 #include "common/eventlog.h"
 #include "common/field_sizes.h"
+#include "common/fdwatch.h"
 #include "common/setup_after.h"
 
 
@@ -76,7 +77,7 @@ namespace pvpgn
 		return -1;
 	}
 
-	extern int net_recv_packet(int sock, t_packet * packet, unsigned int * currsize)
+	extern int net_recv_packet(int sock, t_packet * packet, unsigned int * currsize, int fdw_idx)
 	{
 		int          addlen;
 		unsigned int header_size;
@@ -103,7 +104,7 @@ namespace pvpgn
 		}
 
 		if (*currsize < header_size)
-			addlen = net_recv(sock, temp, header_size - *currsize);
+			addlen = (fdw_idx < 0) ? net_recv(sock, temp, header_size - *currsize) : fdwatch_recv(fdw_idx, temp, header_size - *currsize);
 		else {
 			unsigned int total_size = packet_get_size(packet);
 
@@ -117,7 +118,7 @@ namespace pvpgn
 				return -1;
 			}
 
-			addlen = net_recv(sock, temp, total_size - *currsize);
+			addlen = (fdw_idx < 0) ? net_recv(sock, temp, total_size - *currsize) : fdwatch_recv(fdw_idx, temp, total_size - *currsize);
 		}
 
 		if (addlen <= 0) return addlen;
@@ -170,7 +171,7 @@ namespace pvpgn
 		return -1;
 	}
 
-	extern int net_send_packet(int sock, t_packet const * packet, unsigned int * currsize)
+	extern int net_send_packet(int sock, t_packet const * packet, unsigned int * currsize, int fdw_idx)
 	{
 		unsigned int size;
 		int          addlen;
@@ -191,7 +192,10 @@ namespace pvpgn
 			return 1;
 		}
 
-		addlen = net_send(sock, packet_get_raw_data_const(packet, *currsize), size - *currsize);
+		if (fdw_idx < 0)
+			addlen = net_send(sock, packet_get_raw_data_const(packet, *currsize), size - *currsize);
+		else
+			addlen = fdwatch_send(fdw_idx, packet_get_raw_data_const(packet, *currsize), size - *currsize);
 
 		if (addlen <= 0) return addlen;
 
@@ -32,8 +32,10 @@ namespace pvpgn
 
 	extern int net_recv(int sock, void *buff, int len);
 	extern int net_send(int sock, const void *buff, int len);
-	extern int net_recv_packet(int sock, t_packet * packet, unsigned int * currsize);
-	extern int net_send_packet(int sock, t_packet const * packet, unsigned int * currsize);
+	/* with fdw_idx, through fdwatch_recv() and fdwatch_send() for a socket
+	 * added with fdwatch_add_io_fd() */
+	extern int net_recv_packet(int sock, t_packet * packet, unsigned int * currsize, int fdw_idx = -1);
+	extern int net_send_packet(int sock, t_packet const * packet, unsigned int * currsize, int fdw_idx = -1);
 
 }
 
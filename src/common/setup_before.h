@@ -145,6 +145,8 @@ const char * const BNETD_IPBAN_FILE = "conf/bnban.conf";
 const char * const BNETD_TRANS_FILE = "conf/address_translation.conf";
 const char * const BNETD_CHANLOG_DIR = "var/chanlogs";
 const char * const BNETD_USERLOG_DIR = "var/userlogs";
+const char * const BNETD_FLIGHTREC_FILE = "var/flightrec.log";
+const char * const BNETD_MEMPROF_FILE = "var/memprof.log";
 const char * const BNETD_REALM_FILE = "conf/realm.conf";
 const char * const BNETD_ISSUE_FILE = "conf/bnissue.txt";
 const char * const BNETD_MAIL_DIR = "var/bnmail";
@@ -201,6 +203,9 @@ const int BNETD_IRC_PORT = 6667; /* used if port not specified */
 const char * const BNETD_IRC_NETWORK_NAME = PVPGN_SOFTWARE;
 const char * const BNETD_TRACK_ADDRS = "track.pvpgn.org";
 const int BNETD_TRACK_PORT = 6114; /* use this port if not specified */
+const char * const BNETD_CLUSTER_ADDR = "127.0.0.1";
+const int BNETD_CLUSTER_PORT = 6118; /* use this port if not specified */
+const unsigned BNETD_CLUSTER_RETRY = 10; /* s between connection attempts to a cluster peer */
 const int BNETD_DEF_TEST_PORT = 6112; /* default guess for UDP test port */
 const int BNETD_MIN_TEST_PORT = 6112;
 const int BNETD_MAX_TEST_PORT = 6500;
@@ -208,6 +213,10 @@ const unsigned BNETD_USERSYNC = 300; /* s */
 const unsigned BNETD_USERFLUSH = 1000;
 const unsigned BNETD_USERSTEP = 100; /* check 100 users per call in accountlist_save() */
 const unsigned BNETD_PACKET_LIMIT = 1000; /* maximum of 1000 packets in packet queue until connections is dropped */
+const unsigned BNETD_READ_PACKETS = 8; /* packets handled per connection and main loop iteration */
+const unsigned BNETD_READ_BYTES = 16384; /* bytes read per connection and main loop iteration */
+const unsigned BNETD_READ_PAUSE = 200; /* queued packets that stop reading from the connection */
+const unsigned BNETD_CLOSE_TIMEOUT = 30; /* s to flush the packet queue of a closing connection */
 const unsigned BNETD_LATENCY = 600; /* s */
 const unsigned BNETD_IRC_LATENCY = 180; /* s */ /* Ping timeout for IRC connections */
 const unsigned BNETD_DEF_NULLMSG = 120; /* s */
@@ -224,6 +233,7 @@ const unsigned BNETD_QUOTA_LINES = 5; /* lines */
 const unsigned BNETD_QUOTA_TIME = 5; /* s */
 const unsigned BNETD_QUOTA_WLINE = 40; /* chars */
 const unsigned BNETD_QUOTA_MLINE = 200; /* chars */
+const unsigned BNETD_PRESENCE_WINDOW = 1; /* s */
 const unsigned BNETD_LADDER_INIT_RAT = 1000;
 const unsigned BNETD_MAIL_SUPPORT = 0;
 const unsigned BNETD_MAIL_QUOTA = 5;
@@ -401,6 +411,11 @@ const int BNETD_MAX_SOCKVAL = 8192;
 # define HAVE_EPOLL	1
 #endif
 
+/* the ring waits with a timeout since Linux 5.11 */
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_IORING_ENTER_EXT_ARG) && defined(HAVE_SYS_MMAN_H)
+# define HAVE_IO_URING	1
+#endif
+
 #if defined(WITH_LUA)
 #define WITH_LUA	1
 #endif
@@ -0,0 +1,159 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+#include "common/tlv.h"
+
+#include <cstring>
+
+#include "common/bn_type.h"
+#include "common/eventlog.h"
+#include "common/setup_after.h"
+
+namespace pvpgn
+{
+
+	static const unsigned int tlv_header_size = 8;
+
+
+	extern void tlv_reader_init(t_tlv_reader * reader, void const * data, unsigned int size)
+	{
+		reader->data = (unsigned char const *)data;
+		reader->size = data ? size : 0;
+		reader->pos = 0;
+	}
+
+
+	extern unsigned int tlv_reader_get_left(t_tlv_reader const * reader)
+	{
+		return reader->size - reader->pos;
+	}
+
+
+	/* returns NULL if fewer than size bytes are left */
+	extern void const * tlv_reader_peek(t_tlv_reader const * reader, unsigned int size)
+	{
+		if (size > reader->size - reader->pos)
+			return NULL;
+		return reader->data + reader->pos;
+	}
+
+
+	extern void const * tlv_reader_take(t_tlv_reader * reader, unsigned int size)
+	{
+		void const * data;
+
+		if (!(data = tlv_reader_peek(reader, size)))
+			return NULL;
+		reader->pos += size;
+		return data;
+	}
+
+
+	/*
+	 * Returns 1 for an item, 0 at the end of the data and -1 if the
+	 * data ends inside an item, the reader is at the end after that.
+	 * The padding may be missing after the last item.
+	 */
+	extern int tlv_reader_next(t_tlv_reader * reader, t_tlv_item * item)
+	{
+		unsigned char const * header;
+		unsigned int left, padded;
+
+		if (!(left = tlv_reader_get_left(reader)))
+			return 0;
+		if (!(header = (unsigned char const *)tlv_reader_take(reader, tlv_header_size)))
+		{
+			reader->pos = reader->size;
+			return -1;
+		}
+
+		item->tag = bn_int_nget(*((bn_int const *)header));
+		item->type = bn_short_nget(*((bn_short const *)(header + 4)));
+		item->size = bn_short_nget(*((bn_short const *)(header + 6)));
+		if (!(item->data = tlv_reader_peek(reader, item->size)))
+		{
+			reader->pos = reader->size;
+			return -1;
+		}
+
+		padded = (item->size + 3) & ~3U;
+		left = tlv_reader_get_left(reader);
+		reader->pos += (padded < left) ? padded : left;
+		return 1;
+	}
+
+
+	static unsigned int tlv_index_hash(t_tag tag)
+	{
+		return (unsigned int)((tag * 2654435761U) >> (32 - tlv_index_bits));
+	}
+
+
+	static t_tag tlv_index_row_tag(t_tlv_index const * index, unsigned int row)
+	{
+		t_tag tag;
+
+		std::memcpy(&tag, index->rows + row * index->stride, sizeof(tag));
+		return tag;
+	}
+
+
+	/* the first of several rows with the same tag wins, as with a linear scan */
+	extern int tlv_index_init(t_tlv_index * index, void const * rows, unsigned int count, std::size_t stride)
+	{
+		unsigned int mask = (1U << tlv_index_bits) - 1;
+		unsigned int row, pos;
+		t_tag tag;
+
+		/* probe chains stay short while the index is at most half full */
+		if (count > (mask + 1) / 2)
+		{
+			eventlog(eventlog_level_error, __FUNCTION__, "too many rows for the index ({})", count);
+			return -1;
+		}
+
+		index->rows = (unsigned char const *)rows;
+		index->stride = stride;
+		std::memset(index->slots, 0, sizeof(index->slots));
+
+		for (row = 0; row < count; row++)
+		{
+			tag = tlv_index_row_tag(index, row);
+			for (pos = tlv_index_hash(tag); index->slots[pos]; pos = (pos + 1) & mask)
+				if (tlv_index_row_tag(index, index->slots[pos] - 1) == tag)
+					break;
+			if (!index->slots[pos])
+				index->slots[pos] = (unsigned short)(row + 1);
+		}
+
+		return 0;
+	}
+
+
+	/* returns the row of the tag, or -1 */
+	extern int tlv_index_find(t_tlv_index const * index, t_tag tag)
+	{
+		unsigned int mask = (1U << tlv_index_bits) - 1;
+		unsigned int pos;
+
+		for (pos = tlv_index_hash(tag); index->slots[pos]; pos = (pos + 1) & mask)
+			if (tlv_index_row_tag(index, index->slots[pos] - 1) == tag)
+				return index->slots[pos] - 1;
+
+		return -1;
+	}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef INCLUDED_TLV_TYPES
+#define INCLUDED_TLV_TYPES
+
+#include <cstddef>
+
+#include "common/tag.h"
+
+namespace pvpgn
+{
+
+	/*
+	 * A bounded view of a report in a packet. Nothing is copied, every
+	 * read is checked against the end of the view.
+	 */
+	typedef struct
+	{
+		unsigned char const * data;
+		unsigned int          size;
+		unsigned int          pos;
+	} t_tlv_reader;
+
+	/*
+	 * One tag/type/length/value item as WOL game results send them: a
+	 * 4 byte tag, a 2 byte type and a 2 byte length, all big endian,
+	 * then the value padded to 4 bytes.
+	 */
+	typedef struct
+	{
+		t_tag        tag;
+		unsigned int type;
+		unsigned int size;   /* of the value, without the padding */
+		void const * data;   /* into the packet */
+	} t_tlv_item;
+
+	/*
+	 * Finds the row of a handler table for a tag with a single probe in
+	 * most cases. The rows must start with their t_tag and must outlive
+	 * the index.
+	 */
+	const unsigned int tlv_index_bits = 10;
+
+	typedef struct
+	{
+		unsigned char const * rows;
+		std::size_t           stride;
+		unsigned short        slots[1 << tlv_index_bits]; /* row number plus one, 0 if free */
+	} t_tlv_index;
+
+}
+
+#endif
+
+
+/*****/
+#ifndef JUST_NEED_TYPES
+#ifndef INCLUDED_TLV_PROTOS
+#define INCLUDED_TLV_PROTOS
+
+namespace pvpgn
+{
+
+	extern void tlv_reader_init(t_tlv_reader * reader, void const * data, unsigned int size);
+	extern unsigned int tlv_reader_get_left(t_tlv_reader const * reader);
+	extern void const * tlv_reader_peek(t_tlv_reader const * reader, unsigned int size);
+	extern void const * tlv_reader_take(t_tlv_reader * reader, unsigned int size);
+	extern int tlv_reader_next(t_tlv_reader * reader, t_tlv_item * item);
+
+	extern int tlv_index_init(t_tlv_index * index, void const * rows, unsigned int count, std::size_t stride);
+	extern int tlv_index_find(t_tlv_index const * index, t_tag tag);
+
+}
+
+#endif
+#endif
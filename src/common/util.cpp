@@ -351,13 +351,17 @@ namespace pvpgn
 
 	extern char * escape_chars(char const * in, unsigned int len)
 	{
-		char *       out;
-		unsigned int inpos;
-		unsigned int outpos;
-
 		if (!in)
 			return NULL;
-		out = (char*)xmalloc(len * 4 + 1); /* if all turn into \xxx */
+		return escape_chars_buf(in, len, (char*)xmalloc(len * 4 + 1)); /* if all turn into \xxx */
+	}
+
+
+	/* out must hold len*4+1 characters, so callers escaping a lot can reuse one buffer */
+	extern char * escape_chars_buf(char const * in, unsigned int len, char * out)
+	{
+		unsigned int inpos;
+		unsigned int outpos;
 
 		for (inpos = 0, outpos = 0; inpos < len; inpos++)
 		{
@@ -39,6 +39,7 @@ namespace pvpgn
 	extern int clockstr_to_seconds(char const * clockstr, unsigned int * totsecs);
 	extern char * escape_fs_chars(char const * in, unsigned int len);
 	extern char * escape_chars(char const * in, unsigned int len);
+	extern char * escape_chars_buf(char const * in, unsigned int len, char * out);
 	extern char * unescape_chars(char const * in);
 	extern void str_to_hex(char * target, char const * data, int datalen);
 	extern int hex_to_str(char const * source, char * data, int datalen);
@@ -22,6 +22,8 @@
 #include "xalloc.h"
 #undef XALLOC_INTERNAL_ACCESS
 
+#include <cstring>
+
 #include "compat/strdup.h"
 #include "common/eventlog.h"
 #include "common/setup_after.h"
@@ -31,59 +33,267 @@ namespace pvpgn
 
 	static t_oom_cb oom_cb = NULL;
 
-	void *xmalloc_real(std::size_t size, const char *fn, unsigned ln)
+	/*
+	 * The profiler keeps the live blocks in an open addressed table keyed by
+	 * address, so a free finds the call site and size of its block. Blocks
+	 * allocated before the profiler started are not in it and their frees
+	 * are not counted. The tables use plain malloc and are not profiled.
+	 */
+	typedef struct
+	{
+		void *       ptr;     /* NULL for a free slot */
+		std::size_t  size;
+		unsigned int site;
+	} t_xalloc_block;
+
+	static int profiling = 0;
+	static std::time_t profile_since = 0;
+
+	static t_xalloc_site * sites = NULL;
+	static unsigned int sites_len = 0;
+	static unsigned int sites_max = 0;
+	static unsigned int * site_slots = NULL; /* index into sites plus one, 0 if free */
+	static unsigned int site_slots_mask = 0;
+
+	static t_xalloc_block * blocks = NULL;
+	static unsigned long blocks_len = 0;
+	static unsigned long blocks_mask = 0;
+
+	static unsigned long site_hash(char const * file, unsigned int line)
+	{
+		return ((unsigned long)file >> 3) * 31 + line * 2654435761UL;
+	}
+
+	static unsigned long block_hash(void const * ptr)
+	{
+		return ((unsigned long)ptr >> 4) * 2654435761UL;
+	}
+
+	static void profile_free_tables(void)
+	{
+		free(sites);
+		free(site_slots);
+		free(blocks);
+		sites = NULL;
+		site_slots = NULL;
+		blocks = NULL;
+		sites_len = sites_max = site_slots_mask = 0;
+		blocks_len = blocks_mask = 0;
+	}
+
+	static void profile_fail(void)
+	{
+		profiling = 0;
+		profile_free_tables();
+		eventlog(eventlog_level_error, __FUNCTION__, "out of memory for the allocation profiler, stopped it");
+	}
+
+	static int profile_grow_sites(void)
+	{
+		unsigned int newmax = sites_max ? sites_max * 2 : 256;
+		t_xalloc_site * newsites;
+		unsigned int * newslots;
+		unsigned int i, pos;
+
+		if (!(newsites = (t_xalloc_site *)realloc(sites, newmax * sizeof(t_xalloc_site))))
+			return -1;
+		sites = newsites;
+		/* the index stays at most half full */
+		if (!(newslots = (unsigned int *)calloc(newmax * 2, sizeof(unsigned int))))
+			return -1;
+		free(site_slots);
+		site_slots = newslots;
+		site_slots_mask = newmax * 2 - 1;
+		sites_max = newmax;
+
+		for (i = 0; i < sites_len; i++)
+		{
+			for (pos = site_hash(sites[i].file, sites[i].line) & site_slots_mask; site_slots[pos]; pos = (pos + 1) & site_slots_mask);
+			site_slots[pos] = i + 1;
+		}
+		return 0;
+	}
+
+	/* returns the index of the site, or -1 when out of memory */
+	static long profile_get_site(char const * file, unsigned int line, char const * func)
+	{
+		unsigned int pos;
+		t_xalloc_site * site;
+
+		if (site_slots)
+			for (pos = site_hash(file, line) & site_slots_mask; site_slots[pos]; pos = (pos + 1) & site_slots_mask)
+			{
+				site = &sites[site_slots[pos] - 1];
+				if (site->line == line && site->file == file)
+					return site_slots[pos] - 1;
+			}
+
+		if (sites_len == sites_max && profile_grow_sites() < 0)
+			return -1;
+
+		site = &sites[sites_len];
+		std::memset(site, 0, sizeof(*site));
+		site->file = file;
+		site->line = line;
+		site->func = func;
+		for (pos = site_hash(file, line) & site_slots_mask; site_slots[pos]; pos = (pos + 1) & site_slots_mask);
+		site_slots[pos] = ++sites_len;
+
+		return sites_len - 1;
+	}
+
+	static int profile_grow_blocks(void)
+	{
+		unsigned long newsize = blocks_mask ? (blocks_mask + 1) * 2 : 4096;
+		unsigned long oldsize = blocks_mask ? blocks_mask + 1 : 0;
+		t_xalloc_block * old = blocks;
+		t_xalloc_block * newblocks;
+		unsigned long i, pos;
+
+		if (!(newblocks = (t_xalloc_block *)calloc(newsize, sizeof(t_xalloc_block))))
+			return -1;
+		blocks = newblocks;
+		blocks_mask = newsize - 1;
+
+		for (i = 0; i < oldsize; i++)
+		{
+			if (!old[i].ptr)
+				continue;
+			for (pos = block_hash(old[i].ptr) & blocks_mask; blocks[pos].ptr; pos = (pos + 1) & blocks_mask);
+			blocks[pos] = old[i];
+		}
+		free(old);
+		return 0;
+	}
+
+	static void profile_alloc(void * ptr, std::size_t size, char const * file, unsigned int line, char const * func)
+	{
+		t_xalloc_site * site;
+		unsigned long pos;
+		long idx;
+
+		/* the table stays at most half full */
+		if ((blocks_len + 1) * 2 > (blocks_mask ? blocks_mask + 1 : 0) && profile_grow_blocks() < 0)
+		{
+			profile_fail();
+			return;
+		}
+		if ((idx = profile_get_site(file, line, func)) < 0)
+		{
+			profile_fail();
+			return;
+		}
+
+		for (pos = block_hash(ptr) & blocks_mask; blocks[pos].ptr; pos = (pos + 1) & blocks_mask);
+		blocks[pos].ptr = ptr;
+		blocks[pos].size = size;
+		blocks[pos].site = (unsigned int)idx;
+		blocks_len++;
+
+		site = &sites[idx];
+		site->live += size;
+		if (site->live > site->peak)
+			site->peak = site->live;
+		site->blocks++;
+		site->allocs++;
+		site->bytes += size;
+	}
+
+	static void profile_free(void * ptr)
+	{
+		t_xalloc_site * site;
+		unsigned long pos, next, home;
+
+		if (!blocks)
+			return;
+		for (pos = block_hash(ptr) & blocks_mask; blocks[pos].ptr != ptr; pos = (pos + 1) & blocks_mask)
+			if (!blocks[pos].ptr)
+				return; /* allocated before the profiler started */
+
+		site = &sites[blocks[pos].site];
+		site->live -= blocks[pos].size;
+		site->blocks--;
+		site->frees++;
+		blocks_len--;
+
+		/* shift the following entries back so no probe chain is broken */
+		for (next = (pos + 1) & blocks_mask; blocks[next].ptr; next = (next + 1) & blocks_mask)
+		{
+			home = block_hash(blocks[next].ptr) & blocks_mask;
+			if (((next - home) & blocks_mask) >= ((next - pos) & blocks_mask))
+			{
+				blocks[pos] = blocks[next];
+				pos = next;
+			}
+		}
+		blocks[pos].ptr = NULL;
+	}
+
+	void *xmalloc_real(std::size_t size, const char *fn, unsigned ln, const char *func)
 	{
 		void *res;
 
 		res = malloc(size);
 		if (!res) {
 			eventlog(eventlog_level_fatal, __FUNCTION__, "out of memory (from {}:{})", fn, ln);
-			if (oom_cb && oom_cb() && (res = malloc(size))) return res;
-			std::abort();
+			if (!(oom_cb && oom_cb() && (res = malloc(size))))
+				std::abort();
 		}
 
+		if (profiling)
+			profile_alloc(res, size, fn, ln, func);
 		return res;
 	}
 
-	void *xcalloc_real(std::size_t nmemb, std::size_t size, const char *fn, unsigned ln)
+	void *xcalloc_real(std::size_t nmemb, std::size_t size, const char *fn, unsigned ln, const char *func)
 	{
 		void *res;
 
 		res = calloc(nmemb, size);
 		if (!res) {
 			eventlog(eventlog_level_fatal, __FUNCTION__, "out of memory (from {}:{})", fn, ln);
-			if (oom_cb && oom_cb() && (res = calloc(nmemb, size))) return res;
-			std::abort();
+			if (!(oom_cb && oom_cb() && (res = calloc(nmemb, size))))
+				std::abort();
 		}
 
+		if (profiling)
+			profile_alloc(res, nmemb * size, fn, ln, func);
 		return res;
 	}
 
-	void *xrealloc_real(void *ptr, std::size_t size, const char *fn, unsigned ln)
+	void *xrealloc_real(void *ptr, std::size_t size, const char *fn, unsigned ln, const char *func)
 	{
 		void *res;
 
 		res = std::realloc(ptr, size);
 		if (!res) {
 			eventlog(eventlog_level_fatal, __FUNCTION__, "out of memory (from {}:{})", fn, ln);
-			if (oom_cb && oom_cb() && (res = std::realloc(ptr, size))) return res;
-			std::abort();
+			if (!(oom_cb && oom_cb() && (res = std::realloc(ptr, size))))
+				std::abort();
 		}
 
+		/* the resized block belongs to the site that resized it */
+		if (profiling) {
+			if (ptr)
+				profile_free(ptr);
+			profile_alloc(res, size, fn, ln, func);
+		}
 		return res;
 	}
 
-	char *xstrdup_real(const char *str, const char *fn, unsigned ln)
+	char *xstrdup_real(const char *str, const char *fn, unsigned ln, const char *func)
 	{
 		char *res;
 
 		res = strdup(str);
 		if (!res) {
 			eventlog(eventlog_level_fatal, __FUNCTION__, "out of memory (from {}:{})", fn, ln);
-			if (oom_cb && oom_cb() && (res = strdup(str))) return res;
-			std::abort();
+			if (!(oom_cb && oom_cb() && (res = strdup(str))))
+				std::abort();
 		}
 
+		if (profiling)
+			profile_alloc(res, std::strlen(res) + 1, fn, ln, func);
 		return res;
 	}
 
@@ -94,6 +304,8 @@ namespace pvpgn
 			return;
 		}
 
+		if (profiling)
+			profile_free(ptr);
 		free(ptr);
 	}
 
@@ -102,6 +314,72 @@ namespace pvpgn
 		oom_cb = cb;
 	}
 
+	void xalloc_profile_start(void)
+	{
+		if (profiling)
+			return;
+		profile_free_tables();
+		profile_since = std::time(NULL);
+		profiling = 1;
+	}
+
+	void xalloc_profile_stop(void)
+	{
+		profiling = 0;
+		profile_free_tables();
+	}
+
+	int xalloc_profile_running(void)
+	{
+		return profiling;
+	}
+
+	/* the live blocks stay tracked, only the counters start over */
+	void xalloc_profile_reset(void)
+	{
+		unsigned int i;
+
+		for (i = 0; i < sites_len; i++)
+		{
+			sites[i].peak = sites[i].live;
+			sites[i].allocs = 0;
+			sites[i].frees = 0;
+			sites[i].bytes = 0;
+		}
+		profile_since = std::time(NULL);
+	}
+
+	std::time_t xalloc_profile_get_since(void)
+	{
+		return profile_since;
+	}
+
+	unsigned int xalloc_profile_get_length(void)
+	{
+		return sites_len;
+	}
+
+	/* copies the "max" sites with the most live bytes into "out", biggest first */
+	unsigned int xalloc_profile_get_top(t_xalloc_site * out, unsigned int max)
+	{
+		unsigned int i, j, n = 0;
+
+		if (!max)
+			return 0;
+		for (i = 0; i < sites_len; i++)
+		{
+			if (n < max)
+				n++;
+			else if (sites[i].live <= out[n - 1].live)
+				continue;
+			for (j = n - 1; j > 0 && out[j - 1].live < sites[i].live; j--)
+				out[j] = out[j - 1];
+			out[j] = sites[i];
+		}
+
+		return n;
+	}
+
 }
 
 #endif /* XALLOC_SKIP */
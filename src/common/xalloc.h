@@ -24,6 +24,20 @@ namespace pvpgn
 	/* out of memory callback function */
 	typedef int(*t_oom_cb)(void);
 
+	/* what the allocation profiler knows about one call site */
+	typedef struct
+	{
+		char const *  file;
+		unsigned int  line;
+		char const *  func;
+		unsigned long live;    /* bytes allocated here and not freed yet */
+		unsigned long peak;    /* high-water mark of live */
+		unsigned long blocks;  /* allocations not freed yet */
+		unsigned long allocs;  /* since the profiler was started or reset */
+		unsigned long frees;
+		unsigned long bytes;   /* allocated in total, freed or not */
+	} t_xalloc_site;
+
 }
 
 #define INCLUDED_XALLOC_TYPES
@@ -33,6 +47,8 @@ namespace pvpgn
 #ifndef INCLUDED_XALLOC_PROTOS
 #define INCLUDED_XALLOC_PROTOS
 
+#include <ctime>
+
 #ifndef XALLOC_SKIP
 #include <cstdlib>
 
@@ -40,18 +56,27 @@ namespace pvpgn
 {
 
 
-#define xmalloc(size) xmalloc_real(size,__FILE__,__LINE__)
-	void *xmalloc_real(std::size_t size, const char *fn, unsigned ln);
-#define xcalloc(no,size) xcalloc_real(no,size,__FILE__,__LINE__)
-	void *xcalloc_real(std::size_t nmemb, std::size_t size, const char *fn, unsigned ln);
-#define xrealloc(ptr,size) xrealloc_real(ptr,size,__FILE__,__LINE__)
-	void *xrealloc_real(void *ptr, std::size_t size, const char *fn, unsigned ln);
-#define xstrdup(str) xstrdup_real(str,__FILE__,__LINE__)
-	char *xstrdup_real(const char *str, const char *fn, unsigned ln);
+#define xmalloc(size) xmalloc_real(size,__FILE__,__LINE__,__FUNCTION__)
+	void *xmalloc_real(std::size_t size, const char *fn, unsigned ln, const char *func);
+#define xcalloc(no,size) xcalloc_real(no,size,__FILE__,__LINE__,__FUNCTION__)
+	void *xcalloc_real(std::size_t nmemb, std::size_t size, const char *fn, unsigned ln, const char *func);
+#define xrealloc(ptr,size) xrealloc_real(ptr,size,__FILE__,__LINE__,__FUNCTION__)
+	void *xrealloc_real(void *ptr, std::size_t size, const char *fn, unsigned ln, const char *func);
+#define xstrdup(str) xstrdup_real(str,__FILE__,__LINE__,__FUNCTION__)
+	char *xstrdup_real(const char *str, const char *fn, unsigned ln, const char *func);
 #define xfree(ptr) xfree_real(ptr,__FILE__,__LINE__)
 	void xfree_real(void *ptr, const char *fn, unsigned ln);
 	void xalloc_setcb(t_oom_cb cb);
 
+	/* allocation profiling by call site, costs a flag test while stopped */
+	void xalloc_profile_start(void);
+	void xalloc_profile_stop(void);
+	int xalloc_profile_running(void);
+	void xalloc_profile_reset(void);
+	std::time_t xalloc_profile_get_since(void);
+	unsigned int xalloc_profile_get_length(void);
+	unsigned int xalloc_profile_get_top(t_xalloc_site * sites, unsigned int max);
+
 }
 
 #else /* XALLOC_SKIP */
@@ -62,6 +87,13 @@ namespace pvpgn
 #define xstrdup(str) strdup(str)
 #define xfree(ptr) free(ptr)
 #define xalloc_setcb(cb)
+#define xalloc_profile_start()
+#define xalloc_profile_stop()
+#define xalloc_profile_running() 0
+#define xalloc_profile_reset()
+#define xalloc_profile_get_since() ((std::time_t)0)
+#define xalloc_profile_get_length() 0U
+#define xalloc_profile_get_top(sites,max) 0U
 
 #endif
 
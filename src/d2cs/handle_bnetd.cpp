@@ -100,6 +100,8 @@ namespace pvpgn
 				bn_int_set(&rpacket->u.d2cs_bnetd_authreply.h.seqno, 1);
 				bn_int_set(&rpacket->u.d2cs_bnetd_authreply.version, D2CS_VERSION_NUMBER);
 				packet_append_string(rpacket, prefs_get_realmname());
+				/* lets bnetd tell apart several d2cs of the realm on one host */
+				packet_append_string(rpacket, prefs_get_servaddrs());
 				conn_push_outqueue(c, rpacket);
 				packet_del_ref(rpacket);
 			}
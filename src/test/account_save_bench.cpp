@@ -0,0 +1,367 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bnetd/attr.h"
+#include "bnetd/file_plain.h"
+#include "bnetd/filesync.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+using namespace pvpgn::bnetd;
+
+/*
+ * An account is saved the way storage_file does it: written to its own
+ * temporary file by the plain engine and renamed over the account by
+ * filesync_commit() at the end of the cycle. A child saving versions of
+ * an account is killed at random points, every time the account must
+ * read back as one whole version once the journal was recovered, and a
+ * save that was complete but not yet renamed must not be lost. Also
+ * reports the bytes a save writes when a single attribute changed.
+ */
+static const unsigned int nattrs = 60;	/* about what a player with a few ladders has */
+static const unsigned int kills = 40;
+static const unsigned int saves = 200;
+static const unsigned int accounts = 100;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+static t_hlist attrs;
+static std::vector<t_attr *> attrv;
+static std::string dir;
+static std::string journal;
+
+static void make_attrs(unsigned int version)
+{
+	char key[64], val[64];
+
+	hlist_init(&attrs);
+	for (unsigned int i = 0; i < nattrs; i++) {
+		std::sprintf(key, "Record\\W3XP\\%u\\%s%u", i / 6, i % 2 ? "wins" : "last game result", i);
+		std::sprintf(val, "%u", version);
+		attrv.push_back(attr_create(key, val));
+		hlist_add(&attrs, &attrv.back()->link);
+	}
+}
+
+static void set_version(unsigned int version)
+{
+	char val[64];
+
+	std::sprintf(val, "%u", version);
+	for (unsigned int i = 0; i < attrv.size(); i++)
+		attr_set_val(attrv[i], val);
+}
+
+static std::string temp_of(char const * path);
+
+static int save(char const * path)
+{
+	std::string tempname = temp_of(path);
+
+	if (file_plain.write_attrs(tempname.c_str(), &attrs))
+		return -1;
+	filesync_add(tempname.c_str(), path);
+	return 0;
+}
+
+struct Check {
+	unsigned int count;
+	std::string version;
+	bool mixed;
+};
+
+static int check_attr(const char * key, const char * val, void * data)
+{
+	Check * check = (Check *)data;
+
+	if (!check->count++)
+		check->version = val;
+	else if (check->version != val)
+		check->mixed = true;
+	return 0;
+}
+
+/* the account has all attributes and all of them from the same save */
+static unsigned int read_version(char const * path)
+{
+	Check check = { 0, "", false };
+
+	require(file_plain.read_attrs(path, check_attr, &check) == 0);
+	require(check.count == nattrs);
+	require(!check.mixed);
+	return std::atoi(check.version.c_str());
+}
+
+static std::string temp_of(char const * path)
+{
+	return dir + "/" + BNETD_ACCOUNT_TMP + "." + std::string(path).substr(dir.size() + 1);
+}
+
+/* what storage_file does at startup, returns whether the crash left a temporary file */
+static bool recover(char const * path)
+{
+	struct stat st;
+	bool left = stat(temp_of(path).c_str(), &st) == 0;
+
+	filesync_open(journal.c_str());
+	if (stat(temp_of(path).c_str(), &st) == 0 && !filesync_get_target(temp_of(path).c_str()))
+		std::remove(temp_of(path).c_str());
+	return left;
+}
+
+/* a child saves a version and dies before the commit */
+static void save_and_die(char const * path, unsigned int version)
+{
+	pid_t pid = fork();
+	require(pid >= 0);
+	if (!pid) {
+		set_version(version);
+		_exit(save(path) ? 1 : 0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	require(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void crash_test(char const * path)
+{
+	unsigned int last = 0;
+	unsigned int left = 0;
+
+	set_version(0);
+	require(save(path) == 0 && filesync_commit() == 0);
+
+	std::srand(1);
+	for (unsigned int i = 0; i < kills; i++) {
+		pid_t pid = fork();
+		require(pid >= 0);
+		if (!pid) {
+			for (unsigned int v = last + 1;; v++) {
+				set_version(v);
+				if (save(path) || filesync_commit())
+					_exit(1);
+			}
+		}
+
+		usleep(std::rand() % 20000);
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+
+		left += recover(path);
+
+		unsigned int version = read_version(path);
+		require(version >= last);
+		last = version;
+	}
+	require(filesync_get_pending() == 0);
+	std::printf("crash    %u kills, account always whole, reached version %u, %u temporary files left\n", kills, last, left);
+}
+
+/* a complete save the crash left unrenamed is finished, a cut one is not */
+static void recovery_test(char const * path)
+{
+	struct stat st;
+
+	set_version(7);
+	require(save(path) == 0 && filesync_commit() == 0);
+
+	save_and_die(path, 8);
+	require(recover(path));
+	require(read_version(path) == 8);
+	require(stat(temp_of(path).c_str(), &st) < 0);
+
+	/* the crash came after the journal line, while the file was written */
+	save_and_die(path, 9);
+	require(stat(temp_of(path).c_str(), &st) == 0);
+	require(truncate(temp_of(path).c_str(), st.st_size / 2) == 0);
+	recover(path);
+	require(read_version(path) == 8);
+	require(stat(temp_of(path).c_str(), &st) < 0);
+
+	/* the system went down before the end of the file was on disk */
+	save_and_die(path, 10);
+	require(stat(temp_of(path).c_str(), &st) == 0);
+	require(truncate(temp_of(path).c_str(), st.st_size / 2) == 0);
+	require(truncate(temp_of(path).c_str(), st.st_size) == 0);
+	recover(path);
+	require(read_version(path) == 8);
+	require(stat(temp_of(path).c_str(), &st) < 0);
+	require(filesync_get_pending() == 0);
+	std::printf("recovery complete save finished after a crash, cut ones removed\n");
+}
+
+/* a save that could not be renamed stays pending until a commit gets it through */
+static void retry_test(char const * path)
+{
+	set_version(7);
+	require(save(path) == 0 && filesync_commit() == 0);
+	require(std::remove(path) == 0 && mkdir(path, 0700) == 0);
+
+	set_version(8);
+	require(save(path) == 0);
+	require(filesync_commit() < 0);
+	require(filesync_get_pending() == 1);
+	require(read_version(filesync_get_tempname(path)) == 8);
+
+	/* and it survives a crash of the process in the meantime */
+	require(recover(path));
+	require(filesync_get_pending() == 1);
+
+	require(rmdir(path) == 0);
+	require(filesync_commit() == 0);
+	require(filesync_get_pending() == 0);
+	require(read_version(path) == 8);
+	std::printf("retry    failed rename kept and done by the next commit\n");
+}
+
+static void full_test(char const * path)
+{
+	struct stat st;
+
+	set_version(7);
+	require(save(path) == 0 && filesync_commit() == 0);
+
+	pid_t pid = fork();
+	require(pid >= 0);
+	if (!pid) {
+		struct rlimit rl = { 512, 512 };
+
+		/* a disk that fills up half way through the file */
+		std::signal(SIGXFSZ, SIG_IGN);
+		setrlimit(RLIMIT_FSIZE, &rl);
+		set_version(1234567890);
+		_exit(save(path) == 0 ? 1 : 0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	require(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	require(read_version(path) == 7);
+	require(stat((dir + "/" + BNETD_ACCOUNT_TMP + ".full").c_str(), &st) < 0);
+	std::printf("full     short write refused, account kept\n");
+}
+
+/* until the commit, readers find the newest save in the temporary file */
+static void pending_test(char const * path)
+{
+	char const * tempname;
+
+	set_version(7);
+	require(save(path) == 0 && filesync_commit() == 0);
+
+	set_version(8);
+	require(save(path) == 0);
+	require((tempname = filesync_get_tempname(path)));
+	require(read_version(tempname) == 8);
+	require(read_version(path) == 7);
+	require(filesync_get_target(tempname) && !std::strcmp(filesync_get_target(tempname), path));
+
+	/* what storage_file does when a later save of the cycle fails */
+	filesync_drop(path);
+	require(!filesync_get_tempname(path));
+	require(filesync_get_pending() == 0);
+	require(filesync_commit() == 0);
+	require(read_version(path) == 7);
+	std::printf("pending  newest save readable before the commit, dropped save not renamed\n");
+}
+
+static void bench(char const * path)
+{
+	struct stat st;
+	char val[32];
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < saves; i++) {
+		/* one attribute changes between saves, as after a game */
+		std::sprintf(val, "%u", i);
+		attr_set_val(attrv[0], val);
+		require(save(path) == 0 && filesync_commit() == 0);
+	}
+	auto end = std::chrono::steady_clock::now();
+	require(stat(path, &st) == 0);
+	std::printf("single   %8ld bytes written per changed attribute, %7.1f us per save and sync\n",
+		(long)st.st_size, std::chrono::duration<double, std::micro>(end - start).count() / saves);
+
+	std::vector<std::string> paths;
+	for (unsigned int i = 0; i < accounts; i++)
+		paths.push_back(dir + "/" + std::to_string(100000 + i));
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < accounts; i++)
+		require(save(paths[i].c_str()) == 0 && filesync_commit() == 0);
+	end = std::chrono::steady_clock::now();
+	double each = std::chrono::duration<double, std::micro>(end - start).count() / accounts;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < accounts; i++)
+		require(save(paths[i].c_str()) == 0);
+	require(filesync_get_pending() == accounts);
+	require(filesync_commit() == 0);
+	end = std::chrono::steady_clock::now();
+	double batched = std::chrono::duration<double, std::micro>(end - start).count() / accounts;
+
+	std::printf("cycle    %7.1f us per account synced one by one, %7.1f us synced once per cycle\n", each, batched);
+
+	for (unsigned int i = 0; i < accounts; i++)
+		std::remove(paths[i].c_str());
+}
+
+int main()
+{
+	char tmpl[] = "account_save_XXXXXX";
+
+	require(mkdtemp(tmpl));
+	dir = tmpl;
+	journal = dir + "/" + BNETD_ACCOUNT_TMP + "-journal";
+	make_attrs(0);
+	require(filesync_open(journal.c_str()) == 0);
+
+	crash_test((dir + "/crash").c_str());
+	recovery_test((dir + "/recovery").c_str());
+	retry_test((dir + "/retry").c_str());
+	full_test((dir + "/full").c_str());
+	pending_test((dir + "/pending").c_str());
+	bench((dir + "/bench").c_str());
+	filesync_close();
+
+	std::remove((dir + "/crash").c_str());
+	std::remove((dir + "/recovery").c_str());
+	std::remove((dir + "/retry").c_str());
+	std::remove((dir + "/full").c_str());
+	std::remove((dir + "/pending").c_str());
+	std::remove((dir + "/bench").c_str());
+	std::remove(journal.c_str());
+	require(rmdir(dir.c_str()) == 0);
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+
+#include "bnetd/attr.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+using namespace pvpgn::bnetd;
+
+/*
+ * 100k cached accounts with the attributes a ladder player has, held
+ * once the way attributes used to be (a copy of key and value each)
+ * and once with shared keys and short values inside the attribute.
+ * Reports the heap in use for both.
+ */
+static const unsigned int naccounts = 100000;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+static unsigned long heap_used()
+{
+	return mallinfo2().uordblks;
+}
+#else
+static unsigned long heap_used()
+{
+	return 0;
+}
+#endif
+
+typedef std::vector<std::pair<std::string, std::string> > t_account_attrs;
+
+static void make_account(unsigned int i, t_account_attrs & attrs)
+{
+	static char const * const tags[] = { "W3XP", "WAR3" };
+	static char const * const modes[] = { "solo", "team", "ffa" };
+	static char const * const fields[] = { "wins", "losses", "xp", "level", "rank" };
+	char buf[64];
+
+	attrs.clear();
+	std::sprintf(buf, "user%06u", i);
+	attrs.push_back(std::make_pair("BNET\\acct\\username", buf));
+	std::sprintf(buf, "%u", i + 1);
+	attrs.push_back(std::make_pair("BNET\\acct\\userid", buf));
+	std::sprintf(buf, "%08x%08x%08x%08x%08x", i * 2654435761U, i, ~i, i * 40503U, i ^ 0x5a5a5a5aU);
+	attrs.push_back(std::make_pair("BNET\\acct\\passhash1", buf));
+	std::sprintf(buf, "%u", 1790000000 + i);
+	attrs.push_back(std::make_pair("BNET\\acct\\ctime", buf));
+	attrs.push_back(std::make_pair("BNET\\acct\\lastlogin_time", buf));
+	std::sprintf(buf, "10.%u.%u.%u", (i >> 16) & 255, (i >> 8) & 255, i & 255);
+	attrs.push_back(std::make_pair("BNET\\acct\\lastlogin_ip", buf));
+	attrs.push_back(std::make_pair("BNET\\acct\\lastlogin_clienttag", "W3XP"));
+	std::sprintf(buf, "owner%u", i % 5000);
+	attrs.push_back(std::make_pair("BNET\\acct\\lastlogin_owner", buf));
+	std::sprintf(buf, "user%06u@example.com", i);
+	attrs.push_back(std::make_pair("BNET\\acct\\email", buf));
+	attrs.push_back(std::make_pair("BNET\\auth\\admin", "false"));
+	attrs.push_back(std::make_pair("BNET\\auth\\operator", "false"));
+	attrs.push_back(std::make_pair("BNET\\auth\\lockk", "false"));
+	attrs.push_back(std::make_pair("BNET\\auth\\botlogin", "false"));
+	attrs.push_back(std::make_pair("BNET\\auth\\command_groups", "1"));
+	attrs.push_back(std::make_pair("profile\\sex", ""));
+	attrs.push_back(std::make_pair("profile\\age", ""));
+	attrs.push_back(std::make_pair("profile\\location", ""));
+	attrs.push_back(std::make_pair("profile\\description", i % 4 ? "" : "Looking for a clan, add me as a friend!"));
+
+	for (unsigned int t = 0; t < sizeof(tags) / sizeof(*tags); t++) {
+		if (t && i % 3)
+			continue;	/* most only play the expansion */
+		for (unsigned int m = 0; m < sizeof(modes) / sizeof(*modes); m++)
+			for (unsigned int f = 0; f < sizeof(fields) / sizeof(*fields); f++) {
+				std::sprintf(buf, "Record\\%s\\%s\\%s", tags[t], modes[m], fields[f]);
+				std::string key = buf;
+				std::sprintf(buf, "%u", (i * (f + 3) + m) % (f == 2 ? 5000 : 60));
+				attrs.push_back(std::make_pair(key, buf));
+			}
+	}
+
+	attrs.push_back(std::make_pair("friend\\count", "1"));
+	std::sprintf(buf, "%u", (i * 7919) % naccounts + 1);
+	attrs.push_back(std::make_pair("friend\\0\\uid", buf));
+}
+
+/* what attr_create() and attr_destroy() did before */
+struct legacy_attr {
+	const char *key;
+	const char *val;
+	int dirty;
+	t_hlist link;
+};
+
+static unsigned long total_attrs;
+
+static void run_legacy()
+{
+	std::vector<t_hlist> accounts(naccounts);
+	t_account_attrs attrs;
+	t_hlist *curr, *save;
+
+	unsigned long before = heap_used();
+	auto start = std::chrono::steady_clock::now();
+	total_attrs = 0;
+	for (unsigned int i = 0; i < naccounts; i++) {
+		hlist_init(&accounts[i]);
+		make_account(i, attrs);
+		for (unsigned int j = 0; j < attrs.size(); j++) {
+			legacy_attr *attr = (legacy_attr *)xmalloc(sizeof(legacy_attr));
+			attr->dirty = 0;
+			attr->key = xstrdup(attrs[j].first.c_str());
+			attr->val = xstrdup(attrs[j].second.c_str());
+			hlist_add(&accounts[i], &attr->link);
+			total_attrs++;
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	unsigned long used = heap_used() - before;
+
+	std::printf("copies   %8.1f MB, %5lu bytes per account, %4.1f per attribute, built in %6.1f ms\n",
+		used / 1048576.0, used / naccounts, (double)used / total_attrs,
+		std::chrono::duration<double, std::milli>(end - start).count());
+
+	for (unsigned int i = 0; i < naccounts; i++)
+		hlist_for_each_safe(curr, &accounts[i], save) {
+			legacy_attr *attr = hlist_entry(curr, legacy_attr, link);
+			xfree((void *)attr->key);
+			xfree((void *)attr->val);
+			xfree(attr);
+		}
+}
+
+static void run_interned()
+{
+	std::vector<t_hlist> accounts(naccounts);
+	t_account_attrs attrs;
+	t_hlist *curr, *save;
+	t_attr_key_stats stats;
+	unsigned long count = 0;
+
+	unsigned long before = heap_used();
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < naccounts; i++) {
+		hlist_init(&accounts[i]);
+		make_account(i, attrs);
+		for (unsigned int j = 0; j < attrs.size(); j++) {
+			t_attr *attr = attr_create(attrs[j].first.c_str(), attrs[j].second.c_str());
+			hlist_add(&accounts[i], &attr->link);
+			count++;
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	unsigned long used = heap_used() - before;
+
+	attr_key_get_stats(&stats);
+	std::printf("interned %8.1f MB, %5lu bytes per account, %4.1f per attribute, built in %6.1f ms (%u keys in %lu bytes)\n",
+		used / 1048576.0, used / naccounts, (double)used / count,
+		std::chrono::duration<double, std::milli>(end - start).count(), stats.keys, stats.bytes);
+	require(count == total_attrs);
+	require(stats.refs == count);
+
+	/* every attribute reads back what was stored */
+	for (unsigned int i = 0; i < naccounts; i += 97) {
+		make_account(i, attrs);
+		unsigned int j = attrs.size();
+		hlist_for_each(curr, &accounts[i]) {
+			t_attr *attr = hlist_entry(curr, t_attr, link);
+			j--;
+			require(!std::strcmp(attr_get_key(attr), attrs[j].first.c_str()));
+			require(!std::strcmp(attr_get_val(attr), attrs[j].second.c_str()));
+		}
+		require(j == 0);
+	}
+
+	for (unsigned int i = 0; i < naccounts; i++)
+		hlist_for_each_safe(curr, &accounts[i], save)
+			attr_destroy(hlist_entry(curr, t_attr, link));
+
+	attr_key_get_stats(&stats);
+	require(stats.keys == 0 && stats.refs == 0);
+}
+
+static void check_values()
+{
+	std::string big(100, 'x');
+	t_attr *attr = attr_create("BNET\\acct\\test", "0");
+	t_attr *same = attr_create("BNET\\acct\\test", NULL);
+
+	/* both use the one copy of the key */
+	require(attr_get_key(attr) == attr_get_key(same));
+	require(attr_get_val(same) == NULL);
+
+	attr_set_val(attr, big.c_str());
+	require(big == attr_get_val(attr));
+	/* a value out of the old one, on the heap and inline */
+	attr_set_val(attr, attr_get_val(attr) + 90);
+	require(!std::strcmp(attr_get_val(attr), "xxxxxxxxxx"));
+	attr_set_val(attr, attr_get_val(attr) + 5);
+	require(!std::strcmp(attr_get_val(attr), "xxxxx"));
+	attr_set_val(attr, big.c_str() + 100 - (ATTR_VAL_INLINE - 1));
+	require(attr_get_val(attr) == attr->inl);
+	attr_set_val(attr, big.c_str() + 100 - ATTR_VAL_INLINE);
+	require(attr_get_val(attr) != attr->inl);
+	attr_set_val(attr, NULL);
+	require(attr_get_val(attr) == NULL);
+
+	attr_destroy(attr);
+	attr_destroy(same);
+}
+
+int main()
+{
+	check_values();
+	run_legacy();
+	run_interned();
+
+	return 0;
+}
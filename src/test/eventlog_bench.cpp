@@ -0,0 +1,195 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "common/addr.h"
+#include "common/eventlog.h"
+#include "common/util.h"
+#include "common/xalloc.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+
+/*
+ * A debug message per attribute of a saved account, the way the hot
+ * paths log, with debug not in loglevels. Run once with the level
+ * checked inside the call after the arguments were built (as eventlog()
+ * used to), once through the macro, and once more with some other
+ * module having levels of its own. Then checks the module levels.
+ */
+static const unsigned int calls = 2000000;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+/* what eventlog() did before */
+template <typename... Args>
+static void legacy_eventlog(t_eventlog_level level, const char* module, fmt::string_view format_str, const Args& ... args)
+{
+	if (!(level & currlevel))
+		return;
+	eventlog_write(level, module, format_str, args...);
+}
+
+static unsigned int evaluated;
+
+static char const * attr_key(unsigned int i)
+{
+	static char const * const keys[] = { "BNET\\acct\\username", "Record\\W3XP\\solo\\wins", "profile\\description" };
+
+	evaluated++;
+	return keys[i % 3];
+}
+
+static void save_legacy(unsigned int i)
+{
+	char * key = escape_chars(attr_key(i), std::strlen(attr_key(i)));
+
+	legacy_eventlog(eventlog_level_debug, __FUNCTION__, "[{}] saving \"{}\"", addr_num_to_addr_str(0x0a000001 + i, 6112), key);
+	xfree(key);
+}
+
+static void save_macro(unsigned int i)
+{
+	eventlog(eventlog_level_debug, __FUNCTION__, "[{}] saving \"{}\"", addr_num_to_addr_str(0x0a000001 + i, 6112), std::string(attr_key(i)));
+}
+
+static void other_module(void)
+{
+	eventlog(eventlog_level_debug, __FUNCTION__, "not logged unless turned on for other_module");
+}
+
+static double run(void(*save)(unsigned int))
+{
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < calls; i++)
+		save(i);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+}
+
+/* the lines written to the log since the last call */
+static unsigned int logged(std::FILE * fp)
+{
+	static long pos = 0;
+	unsigned int lines = 0;
+	int ch;
+
+	std::fflush(fp);
+	std::fseek(fp, pos, SEEK_SET);
+	while ((ch = std::fgetc(fp)) != EOF)
+		if (ch == '\n')
+			lines++;
+	pos = std::ftell(fp);
+	return lines;
+}
+
+static void check_modules(void)
+{
+	std::FILE * fp = std::tmpfile();
+	unsigned int mask;
+
+	require(fp);
+	eventlog_set(fp);
+	currlevel = eventlog_level_error | eventlog_level_fatal;
+
+	require(eventlog_parse_levels("fatal,error,info", &mask) == 0);
+	require(mask == (eventlog_level_fatal | eventlog_level_error | eventlog_level_info));
+	require(eventlog_parse_levels("none", &mask) == 0 && mask == 0);
+	require(eventlog_parse_levels("fatal,loud", &mask) < 0);
+	require(eventlog_get_levels_str(eventlog_level_info | eventlog_level_error) == "error,info");
+
+	/* off, and the arguments are left alone */
+	evaluated = 0;
+	save_macro(0);
+	other_module();
+	require(evaluated == 0 && logged(fp) == 0);
+
+	/* one function */
+	require(eventlog_set_module_level("save_macro", "debug") == 0);
+	require(eventlog_modules != 0);
+	save_macro(0);
+	other_module();
+	require(evaluated == 1 && logged(fp) == 1);
+	eventlog(eventlog_level_error, "save_macro", "errors are not in its levels any more");
+	require(logged(fp) == 0);
+
+	/* the whole file, the function still has its own */
+	require(eventlog_set_module_level("eventlog_bench.cpp", "debug,error") == 0);
+	other_module();
+	eventlog(eventlog_level_error, "save_macro", "still not logged");
+	require(logged(fp) == 1);
+
+	/* a changed level is seen by modules looked up before */
+	require(eventlog_set_module_level("save_macro", "default") == 0);
+	eventlog(eventlog_level_error, "save_macro", "logged for the file");
+	require(logged(fp) == 1);
+
+	require(eventlog_set_module_levels("other_module=none; save_macro=debug junk") < 0);
+	require(eventlog_get_module_levels_str() == "other_module=none save_macro=debug");
+	other_module();
+	save_macro(1);
+	require(logged(fp) == 2);	/* with the error about junk */
+
+	/* one name in two files, as after the linker merged the strings */
+	require(eventlog_set_module_levels("eventlog_bench.cpp=debug") == 0);
+	require(eventlog_get_module_level("save_macro", "src/test/eventlog_bench.cpp") == eventlog_level_debug);
+	require(eventlog_get_module_level("save_macro", "src/bnetd/server.cpp") == currlevel);
+
+	/* currlevel applies again */
+	eventlog_clear_module_levels();
+	require(eventlog_modules == 0);
+	save_macro(2);
+	other_module();
+	eventlog(eventlog_level_error, "save_macro", "logged with currlevel");
+	require(logged(fp) == 1);
+
+	eventlog_set(stderr);
+	std::fclose(fp);
+}
+
+int main()
+{
+	check_modules();
+
+	currlevel = eventlog_level_info | eventlog_level_warn | eventlog_level_error | eventlog_level_fatal;
+
+	evaluated = 0;
+	double legacy = run(save_legacy);
+	require(evaluated == 2 * calls);
+
+	evaluated = 0;
+	double macro = run(save_macro);
+	require(evaluated == 0);
+
+	require(eventlog_set_module_level("other_module", "debug") == 0);
+	double modules = run(save_macro);
+	require(evaluated == 0);
+	eventlog_clear_module_levels();
+
+	std::printf("disabled debug, %u calls: %6.1f ns evaluated, %5.1f ns skipped, %5.1f ns skipped with module levels\n",
+		calls, legacy, macro, modules);
+
+	return 0;
+}
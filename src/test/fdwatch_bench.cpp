@@ -0,0 +1,358 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common/fdwatch.h"
+#include "common/fdwatch_epoll.h"
+#include "common/fdwatch_iouring.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+
+/*
+ * An echo server on socketpairs driven the way bnetd drives its sockets:
+ * a read turns on write interest for the reply, the write turns it off
+ * again, and the reads and writes go through the backend as bnetd's
+ * fdwatch_recv() and fdwatch_send() do. The clients send two packets at a
+ * time and the server reads one per event, so the backends must keep
+ * reporting a socket with data left. The system calls are counted by
+ * tracing a second run the way strace -c does, the clients' own send()
+ * and recv() included; the cpu time is taken from the untraced run.
+ */
+static const unsigned int pairs = 64;
+static const unsigned int packets = 100000;
+static const unsigned int packetsize = 64;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+struct Pair {
+	int server;
+	int client;
+	unsigned owed;		/* replies the server still has to write */
+	char data[2 * packetsize];	/* and their packets */
+	unsigned inflight;	/* packets sent by the client not yet echoed */
+	unsigned seq;		/* next packet the client sends */
+	unsigned expect;	/* next reply the client reads */
+};
+
+static FDWBackend * backend;
+static bool writes_in_watch;	/* the backend writes the replies in the next watch() */
+static std::vector<Pair> pair;
+static std::vector<int> replied;
+static unsigned long echoed;
+static unsigned long sent;
+
+/* as fdwatch_add_fd() and fdwatch_update_fd() do */
+static void update(int idx, unsigned rw)
+{
+	require(backend->add(idx, rw) == 0);
+	fdw_rw(fdw_fds + idx) = rw;
+}
+
+static void fill(char * buf, unsigned seq)
+{
+	std::memset(buf, 'x', packetsize);
+	std::memcpy(buf, &seq, sizeof(seq));
+}
+
+static int server_handler(void * data, t_fdwatch_type type)
+{
+	int idx = (int)(long)data;
+	Pair * p = &pair[idx];
+
+	if (type == fdwatch_type_read) {
+		require(p->owed < 2);
+		require(backend->recv(idx, p->data + p->owed * packetsize, packetsize) == (int)packetsize);
+		if (!p->owed++)
+			update(idx, fdwatch_type_read | fdwatch_type_write);
+		return 0;
+	}
+
+	/* echo the replies in one go, as bnetd sends its queue */
+	require(backend->send(idx, p->data, p->owed * packetsize) == (int)(p->owed * packetsize));
+	p->owed = 0;
+	update(idx, fdwatch_type_read);
+	replied.push_back(idx);
+	return 0;
+}
+
+static void client_send(Pair * p, unsigned count)
+{
+	char buf[2 * packetsize];
+
+	if (count > packets - sent)
+		count = packets - sent;
+	for (unsigned i = 0; i < count; i++)
+		fill(buf + i * packetsize, p->seq++);
+	if (count)
+		require(send(p->client, buf, count * packetsize, 0) == (ssize_t)(count * packetsize));
+	p->inflight += count;
+	sent += count;
+}
+
+static void client_recv(Pair * p)
+{
+	char buf[2 * packetsize];
+	ssize_t got;
+	unsigned seq;
+
+	got = recv(p->client, buf, sizeof(buf), 0);
+	require(got > 0 && got % packetsize == 0);
+	for (ssize_t pos = 0; pos < got; pos += packetsize) {
+		std::memcpy(&seq, buf + pos, sizeof(seq));
+		require(seq == p->expect);
+		p->expect++;
+		p->inflight--;
+		echoed++;
+	}
+	if (!p->inflight)
+		client_send(p, 2);
+}
+
+/* the clients read the replies and send the next packets */
+static void clients_recv()
+{
+	for (std::vector<int>::iterator it = replied.begin(); it != replied.end(); ++it)
+		client_recv(&pair[*it]);
+	replied.clear();
+}
+
+static void setup()
+{
+	int sv[2];
+
+	pair.resize(pairs);
+	for (unsigned i = 0; i < pairs; i++) {
+		require(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+		require(fcntl(sv[0], F_SETFL, O_NONBLOCK) == 0);
+		std::memset(&pair[i], 0, sizeof(pair[i]));
+		pair[i].server = sv[0];
+		pair[i].client = sv[1];
+	}
+}
+
+static void teardown()
+{
+	for (unsigned i = 0; i < pairs; i++) {
+		close(pair[i].server);
+		close(pair[i].client);
+	}
+	pair.clear();
+}
+
+static double cpu_ms()
+{
+	struct rusage ru;
+
+	require(getrusage(RUSAGE_SELF, &ru) == 0);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+/* echoes all packets, returns the number of server loops */
+static unsigned long run()
+{
+	unsigned long loops = 0;
+
+	setup();
+	echoed = sent = 0;
+	for (unsigned i = 0; i < pairs; i++) {
+		fdw_fd(fdw_fds + i) = pair[i].server;
+		fdw_fds[i].io = true;
+		fdw_hnd(fdw_fds + i) = server_handler;
+		fdw_data(fdw_fds + i) = (void *)(long)i;
+		require(backend->add(i, fdwatch_type_read) == 0);
+		fdw_rw(fdw_fds + i) = fdwatch_type_read;
+		client_send(&pair[i], 2);
+	}
+
+	while (echoed < packets) {
+		int n = backend->watch(1000);
+		require(n > 0 || (n < 0 && errno == EINTR));
+		loops++;
+		if (writes_in_watch)
+			clients_recv();
+		if (n > 0)
+			backend->handle();
+		if (!writes_in_watch)
+			clients_recv();
+	}
+
+	for (unsigned i = 0; i < pairs; i++) {
+		require(backend->del(i) == 0);
+		fdw_rw(fdw_fds + i) = 0;
+	}
+	teardown();
+	return loops;
+}
+
+typedef FDWBackend * (*t_create)(void);
+
+static FDWBackend * create_epoll(void)
+{
+	writes_in_watch = false;
+	return new FDWEpollBackend(fdw_maxcons);
+}
+
+#ifdef HAVE_IO_URING
+static FDWBackend * create_iouring(void)
+{
+	writes_in_watch = true;
+	return new FDWIouringBackend(fdw_maxcons);
+}
+#endif
+
+/* system calls of a run in a child traced with ptrace, -1 if it cannot be traced */
+static long count_syscalls(t_create create)
+{
+	struct __ptrace_syscall_info info;
+	long count = 0;
+	int markers = 0;
+	int status;
+	int sig = 0;
+	pid_t pid;
+
+	require((pid = fork()) >= 0);
+	if (!pid) {
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0)
+			_exit(2);
+		raise(SIGSTOP);
+		backend = create();
+		/* getppid() marks where the counting starts and stops */
+		syscall(SYS_getppid);
+		run();
+		syscall(SYS_getppid);
+		delete backend;
+		_exit(0);
+	}
+
+	require(waitpid(pid, &status, 0) == pid);
+	if (!WIFSTOPPED(status))
+		return -1;
+	require(ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL)) == 0);
+	for (;;) {
+		require(ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)sig) == 0);
+		sig = 0;
+		require(waitpid(pid, &status, 0) == pid);
+		if (WIFEXITED(status) || WIFSIGNALED(status))
+			break;
+		if (WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+			sig = WSTOPSIG(status);
+			continue;
+		}
+		require(ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void *)sizeof(info), &info) > 0);
+		if (info.op != PTRACE_SYSCALL_INFO_ENTRY)
+			continue;
+		if (info.entry.nr == SYS_getppid)
+			markers++;
+		else if (markers == 1)
+			count++;
+	}
+	require(WIFEXITED(status) && WEXITSTATUS(status) == 0 && markers == 2);
+
+	return count;
+}
+
+static void report(const char * name, double ms, long syscalls, unsigned long loops)
+{
+	if (syscalls < 0)
+		std::printf("%-10s %8.1f ms cpu  %8s syscalls  %7lu loops  per %u packets\n", name, ms, "(untraced)", loops, packets);
+	else
+		std::printf("%-10s %8.1f ms cpu  %8ld syscalls  %7lu loops  per %u packets\n", name, ms, syscalls, loops, packets);
+}
+
+static void bench(const char * name, t_create create)
+{
+	unsigned long loops;
+	double ms;
+
+	backend = create();
+	ms = cpu_ms();
+	loops = run();
+	ms = cpu_ms() - ms;
+	delete backend;
+	report(name, ms, count_syscalls(create), loops);
+}
+
+int main()
+{
+	fdw_maxcons = pairs * 2;
+	fdw_fds = new t_fdwatch_fd[fdw_maxcons];
+
+	/* epoll: one epoll_wait() per loop and one epoll_ctl() per change */
+	bench("epoll", create_epoll);
+
+#ifdef HAVE_IO_URING
+	try {
+		backend = create_iouring();
+	}
+	catch (const FDWBackend::InitError&) {
+		std::printf("io_uring is not available here, skipped\n");
+		delete[] fdw_fds;
+		return 0;
+	}
+	delete backend;
+
+	/* io_uring: the reads and writes of a loop go in with the wait */
+	bench("io_uring", create_iouring);
+
+	/* a socket removed from the ring is closed for its peer right away,
+	 * polled or read through the ring, and what was sent to it last is
+	 * written before */
+	for (int io = 0; io < 2; io++) {
+		int sv[2];
+		char buf[8];
+
+		backend = create_iouring();
+		require(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+		require(fcntl(sv[0], F_SETFL, O_NONBLOCK) == 0);
+		require(fcntl(sv[1], F_SETFL, O_NONBLOCK) == 0);
+		fdw_fd(fdw_fds) = sv[0];
+		fdw_fds[0].io = io;
+		require(backend->add(0, fdwatch_type_read) == 0);
+		fdw_rw(fdw_fds) = fdwatch_type_read;
+		require(backend->watch(0) == 0);
+		require(backend->send(0, "bye", 3) == 3);
+		require(backend->del(0) == 0);
+		fdw_rw(fdw_fds) = 0;
+		close(sv[0]);
+		require(recv(sv[1], buf, sizeof(buf), 0) == 3 && !std::memcmp(buf, "bye", 3));
+		require(recv(sv[1], buf, sizeof(buf), 0) == 0);
+		close(sv[1]);
+		delete backend;
+	}
+#endif
+
+	delete[] fdw_fds;
+	return 0;
+}
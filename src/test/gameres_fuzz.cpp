@@ -0,0 +1,263 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "common/bn_type.h"
+#include "common/bnet_protocol.h"
+#include "common/packet.h"
+#include "common/tlv.h"
+#include "bnetd/anongame_gameresult.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+using namespace pvpgn::bnetd;
+
+/*
+ * Game result reports as clients send them, then cut short at every
+ * length, mutated and replaced by random bytes. The decoders must never
+ * hand out data beyond the end of the report and must not leak or crash
+ * on any of them.
+ */
+static const unsigned int rounds = 20000;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+/* deterministic so failures can be repeated */
+static unsigned int rnd_state = 1;
+static unsigned int rnd()
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) & 0xffffff;
+}
+
+static void put_item(std::vector<unsigned char> & buf, t_tag tag, unsigned int type, void const * data, unsigned int size)
+{
+	unsigned char header[8];
+
+	bn_int_nset((bn_int *)header, tag);
+	bn_short_nset((bn_short *)(header + 4), type);
+	bn_short_nset((bn_short *)(header + 6), size);
+	buf.insert(buf.end(), header, header + 8);
+	buf.insert(buf.end(), (unsigned char const *)data, (unsigned char const *)data + size);
+	while (buf.size() % 4)
+		buf.push_back(0);
+}
+
+/* decodes all of buf, returns the number of items or -1 */
+static int decode(std::vector<unsigned char> const & buf, unsigned int len)
+{
+	t_tlv_reader reader;
+	t_tlv_item item;
+	unsigned char const * end;
+	int ret, count = 0;
+
+	/* a copy of exactly len bytes, so reading past it is caught by the checks below */
+	std::vector<unsigned char> copy(buf.begin(), buf.begin() + len);
+	end = copy.data() + len;
+	tlv_reader_init(&reader, copy.data(), len);
+	while ((ret = tlv_reader_next(&reader, &item)) > 0) {
+		require((unsigned char const *)item.data >= copy.data());
+		require((unsigned char const *)item.data + item.size <= end);
+		require(reader.pos <= len);
+		count++;
+	}
+	require(tlv_reader_get_left(&reader) == 0);
+	return ret < 0 ? -1 : count;
+}
+
+static void test_reader()
+{
+	std::vector<unsigned char> buf;
+	unsigned char value[64];
+	unsigned int i, len;
+
+	for (i = 0; i < sizeof(value); i++)
+		value[i] = (unsigned char)i;
+	put_item(buf, 0x49444e4f, 6, value, 4);	/* IDNO */
+	put_item(buf, 0x4e414d30, 7, "player\0", 7);	/* NAM0, padded */
+	put_item(buf, 0x4f4f5359, 2, value, 1);	/* OOSY */
+	put_item(buf, 0x53455223, 20, value, 0);	/* SER#, empty */
+	put_item(buf, 0x434d5030, 6, value, 4);	/* CMP0 */
+
+	require(decode(buf, buf.size()) == 5);
+	/* without the padding of the last item */
+	put_item(buf, 0x54494d45, 7, "abcde", 5);
+	require(decode(buf, buf.size() - 3) == 6);
+
+	/* every cut ends the report or breaks an item, never reads past it */
+	for (len = 0; len < buf.size(); len++)
+		decode(buf, len);
+
+	/* single bytes changed, the lengths of the items among them */
+	std::vector<unsigned char> mutated;
+	for (i = 0; i < rounds; i++) {
+		mutated = buf;
+		mutated[rnd() % mutated.size()] = (unsigned char)rnd();
+		mutated[rnd() % mutated.size()] = (unsigned char)rnd();
+		decode(mutated, rnd() % (mutated.size() + 1));
+	}
+
+	/* noise */
+	for (i = 0; i < rounds; i++) {
+		len = rnd() % 256;
+		mutated.resize(len);
+		for (unsigned int j = 0; j < len; j++)
+			mutated[j] = (unsigned char)rnd();
+		decode(mutated, len);
+	}
+}
+
+typedef struct {
+	t_tag tag;
+	int   value;
+} t_row;
+
+static void test_index()
+{
+	static t_tlv_index index;
+	std::vector<t_row> rows;
+	unsigned int i, n;
+	volatile unsigned long found = 0;
+
+	/* as many rows as the WOL results table, one tag twice */
+	for (i = 0; i < 240; i++) {
+		t_row row = { (t_tag)(0x41414141 + (i / 26) * 0x100 + (i % 26)), (int)i };
+		rows.push_back(row);
+	}
+	t_row dup = { rows[17].tag, 999 };
+	rows.push_back(dup);
+
+	require(tlv_index_init(&index, rows.data(), rows.size(), sizeof(t_row)) == 0);
+	for (i = 0; i < rows.size(); i++)
+		require(tlv_index_find(&index, rows[i].tag) == (int)(i == rows.size() - 1 ? 17 : i));
+	for (i = 0; i < rounds; i++) {
+		t_tag tag = rnd() | 0x80000000;
+		require(tlv_index_find(&index, tag) == -1);
+	}
+	require(tlv_index_init(&index, rows.data(), 1 << tlv_index_bits, sizeof(t_row)) < 0);
+
+	/* what a report of all tags costs either way */
+	n = rows.size() - 1;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < 1000; r++)
+		for (i = 0; i < n; i++)
+			for (unsigned int j = 0; j < n; j++)
+				if (rows[j].tag == rows[i].tag) {
+					found += j;
+					break;
+				}
+	auto mid = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < 1000; r++)
+		for (i = 0; i < n; i++)
+			found += tlv_index_find(&index, rows[i].tag);
+	auto end = std::chrono::steady_clock::now();
+	std::printf("scan  %8.1f ns per tag over %u tags\n", std::chrono::duration<double, std::nano>(mid - start).count() / (1000.0 * n), n);
+	std::printf("index %8.1f ns per tag over %u tags\n", std::chrono::duration<double, std::nano>(end - mid).count() / (1000.0 * n), n);
+}
+
+static t_anongame_gameresult * parse(std::vector<unsigned char> const & buf, unsigned int len)
+{
+	t_packet * packet;
+	t_anongame_gameresult * result;
+
+	require((packet = packet_create(packet_class_w3route)));
+	require(packet_set_size(packet, len) == 0);
+	std::memcpy(packet_get_raw_data(packet, 0), buf.data(), len);
+	/* the size is kept in the header the copy overwrote */
+	require(packet_set_size(packet, len) == 0);
+	result = anongame_gameresult_parse(packet);
+	packet_del_ref(packet);
+	return result;
+}
+
+static void test_anongame()
+{
+	t_client_w3route_gameresult head;
+	t_client_w3route_gameresult_player player;
+	t_client_w3route_gameresult_part2 part2;
+	t_client_w3route_gameresult_hero hero;
+	t_client_w3route_gameresult_part3 part3;
+	std::vector<unsigned char> buf;
+	t_anongame_gameresult * result;
+	unsigned int i, len;
+
+	std::memset(&head, 0, sizeof(head));
+	bn_byte_set(&head.number_of_results, 2);
+	buf.insert(buf.end(), (unsigned char *)&head, (unsigned char *)(&head + 1));
+	for (i = 0; i < 2; i++) {
+		std::memset(&player, 0, sizeof(player));
+		bn_byte_set(&player.number, i + 1);
+		bn_int_set(&player.result, i ? W3_GAMERESULT_LOSS : W3_GAMERESULT_WIN);
+		buf.insert(buf.end(), (unsigned char *)&player, (unsigned char *)(&player + 1));
+	}
+	std::memset(&part2, 0, sizeof(part2));
+	bn_int_set(&part2.heroes_used_count, 3);
+	buf.insert(buf.end(), (unsigned char *)&part2, (unsigned char *)(&part2 + 1));
+	for (i = 0; i < 3; i++) {
+		std::memset(&hero, 0, sizeof(hero));
+		bn_short_set(&hero.level, i + 1);
+		buf.insert(buf.end(), (unsigned char *)&hero, (unsigned char *)(&hero + 1));
+	}
+	std::memset(&part3, 0, sizeof(part3));
+	buf.insert(buf.end(), (unsigned char *)&part3, (unsigned char *)(&part3 + 1));
+
+	require((result = parse(buf, buf.size())));
+	require(gameresult_get_number_of_results(result) == 2);
+	require(gameresult_get_player_number(result, 1) == 2);
+	require(gameresult_get_player_result(result, 0) == W3_GAMERESULT_WIN);
+	require(gameresult_get_player_result(result, 2) == -1);
+	require(gameresult_destroy(result) == 0);
+
+	/* a part missing at the end */
+	for (len = sizeof(t_w3route_header); len < buf.size(); len++)
+		require(!parse(buf, len));
+
+	/* more heroes than the packet holds, also negative as the old int count */
+	unsigned int heroes_pos = sizeof(head) + 2 * sizeof(player) + sizeof(part2) - sizeof(bn_int);
+	std::vector<unsigned char> mutated = buf;
+	bn_int_set((bn_int *)&mutated[heroes_pos], 4);
+	require(!parse(mutated, mutated.size()));
+	bn_int_set((bn_int *)&mutated[heroes_pos], 0xffffffff);
+	require(!parse(mutated, mutated.size()));
+
+	for (i = 0; i < rounds; i++) {
+		mutated = buf;
+		mutated[sizeof(t_w3route_header) + rnd() % (mutated.size() - sizeof(t_w3route_header))] = (unsigned char)rnd();
+		if (rnd() % 2)
+			bn_int_set((bn_int *)&mutated[heroes_pos], rnd() % 8);
+		len = sizeof(t_w3route_header) + rnd() % (mutated.size() - sizeof(t_w3route_header) + 1);
+		if ((result = parse(mutated, len)))
+			gameresult_destroy(result);
+	}
+}
+
+int main()
+{
+	test_reader();
+	test_index();
+	test_anongame();
+
+	return 0;
+}
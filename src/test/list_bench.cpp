@@ -0,0 +1,177 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "common/list.h"
+#include "common/elist.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+
+/*
+ * Connection churn as the server sees it: a steady population of objects,
+ * one leaves and one arrives per step, and every few steps somebody walks
+ * the whole list looking for one of them (connlist_find_connection_by_*).
+ * Run once on t_list and once on a t_elist embedded in the object.
+ */
+static const unsigned int population = 5000;
+static const unsigned int steps = 200000;
+static const unsigned int walk_every = 50;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+#ifdef __GLIBC__
+/* count the allocations the lists make on top of the objects themselves */
+extern "C" void * __libc_malloc(std::size_t size);
+static unsigned long mallocs;
+
+extern "C" void * malloc(std::size_t size)
+{
+	mallocs++;
+	return __libc_malloc(size);
+}
+#define ALLOC_COUNT mallocs
+#else
+#define ALLOC_COUNT 0UL
+#endif
+
+struct Obj {
+	unsigned int id;
+	t_elist list;
+};
+
+static std::vector<Obj> objs;
+static std::vector<unsigned int> live;	/* ids of the objects in the list */
+static unsigned long found;
+
+/* deterministic so both runs see the same sequence */
+static unsigned int rnd_state;
+static unsigned int rnd()
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) & 0xffffff;
+}
+
+static void report(const char * name, double ms, unsigned long allocs)
+{
+	std::printf("%-8s %8.1f ms  %8lu allocations  per %u steps over %u objects\n", name, ms, allocs, steps, population);
+}
+
+static void run_list()
+{
+	t_list * list = list_create();
+	t_elem * curr;
+	t_elem const * ccurr;
+	unsigned int next = 0;
+
+	rnd_state = 1;
+	found = 0;
+	live.clear();
+	for (; next < population; next++) {
+		list_prepend_data(list, &objs[next]);
+		live.push_back(next);
+	}
+
+	unsigned long allocs = ALLOC_COUNT;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < steps; i++) {
+		unsigned int pos = rnd() % live.size();
+		require(list_remove_data(list, &objs[live[pos]], &curr) == 0);
+		live[pos] = next;
+		list_prepend_data(list, &objs[live[pos]]);
+		next++;
+
+		if (i % walk_every == 0) {
+			unsigned int want = live[rnd() % live.size()];
+			LIST_TRAVERSE_CONST(list, ccurr)
+			if (((Obj *)elem_get_data(ccurr))->id == want) {
+				found++;
+				break;
+			}
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	report("t_list", std::chrono::duration<double, std::milli>(end - start).count(), ALLOC_COUNT - allocs);
+
+	require(list_get_length(list) == population);
+	LIST_TRAVERSE(list, curr)
+		list_remove_elem(list, &curr);
+	list_destroy(list);
+}
+
+static void run_elist()
+{
+	DECLARE_ELIST_INIT(head);
+	t_elist * curr;
+	unsigned int next = 0;
+	unsigned int count = 0;
+
+	rnd_state = 1;
+	found = 0;
+	live.clear();
+	for (; next < population; next++) {
+		elist_add(&head, &objs[next].list);
+		live.push_back(next);
+	}
+
+	unsigned long allocs = ALLOC_COUNT;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < steps; i++) {
+		unsigned int pos = rnd() % live.size();
+		elist_del(&objs[live[pos]].list);
+		live[pos] = next;
+		elist_add(&head, &objs[live[pos]].list);
+		next++;
+
+		if (i % walk_every == 0) {
+			unsigned int want = live[rnd() % live.size()];
+			elist_for_each(curr, &head)
+			if (elist_entry(curr, Obj, list)->id == want) {
+				found++;
+				break;
+			}
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	report("t_elist", std::chrono::duration<double, std::milli>(end - start).count(), ALLOC_COUNT - allocs);
+
+	elist_for_each(curr, &head)
+		count++;
+	require(count == population);
+}
+
+int main()
+{
+	/* every arrival is a fresh object */
+	objs.resize(population + steps);
+	for (unsigned int i = 0; i < objs.size(); i++)
+		objs[i].id = i;
+
+	run_list();
+	unsigned long list_found = found;
+	run_elist();
+	require(found == list_found && found == steps / walk_every);
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include "common/packet.h"
+#include "bnetd/memlimit.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+using namespace pvpgn::bnetd;
+
+/*
+ * Walks the memory governor through its degradation stages the way the
+ * main loop drives it: memory is accounted, memlimit_check() runs and the
+ * stage and the amount to reclaim are checked against mem_budget.
+ */
+static const unsigned long budget = 1000 * 1024;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+static void set_used(unsigned long bytes)
+{
+	t_memlimit_stats stats;
+
+	memlimit_get_stats(&stats);
+	if (stats.used < bytes)
+		memlimit_add(bytes - stats.used);
+	else
+		memlimit_sub(stats.used - bytes);
+}
+
+int main(int argc, char ** argv)
+{
+	t_memlimit_stats stats;
+
+	/* no budget, no stages */
+	set_used(budget * 2);
+	require(memlimit_check(0) == 0);
+	require(memlimit_get_stage() == memlimit_stage_normal);
+
+	set_used(budget / 100 * 69);
+	require(memlimit_check(budget) == 0);
+	require(memlimit_get_stage() == memlimit_stage_normal);
+
+	/* 70% sheds chat to backlogged clients only */
+	set_used(budget / 100 * 70);
+	require(memlimit_check(budget) == 0);
+	require(memlimit_get_stage() == memlimit_stage_shed);
+	require(!memlimit_is_backlogged(sizeof(t_packet)));
+	require(memlimit_is_backlogged(8 * sizeof(t_packet)));
+
+	/* 85% refuses new connections */
+	set_used(budget / 100 * 85);
+	require(memlimit_check(budget) == 0);
+	require(memlimit_get_stage() == memlimit_stage_nologin);
+
+	/* a full budget asks to get back under the login threshold in one go */
+	set_used(budget + 4096);
+	require(memlimit_check(budget) == budget + 4096 - budget / 100 * 85);
+	require(memlimit_get_stage() == memlimit_stage_disconnect);
+	memlimit_count_kicked(3);
+
+	/* and the stages go back down as memory is freed */
+	set_used(budget / 100 * 80);
+	require(memlimit_check(budget) == 0);
+	require(memlimit_get_stage() == memlimit_stage_shed);
+	set_used(0);
+	require(memlimit_check(budget) == 0);
+	require(memlimit_get_stage() == memlimit_stage_normal);
+
+	/* freeing more than was accounted is clamped, not wrapped around */
+	memlimit_add(100);
+	memlimit_sub(200);
+	memlimit_count_shed();
+	memlimit_count_refused();
+	memlimit_get_stats(&stats);
+	require(stats.used == 0);
+	require(stats.peak == budget * 2);
+	require(stats.kicked == 3);
+	require(stats.shed == 1);
+	require(stats.refused == 1);
+
+	std::cout << "memory governor stages ok\n";
+	return 0;
+}
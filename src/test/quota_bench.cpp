@@ -0,0 +1,168 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <cassert>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include "common/list.h"
+#include "common/xalloc.h"
+#include "bnetd/quota.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+using namespace pvpgn::bnetd;
+
+/* quota_lines = 5, quota_time = 5, quota_dobae = 10, as in the default bnetd.conf */
+static const unsigned int lines = 5;
+static const unsigned int period = 5;
+static const unsigned int dobae = 10;
+
+static const unsigned int connections = 1000;
+static const unsigned int messages = 2000000;
+
+/* the previous implementation, one allocated line record per message */
+typedef struct
+{
+	std::time_t  inf;
+	unsigned int count;
+} t_qline;
+
+typedef struct
+{
+	unsigned int totcount;
+	t_list *     list;
+} t_listquota;
+
+static unsigned int listquota_add(t_listquota * q, unsigned int count, std::time_t now)
+{
+	t_elem * curr;
+	t_qline * qline;
+
+	LIST_TRAVERSE(q->list, curr)
+	{
+		qline = (t_qline*)elem_get_data(curr);
+		if (now >= qline->inf + (std::time_t)period)
+		{
+			list_remove_elem(q->list, &curr);
+			q->totcount -= qline->count;
+			xfree(qline);
+		}
+		else
+			break;
+	}
+
+	qline = (t_qline*)xmalloc(sizeof(t_qline));
+	qline->inf = now;
+	qline->count = count;
+	list_append_data(q->list, qline);
+	q->totcount += count;
+
+	return q->totcount;
+}
+
+/* most connections send a line every 2 seconds, one in ten floods with 5 lines per second */
+static std::time_t msg_time(unsigned int i)
+{
+	if (i % connections < connections / 10)
+		return 1000 + (std::time_t)(i / connections / 5);
+	return 1000 + (std::time_t)(i / connections * 2);
+}
+
+static void semantics()
+{
+	t_quota q;
+	unsigned int i;
+
+	quota_init(&q);
+	/* a burst of quota_lines lines fills the bucket */
+	for (i = 1; i < lines; i++)
+		assert(quota_add(&q, 1, 100, lines, period) < lines);
+	assert(quota_add(&q, 1, 100, lines, period) >= lines);
+	/* after quota_time seconds the bucket is empty again */
+	assert(quota_add(&q, 1, 100 + period * 2, lines, period) == 1);
+
+	/* a fast flood reaches the dobae limit */
+	quota_init(&q);
+	for (i = 0; i < dobae - 1; i++)
+		quota_add(&q, 1, 200, lines, period);
+	assert(quota_add(&q, 1, 200, lines, period) >= dobae);
+
+	/* a long line counts as several */
+	quota_init(&q);
+	assert(quota_add(&q, 3, 300, lines, period) == 3);
+
+	/* per address buckets are shared and independent between addresses */
+	quota_addr_reset();
+	t_quota * a = quota_get_by_addr(0x7f000001, 400, lines, period);
+	t_quota * b = quota_get_by_addr(0x7f000002, 400, lines, period);
+	assert(a && b && a != b);
+	quota_add(a, 2, 400, lines, period);
+	assert(quota_get_by_addr(0x7f000001, 400, lines, period) == a);
+	assert(a->level / period == 2);
+}
+
+int main()
+{
+	std::vector<t_listquota> lq(connections);
+	std::vector<t_quota> bq(connections);
+	unsigned int i;
+	unsigned long exceeded_list = 0;
+	unsigned long exceeded_bucket = 0;
+
+	semantics();
+
+	for (i = 0; i < connections; i++)
+	{
+		lq[i].totcount = 0;
+		lq[i].list = list_create();
+		quota_init(&bq[i]);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (i = 0; i < messages; i++)
+		if (listquota_add(&lq[i % connections], 1, msg_time(i)) >= lines)
+			exceeded_list++;
+	auto mid = std::chrono::steady_clock::now();
+	for (i = 0; i < messages; i++)
+		if (quota_add(&bq[i % connections], 1, msg_time(i), lines, period) >= lines)
+			exceeded_bucket++;
+	auto end = std::chrono::steady_clock::now();
+
+	double list_s = std::chrono::duration<double>(mid - start).count();
+	double bucket_s = std::chrono::duration<double>(end - mid).count();
+
+	std::cout << messages << " messages over " << connections << " connections\n";
+	std::cout << "list quota:   " << list_s << " s, " << (unsigned long)(messages / list_s) << " msg/s, " << exceeded_list << " over quota\n";
+	std::cout << "bucket quota: " << bucket_s << " s, " << (unsigned long)(messages / bucket_s) << " msg/s, " << exceeded_bucket << " over quota\n";
+
+	for (i = 0; i < connections; i++)
+	{
+		t_elem * curr;
+		LIST_TRAVERSE(lq[i].list, curr)
+		{
+			xfree(elem_get_data(curr));
+			list_remove_elem(lq[i].list, &curr);
+		}
+		list_destroy(lq[i].list);
+	}
+
+	return 0;
+}
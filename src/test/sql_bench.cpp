@@ -0,0 +1,277 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef WITH_SQL_MYSQL
+#include "bnetd/sql_mysql.h"
+#endif
+#ifdef WITH_SQL_PGSQL
+#include "bnetd/sql_pgsql.h"
+#endif
+#ifdef WITH_SQL_SQLITE3
+#include "bnetd/sql_sqlite3.h"
+#endif
+#ifdef WITH_SQL_ODBC
+#include "bnetd/sql_odbc.h"
+#endif
+
+#include "common/setup_after.h"
+
+using namespace pvpgn::bnetd;
+
+/* the accounts table is scanned by name and uid as in storage_sql */
+static const unsigned int accounts = 10000;
+static const unsigned int queries = 50000;
+
+static t_sql_engine * sql = NULL;
+
+/* the checks run queries, so they must not compile away with NDEBUG */
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+/* the tables are made anew, a server database keeps them from the last run */
+static void setup()
+{
+	char query[512];
+	unsigned int i;
+
+	require(sql->query("DROP TABLE IF EXISTS BNET") == 0);
+	require(sql->query("DROP TABLE IF EXISTS profile") == 0);
+	require(sql->query("CREATE TABLE BNET (uid int NOT NULL PRIMARY KEY, username varchar(32) UNIQUE, acct_passhash1 varchar(128), acct_lastlogin_time int, acct_lastlogin_ip varchar(16))") == 0);
+	require(sql->query("CREATE TABLE profile (uid int NOT NULL PRIMARY KEY, sex varchar(8), age varchar(8), location varchar(128), description varchar(128))") == 0);
+	require(sql->query("BEGIN") == 0);
+	for (i = 1; i <= accounts; i++)
+	{
+		std::snprintf(query, sizeof(query), "INSERT INTO BNET VALUES('%u', 'bob%06u', '3ac7fc2662a6818c07d30ea20759b0eec046e130', '1700000000', '127.0.0.1')", i, i);
+		require(sql->query(query) == 0);
+		std::snprintf(query, sizeof(query), "INSERT INTO profile VALUES('%u', 'm', '42', 'somewhere', 'a rather long profile description')", i);
+		require(sql->query(query) == 0);
+	}
+	require(sql->query("COMMIT") == 0);
+}
+
+static unsigned int pick(unsigned int i)
+{
+	return (i * 7919) % accounts + 1;
+}
+
+/* previous way: format, escape and run the text of every query */
+static unsigned long text_lookup(unsigned int i)
+{
+	char query[512];
+	char name[32];
+	t_sql_res * result;
+	t_sql_row * row;
+	unsigned long uid = 0;
+
+	std::snprintf(name, sizeof(name), "bob%06u", pick(i));
+	std::snprintf(query, sizeof(query), "SELECT uid FROM BNET WHERE username='%s'", name);
+	result = sql->query_res(query);
+	if (result && (row = sql->fetch_row(result)) && row[0])
+		uid = std::strtoul(row[0], NULL, 10);
+	if (result)
+		sql->free_result(result);
+	return uid;
+}
+
+static unsigned long text_read(unsigned int i)
+{
+	char query[512];
+	t_sql_res * result;
+	unsigned long fields = 0;
+
+	std::snprintf(query, sizeof(query), "SELECT * FROM profile WHERE uid='%u'", pick(i));
+	result = sql->query_res(query);
+	if (result && sql->fetch_row(result))
+		fields = sql->num_fields(result);
+	if (result)
+		sql->free_result(result);
+	return fields;
+}
+
+static int text_write(unsigned int i)
+{
+	char query[512];
+	char value[64];
+	char escape[sizeof(value) * 2 + 1];
+
+	std::snprintf(value, sizeof(value), "it's %u", i);
+	sql->escape_string(escape, value, std::strlen(value));
+	std::snprintf(query, sizeof(query), "UPDATE profile SET location = '%s' WHERE uid = '%u'", escape, pick(i));
+	return sql->query(query);
+}
+
+/* prepared once, values bound on every execution */
+static t_sql_stmt * stmt_lookup;
+static t_sql_stmt * stmt_read;
+static t_sql_stmt * stmt_write;
+
+static unsigned long prepared_lookup(unsigned int i)
+{
+	char name[32];
+	const char * params[1] = { name };
+	t_sql_res * result;
+	t_sql_row * row;
+	unsigned long uid = 0;
+
+	std::snprintf(name, sizeof(name), "bob%06u", pick(i));
+	result = sql->execute_res(stmt_lookup, 1, params);
+	if (result && (row = sql->fetch_row(result)) && row[0])
+		uid = std::strtoul(row[0], NULL, 10);
+	if (result)
+		sql->free_result(result);
+	return uid;
+}
+
+static unsigned long prepared_read(unsigned int i)
+{
+	std::string uid = std::to_string(pick(i));
+	const char * params[1] = { uid.c_str() };
+	t_sql_res * result;
+	unsigned long fields = 0;
+
+	result = sql->execute_res(stmt_read, 1, params);
+	if (result && sql->fetch_row(result))
+		fields = sql->num_fields(result);
+	if (result)
+		sql->free_result(result);
+	return fields;
+}
+
+static int prepared_write(unsigned int i)
+{
+	char value[64];
+	std::string uid = std::to_string(pick(i));
+	const char * params[2] = { value, uid.c_str() };
+
+	std::snprintf(value, sizeof(value), "it's %u", i);
+	return sql->execute(stmt_write, 2, params);
+}
+
+template <typename F>
+static double per_query_us(F f)
+{
+	unsigned int i;
+
+	auto start = std::chrono::steady_clock::now();
+	for (i = 0; i < queries; i++)
+		f(i);
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::micro>(end - start).count() / queries;
+}
+
+static void report(const char * shape, double text, double prepared)
+{
+	std::printf("%-18s text %6.2f us   prepared %6.2f us   (%.1fx)\n", shape, text, prepared, text / prepared);
+}
+
+/* an empty argument is left out, as in storage_path */
+static const char * arg(int argc, char ** argv, int n)
+{
+	return n < argc && argv[n][0] ? argv[n] : NULL;
+}
+
+int main(int argc, char ** argv)
+{
+	const char * driver = arg(argc, argv, 1);
+	const char * params[1];
+	t_sql_res * result;
+	t_sql_row * row;
+	unsigned int i;
+
+	if (argc != 1 && argc != 7)
+	{
+		std::cerr << "usage: " << argv[0] << " [driver host port name user pass]\n";
+		return 1;
+	}
+
+#ifdef WITH_SQL_MYSQL
+	if (driver && std::strcmp(driver, "mysql") == 0)
+		sql = &sql_mysql;
+#endif
+#ifdef WITH_SQL_PGSQL
+	if (driver && std::strcmp(driver, "pgsql") == 0)
+		sql = &sql_pgsql;
+#endif
+#ifdef WITH_SQL_SQLITE3
+	if (!driver || std::strcmp(driver, "sqlite3") == 0)
+		sql = &sql_sqlite3;
+#endif
+#ifdef WITH_SQL_ODBC
+	if (driver && std::strcmp(driver, "odbc") == 0)
+		sql = &sql_odbc;
+#endif
+	if (sql == NULL)
+	{
+		std::cerr << "driver " << (driver ? driver : "sqlite3") << " is not built in\n";
+		return 1;
+	}
+
+	if (driver)
+		require(sql->init(arg(argc, argv, 2), arg(argc, argv, 3), NULL, arg(argc, argv, 4), arg(argc, argv, 5), arg(argc, argv, 6)) == 0);
+	else
+		require(sql->init(NULL, NULL, NULL, ":memory:", NULL, NULL) == 0);
+	setup();
+
+	require((stmt_lookup = sql->prepare("SELECT uid FROM BNET WHERE username = ?")) != NULL);
+	require((stmt_read = sql->prepare("SELECT * FROM profile WHERE uid = ?")) != NULL);
+	require((stmt_write = sql->prepare("UPDATE profile SET location = ? WHERE uid = ?")) != NULL);
+
+	/* both ways return the same rows */
+	for (i = 0; i < 100; i++)
+	{
+		require(text_lookup(i) == pick(i));
+		require(prepared_lookup(i) == pick(i));
+		require(text_read(i) == 5 && prepared_read(i) == 5);
+	}
+
+	/* quotes need no escaping and come back unchanged */
+	require(prepared_write(1) == 0 && sql->affected_rows() == 1);
+	std::string uid = std::to_string(pick(1));
+	params[0] = uid.c_str();
+	require((result = sql->execute_res(stmt_read, 1, params)) != NULL);
+	require(sql->num_rows(result) == 1 && (row = sql->fetch_row(result)) != NULL);
+	require(std::strcmp(row[3], "it's 1") == 0);
+	sql->free_result(result);
+
+	/* a NULL value binds SQL NULL */
+	params[0] = NULL;
+	require((result = sql->execute_res(stmt_lookup, 1, params)) != NULL);
+	require(sql->num_rows(result) == 0 && sql->fetch_row(result) == NULL);
+	sql->free_result(result);
+
+	std::printf("%s: %u queries per shape over %u accounts\n", driver ? driver : "sqlite3", queries, accounts);
+	report("account by name:", per_query_us(text_lookup), per_query_us(prepared_lookup));
+	report("attribute read:", per_query_us(text_read), per_query_us(prepared_read));
+	require(sql->query("BEGIN") == 0);
+	report("attribute write:", per_query_us(text_write), per_query_us(prepared_write));
+	require(sql->query("COMMIT") == 0);
+
+	sql->finalize(stmt_lookup);
+	sql->finalize(stmt_read);
+	sql->finalize(stmt_write);
+	sql->close();
+
+	return 0;
+}
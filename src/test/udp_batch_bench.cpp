@@ -0,0 +1,164 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "compat/psock.h"
+#include "common/packet.h"
+#include "common/bnet_protocol.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+
+/*
+ * A login storm as the UDP socket of bnetd sees it: two 8 byte UDPTEST
+ * packets to every client and the datagrams of the clients coming in.
+ * Sent and read once a datagram per call as udptest_send() and
+ * sd_udpinput() used to, and once in batches the way they do now.
+ */
+static const unsigned int datagrams = 20480;
+static const unsigned int burst = 256;	/* what waits in the socket buffer at a time */
+static const unsigned int send_batch = 64;	/* UDPTEST_BATCH */
+static const unsigned int recv_batch = 32;	/* UDP_RECV_BATCH */
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+static int tx, rx;
+static struct sockaddr_in rxaddr;
+static char udptest[8] = { 5, 0, 0, 0, 'B', 'N', 'E', 'T' };
+
+static unsigned long send_one(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		require(psock_sendto(tx, udptest, sizeof(udptest), 0, (struct sockaddr *)&rxaddr, sizeof(rxaddr)) == (int)sizeof(udptest));
+	return count;
+}
+
+static unsigned long recv_one(unsigned int count)
+{
+	static char buf[MAX_PACKET_SIZE];
+	struct sockaddr_in from;
+	psock_t_socklen fromlen;
+
+	for (unsigned int i = 0; i < count; i++) {
+		fromlen = sizeof(from);
+		require(psock_recvfrom(rx, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen) == (int)sizeof(udptest));
+	}
+	return count;
+}
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+static unsigned long send_batched(unsigned int count)
+{
+	struct mmsghdr msgs[send_batch];
+	struct iovec iov = { udptest, sizeof(udptest) };
+	unsigned long calls = 0;
+
+	std::memset(msgs, 0, sizeof(msgs));
+	for (unsigned int i = 0; i < send_batch; i++) {
+		msgs[i].msg_hdr.msg_name = &rxaddr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(rxaddr);
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	for (unsigned int sent = 0; sent < count; calls++) {
+		int n = sendmmsg(tx, msgs, count - sent < send_batch ? count - sent : send_batch, 0);
+		require(n > 0);
+		sent += n;
+	}
+	return calls;
+}
+
+static unsigned long recv_batched(unsigned int count)
+{
+	static t_packet packets[recv_batch];	/* preallocated, as in sd_udpinput() */
+	struct mmsghdr msgs[recv_batch];
+	struct iovec iovs[recv_batch];
+	struct sockaddr_in from[recv_batch];
+	unsigned long calls = 0;
+
+	for (unsigned int got = 0; got < count; calls++) {
+		std::memset(msgs, 0, sizeof(msgs));
+		for (unsigned int i = 0; i < recv_batch; i++) {
+			iovs[i].iov_base = packets[i].u.data;
+			iovs[i].iov_len = MAX_PACKET_SIZE;
+			msgs[i].msg_hdr.msg_name = &from[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		int n = recvmmsg(rx, msgs, recv_batch, MSG_DONTWAIT, NULL);
+		require(n > 0);
+		for (int i = 0; i < n; i++)
+			require(msgs[i].msg_len == sizeof(udptest) && !std::memcmp(packets[i].u.data, udptest, sizeof(udptest)));
+		got += n;
+	}
+	return calls;
+}
+#endif
+
+static void run(char const * name, unsigned long(*sendf)(unsigned int), unsigned long(*recvf)(unsigned int))
+{
+	double send_us = 0, recv_us = 0;
+	unsigned long send_calls = 0, recv_calls = 0;
+
+	for (unsigned int done = 0; done < datagrams; done += burst) {
+		auto start = std::chrono::steady_clock::now();
+		send_calls += sendf(burst);
+		auto mid = std::chrono::steady_clock::now();
+		recv_calls += recvf(burst);
+		auto end = std::chrono::steady_clock::now();
+		send_us += std::chrono::duration<double, std::micro>(mid - start).count();
+		recv_us += std::chrono::duration<double, std::micro>(end - mid).count();
+	}
+
+	std::printf("%-8s send %6lu calls %6.2f us per datagram, recv %6lu calls %6.2f us per datagram\n",
+		name, send_calls, send_us / datagrams, recv_calls, recv_us / datagrams);
+}
+
+int main()
+{
+	psock_t_socklen len = sizeof(rxaddr);
+	int bufsize = 1 << 20;
+
+	require((tx = psock_socket(PSOCK_PF_INET, PSOCK_SOCK_DGRAM, PSOCK_IPPROTO_UDP)) >= 0);
+	require((rx = psock_socket(PSOCK_PF_INET, PSOCK_SOCK_DGRAM, PSOCK_IPPROTO_UDP)) >= 0);
+	psock_setsockopt(rx, PSOCK_SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+	std::memset(&rxaddr, 0, sizeof(rxaddr));
+	rxaddr.sin_family = PSOCK_AF_INET;
+	rxaddr.sin_addr.s_addr = htonl(0x7f000001);
+	require(psock_bind(rx, (struct sockaddr *)&rxaddr, sizeof(rxaddr)) == 0);
+	require(psock_getsockname(rx, (struct sockaddr *)&rxaddr, &len) == 0);
+
+	run("single", send_one, recv_one);
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+	run("batched", send_batched, recv_batched);
+#else
+	std::printf("batched  no sendmmsg/recvmmsg here\n");
+#endif
+
+	psock_close(tx);
+	psock_close(rx);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "common/list.h"
+#include "bnetd/anongame_wol_queue.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+using namespace pvpgn::bnetd;
+
+/*
+ * An hour of Red Alert 2 and Yuri's Revenge quick matches: thousands of
+ * players in three lobbies ask for a match, play for a few minutes and
+ * ask again, some of them disconnect. Matched once the way
+ * anongame_wol_trystart() used to (one list of every player who asked,
+ * walked on every request and every disconnect) and once with the
+ * queues. Then with a player of the same region preferred for two
+ * minutes, once with a few regions and once with so many that thousands
+ * wait.
+ */
+static const unsigned int players = 6000;
+static const unsigned int lobbies = 3;
+static unsigned int regions;
+static const unsigned int seconds = 3600;
+static const unsigned int disconnects = 2;	/* per second */
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+struct Player {
+	unsigned int lobby;
+	int region;
+	bool waiting;
+	bool listed;	/* legacy: in the list */
+	t_anongame_wol_waiter waiter;
+};
+
+static std::vector<Player> pl;
+static std::vector<std::vector<unsigned int> > returns;	/* who comes back from a game, by second */
+static unsigned long matches, same_region;
+static double waited;
+
+static unsigned int rnd_state;
+static unsigned int rnd()
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) & 0xffffff;
+}
+
+static Player * from_waiter(t_anongame_wol_waiter const * waiter)
+{
+	return (Player *)((char *)waiter - offsetof(Player, waiter));
+}
+
+static int check_waiter(t_anongame_wol_waiter const * waiter)
+{
+	return from_waiter(waiter)->waiting;
+}
+
+static void play(unsigned int now, Player * p1, Player * p2)
+{
+	p1->waiting = p2->waiting = false;
+	matches++;
+	if (p1->region == p2->region)
+		same_region++;
+	returns[(now + 120 + rnd() % 480) % returns.size()].push_back(p1 - &pl[0]);
+	returns[(now + 120 + rnd() % 480) % returns.size()].push_back(p2 - &pl[0]);
+}
+
+/* ---- one list of everybody, as before ---- */
+
+static t_list * legacy;
+
+static void legacy_request(unsigned int now, Player * p)
+{
+	t_elem const * curr;
+
+	if (!p->listed) {
+		list_append_data(legacy, p);
+		p->listed = true;
+	}
+	p->waiting = true;
+
+	LIST_TRAVERSE_CONST(legacy, curr) {
+		Player * other = (Player *)elem_get_data(curr);
+		if (other != p && other->waiting && other->lobby == p->lobby) {
+			play(now, p, other);
+			return;
+		}
+	}
+}
+
+static void legacy_disconnect(Player * p)
+{
+	t_elem * curr;
+
+	if (p->listed)
+		require(list_remove_data(legacy, p, &curr) == 0);
+	p->listed = p->waiting = false;
+}
+
+/* ---- the queues ---- */
+
+static unsigned int region_wait;
+static std::vector<t_anongame_wol_queue *> queues;
+
+static void queue_request(unsigned int now, Player * p)
+{
+	t_anongame_wol_waiter * other;
+
+	p->waiting = true;
+	anongame_wol_queue_add(queues[p->lobby], &p->waiter, p->region, now);
+	if ((other = anongame_wol_queue_find_partner(&p->waiter, now, region_wait, check_waiter))) {
+		waited += now - other->since;
+		anongame_wol_queue_del(&p->waiter);
+		anongame_wol_queue_del(other);
+		play(now, p, from_waiter(other));
+	}
+}
+
+static void queue_disconnect(Player * p)
+{
+	anongame_wol_queue_del(&p->waiter);
+	p->waiting = false;
+}
+
+static void queue_check(unsigned int now)
+{
+	t_anongame_wol_waiter * w1;
+	t_anongame_wol_waiter * w2;
+
+	while (anongame_wol_queue_pop_expired(now, region_wait, check_waiter, &w1, &w2)) {
+		waited += 2 * now - w1->since - w2->since;
+		play(now, from_waiter(w1), from_waiter(w2));
+	}
+}
+
+static void run(char const * name, void (*request)(unsigned int, Player *), void (*disconnect)(Player *), void (*check)(unsigned int))
+{
+	unsigned long requests = 0;
+	unsigned int most = 0;
+
+	pl.assign(players, Player());
+	returns.assign(600, std::vector<unsigned int>());
+	matches = same_region = 0;
+	waited = 0;
+	rnd_state = 1;
+	for (unsigned int i = 0; i < players; i++) {
+		pl[i].lobby = i % lobbies;
+		pl[i].region = rnd() % regions;
+		anongame_wol_waiter_init(&pl[i].waiter);
+		returns[rnd() % returns.size()].push_back(i);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int now = 1; now <= seconds; now++) {
+		std::vector<unsigned int> back;
+		back.swap(returns[now % returns.size()]);
+		for (unsigned int i = 0; i < back.size(); i++, requests++)
+			request(now, &pl[back[i]]);
+		for (unsigned int i = 0; i < disconnects; i++) {
+			/* and somebody new asks in their place */
+			Player * p = &pl[rnd() % players];
+			disconnect(p);
+			request(now, p);
+			requests++;
+		}
+		if (check)
+			check(now);
+
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < players; i += 16)
+			count += pl[i].waiting;
+		if (count * 16 > most)
+			most = count * 16;
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	std::printf("%-8s %8lu requests %7.2f us each, %6lu matches, %5.1f%% in the region, %4.1f s waited, about %u waiting at most\n",
+		name, requests, std::chrono::duration<double, std::micro>(end - start).count() / requests,
+		matches, 100.0 * same_region / matches, matches ? waited / (2 * matches) : 0.0, most);
+}
+
+static void check_queue()
+{
+	t_anongame_wol_queue * solo = anongame_wol_queue_get("Lob 38 0");
+	t_anongame_wol_waiter * w1;
+	t_anongame_wol_waiter * w2;
+	Player a = Player(), b = Player(), c = Player();
+
+	require(anongame_wol_queue_get("lob 38 0") == solo);
+	anongame_wol_waiter_init(&a.waiter);
+	anongame_wol_waiter_init(&b.waiter);
+	anongame_wol_waiter_init(&c.waiter);
+	a.waiting = b.waiting = c.waiting = true;
+
+	/* regions are kept apart until one has waited 30 seconds */
+	anongame_wol_queue_add(solo, &a.waiter, 5, 100);
+	anongame_wol_queue_add(solo, &b.waiter, 6, 110);
+	require(anongame_wol_queue_find_partner(&b.waiter, 110, 30, check_waiter) == NULL);
+	require(anongame_wol_queue_find_partner(&b.waiter, 110, 0, check_waiter) == &a.waiter);
+	require(anongame_wol_queue_find_partner(&b.waiter, 130, 30, check_waiter) == &a.waiter);
+	require(!anongame_wol_queue_pop_expired(129, 30, check_waiter, &w1, &w2));
+
+	/* the same region is found, one gone from the lobby is taken out */
+	anongame_wol_queue_add(solo, &c.waiter, 5, 120);
+	require(anongame_wol_queue_find_partner(&c.waiter, 120, 30, check_waiter) == &a.waiter);
+	a.waiting = false;
+	require(anongame_wol_queue_find_partner(&c.waiter, 120, 30, check_waiter) == NULL);
+	require(a.waiter.queue == NULL && solo->count == 2);
+
+	require(anongame_wol_queue_pop_expired(140, 30, check_waiter, &w1, &w2));
+	require(w1 == &b.waiter && w2 == &c.waiter && solo->count == 0);
+	require(anongame_wol_queue_get_waiting() == 0);
+	anongame_wol_queue_del(&b.waiter);
+}
+
+int main()
+{
+	check_queue();
+
+	queues.clear();
+	for (unsigned int i = 0; i < lobbies; i++) {
+		char name[16];
+		std::sprintf(name, "Lob %u 0", 38 + i);
+		queues.push_back(anongame_wol_queue_get(name));
+	}
+
+	regions = 40;
+	legacy = list_create();
+	run("list", legacy_request, legacy_disconnect, NULL);
+	list_destroy(legacy);
+
+	regions = 40;
+	region_wait = 0;
+	run("queues", queue_request, queue_disconnect, NULL);
+	require(anongame_wol_queue_get_waiting() <= lobbies);
+	for (unsigned int i = 0; i < players; i++)
+		queue_disconnect(&pl[i]);
+
+	region_wait = 120;
+	run("regions", queue_request, queue_disconnect, queue_check);
+	for (unsigned int i = 0; i < players; i++)
+		queue_disconnect(&pl[i]);
+	require(anongame_wol_queue_get_waiting() == 0);
+
+	regions = 1000;
+	run("sparse", queue_request, queue_disconnect, queue_check);
+	for (unsigned int i = 0; i < players; i++)
+		queue_disconnect(&pl[i]);
+	require(anongame_wol_queue_get_waiting() == 0);
+
+	anongame_wol_queue_destroy_all();
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "common/setup_before.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "common/xalloc.h"
+
+#include "common/setup_after.h"
+
+using namespace pvpgn;
+
+/*
+ * Packet churn through xmalloc()/xfree(): a pool of live blocks, each step
+ * frees one and allocates another from one of two call sites. Run with the
+ * allocation profiler stopped and running, then check what it counted.
+ */
+static const unsigned int population = 10000;
+static const unsigned int steps = 2000000;
+
+#define require(cond) \
+	do { if (!(cond)) { std::cerr << __LINE__ << ": failed: " #cond "\n"; std::exit(1); } } while (0)
+
+static std::vector<void *> pool;
+
+/* deterministic so both runs see the same sequence */
+static unsigned int rnd_state;
+static unsigned int rnd()
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) & 0xffffff;
+}
+
+static void * small_alloc()
+{
+	return xmalloc(32);
+}
+
+static void * big_alloc()
+{
+	return xmalloc(512);
+}
+
+static double run(const char * name)
+{
+	unsigned int i, pos;
+
+	rnd_state = 1;
+	pool.resize(population);
+	for (i = 0; i < population; i++)
+		pool[i] = (i & 1) ? big_alloc() : small_alloc();
+
+	auto start = std::chrono::steady_clock::now();
+	for (i = 0; i < steps; i++) {
+		pos = rnd() % population;
+		xfree(pool[pos]);
+		pool[pos] = (pos & 1) ? big_alloc() : small_alloc();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double ns = std::chrono::duration<double, std::nano>(end - start).count() / steps;
+	std::printf("%-8s %6.1f ns per free and allocation over %u live blocks\n", name, ns, population);
+	return ns;
+}
+
+static void release()
+{
+	for (unsigned int i = 0; i < population; i++)
+		xfree(pool[i]);
+}
+
+int main()
+{
+	t_xalloc_site sites[4];
+
+	run("stopped");
+	require(xalloc_profile_get_length() == 0);
+	release();
+
+	xalloc_profile_start();
+	run("running");
+
+	/* the big blocks come first, each site holds half the pool */
+	require(xalloc_profile_get_top(sites, 4) == 2);
+	require(sites[0].live == 512UL * population / 2 && sites[0].blocks == population / 2);
+	require(sites[1].live == 32UL * population / 2 && sites[1].blocks == population / 2);
+	require(sites[0].allocs + sites[1].allocs == population + steps);
+	require(sites[0].frees + sites[1].frees == steps);
+	require(std::strcmp(sites[0].func, "big_alloc") == 0);
+
+	/* a reset keeps the live blocks, their frees are still counted */
+	xalloc_profile_reset();
+	release();
+	require(xalloc_profile_get_top(sites, 4) == 2);
+	t_xalloc_site * big = (std::strcmp(sites[0].func, "big_alloc") == 0) ? &sites[0] : &sites[1];
+	require(big->live == 0 && big->blocks == 0 && big->frees == population / 2);
+	require(big->allocs == 0 && big->peak == 512UL * population / 2);
+
+	xalloc_profile_stop();
+	require(!xalloc_profile_running() && xalloc_profile_get_length() == 0);
+
+	return 0;
+}
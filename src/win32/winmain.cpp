@@ -581,14 +581,14 @@ namespace pvpgn
 		extern void guiOnUpdateUserList()
 		{
 			t_connection * c;
-			t_elem const * curr;
+			t_elist * curr;
 			t_account * acc;
 
 			SendMessageW(gui.hwndUsers, LB_RESETCONTENT, 0, 0);
 
-			LIST_TRAVERSE_CONST(connlist(), curr)
+			elist_for_each(curr, connlist())
 			{
-				if (!(c = (t_connection *)elem_get_data(curr)))
+				if (!(c = connlist_get_conn(curr)))
 					continue;
 				if (!(acc = conn_get_account(c)))
 					continue;